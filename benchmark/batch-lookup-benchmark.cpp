@@ -0,0 +1,69 @@
+#include <bplustree.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace {
+
+using set = btree<std::int64_t, std::int64_t, btree_key_extractor_self>;
+
+constexpr std::size_t batch_size = 1024;
+
+set make_tree(std::int64_t size) {
+    std::vector<std::int64_t> values(static_cast<std::size_t>(size));
+    std::iota(values.begin(), values.end(), 0);
+    return set(values.begin(), values.end());
+}
+
+std::vector<std::int64_t> make_keys(std::int64_t size, bool sorted) {
+    std::mt19937_64 generator(42);
+    std::uniform_int_distribution<std::int64_t> distribution(0, size - 1);
+    std::vector<std::int64_t> keys(batch_size);
+    std::generate(keys.begin(), keys.end(), [&] { return distribution(generator); });
+    if (sorted) {
+        std::sort(keys.begin(), keys.end());
+    }
+    return keys;
+}
+
+void lower_bound_one_by_one(benchmark::State& state) {
+    const auto tree = make_tree(state.range(0));
+    const auto keys = make_keys(state.range(0), state.range(1) != 0);
+    for (auto _ : state) {
+        for (auto key : keys) {
+            benchmark::DoNotOptimize(tree.lower_bound(key));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(keys.size()));
+}
+
+void lower_bound_batched(benchmark::State& state) {
+    const auto tree = make_tree(state.range(0));
+    const auto keys = make_keys(state.range(0), state.range(1) != 0);
+    std::vector<set::const_iterator> result(keys.size());
+    for (auto _ : state) {
+        tree.lower_bound(keys, result);
+        benchmark::DoNotOptimize(result.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(keys.size()));
+}
+
+// Tree sizes from fitting in the L2 cache to well beyond the last level cache, with unsorted and sorted batches
+void batch_arguments(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgNames({"size", "sorted"});
+    for (std::int64_t size : {1 << 12, 1 << 16, 1 << 20, 1 << 24}) {
+        benchmark->Args({size, 0});
+        benchmark->Args({size, 1});
+    }
+}
+
+}  // namespace
+
+BENCHMARK(lower_bound_one_by_one)->Apply(batch_arguments);
+BENCHMARK(lower_bound_batched)->Apply(batch_arguments);
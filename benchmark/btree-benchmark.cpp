@@ -0,0 +1,723 @@
+#include <bplustree.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Benchmarks of the tree operations against std::set and std::map, for several key distributions, tree sizes and node
+ * sizes.
+ *
+ * Benchmarks are named `<container>/<operation>/<distribution>/size:<n>`, so that a filter such as
+ * `--benchmark_filter=/find/zipfian/` compares all the containers on one workload. Run the `bplustree-benchmark-json`
+ * target to store the results as JSON next to the executable, e.g. to compare them with tools/compare.py from Google
+ * Benchmark.
+ */
+
+namespace {
+
+using key_type = std::int64_t;
+
+/**
+ * Number of keys stored in the benchmarked containers: the smallest trees fit in the L1 cache, the largest ones are
+ * far bigger than the last level cache of most machines.
+ */
+constexpr std::int64_t sizes[] = {1 << 9, 1 << 13, 1 << 17, 1 << 20, 1 << 23};
+
+/**
+ * Number of precomputed probe keys, looped over by the lookup benchmarks.
+ */
+constexpr std::size_t probe_count = 1 << 16;
+
+enum class distribution { uniform, zipfian, sequential };
+
+constexpr distribution distributions[] = {distribution::uniform, distribution::zipfian, distribution::sequential};
+
+const char* to_string(distribution d) {
+    switch (d) {
+        case distribution::uniform:
+            return "uniform";
+        case distribution::zipfian:
+            return "zipfian";
+        case distribution::sequential:
+            return "sequential";
+    }
+    return "";
+}
+
+/**
+ * Zipfian distribution of ranks in [0, n), rank 0 being the most frequent one.
+ *
+ * @see Gray et al., Quickly Generating Billion-Record Synthetic Databases, SIGMOD 1994
+ */
+class zipfian_distribution {
+public:
+    explicit zipfian_distribution(std::int64_t count, double skew = 0.99)
+        : n(static_cast<double>(count)), theta(skew), alpha(1.0 / (1.0 - skew)), zetan(zeta(count, skew)) {
+        eta = (1.0 - std::pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta(2, theta) / zetan);
+    }
+
+    template <typename Generator>
+    std::int64_t operator()(Generator& generator) {
+        const double u = std::uniform_real_distribution<double>(0.0, 1.0)(generator);
+        const double uz = u * zetan;
+        if (uz < 1.0) {
+            return 0;
+        }
+        if (uz < 1.0 + std::pow(0.5, theta)) {
+            return 1;
+        }
+        const auto rank = static_cast<std::int64_t>(n * std::pow(eta * u - eta + 1.0, alpha));
+        return std::min(rank, static_cast<std::int64_t>(n) - 1);
+    }
+
+private:
+    static double zeta(std::int64_t count, double skew) {
+        double sum = 0.0;
+        for (std::int64_t i = 1; i <= count; ++i) {
+            sum += 1.0 / std::pow(static_cast<double>(i), skew);
+        }
+        return sum;
+    }
+
+    double n;
+    double theta;
+    double alpha;
+    double zetan;
+    double eta{};
+};
+
+/**
+ * The i-th key stored in a benchmarked container. Keys are spaced so that lookups between them can be benchmarked.
+ */
+constexpr key_type stored_key(std::int64_t i) {
+    return 2 * i;
+}
+
+/**
+ * Value stored for `key` in a set-like container, or in a map-like one, mapping the key to itself.
+ */
+template <typename Container>
+auto value_of(key_type key) {
+    if constexpr (std::is_same_v<typename Container::value_type, key_type>) {
+        return key;
+    } else {
+        return std::pair<key_type, key_type>(key, key);
+    }
+}
+
+key_type key_of(key_type value) {
+    return value;
+}
+template <typename Key>
+key_type key_of(const std::pair<Key, key_type>& value) {
+    return value.first;
+}
+
+/**
+ * Draw `count` ranks in [0, size) following the distribution `d`.
+ *
+ * Zipfian ranks are scattered over the whole key space, so that the frequent keys are not all in the same leaf.
+ */
+std::vector<std::int64_t> make_ranks(std::int64_t size, distribution d, std::size_t count) {
+    std::mt19937_64 generator(42);
+    std::vector<std::int64_t> ranks(count);
+    switch (d) {
+        case distribution::uniform: {
+            std::uniform_int_distribution<std::int64_t> uniform(0, size - 1);
+            std::generate(ranks.begin(), ranks.end(), [&] { return uniform(generator); });
+            break;
+        }
+        case distribution::zipfian: {
+            zipfian_distribution zipfian(size);
+            std::generate(ranks.begin(), ranks.end(), [&] {
+                const auto scattered = static_cast<std::uint64_t>(zipfian(generator)) * 0x9E3779B97F4A7C15ull;
+                return static_cast<std::int64_t>(scattered % static_cast<std::uint64_t>(size));
+            });
+            break;
+        }
+        case distribution::sequential:
+            for (std::size_t i = 0; i < count; ++i) {
+                ranks[i] = static_cast<std::int64_t>(i) % size;
+            }
+            break;
+    }
+    return ranks;
+}
+
+/**
+ * Keys of the lookups performed on a container of `size` keys. Each key is stored in the container.
+ * Probes are generated once per size and distribution, since a benchmark function is run several times.
+ */
+const std::vector<key_type>& probes_for(std::int64_t size, distribution d) {
+    static std::map<std::pair<std::int64_t, distribution>, std::vector<key_type>> cache;
+    auto& probes = cache[{size, d}];
+    if (probes.empty()) {
+        probes = make_ranks(size, d, probe_count);
+        std::transform(probes.begin(), probes.end(), probes.begin(), stored_key);
+    }
+    return probes;
+}
+
+/**
+ * A new container holding the first `size` stored keys.
+ */
+template <typename Container>
+std::unique_ptr<Container> make_container(std::int64_t size) {
+    std::vector<decltype(value_of<Container>(0))> values(static_cast<std::size_t>(size));
+    for (std::int64_t i = 0; i < size; ++i) {
+        values[static_cast<std::size_t>(i)] = value_of<Container>(stored_key(i));
+    }
+    return std::make_unique<Container>(values.begin(), values.end());
+}
+
+/**
+ * The container of `size` keys shared by the benchmarks of a given container type, rebuilt when the size changes.
+ * Only the last one is kept, since benchmarks are run by increasing sizes.
+ */
+template <typename Container>
+const Container& shared_container(std::int64_t size) {
+    static std::int64_t cached_size = -1;
+    static std::unique_ptr<Container> container;
+    if (cached_size != size) {
+        container.reset();
+        container = make_container<Container>(size);
+        cached_size = size;
+    }
+    return *container;
+}
+
+template <typename Container>
+void find(benchmark::State& state, std::int64_t size, distribution d) {
+    const auto& container = shared_container<Container>(size);
+    const auto& probes = probes_for(size, d);
+    std::size_t i = 0;
+    for (auto _ : state) {
+        const key_type key = probes[i++ % probe_count];
+        auto it = container.lower_bound(key);
+        benchmark::DoNotOptimize(it != container.end() && key_of(*it) == key);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+template <typename Container>
+void lower_bound(benchmark::State& state, std::int64_t size, distribution d) {
+    const auto& container = shared_container<Container>(size);
+    const auto& probes = probes_for(size, d);
+    std::size_t i = 0;
+    for (auto _ : state) {
+        // Probe between two stored keys
+        benchmark::DoNotOptimize(container.lower_bound(probes[i++ % probe_count] - 1));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+template <typename Container>
+void upper_bound(benchmark::State& state, std::int64_t size, distribution d) {
+    const auto& container = shared_container<Container>(size);
+    const auto& probes = probes_for(size, d);
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(container.upper_bound(probes[i++ % probe_count]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+template <typename Container>
+void iterate_forward(benchmark::State& state, std::int64_t size) {
+    const auto& container = shared_container<Container>(size);
+    for (auto _ : state) {
+        key_type sum = 0;
+        for (auto it = container.begin(); it != container.end(); ++it) {
+            sum += key_of(*it);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * size);
+}
+
+template <typename Container>
+void iterate_reverse(benchmark::State& state, std::int64_t size) {
+    const auto& container = shared_container<Container>(size);
+    for (auto _ : state) {
+        key_type sum = 0;
+        for (auto it = container.rbegin(); it != container.rend(); ++it) {
+            sum += key_of(*it);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * size);
+}
+
+/**
+ * Same as iterate_forward, processing the values of one leaf at a time.
+ */
+template <typename Container>
+void scan_leaf_spans(benchmark::State& state, std::int64_t size) {
+    const auto& container = shared_container<Container>(size);
+    for (auto _ : state) {
+        key_type sum = 0;
+        container.for_each_leaf_span([&](const auto& span) {
+            for (const auto& value : span) {
+                sum += key_of(value);
+            }
+        });
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * size);
+}
+
+/**
+ * Build a whole container from keys arriving in the order given by the distribution. Zipfian keys are not distinct,
+ * so this workload is only run on the uniform (shuffled) and sequential (sorted) orders.
+ */
+template <typename Container>
+void build(benchmark::State& state, std::int64_t size, distribution d) {
+    std::vector<decltype(value_of<Container>(0))> values(static_cast<std::size_t>(size));
+    for (std::int64_t i = 0; i < size; ++i) {
+        values[static_cast<std::size_t>(i)] = value_of<Container>(stored_key(i));
+    }
+    if (d == distribution::uniform) {
+        std::shuffle(values.begin(), values.end(), std::mt19937_64(42));
+    }
+    for (auto _ : state) {
+        Container container(values.begin(), values.end());
+        benchmark::DoNotOptimize(container.begin());
+    }
+    state.SetItemsProcessed(state.iterations() * size);
+}
+
+/**
+ * Read-mostly workload: 90% of point lookups and 10% of short range scans of 16 keys.
+ */
+template <typename Container>
+void mixed(benchmark::State& state, std::int64_t size, distribution d) {
+    const auto& container = shared_container<Container>(size);
+    const auto& probes = probes_for(size, d);
+    std::size_t i = 0;
+    for (auto _ : state) {
+        const key_type key = probes[i % probe_count];
+        auto it = container.lower_bound(key);
+        if (i++ % 10 == 0) {
+            key_type sum = 0;
+            for (int n = 0; n < 16 && it != container.end(); ++n, ++it) {
+                sum += key_of(*it);
+            }
+            benchmark::DoNotOptimize(sum);
+        } else {
+            benchmark::DoNotOptimize(it != container.end() && key_of(*it) == key);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+enum class write_workload { insert, erase, mix };
+
+/**
+ * Writes at keys drawn from the distribution `d` in a container of `size` keys:
+ *   - insert: insertions of new keys, each one between two stored keys,
+ *   - erase: erasures of stored keys, which may already be erased when drawn again,
+ *   - mix: 50% of point lookups, 25% of insertions and 25% of erasures, like an update-heavy key-value workload.
+ *
+ * The container is rebuilt while the timing is paused once the writes may have changed up to half of its keys, so that
+ * its size does not drift.
+ */
+template <typename Container, write_workload workload>
+void write(benchmark::State& state, std::int64_t size, distribution d) {
+    const auto& probes = probes_for(size, d);
+    const auto rebuild_period = std::min<std::size_t>(probe_count, static_cast<std::size_t>(size / 2));
+    std::unique_ptr<Container> container;
+    std::size_t i = 0;
+    for (auto _ : state) {
+        if (i % rebuild_period == 0) {
+            state.PauseTiming();
+            container.reset();
+            container = make_container<Container>(size);
+            state.ResumeTiming();
+        }
+        const std::size_t step = i++;
+        const key_type key = probes[step % probe_count];
+        if constexpr (workload == write_workload::insert) {
+            container->insert(value_of<Container>(key + 1));
+        } else if constexpr (workload == write_workload::erase) {
+            benchmark::DoNotOptimize(container->erase(key));
+        } else {
+            switch (step % 4) {
+                case 0:
+                    container->insert(value_of<Container>(key + 1));
+                    break;
+                case 1:
+                    benchmark::DoNotOptimize(container->erase(key));
+                    break;
+                default: {
+                    auto it = container->lower_bound(key);
+                    benchmark::DoNotOptimize(it != container->end() && key_of(*it) == key);
+                }
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+template <int LeafSlots, int InnerSlots>
+struct sized_traits : btree_default_traits<key_type, key_type> {
+    static const int leaf_slots = LeafSlots;
+    static const int inner_slots = InnerSlots;
+};
+
+template <typename Traits = btree_default_traits<key_type, key_type>>
+using btree_set = btree<key_type, key_type, btree_key_extractor_self, std::less<key_type>, Traits>;
+
+using map_value_type = std::pair<key_type, key_type>;
+
+template <typename Traits = btree_default_traits<key_type, map_value_type>>
+using btree_map = btree<key_type, map_value_type, btree_key_extractor_pair, std::less<key_type>, Traits>;
+
+template <typename Container>
+constexpr bool is_std_container_v =
+    std::is_same_v<Container, std::set<key_type>> || std::is_same_v<Container, std::map<key_type, key_type>>;
+
+template <typename Container>
+void register_container(const std::string& name) {
+    for (const auto size : sizes) {
+        const auto suffix = "/size:" + std::to_string(size);
+        for (const auto d : distributions) {
+            const auto infix = std::string("/") + to_string(d);
+            benchmark::RegisterBenchmark((name + "/find" + infix + suffix).c_str(), find<Container>, size, d);
+            benchmark::RegisterBenchmark((name + "/lower_bound" + infix + suffix).c_str(), lower_bound<Container>,
+                                         size, d);
+            benchmark::RegisterBenchmark((name + "/upper_bound" + infix + suffix).c_str(), upper_bound<Container>,
+                                         size, d);
+            benchmark::RegisterBenchmark((name + "/mixed" + infix + suffix).c_str(), mixed<Container>, size, d);
+            benchmark::RegisterBenchmark((name + "/point_insert" + infix + suffix).c_str(),
+                                         write<Container, write_workload::insert>, size, d);
+            benchmark::RegisterBenchmark((name + "/point_erase" + infix + suffix).c_str(),
+                                         write<Container, write_workload::erase>, size, d);
+            benchmark::RegisterBenchmark((name + "/write_mix" + infix + suffix).c_str(),
+                                         write<Container, write_workload::mix>, size, d);
+            if (d != distribution::zipfian) {
+                benchmark::RegisterBenchmark((name + "/build" + infix + suffix).c_str(), build<Container>, size, d);
+            }
+        }
+        benchmark::RegisterBenchmark((name + "/iterate_forward" + suffix).c_str(), iterate_forward<Container>, size);
+        benchmark::RegisterBenchmark((name + "/iterate_reverse" + suffix).c_str(), iterate_reverse<Container>, size);
+        if constexpr (!is_std_container_v<Container>) {
+            benchmark::RegisterBenchmark((name + "/scan_leaf_spans" + suffix).c_str(), scan_leaf_spans<Container>,
+                                         size);
+        }
+    }
+}
+
+/**
+ * Sorted URL-like keys, sharing long prefixes.
+ */
+std::vector<std::string> make_urls(std::int64_t size) {
+    std::vector<std::string> urls;
+    urls.reserve(static_cast<std::size_t>(size));
+    for (std::int64_t i = 0; i < size; ++i) {
+        urls.push_back("https://www.example.com/static/assets/" + std::to_string(i % 16) + "/images/thumbnail-" +
+                       std::to_string(i * 7919));
+    }
+    std::sort(urls.begin(), urls.end());
+    return urls;
+}
+
+/**
+ * Point lookups of uniformly distributed string keys.
+ */
+template <typename Container>
+void find_string(benchmark::State& state, std::int64_t size) {
+    const auto urls = make_urls(size);
+    const Container container(urls.begin(), urls.end());
+    const auto ranks = make_ranks(size, distribution::uniform, probe_count);
+    std::size_t i = 0;
+    for (auto _ : state) {
+        const std::string& key = urls[static_cast<std::size_t>(ranks[i++ % probe_count])];
+        auto it = container.lower_bound(key);
+        benchmark::DoNotOptimize(it != container.end() && *it == key);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/**
+ * Point lookups of uniformly distributed string keys given as `std::string_view`, as when parsed from a buffer. With a
+ * transparent comparator, the probes are compared as is, otherwise each one is first converted to a `std::string`.
+ */
+template <typename Container>
+void find_string_view(benchmark::State& state, std::int64_t size) {
+    const auto urls = make_urls(size);
+    const Container container(urls.begin(), urls.end());
+    const auto ranks = make_ranks(size, distribution::uniform, probe_count);
+    std::size_t i = 0;
+    for (auto _ : state) {
+        const std::string_view key = urls[static_cast<std::size_t>(ranks[i++ % probe_count])];
+        typename Container::const_iterator it;
+        if constexpr (detail::is_transparent_v<typename Container::key_compare_type>) {
+            it = container.lower_bound(key);
+        } else {
+            it = container.lower_bound(std::string(key));
+        }
+        benchmark::DoNotOptimize(it != container.end() && *it == key);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+template <typename Traits, typename Compare = std::less<std::string>>
+using btree_string_set = btree<std::string, std::string, btree_key_extractor_self, Compare, Traits>;
+
+void register_string_containers() {
+    for (const std::int64_t size : {1 << 10, 1 << 14, 1 << 17, 1 << 20}) {
+        const auto suffix = "/find/uniform/size:" + std::to_string(size);
+        benchmark::RegisterBenchmark(("std::set<string>" + suffix).c_str(), find_string<std::set<std::string>>, size);
+        benchmark::RegisterBenchmark(("btree<string,default>" + suffix).c_str(),
+                                     find_string<btree_string_set<btree_default_traits<std::string, std::string>>>,
+                                     size);
+        benchmark::RegisterBenchmark(("btree<string,prefix_compressed>" + suffix).c_str(),
+                                     find_string<btree_string_set<btree_string_traits<std::string, std::string>>>,
+                                     size);
+        const auto view_suffix = "/find_view/uniform/size:" + std::to_string(size);
+        benchmark::RegisterBenchmark(("btree<string,default>" + view_suffix).c_str(),
+                                     find_string_view<btree_string_set<btree_default_traits<std::string, std::string>>>,
+                                     size);
+        benchmark::RegisterBenchmark(
+            ("btree<string,default,transparent>" + view_suffix).c_str(),
+            find_string_view<btree_string_set<btree_default_traits<std::string, std::string>, std::less<>>>, size);
+    }
+}
+
+struct sum_traits : btree_default_traits<key_type, key_type> {
+    using aggregate = btree_sum_aggregate<key_type>;
+};
+
+/**
+ * Sum of the keys in windows spanning 1/16 of the key space, by iterating over the window or by combining the cached
+ * subtree aggregates.
+ */
+template <bool use_aggregate>
+void window_sum(benchmark::State& state, std::int64_t size) {
+    const auto& container = shared_container<btree_set<sum_traits>>(size);
+    const auto& probes = probes_for(size, distribution::uniform);
+    const key_type width = stored_key(size / 16);
+    std::size_t i = 0;
+    for (auto _ : state) {
+        const key_type lower = probes[i++ % probe_count];
+        key_type sum = 0;
+        if constexpr (use_aggregate) {
+            sum = container.aggregate(lower, lower + width);
+        } else {
+            for (auto it = container.lower_bound(lower); it != container.end() && *it < lower + width; ++it) {
+                sum += *it;
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void register_window_sums() {
+    for (const auto size : sizes) {
+        const auto suffix = "/window_sum/uniform/size:" + std::to_string(size);
+        benchmark::RegisterBenchmark(("btree<iterate>" + suffix).c_str(), window_sum<false>, size);
+        benchmark::RegisterBenchmark(("btree<aggregate>" + suffix).c_str(), window_sum<true>, size);
+    }
+}
+
+/**
+ * Expire the oldest half of the keys, like a retention cutoff, either with a range erase or by destroying a tree of the
+ * same number of keys, which is the cost of freeing its nodes.
+ */
+template <bool use_erase>
+void expire_half(benchmark::State& state, std::int64_t size) {
+    std::vector<key_type> keys(static_cast<std::size_t>(size));
+    for (std::int64_t i = 0; i < size; ++i) {
+        keys[static_cast<std::size_t>(i)] = stored_key(i);
+    }
+    const auto middle = keys.begin() + static_cast<std::ptrdiff_t>(size / 2);
+    // Built and destroyed while the timing is paused, except for what is measured
+    std::unique_ptr<btree_set<>> container;
+    for (auto _ : state) {
+        state.PauseTiming();
+        container = std::make_unique<btree_set<>>(keys.begin(), use_erase ? keys.end() : middle);
+        state.ResumeTiming();
+        if constexpr (use_erase) {
+            benchmark::DoNotOptimize(container->erase_range(keys.front(), *middle));
+        } else {
+            container.reset();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * (size / 2));
+}
+
+void register_expirations() {
+    for (const auto size : sizes) {
+        const auto suffix = "/expire_half/sequential/size:" + std::to_string(size);
+        benchmark::RegisterBenchmark(("btree<erase_range>" + suffix).c_str(), expire_half<true>, size);
+        benchmark::RegisterBenchmark(("btree<destroy>" + suffix).c_str(), expire_half<false>, size);
+    }
+}
+
+/**
+ * Move the keys from a uniformly drawn key onwards to another tree and back, like a shard rebalancing, either by
+ * splitting and joining the trees or by copying the keys to a new tree and merging it back.
+ */
+template <bool use_split>
+void reshard(benchmark::State& state, std::int64_t size) {
+    std::vector<key_type> keys(static_cast<std::size_t>(size));
+    for (std::int64_t i = 0; i < size; ++i) {
+        keys[static_cast<std::size_t>(i)] = stored_key(i);
+    }
+    btree_set<> container(keys.begin(), keys.end());
+    const auto& probes = probes_for(size, distribution::uniform);
+    std::size_t i = 0;
+    for (auto _ : state) {
+        const key_type key = probes[i++ % probe_count];
+        if constexpr (use_split) {
+            btree_set<> upper = container.split(key);
+            container.join(upper);
+        } else {
+            btree_set<> upper(container.lower_bound(key), container.end());
+            btree_set<> lower(container.begin(), container.lower_bound(key));
+            lower.merge(upper);
+            container = std::move(lower);
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void register_reshards() {
+    for (const auto size : sizes) {
+        const auto suffix = "/reshard/uniform/size:" + std::to_string(size);
+        benchmark::RegisterBenchmark(("btree<split_join>" + suffix).c_str(), reshard<true>, size);
+        benchmark::RegisterBenchmark(("btree<copy_merge>" + suffix).c_str(), reshard<false>, size);
+    }
+}
+
+enum class lookup_start { root, hint, cursor };
+
+/**
+ * Lower bounds of increasing keys, each one at most `max_gap` stored keys after the previous one, like a merge-join
+ * against a sorted stream. Each lookup starts from the root, from the result of the previous one, or from the position
+ * of a seek cursor.
+ */
+template <lookup_start start>
+void nearby_lookups(benchmark::State& state, std::int64_t size, std::int64_t max_gap) {
+    const auto& container = shared_container<btree_set<>>(size);
+    std::mt19937_64 generator(42);
+    std::uniform_int_distribution<std::int64_t> gap(1, max_gap);
+    std::vector<key_type> probes(probe_count);
+    std::int64_t rank = 0;
+    for (auto& probe : probes) {
+        rank = (rank + gap(generator)) % size;
+        probe = stored_key(rank);
+    }
+    std::size_t i = 0;
+    auto it = container.begin();
+    auto cursor = container.seek_cursor();
+    for (auto _ : state) {
+        const key_type key = probes[i++ % probe_count];
+        if constexpr (start == lookup_start::root) {
+            benchmark::DoNotOptimize(it = container.lower_bound(key));
+        } else if constexpr (start == lookup_start::hint) {
+            benchmark::DoNotOptimize(it = container.lower_bound(it, key));
+        } else {
+            benchmark::DoNotOptimize(cursor.seek(key));
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void register_nearby_lookups() {
+    for (const auto size : sizes) {
+        for (const std::int64_t max_gap : {4, 64, 1024}) {
+            const auto suffix = "/nearby_lookup/gap:" + std::to_string(max_gap) + "/size:" + std::to_string(size);
+            benchmark::RegisterBenchmark(("btree<root>" + suffix).c_str(), nearby_lookups<lookup_start::root>, size,
+                                         max_gap);
+            benchmark::RegisterBenchmark(("btree<hint>" + suffix).c_str(), nearby_lookups<lookup_start::hint>, size,
+                                         max_gap);
+            benchmark::RegisterBenchmark(("btree<cursor>" + suffix).c_str(), nearby_lookups<lookup_start::cursor>,
+                                         size, max_gap);
+        }
+    }
+}
+
+/**
+ * Insert keys one by one into an empty container, in sorted order or nearly so (one key out of ten swapped with one of
+ * the next 8 keys), either plainly or with end() as hint.
+ */
+template <typename Container, bool hinted>
+void insert_keys(benchmark::State& state, std::int64_t size, bool nearly_sorted) {
+    std::vector<key_type> keys(static_cast<std::size_t>(size));
+    for (std::int64_t i = 0; i < size; ++i) {
+        keys[static_cast<std::size_t>(i)] = stored_key(i);
+    }
+    if (nearly_sorted) {
+        std::mt19937_64 generator(42);
+        for (std::size_t i = 0; i + 8 < keys.size(); i += 10) {
+            std::swap(keys[i], keys[i + std::uniform_int_distribution<std::size_t>(1, 8)(generator)]);
+        }
+    }
+    for (auto _ : state) {
+        Container container;
+        for (const key_type key : keys) {
+            if constexpr (hinted) {
+                container.insert(container.end(), value_of<Container>(key));
+            } else {
+                container.insert(value_of<Container>(key));
+            }
+        }
+        benchmark::DoNotOptimize(container.begin());
+    }
+    state.SetItemsProcessed(state.iterations() * size);
+}
+
+template <typename Container>
+void register_inserts(const std::string& name) {
+    for (const auto size : sizes) {
+        const auto suffix = "/size:" + std::to_string(size);
+        for (const bool nearly_sorted : {false, true}) {
+            const std::string order = nearly_sorted ? "/nearly_sorted" : "/sequential";
+            benchmark::RegisterBenchmark((name + "/insert" + order + suffix).c_str(), insert_keys<Container, false>,
+                                         size, nearly_sorted);
+            benchmark::RegisterBenchmark((name + "/insert_hint" + order + suffix).c_str(),
+                                         insert_keys<Container, true>, size, nearly_sorted);
+        }
+    }
+}
+
+[[maybe_unused]] const bool registered = [] {
+    register_container<std::set<key_type>>("std::set");
+    register_container<btree_set<>>("btree<default>");
+    register_container<btree_set<btree_compact_traits<key_type, key_type>>>("btree<compact>");
+    register_container<btree_set<sized_traits<16, 16>>>("btree<leaf:16,inner:16>");
+    register_container<btree_set<sized_traits<64, 32>>>("btree<leaf:64,inner:32>");
+    register_container<btree_set<sized_traits<128, 64>>>("btree<leaf:128,inner:64>");
+    register_container<btree_set<sized_traits<256, 128>>>("btree<leaf:256,inner:128>");
+    register_container<std::map<key_type, key_type>>("std::map");
+    register_container<btree_map<>>("btree<map,values>");
+    register_container<btree_map<btree_separate_keys_traits<key_type, map_value_type>>>("btree<map,separate_keys>");
+    register_string_containers();
+    register_window_sums();
+    register_expirations();
+    register_reshards();
+    register_nearby_lookups();
+    register_inserts<std::set<key_type>>("std::set");
+    register_inserts<btree_set<>>("btree<default>");
+    register_inserts<btree_set<btree_compact_traits<key_type, key_type>>>("btree<compact>");
+    register_inserts<std::map<key_type, key_type>>("std::map");
+    register_inserts<btree_map<>>("btree<map,values>");
+    register_inserts<btree_map<btree_separate_keys_traits<key_type, map_value_type>>>("btree<map,separate_keys>");
+    return true;
+}();
+
+}  // namespace
@@ -0,0 +1,110 @@
+#include <bplustree_buffered.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace {
+
+using set = btree<std::int64_t, std::int64_t, btree_key_extractor_self>;
+using buffered_set = buffered_btree<std::int64_t, std::int64_t, btree_key_extractor_self>;
+
+constexpr std::size_t probe_count = 1 << 16;
+
+std::vector<std::int64_t> make_keys(std::size_t count, std::uint64_t seed) {
+    std::mt19937_64 generator(seed);
+    std::uniform_int_distribution<std::int64_t> distribution;
+    std::vector<std::int64_t> keys(count);
+    std::generate(keys.begin(), keys.end(), [&] { return distribution(generator); });
+    return keys;
+}
+
+/**
+ * Insertion of `size` random keys into an empty container, by `insert`.
+ */
+template <typename Container, typename Insert>
+void random_inserts(benchmark::State& state, Insert insert) {
+    const auto keys = make_keys(static_cast<std::size_t>(state.range(0)), 42);
+    for (auto _ : state) {
+        Container container;
+        for (const std::int64_t key : keys) {
+            insert(container, key);
+        }
+        benchmark::DoNotOptimize(container.begin());
+        state.PauseTiming();
+        container.clear();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void btree_random_inserts(benchmark::State& state) {
+    random_inserts<set>(state, [](set& s, std::int64_t key) { s.insert(key); });
+}
+
+void buffered_random_inserts(benchmark::State& state) {
+    random_inserts<buffered_set>(state, [](buffered_set& s, std::int64_t key) { s.insert(key); });
+}
+
+/**
+ * Random lookups of present keys by `lookup` once `size` random keys are inserted, with `flush` applied to the container
+ * first.
+ */
+template <typename Container, typename Flush, typename Lookup>
+void random_lookups(benchmark::State& state, Flush flush, Lookup lookup) {
+    const auto keys = make_keys(static_cast<std::size_t>(state.range(0)), 42);
+    Container container;
+    for (const std::int64_t key : keys) {
+        container.insert(key);
+    }
+    flush(container);
+    std::vector<std::int64_t> probes(probe_count);
+    std::mt19937_64 generator(7);
+    std::uniform_int_distribution<std::size_t> distribution(0, keys.size() - 1);
+    std::generate(probes.begin(), probes.end(), [&] { return keys[distribution(generator)]; });
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(lookup(container, probes[i++ % probe_count]));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+bool contains(const buffered_set& s, std::int64_t key) {
+    return s.contains(key);
+}
+
+void btree_random_lookups(benchmark::State& state) {
+    random_lookups<set>(state, [](set&) {}, [](const set& s, std::int64_t key) {
+        const auto it = s.lower_bound(key);
+        return it != s.end() && *it == key;
+    });
+}
+
+// Lookups searching the buffers along the path, with most of the inserted keys still pending
+void buffered_random_lookups(benchmark::State& state) {
+    random_lookups<buffered_set>(state, [](buffered_set&) {}, contains);
+}
+
+void buffered_flushed_random_lookups(benchmark::State& state) {
+    random_lookups<buffered_set>(state, [](buffered_set& s) { s.flush(); }, contains);
+}
+
+// Sizes from fitting in the L2 cache to well beyond the last level cache
+void sizes(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgName("size");
+    for (std::int64_t size : {1 << 16, 1 << 20, 1 << 23}) {
+        benchmark->Arg(size);
+    }
+}
+
+}  // namespace
+
+BENCHMARK(btree_random_inserts)->Apply(sizes)->Unit(benchmark::kMillisecond);
+BENCHMARK(buffered_random_inserts)->Apply(sizes)->Unit(benchmark::kMillisecond);
+BENCHMARK(btree_random_lookups)->Apply(sizes);
+BENCHMARK(buffered_random_lookups)->Apply(sizes);
+BENCHMARK(buffered_flushed_random_lookups)->Apply(sizes);
@@ -0,0 +1,104 @@
+#include <bplustree_concurrent.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+
+namespace {
+
+constexpr std::int64_t initial_size = 1 << 20;
+
+int max_threads() {
+    return static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+using concurrent_set = concurrent_btree<std::int64_t, std::int64_t, btree_key_extractor_self>;
+
+/**
+ * Baseline: a std::map shared by all threads behind a single reader-writer lock.
+ */
+struct locked_map {
+    std::map<std::int64_t, std::int64_t> map;
+    mutable std::shared_mutex mutex;
+
+    void insert(std::int64_t key) {
+        std::unique_lock lock(mutex);
+        map.emplace(key, key);
+    }
+
+    bool lower_bound(std::int64_t key) const {
+        std::shared_lock lock(mutex);
+        return map.lower_bound(key) != map.end();
+    }
+};
+
+concurrent_set& shared_concurrent_set() {
+    static concurrent_set* tree = [] {
+        auto* t = new concurrent_set;
+        for (std::int64_t i = 0; i < initial_size; ++i) {
+            t->insert(i * 2);
+        }
+        return t;
+    }();
+    return *tree;
+}
+
+locked_map& shared_locked_map() {
+    static locked_map* map = [] {
+        auto* m = new locked_map;
+        for (std::int64_t i = 0; i < initial_size; ++i) {
+            m->map.emplace(i * 2, i * 2);
+        }
+        return m;
+    }();
+    return *map;
+}
+
+/**
+ * Run a workload on `container` where `write_percent` of the operations insert a random key and the other ones
+ * look up a random key.
+ */
+template <typename Container>
+void run_mixed_workload(benchmark::State& state, Container& container, int write_percent) {
+    std::mt19937_64 rng(static_cast<std::uint64_t>(state.thread_index()));
+    std::uniform_int_distribution<std::int64_t> keys(0, initial_size * 2);
+    std::uniform_int_distribution<int> percent(0, 99);
+    for (auto _ : state) {
+        const std::int64_t key = keys(rng);
+        if (percent(rng) < write_percent) {
+            container.insert(key);
+        } else {
+            benchmark::DoNotOptimize(container.lower_bound(key));
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+void concurrent_btree_read_only(benchmark::State& state) {
+    run_mixed_workload(state, shared_concurrent_set(), 0);
+}
+
+void concurrent_btree_read_mostly(benchmark::State& state) {
+    run_mixed_workload(state, shared_concurrent_set(), 10);
+}
+
+void locked_map_read_only(benchmark::State& state) {
+    run_mixed_workload(state, shared_locked_map(), 0);
+}
+
+void locked_map_read_mostly(benchmark::State& state) {
+    run_mixed_workload(state, shared_locked_map(), 10);
+}
+
+}  // namespace
+
+BENCHMARK(concurrent_btree_read_only)->ThreadRange(1, max_threads())->UseRealTime();
+BENCHMARK(concurrent_btree_read_mostly)->ThreadRange(1, max_threads())->UseRealTime();
+BENCHMARK(locked_map_read_only)->ThreadRange(1, max_threads())->UseRealTime();
+BENCHMARK(locked_map_read_mostly)->ThreadRange(1, max_threads())->UseRealTime();
@@ -0,0 +1,141 @@
+#include <bplustree_frozen.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <vector>
+
+namespace {
+
+std::atomic<std::size_t> allocated_bytes{0};
+
+/**
+ * Allocator counting the bytes currently allocated through it, to compare the memory used by the containers.
+ */
+template <typename T>
+struct counting_allocator {
+    using value_type = T;
+
+    counting_allocator() = default;
+
+    template <typename U>
+    counting_allocator(const counting_allocator<U>&) noexcept {}
+
+    T* allocate(std::size_t n) {
+        allocated_bytes.fetch_add(n * sizeof(T), std::memory_order_relaxed);
+        return std::allocator<T>{}.allocate(n);
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept {
+        allocated_bytes.fetch_sub(n * sizeof(T), std::memory_order_relaxed);
+        std::allocator<T>{}.deallocate(p, n);
+    }
+
+    template <typename U>
+    bool operator==(const counting_allocator<U>&) const noexcept {
+        return true;
+    }
+};
+
+using traits = btree_default_traits<std::int64_t, std::int64_t>;
+using set = btree<std::int64_t,
+                  std::int64_t,
+                  btree_key_extractor_self,
+                  std::less<std::int64_t>,
+                  traits,
+                  counting_allocator<std::int64_t>>;
+using frozen_set = frozen_btree<std::int64_t,
+                                std::int64_t,
+                                btree_key_extractor_self,
+                                std::less<std::int64_t>,
+                                traits,
+                                counting_allocator<std::int64_t>>;
+
+constexpr std::size_t probe_count = 1 << 16;
+
+// Odd keys, so that half of the probes fall between two keys
+set make_tree(std::int64_t size) {
+    std::vector<std::int64_t> values(static_cast<std::size_t>(size));
+    std::iota(values.begin(), values.end(), 0);
+    std::transform(values.begin(), values.end(), values.begin(), [](std::int64_t v) { return v * 2 + 1; });
+    return set(values.begin(), values.end());
+}
+
+std::vector<std::int64_t> make_probes(std::int64_t size) {
+    std::mt19937_64 generator(42);
+    std::uniform_int_distribution<std::int64_t> distribution(0, size * 2);
+    std::vector<std::int64_t> probes(probe_count);
+    std::generate(probes.begin(), probes.end(), [&] { return distribution(generator); });
+    return probes;
+}
+
+/**
+ * Random lookups in the container built by `make`, reporting the bytes it uses per value as `bytes_per_value`.
+ */
+template <typename Make>
+void lower_bound(benchmark::State& state, Make make) {
+    const auto before = allocated_bytes.load();
+    const auto container = make();
+    const auto bytes = static_cast<double>(allocated_bytes.load() - before);
+    const auto probes = make_probes(state.range(0));
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(container.lower_bound(probes[i++ % probe_count]));
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["bytes_per_value"] = bytes / static_cast<double>(container.size());
+}
+
+void btree_lower_bound(benchmark::State& state) {
+    lower_bound(state, [&] { return make_tree(state.range(0)); });
+}
+
+void frozen_lower_bound(benchmark::State& state) {
+    lower_bound(state, [&] { return freeze(make_tree(state.range(0))); });
+}
+
+// Baseline: binary search of the sorted values, which have no memory overhead
+void sorted_vector_lower_bound(benchmark::State& state) {
+    const auto tree = make_tree(state.range(0));
+    const std::vector<std::int64_t> values(tree.begin(), tree.end());
+    const auto probes = make_probes(state.range(0));
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(std::lower_bound(values.begin(), values.end(), probes[i++ % probe_count]));
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["bytes_per_value"] = sizeof(std::int64_t);
+}
+
+void iterate(benchmark::State& state) {
+    const frozen_set frozen(make_tree(state.range(0)));
+    for (auto _ : state) {
+        std::int64_t sum = 0;
+        for (const std::int64_t value : frozen) {
+            sum += value;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Sizes from fitting in the L2 cache to well beyond the last level cache
+void sizes(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgName("size");
+    for (std::int64_t size : {1 << 12, 1 << 16, 1 << 20, 1 << 24}) {
+        benchmark->Arg(size);
+    }
+}
+
+}  // namespace
+
+BENCHMARK(btree_lower_bound)->Apply(sizes);
+BENCHMARK(frozen_lower_bound)->Apply(sizes);
+BENCHMARK(sorted_vector_lower_bound)->Apply(sizes);
+BENCHMARK(iterate)->Apply(sizes);
@@ -0,0 +1,88 @@
+#include <bplustree_paged.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using paged_set = paged_btree<std::int64_t, std::int64_t, btree_key_extractor_self>;
+
+constexpr std::size_t probe_count = 1 << 16;
+constexpr std::int64_t key_count = 1 << 22;
+
+/**
+ * File holding the even keys from 0 to 2 * (key_count - 1), written once for all the benchmarks.
+ */
+const std::string& tree_file() {
+    static const std::string path = [] {
+        const std::string p = (std::filesystem::temp_directory_path() / "bplustree-paged-benchmark").string();
+        std::filesystem::remove(p);
+        paged_set tree(p);
+        for (std::int64_t key = 0; key < key_count; ++key) {
+            tree.insert(2 * key);
+        }
+        return p;
+    }();
+    return path;
+}
+
+void report_counters(benchmark::State& state, const paged_set& tree) {
+    const auto counters = tree.get_counters();
+    const auto accesses = static_cast<double>(counters.hits + counters.misses);
+    state.counters["hit_rate"] = accesses > 0 ? static_cast<double>(counters.hits) / accesses : 0;
+    state.counters["evictions"] = static_cast<double>(counters.evictions);
+    state.counters["read_ahead"] = static_cast<double>(counters.read_ahead_pages);
+}
+
+/**
+ * Random lookups of present keys with a buffer pool of `pool_pages` pages, the tree spanning about 8200 pages of 4 KiB.
+ */
+void random_lookups(benchmark::State& state) {
+    const paged_set tree(tree_file(), static_cast<std::size_t>(state.range(0)));
+    std::vector<std::int64_t> probes(probe_count);
+    std::mt19937_64 generator(7);
+    std::uniform_int_distribution<std::int64_t> distribution(0, key_count - 1);
+    std::generate(probes.begin(), probes.end(), [&] { return 2 * distribution(generator); });
+    std::size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(*tree.lower_bound(probes[i++ % probe_count]));
+    }
+    state.SetItemsProcessed(state.iterations());
+    report_counters(state, tree);
+}
+
+/**
+ * Full scans with a buffer pool of `pool_pages` pages, reading the leaves ahead.
+ */
+void scan(benchmark::State& state) {
+    const paged_set tree(tree_file(), static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state) {
+        std::int64_t sum = 0;
+        for (const std::int64_t key : tree) {
+            sum += key;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * key_count);
+    report_counters(state, tree);
+}
+
+// Pools holding a small part of the tree, a large part of it, and all of it
+void pool_sizes(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgName("pool_pages");
+    for (std::int64_t pages : {256, 4096, 16384}) {
+        benchmark->Arg(pages);
+    }
+}
+
+}  // namespace
+
+BENCHMARK(random_lookups)->Apply(pool_sizes);
+BENCHMARK(scan)->Apply(pool_sizes)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,69 @@
+#include <bplustree_parallel.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <span>
+#include <vector>
+
+/**
+ * Scans of a whole tree by the parallel algorithms, for several numbers of threads, against a sequential scan.
+ */
+
+namespace {
+
+using set = btree<std::int64_t, std::int64_t, btree_key_extractor_self>;
+
+constexpr std::int64_t tree_size = 1 << 24;
+
+const set& shared_tree() {
+    static const set tree = [] {
+        std::vector<std::int64_t> values(tree_size);
+        std::iota(values.begin(), values.end(), 0);
+        return set(values.begin(), values.end());
+    }();
+    return tree;
+}
+
+constexpr auto selected = [](std::int64_t value) { return value % 7 == 3; };
+
+void count_if_sequential(benchmark::State& state) {
+    const auto& tree = shared_tree();
+    for (auto _ : state) {
+        std::size_t count = 0;
+        tree.for_each_leaf_span([&](std::span<const std::int64_t> span) {
+            for (const auto value : span) {
+                count += selected(value) ? 1u : 0u;
+            }
+        });
+        benchmark::DoNotOptimize(count);
+    }
+    state.SetItemsProcessed(state.iterations() * tree_size);
+}
+BENCHMARK(count_if_sequential)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+void count_if_parallel(benchmark::State& state) {
+    const auto& tree = shared_tree();
+    btree_thread_pool pool(static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(parallel_count_if(pool, tree, selected));
+    }
+    state.SetItemsProcessed(state.iterations() * tree_size);
+}
+BENCHMARK(count_if_parallel)->RangeMultiplier(2)->Range(1, 64)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+void transform_reduce_parallel(benchmark::State& state) {
+    const auto& tree = shared_tree();
+    btree_thread_pool pool(static_cast<std::size_t>(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+            parallel_transform_reduce(pool, tree, tree_size / 4, tree_size / 2, std::int64_t{0}, std::plus<>{},
+                                      [](std::int64_t value) { return value * value; }));
+    }
+    state.SetItemsProcessed(state.iterations() * tree_size / 4);
+}
+BENCHMARK(transform_reduce_parallel)->RangeMultiplier(2)->Range(1, 64)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+}  // namespace
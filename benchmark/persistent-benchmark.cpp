@@ -0,0 +1,214 @@
+#include <bplustree_persistent.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr std::int64_t initial_size = 1 << 20;
+
+int max_threads() {
+    return static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+std::atomic<std::size_t> allocated_bytes{0};
+
+/**
+ * Allocator counting the bytes currently allocated through it, to measure the memory shared by the snapshots.
+ */
+template <typename T>
+struct counting_allocator {
+    using value_type = T;
+
+    counting_allocator() = default;
+
+    template <typename U>
+    counting_allocator(const counting_allocator<U>&) noexcept {}
+
+    T* allocate(std::size_t n) {
+        allocated_bytes.fetch_add(n * sizeof(T), std::memory_order_relaxed);
+        return std::allocator<T>{}.allocate(n);
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept {
+        allocated_bytes.fetch_sub(n * sizeof(T), std::memory_order_relaxed);
+        std::allocator<T>{}.deallocate(p, n);
+    }
+
+    template <typename U>
+    bool operator==(const counting_allocator<U>&) const noexcept {
+        return true;
+    }
+};
+
+using persistent_set = persistent_btree<std::int64_t, std::int64_t, btree_key_extractor_self>;
+using counted_persistent_set = persistent_btree<std::int64_t,
+                                                std::int64_t,
+                                                btree_key_extractor_self,
+                                                std::less<std::int64_t>,
+                                                btree_default_traits<std::int64_t, std::int64_t>,
+                                                counting_allocator<std::int64_t>>;
+using counted_set = btree<std::int64_t,
+                          std::int64_t,
+                          btree_key_extractor_self,
+                          std::less<std::int64_t>,
+                          btree_default_traits<std::int64_t, std::int64_t>,
+                          counting_allocator<std::int64_t>>;
+
+persistent_set& shared_persistent_set() {
+    static persistent_set* tree = [] {
+        auto* t = new persistent_set;
+        for (std::int64_t i = 0; i < initial_size; ++i) {
+            t->insert(i * 2);
+        }
+        return t;
+    }();
+    return *tree;
+}
+
+const btree<std::int64_t, std::int64_t, btree_key_extractor_self>& shared_btree() {
+    static const auto* tree = [] {
+        auto* t = new btree<std::int64_t, std::int64_t, btree_key_extractor_self>;
+        for (std::int64_t i = 0; i < initial_size; ++i) {
+            t->insert(i * 2);
+        }
+        return t;
+    }();
+    return *tree;
+}
+
+/**
+ * Baseline: lookups of random keys in a btree that is not modified.
+ */
+void btree_lookup(benchmark::State& state) {
+    const auto& tree = shared_btree();
+    std::mt19937_64 rng(static_cast<std::uint64_t>(state.thread_index()));
+    std::uniform_int_distribution<std::int64_t> keys(0, initial_size * 2);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(tree.lower_bound(keys(rng)));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/**
+ * Lookups of random keys in a snapshot taken by each reader, while thread 0 keeps modifying the tree and taking
+ * snapshots of it. Readers share a snapshot of the initial tree and take no lock at all.
+ */
+void persistent_snapshot_lookup(benchmark::State& state) {
+    auto& tree = shared_persistent_set();
+    std::mt19937_64 rng(static_cast<std::uint64_t>(state.thread_index()));
+    std::uniform_int_distribution<std::int64_t> keys(0, initial_size * 2);
+    // Taken once, by whichever thread comes first, before the writer starts modifying the tree
+    static const persistent_set::snapshot_type initial = tree.snapshot();
+    if (state.thread_index() == 0 && state.threads() > 1) {
+        // Writer: toggle odd keys, taking a snapshot every 64 modifications
+        std::int64_t modifications = 0;
+        for (auto _ : state) {
+            const std::int64_t key = keys(rng) | 1;
+            if (tree.erase(key) == 0) {
+                tree.insert(key);
+            }
+            if (++modifications % 64 == 0) {
+                benchmark::DoNotOptimize(tree.snapshot());
+            }
+        }
+        return;
+    }
+    const auto snapshot = initial;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(snapshot.lower_bound(keys(rng)));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+/**
+ * Sequential scan of a snapshot, against a scan of a btree.
+ */
+void btree_scan(benchmark::State& state) {
+    const auto& tree = shared_btree();
+    for (auto _ : state) {
+        std::int64_t sum = 0;
+        for (const std::int64_t value : tree) {
+            sum += value;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * initial_size);
+}
+
+void persistent_snapshot_scan(benchmark::State& state) {
+    const auto snapshot = shared_persistent_set().snapshot();
+    for (auto _ : state) {
+        std::int64_t sum = 0;
+        for (const std::int64_t value : snapshot) {
+            sum += value;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * initial_size);
+}
+
+/**
+ * Random inserts keeping every snapshot taken each `state.range(0)` inserts (none for 0), reporting the memory used
+ * per value, snapshots included. The shared nodes are counted once.
+ */
+void persistent_insert_with_snapshots(benchmark::State& state) {
+    const auto interval = state.range(0);
+    std::mt19937_64 rng(42);
+    std::vector<std::int64_t> keys(static_cast<std::size_t>(initial_size / 4));
+    std::generate(keys.begin(), keys.end(), rng);
+    double bytes_per_value = 0;
+    for (auto _ : state) {
+        const auto before = allocated_bytes.load();
+        {
+            counted_persistent_set tree;
+            std::vector<counted_persistent_set::snapshot_type> snapshots;
+            for (std::size_t i = 0; i < keys.size(); ++i) {
+                tree.insert(keys[i]);
+                if (interval > 0 && static_cast<std::int64_t>(i) % interval == 0) {
+                    snapshots.push_back(tree.snapshot());
+                }
+            }
+            bytes_per_value = static_cast<double>(allocated_bytes.load() - before) / static_cast<double>(keys.size());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(keys.size()));
+    state.counters["bytes_per_value"] = bytes_per_value;
+}
+
+/**
+ * Baseline: random inserts in a btree, reporting the memory used per value.
+ */
+void btree_insert(benchmark::State& state) {
+    std::mt19937_64 rng(42);
+    std::vector<std::int64_t> keys(static_cast<std::size_t>(initial_size / 4));
+    std::generate(keys.begin(), keys.end(), rng);
+    double bytes_per_value = 0;
+    for (auto _ : state) {
+        const auto before = allocated_bytes.load();
+        counted_set tree;
+        for (const std::int64_t key : keys) {
+            tree.insert(key);
+        }
+        bytes_per_value = static_cast<double>(allocated_bytes.load() - before) / static_cast<double>(keys.size());
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(keys.size()));
+    state.counters["bytes_per_value"] = bytes_per_value;
+}
+
+}  // namespace
+
+BENCHMARK(btree_lookup)->ThreadRange(1, max_threads())->UseRealTime();
+BENCHMARK(persistent_snapshot_lookup)->ThreadRange(1, max_threads())->UseRealTime();
+BENCHMARK(btree_scan)->Unit(benchmark::kMillisecond);
+BENCHMARK(persistent_snapshot_scan)->Unit(benchmark::kMillisecond);
+BENCHMARK(btree_insert)->Unit(benchmark::kMillisecond);
+BENCHMARK(persistent_insert_with_snapshots)->Arg(0)->Arg(100000)->Arg(1000)->Arg(10)->Unit(benchmark::kMillisecond);
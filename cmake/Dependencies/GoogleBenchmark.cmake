@@ -0,0 +1,22 @@
+# FetchContent_MakeAvailable was added in CMake 3.14
+cmake_minimum_required(VERSION 3.14)
+
+# Use an installed Google Benchmark when available, as it is usually built in release mode
+find_package(benchmark QUIET)
+
+if(NOT benchmark_FOUND)
+    include(FetchContent)
+
+    FetchContent_Declare(
+        googlebenchmark
+        GIT_REPOSITORY  https://github.com/google/benchmark.git
+        GIT_TAG         v1.7.1
+        GIT_SHALLOW     TRUE
+    )
+
+    set(BENCHMARK_ENABLE_TESTING OFF CACHE BOOL "" FORCE)
+    set(BENCHMARK_ENABLE_GTEST_TESTS OFF CACHE BOOL "" FORCE)
+    set(BENCHMARK_ENABLE_INSTALL OFF CACHE BOOL "" FORCE)
+
+    FetchContent_MakeAvailable(googlebenchmark)
+endif()
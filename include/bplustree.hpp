@@ -2,12 +2,26 @@
 
 #include <algorithm>
 #include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <functional>
 #include <iterator>
 #include <limits>
 #include <memory>
+#include <new>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #ifndef NDEBUG
 #include <cassert>
@@ -21,20 +35,194 @@
     } while (0)
 #endif
 
+#ifdef BPLUSTREE_TESTING_PRIVATE
+#define BPLUSTREE_PRIVATE public
+#else
+#define BPLUSTREE_PRIVATE private
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BPLUSTREE_HAS_SSE2
+#endif
+#if defined(__AVX2__)
+#define BPLUSTREE_HAS_AVX2
+#endif
+#if defined(__AVX512F__)
+#define BPLUSTREE_HAS_AVX512
+#endif
+#if defined(BPLUSTREE_HAS_SSE2) || defined(BPLUSTREE_HAS_AVX2) || defined(BPLUSTREE_HAS_AVX512)
+#include <immintrin.h>
+#endif
+
+/**
+ * Instruction sets usable to compare a block of keys at once during a linear search in a node. An instruction set not
+ * enabled at compile time falls back to the best enabled one below it, and ultimately to a scalar loop.
+ */
+enum class btree_simd { none, sse2, avx2, avx512, native };
+
+/**
+ * Memory layouts of the slots of a leaf node.
+ */
+enum class btree_leaf_layout {
+    // Only the values are stored, keys are extracted from them on each access
+    values,
+    // A dense array of keys is stored next to the values, so that searches only scan the keys
+    separate_keys,
+};
+
+/**
+ * Memory layouts of the separators of an inner node.
+ */
+enum class btree_inner_layout {
+    // An array of keys
+    keys,
+    // For std::string keys only: the bytes of the separators are stored inline, the prefix they share being stored
+    // once, and separators are truncated to the shortest prefix telling apart the subtrees around them
+    prefix_compressed,
+};
+
+namespace detail {
+
+/**
+ * Slots count in each leaf node of the tree so that each node has a size of about 256 bytes, given the leaf `layout`.
+ */
+template <typename Key, typename Value>
+[[nodiscard]] constexpr int default_leaf_slots(btree_leaf_layout layout) noexcept {
+    const auto slot_size = layout == btree_leaf_layout::separate_keys ? sizeof(Key) + sizeof(Value) : sizeof(Value);
+    return std::max<int>(8, static_cast<int>(256 / slot_size));
+}
+
+/**
+ * Slots count in each inner node of the tree so that each node has a size of about 256 bytes, given the size of its
+ * header and of the links to its childs.
+ */
+template <typename Key>
+[[nodiscard]] constexpr int default_inner_slots(std::size_t header_size, std::size_t link_size) noexcept {
+    return std::max<int>(8, static_cast<int>((256 - header_size - link_size) / (sizeof(Key) + link_size)));
+}
+
+/**
+ * Whether keys of type `T` compared with `Compare` can be searched using the count_less kernels.
+ */
+template <typename T, typename Compare>
+inline constexpr bool is_simd_searchable_v =
+    (std::is_same_v<Compare, std::less<T>> || std::is_same_v<Compare, std::less<>>) &&
+    (sizeof(T) == 4 || sizeof(T) == 8) &&
+    ((std::is_integral_v<T> && std::is_signed_v<T>) || std::is_floating_point_v<T>);
+
+}  // namespace detail
+
 template <typename Key, typename Value>
 struct btree_default_traits {
+    /**
+     * Memory layout of the slots of a leaf node.
+     */
+    static const btree_leaf_layout leaf_layout = btree_leaf_layout::values;
     /**
      * Slots count in each leaf node of the tree. Estimated so that each node has a size of about 256 bytes.
      * Must be correlated with the layout of an leaf node.
      */
-    static const int leaf_slots = std::max<int>(8, 256 / (sizeof(Value)));
+    static const int leaf_slots = detail::default_leaf_slots<Key, Value>(leaf_layout);
     /**
      * Slots count in each inner node of the tree. Estimated so that each node has a size of about 256 bytes.
      * Must be correlated with the layout of an inner node.
      */
-    static const int inner_slots = std::max<int>(8, (240 - sizeof(void*)) / (sizeof(Key) + sizeof(void*)));
+    static const int inner_slots = detail::default_inner_slots<Key>(16, sizeof(void*));
+    /**
+     * Memory layout of the separators of an inner node.
+     */
+    static const btree_inner_layout inner_layout = btree_inner_layout::keys;
+    /**
+     * Bytes available in each inner node to store its separators, with the prefix_compressed inner layout only. Keys
+     * must not be longer, since a separator may be as long as a whole key.
+     */
+    static const int inner_key_bytes = 0;
+    /**
+     * Nodes holding at most this number of keys are searched linearly instead of using a binary search. Set to 0 to
+     * always perform a binary search. A linear search counting keys with SIMD comparisons (see `simd`) pays off up to
+     * large nodes, while a search comparing one key at a time only beats a binary search in small nodes, so the latter
+     * is linear up to 8 keys at most.
+     */
+    static const int linear_search_threshold = 64;
+    /**
+     * Instruction set used by linear searches over signed integral or floating point keys of 4 or 8 bytes compared
+     * with `std::less`. Other keys are always searched using a scalar loop.
+     */
+    static const btree_simd simd = btree_simd::native;
+    /**
+     * Size in bytes of the chunks from which nodes are carved by the node pool. Set to 0 to disable the pool and
+     * allocate each node separately from the allocator.
+     */
+    static const int node_pool_chunk_bytes = 0;
+    /**
+     * Link inner nodes to their childs, and leaves to their siblings, by 32 bits handles into the node pool instead of
+     * by pointers, which requires `node_pool_chunk_bytes`. Nodes then hold no addresses, only the table of the chunks
+     * of the pool does. Raises the fanout of inner nodes over small keys when `inner_slots` is computed from the size of
+     * a handle, see `btree_compact_traits`. Resolving a handle costs two dependent loads per level descended, or per
+     * leaf crossed by an iterator.
+     */
+    static const bool compact_handles = false;
+    /**
+     * Size in bytes of the message buffer of each inner node of a `buffered_btree`. Larger buffers move more messages
+     * per flush, which speeds up writes, but lookups have more messages to search along their path.
+     */
+    static const int message_buffer_bytes = 16384;
+    /**
+     * Verify the whole structure of the tree after each modification, aborting with a description of the first broken
+     * invariant (see `btree::verify()`). Very slow, intended to track down corruptions.
+     */
     static const bool debug = false;
+    /**
+     * Maintain counters of the operations performed on the tree, such as key comparisons or nodes visited by lookups
+     * (see `btree::get_counters()`). When disabled, counters take no space and no time.
+     */
     static const bool with_stats = false;
+    /**
+     * Maintain in each inner node the number of values in the subtree of each child, so that positions can be computed
+     * in logarithmic time (see `btree::nth()`, `btree::rank()` and `btree::count()`). Costs one counter per child.
+     */
+    static const bool order_statistics = false;
+    /**
+     * Monoid whose aggregate of the values of each child subtree is cached in the inner nodes, so that values can be
+     * aggregated over a key range in logarithmic time (see `btree::aggregate()`), or void for none. It provides a
+     * default constructible `value_type`, along with static `identity()`, `lift(const Value&)` and associative
+     * `combine(a, b)` functions, see `btree_sum_aggregate` for instance.
+     */
+    using aggregate = void;
+};
+
+/**
+ * Default traits for a tree whose leaves store a dense array of keys next to the values.
+ * @note Useful for map-like trees with large values, since leaf searches do not have to load the values.
+ */
+template <typename Key, typename Value>
+struct btree_separate_keys_traits : btree_default_traits<Key, Value> {
+    static const btree_leaf_layout leaf_layout = btree_leaf_layout::separate_keys;
+    static const int leaf_slots = detail::default_leaf_slots<Key, Value>(leaf_layout);
+};
+
+/**
+ * Default traits for a tree whose nodes are carved out of a node pool, and link to each other by 32 bits handles.
+ * @note Useful for small keys: inner nodes over 4 or 8 bytes keys hold about 40% more childs than with pointers.
+ */
+template <typename Key, typename Value>
+struct btree_compact_traits : btree_default_traits<Key, Value> {
+    static const int node_pool_chunk_bytes = 64 * 1024;
+    static const bool compact_handles = true;
+    // Nodes also store their own handle
+    static const int inner_slots = detail::default_inner_slots<Key>(24, sizeof(std::uint32_t));
+};
+
+/**
+ * Default traits for a tree of std::string keys whose inner nodes store prefix compressed separators.
+ * @note Useful for long keys sharing prefixes such as paths or URLs: the fanout of an inner node depends on the length
+ * of the distinguishing part of its separators instead of on sizeof(std::string). Keys are limited to 1024 bytes.
+ */
+template <typename Key, typename Value>
+struct btree_string_traits : btree_default_traits<Key, Value> {
+    static const btree_inner_layout inner_layout = btree_inner_layout::prefix_compressed;
+    static const int inner_slots = 64;
+    static const int inner_key_bytes = 1024;
 };
 
 /**
@@ -59,6 +247,48 @@ struct btree_key_extractor_pair {
     }
 };
 
+/**
+ * Sum of the values, projected to `T` by `Projection`. Usable as `Traits::aggregate`.
+ */
+template <typename T, typename Projection = std::identity>
+struct btree_sum_aggregate {
+    using value_type = T;
+    [[nodiscard]] static value_type identity() noexcept { return value_type{}; }
+    template <typename Value>
+    [[nodiscard]] static value_type lift(const Value& value) {
+        return static_cast<value_type>(Projection{}(value));
+    }
+    [[nodiscard]] static value_type combine(const value_type& a, const value_type& b) { return a + b; }
+};
+
+/**
+ * Minimum of the values, projected to `T` by `Projection`. Usable as `Traits::aggregate`.
+ */
+template <typename T, typename Projection = std::identity>
+struct btree_min_aggregate {
+    using value_type = T;
+    [[nodiscard]] static value_type identity() noexcept { return std::numeric_limits<value_type>::max(); }
+    template <typename Value>
+    [[nodiscard]] static value_type lift(const Value& value) {
+        return static_cast<value_type>(Projection{}(value));
+    }
+    [[nodiscard]] static value_type combine(const value_type& a, const value_type& b) { return std::min(a, b); }
+};
+
+/**
+ * Maximum of the values, projected to `T` by `Projection`. Usable as `Traits::aggregate`.
+ */
+template <typename T, typename Projection = std::identity>
+struct btree_max_aggregate {
+    using value_type = T;
+    [[nodiscard]] static value_type identity() noexcept { return std::numeric_limits<value_type>::lowest(); }
+    template <typename Value>
+    [[nodiscard]] static value_type lift(const Value& value) {
+        return static_cast<value_type>(Projection{}(value));
+    }
+    [[nodiscard]] static value_type combine(const value_type& a, const value_type& b) { return std::max(a, b); }
+};
+
 namespace detail {
 
 /**
@@ -72,50 +302,222 @@ namespace detail {
  * giving for example a comparator implementing a `greater than` relation would cause the semantic to be reversed:
  * less_than() would performs `greater than` and greater_than() would performs `less than`. But the logic would remain
  * intact.
+ *
+ * Both arguments may have different types, a key and a probe compared to it by a transparent comparator.
  */
 
 static constexpr struct {
-    template <typename Compare, typename T>
-    [[nodiscard]] constexpr bool operator()(Compare&& comp, T&& a, T&& b) const {
-        return comp(std::forward<T>(a), std::forward<T>(b));
+    template <typename Compare, typename A, typename B>
+    [[nodiscard]] constexpr bool operator()(Compare&& comp, A&& a, B&& b) const {
+        return comp(std::forward<A>(a), std::forward<B>(b));
     }
 } less_than;
 
 static constexpr struct {
-    template <typename Compare, typename T>
-    [[nodiscard]] constexpr bool operator()(Compare&& comp, T&& a, T&& b) const {
-        return !comp(std::forward<T>(b), std::forward<T>(a));
+    template <typename Compare, typename A, typename B>
+    [[nodiscard]] constexpr bool operator()(Compare&& comp, A&& a, B&& b) const {
+        return !comp(std::forward<B>(b), std::forward<A>(a));
     }
 } less_than_or_equal_to;
 
 static constexpr struct {
-    template <typename Compare, typename T>
-    [[nodiscard]] constexpr bool operator()(Compare&& comp, T&& a, T&& b) const {
-        return comp(std::forward<T>(b), std::forward<T>(a));
+    template <typename Compare, typename A, typename B>
+    [[nodiscard]] constexpr bool operator()(Compare&& comp, A&& a, B&& b) const {
+        return comp(std::forward<B>(b), std::forward<A>(a));
     }
 } greater_than;
 
 static constexpr struct {
-    template <typename Compare, typename T>
-    [[nodiscard]] constexpr bool operator()(Compare&& comp, T&& a, T&& b) const {
-        return !comp(std::forward<T>(a), std::forward<T>(b));
+    template <typename Compare, typename A, typename B>
+    [[nodiscard]] constexpr bool operator()(Compare&& comp, A&& a, B&& b) const {
+        return !comp(std::forward<A>(a), std::forward<B>(b));
     }
 } greater_than_or_equal_to;
 
 static constexpr struct {
-    template <typename Compare, typename T>
-    [[nodiscard]] constexpr bool operator()(Compare&& comp, T&& a, T&& b) const {
-        return !comp(std::forward<T>(a), std::forward<T>(b)) && !comp(std::forward<T>(b), std::forward<T>(a));
+    template <typename Compare, typename A, typename B>
+    [[nodiscard]] constexpr bool operator()(Compare&& comp, A&& a, B&& b) const {
+        return !comp(std::forward<A>(a), std::forward<B>(b)) && !comp(std::forward<B>(b), std::forward<A>(a));
     }
 } equal_to;
 
 static constexpr struct {
-    template <typename Compare, typename T>
-    [[nodiscard]] constexpr bool operator()(Compare&& comp, T&& a, T&& b) const {
-        return comp(std::forward<T>(a), std::forward<T>(b)) || comp(std::forward<T>(b), std::forward<T>(a));
+    template <typename Compare, typename A, typename B>
+    [[nodiscard]] constexpr bool operator()(Compare&& comp, A&& a, B&& b) const {
+        return comp(std::forward<A>(a), std::forward<B>(b)) || comp(std::forward<B>(b), std::forward<A>(a));
     }
 } not_equal_to;
 
+/**
+ * Whether `Comparator` is the comparison used to find the lower bound (respectively the upper bound) of a key.
+ */
+template <typename Comparator>
+inline constexpr bool is_lower_bound_v =
+    std::is_same_v<std::remove_cvref_t<Comparator>, std::remove_cv_t<decltype(greater_than_or_equal_to)>>;
+template <typename Comparator>
+inline constexpr bool is_upper_bound_v =
+    std::is_same_v<std::remove_cvref_t<Comparator>, std::remove_cv_t<decltype(greater_than)>>;
+
+/**
+ * Whether `Compare` declares `is_transparent`, like `std::less<>`, and thus compares keys with values of other types
+ * without converting them to keys.
+ */
+template <typename Compare>
+inline constexpr bool is_transparent_v = requires { typename Compare::is_transparent; };
+
+/**
+ * Count the number of keys in [keys, keys + count) for which `key < probe` holds, or `probe < key` if `reversed` is
+ * set. On a sorted range, this is the slot of the lower bound, respectively the slot count minus the slot of the
+ * upper bound, of `probe`.
+ *
+ * The scalar version is branchless to let the compiler vectorize it when possible. The SIMD versions compare a whole
+ * register of keys at once and count the set lanes of the resulting mask.
+ */
+template <bool reversed, typename T>
+[[nodiscard]] inline std::size_t count_less_scalar(const T* keys, std::size_t count, T probe) noexcept {
+    std::size_t n = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        n += static_cast<std::size_t>(reversed ? probe < keys[i] : keys[i] < probe);
+    }
+    return n;
+}
+
+#ifdef BPLUSTREE_HAS_SSE2
+template <bool reversed, typename T>
+[[nodiscard]] inline std::size_t count_less_sse2(const T* keys, std::size_t count, T probe) noexcept {
+    std::size_t n = 0;
+    std::size_t i = 0;
+    if constexpr (std::is_same_v<T, float>) {
+        const __m128 p = _mm_set1_ps(probe);
+        for (; i + 4 <= count; i += 4) {
+            const __m128 block = _mm_loadu_ps(keys + i);
+            const __m128 mask = reversed ? _mm_cmplt_ps(p, block) : _mm_cmplt_ps(block, p);
+            n += static_cast<std::size_t>(std::popcount(static_cast<unsigned>(_mm_movemask_ps(mask))));
+        }
+    } else if constexpr (std::is_same_v<T, double>) {
+        const __m128d p = _mm_set1_pd(probe);
+        for (; i + 2 <= count; i += 2) {
+            const __m128d block = _mm_loadu_pd(keys + i);
+            const __m128d mask = reversed ? _mm_cmplt_pd(p, block) : _mm_cmplt_pd(block, p);
+            n += static_cast<std::size_t>(std::popcount(static_cast<unsigned>(_mm_movemask_pd(mask))));
+        }
+    } else if constexpr (sizeof(T) == 4) {
+        const __m128i p = _mm_set1_epi32(static_cast<std::int32_t>(probe));
+        for (; i + 4 <= count; i += 4) {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+            const __m128i mask = reversed ? _mm_cmpgt_epi32(block, p) : _mm_cmpgt_epi32(p, block);
+            n += static_cast<std::size_t>(
+                std::popcount(static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(mask)))));
+        }
+    }
+    // 64-bit integer comparisons are not available before SSE4.2, they are left to the scalar loop
+    return n + count_less_scalar<reversed>(keys + i, count - i, probe);
+}
+#endif
+
+#ifdef BPLUSTREE_HAS_AVX2
+template <bool reversed, typename T>
+[[nodiscard]] inline std::size_t count_less_avx2(const T* keys, std::size_t count, T probe) noexcept {
+    std::size_t n = 0;
+    std::size_t i = 0;
+    if constexpr (std::is_same_v<T, float>) {
+        const __m256 p = _mm256_set1_ps(probe);
+        for (; i + 8 <= count; i += 8) {
+            const __m256 block = _mm256_loadu_ps(keys + i);
+            const __m256 mask = reversed ? _mm256_cmp_ps(p, block, _CMP_LT_OQ) : _mm256_cmp_ps(block, p, _CMP_LT_OQ);
+            n += static_cast<std::size_t>(std::popcount(static_cast<unsigned>(_mm256_movemask_ps(mask))));
+        }
+    } else if constexpr (std::is_same_v<T, double>) {
+        const __m256d p = _mm256_set1_pd(probe);
+        for (; i + 4 <= count; i += 4) {
+            const __m256d block = _mm256_loadu_pd(keys + i);
+            const __m256d mask = reversed ? _mm256_cmp_pd(p, block, _CMP_LT_OQ) : _mm256_cmp_pd(block, p, _CMP_LT_OQ);
+            n += static_cast<std::size_t>(std::popcount(static_cast<unsigned>(_mm256_movemask_pd(mask))));
+        }
+    } else if constexpr (sizeof(T) == 4) {
+        const __m256i p = _mm256_set1_epi32(static_cast<std::int32_t>(probe));
+        for (; i + 8 <= count; i += 8) {
+            const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+            const __m256i mask = reversed ? _mm256_cmpgt_epi32(block, p) : _mm256_cmpgt_epi32(p, block);
+            n += static_cast<std::size_t>(
+                std::popcount(static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(mask)))));
+        }
+    } else {
+        const __m256i p = _mm256_set1_epi64x(static_cast<std::int64_t>(probe));
+        for (; i + 4 <= count; i += 4) {
+            const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+            const __m256i mask = reversed ? _mm256_cmpgt_epi64(block, p) : _mm256_cmpgt_epi64(p, block);
+            n += static_cast<std::size_t>(
+                std::popcount(static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(mask)))));
+        }
+    }
+    return n + count_less_scalar<reversed>(keys + i, count - i, probe);
+}
+#endif
+
+#ifdef BPLUSTREE_HAS_AVX512
+template <bool reversed, typename T>
+[[nodiscard]] inline std::size_t count_less_avx512(const T* keys, std::size_t count, T probe) noexcept {
+    std::size_t n = 0;
+    std::size_t i = 0;
+    if constexpr (std::is_same_v<T, float>) {
+        const __m512 p = _mm512_set1_ps(probe);
+        for (; i + 16 <= count; i += 16) {
+            const __m512 block = _mm512_loadu_ps(keys + i);
+            const __mmask16 mask =
+                reversed ? _mm512_cmp_ps_mask(p, block, _CMP_LT_OQ) : _mm512_cmp_ps_mask(block, p, _CMP_LT_OQ);
+            n += static_cast<std::size_t>(std::popcount(static_cast<unsigned>(mask)));
+        }
+    } else if constexpr (std::is_same_v<T, double>) {
+        const __m512d p = _mm512_set1_pd(probe);
+        for (; i + 8 <= count; i += 8) {
+            const __m512d block = _mm512_loadu_pd(keys + i);
+            const __mmask8 mask =
+                reversed ? _mm512_cmp_pd_mask(p, block, _CMP_LT_OQ) : _mm512_cmp_pd_mask(block, p, _CMP_LT_OQ);
+            n += static_cast<std::size_t>(std::popcount(static_cast<unsigned>(mask)));
+        }
+    } else if constexpr (sizeof(T) == 4) {
+        const __m512i p = _mm512_set1_epi32(static_cast<std::int32_t>(probe));
+        for (; i + 16 <= count; i += 16) {
+            const __m512i block = _mm512_loadu_si512(keys + i);
+            const __mmask16 mask = reversed ? _mm512_cmplt_epi32_mask(p, block) : _mm512_cmplt_epi32_mask(block, p);
+            n += static_cast<std::size_t>(std::popcount(static_cast<unsigned>(mask)));
+        }
+    } else {
+        const __m512i p = _mm512_set1_epi64(static_cast<std::int64_t>(probe));
+        for (; i + 8 <= count; i += 8) {
+            const __m512i block = _mm512_loadu_si512(keys + i);
+            const __mmask8 mask = reversed ? _mm512_cmplt_epi64_mask(p, block) : _mm512_cmplt_epi64_mask(block, p);
+            n += static_cast<std::size_t>(std::popcount(static_cast<unsigned>(mask)));
+        }
+    }
+    return n + count_less_scalar<reversed>(keys + i, count - i, probe);
+}
+#endif
+
+/**
+ * Dispatch to the count_less kernel of the best instruction set enabled at compile time, not above `simd`.
+ */
+template <btree_simd simd, bool reversed, typename T>
+[[nodiscard]] inline std::size_t count_less(const T* keys, std::size_t count, T probe) noexcept {
+#ifdef BPLUSTREE_HAS_AVX512
+    if constexpr (simd >= btree_simd::avx512) {
+        return count_less_avx512<reversed>(keys, count, probe);
+    }
+#endif
+#ifdef BPLUSTREE_HAS_AVX2
+    if constexpr (simd >= btree_simd::avx2) {
+        return count_less_avx2<reversed>(keys, count, probe);
+    }
+#endif
+#ifdef BPLUSTREE_HAS_SSE2
+    if constexpr (simd >= btree_simd::sse2) {
+        return count_less_sse2<reversed>(keys, count, probe);
+    }
+#endif
+    return count_less_scalar<reversed>(keys, count, probe);
+}
+
 /**
  * Converts an enumeration to its underlying type. Backported from C++23.
  *
@@ -127,223 +529,2827 @@ constexpr std::underlying_type_t<Enum> to_underlying(Enum e) noexcept {
 }
 
 /**
- * Enumeration denoting the constness of a btree iterator.
- * Acts like a boolean.
+ * Placeholder for a member that is absent from a given configuration of a node.
  */
-enum class is_const_t : bool { no = false, yes = true };
+struct empty {};
 
-}  // namespace detail
+/**
+ * Handle of a node in the node_arena it was carved from, if `WithHandle`. A base class of its own rather than a member,
+ * so that it does not keep the empty members of nodes without handles from sharing their address.
+ */
+template <bool WithHandle>
+struct node_handle {};
 
-template <typename Key,
-          typename Value,
-          typename KeyExtractor,
-          typename Compare = std::less<Key>,
-          typename Traits = btree_default_traits<Key, Value>,
-          typename Allocator = std::allocator<Value>>
-class btree {
-private:
-    template <detail::is_const_t is_const>
-    class iterator_base;
+template <>
+struct node_handle<true> {
+    std::uint32_t handle{};
+};
 
-public:
-    using btree_type = btree<Key, Value, KeyExtractor, Compare, Traits, Allocator>;
-    using key_type = Key;
-    using value_type = Value;
-    using key_extractor_type = KeyExtractor;
-    using key_compare_type = Compare;
-    using value_compare_type = int;  // TODO
-    using traits_type = Traits;
-    using allocator_type = Allocator;
-    using size_type = size_t;
+/**
+ * Type of the aggregates computed by the monoid `Aggregate` (see `Traits::aggregate`), or empty when there is none.
+ */
+template <typename Aggregate>
+struct aggregate_value {
+    using type = typename Aggregate::value_type;
+};
+template <>
+struct aggregate_value<void> {
+    using type = empty;
+};
 
-    using iterator = iterator_base<detail::is_const_t::no>;
-    using const_iterator = iterator_base<detail::is_const_t::yes>;
-    using reverse_iterator = std::reverse_iterator<iterator>;
-    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+/**
+ * Assumed size in bytes of a cache line, used to step through an object when prefetching it.
+ */
+inline constexpr std::size_t cache_line_size = 64;
 
-private:
-    /**
-     * Aliases on the appropriate iterator type depending on the constness of the tree type `Self`
-     */
-    template <typename Self>
-    using select_iterator_type =
-        std::conditional_t<std::is_const_v<std::remove_reference_t<Self>>, const_iterator, iterator>;
-    template <typename Self>
-    using select_reverse_iterator_type =
-        std::conditional_t<std::is_const_v<std::remove_reference_t<Self>>, const_reverse_iterator, reverse_iterator>;
+/**
+ * Hint the processor to load the first `size` bytes of the object at `address` into the cache, without waiting for
+ * them. Does nothing on compilers providing no prefetch intrinsic.
+ */
+inline void prefetch(const void* address, std::size_t size) noexcept {
+    const auto* bytes = static_cast<const char*>(address);
+    for (std::size_t offset = 0; offset < size; offset += cache_line_size) {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(bytes + offset, 0, 3);
+#elif defined(BPLUSTREE_HAS_SSE2)
+        _mm_prefetch(bytes + offset, _MM_HINT_T0);
+#else
+        (void)bytes;
+#endif
+    }
+}
+
+/**
+ * Whether objects of type T can be relocated (moved to a new address then destroyed at the old one) by copying their
+ * bytes.
+ *
+ * @note There is no standard way to detect trivially relocatable types, so this is conservatively limited to
+ * trivially copyable types.
+ */
+template <typename T>
+inline constexpr bool is_trivially_relocatable_v = std::is_trivially_copyable_v<T>;
 
+/**
+ * Relocate the objects in [first, last) to the uninitialized range starting at `d_first`. After the call, the source
+ * range is uninitialized and the destination range holds the objects.
+ *
+ * Both ranges may overlap, which allows to shift the slots of a node in either direction. Objects are relocated one by
+ * one, starting from the end of the source range when moving forward so that each destination slot has already been
+ * vacated.
+ */
+template <typename T>
+void relocate(T* first, T* last, T* d_first) noexcept(std::is_nothrow_move_constructible_v<T>) {
+    if (first == d_first || first == last) {
+        return;
+    }
+    if constexpr (is_trivially_relocatable_v<T>) {
+        std::memmove(static_cast<void*>(d_first), static_cast<const void*>(first),
+                     static_cast<std::size_t>(last - first) * sizeof(T));
+    } else if (d_first < first) {
+        for (; first != last; ++first, ++d_first) {
+            std::construct_at(d_first, std::move(*first));
+            std::destroy_at(first);
+        }
+    } else {
+        T* d_last = d_first + (last - first);
+        while (first != last) {
+            std::construct_at(--d_last, std::move(*--last));
+            std::destroy_at(last);
+        }
+    }
+}
+
+/**
+ * Fixed-capacity storage for N objects of type T that are neither constructed nor destroyed automatically.
+ *
+ * Nodes use it so that only their live slots hold constructed objects: allocating a node does not default-construct
+ * all its slots, and T does not need to be default-constructible. The owner keeps track of which slots are live and is
+ * responsible for constructing and destroying them.
+ */
+template <typename T, std::size_t N>
+class uninitialized_array {
 public:
-    struct stats_type;
+    uninitialized_array() noexcept = default;
+    uninitialized_array(const uninitialized_array&) = delete;
+    uninitialized_array& operator=(const uninitialized_array&) = delete;
+    ~uninitialized_array() = default;
 
-    explicit btree(const allocator_type& alloc = allocator_type{}) : allocator(alloc) {}
+    [[nodiscard]] T* data() noexcept { return std::launder(reinterpret_cast<T*>(storage)); }
+    [[nodiscard]] const T* data() const noexcept { return std::launder(reinterpret_cast<const T*>(storage)); }
 
-    explicit btree(const key_compare_type& comp, const allocator_type& alloc = allocator_type{})
-        : key_compare(comp), allocator(alloc) {}
+    [[nodiscard]] T& operator[](std::size_t i) noexcept { return data()[i]; }
+    [[nodiscard]] const T& operator[](std::size_t i) const noexcept { return data()[i]; }
 
-    template <class InputIterator>
-    btree(InputIterator first, InputIterator last, const allocator_type& alloc = allocator_type{}) : allocator(alloc) {
-        // insert(first, last);
-    }
+    [[nodiscard]] static constexpr std::size_t size() noexcept { return N; }
 
-    template <class InputIterator>
-    btree(InputIterator first,
-          InputIterator last,
-          const key_compare_type& comp,
-          const allocator_type& alloc = allocator_type{})
-        : key_compare(comp), allocator(alloc) {
-        // insert(first, last);
+    template <typename... Args>
+    T& construct(std::size_t i, Args&&... args) {
+        return *std::construct_at(data() + i, std::forward<Args>(args)...);
     }
 
-    ~btree() { clear(); }
-
-    [[nodiscard]] iterator begin() noexcept { return iterator(head_leaf, 0); }
-    [[nodiscard]] const_iterator begin() const noexcept { return const_iterator(head_leaf, 0); }
-    [[nodiscard]] const_iterator cbegin() const noexcept { return const_iterator(head_leaf, 0); }
-    [[nodiscard]] reverse_iterator rbegin() noexcept { return reverse_iterator(end()); }
-    [[nodiscard]] const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator(end()); }
-    [[nodiscard]] const_reverse_iterator crbegin() const noexcept { return const_reverse_iterator(end()); }
+    void destroy(std::size_t first, std::size_t last) noexcept { std::destroy(data() + first, data() + last); }
 
-    [[nodiscard]] iterator end() noexcept { return iterator(tail_leaf, tail_leaf ? tail_leaf->slot_count : 0); }
-    [[nodiscard]] const_iterator end() const noexcept {
-        return const_iterator(tail_leaf, tail_leaf ? tail_leaf->slot_count : 0);
-    }
-    [[nodiscard]] const_iterator cend() const noexcept {
-        return const_iterator(tail_leaf, tail_leaf ? tail_leaf->slot_count : 0);
-    }
-    [[nodiscard]] reverse_iterator rend() noexcept { return reverse_iterator(begin()); }
-    [[nodiscard]] const_reverse_iterator rend() const noexcept { return const_reverse_iterator(begin()); }
-    [[nodiscard]] const_reverse_iterator crend() const noexcept { return const_reverse_iterator(begin()); }
+private:
+    alignas(T) std::byte storage[sizeof(T) * N];
+};
 
-    allocator_type get_allocator() const noexcept { return allocator; }
+/**
+ * Pool carving objects of type T out of chunks of about `ChunkBytes` bytes, each allocated at once from an allocator
+ * rebound from `Allocator`.
+ *
+ * The pool only provides storage: objects must be constructed and destroyed by the caller. Deallocated storage is
+ * kept in a free list and reused by the next allocations. Chunks are only returned to the allocator by release(),
+ * which frees all the objects of the pool at once.
+ */
+template <typename T, std::size_t ChunkBytes, typename Allocator>
+class node_pool {
+public:
+    node_pool() noexcept = default;
+    node_pool(const node_pool&) = delete;
+    node_pool& operator=(const node_pool&) = delete;
+    ~node_pool() { BPLUSTREE_ASSERT(chunk_list == nullptr); }
 
-    void swap(btree& from) {
-        std::swap(root, from.root);
-        std::swap(head_leaf, from.head_leaf);
-        std::swap(tail_leaf, from.tail_leaf);
-        std::swap(stats, from.stats);
-        std::swap(key_compare, from.key_compare);
-        std::swap(allocator, from.allocator);
+    /**
+     * Number of objects held by each chunk.
+     */
+    [[nodiscard]] static constexpr std::size_t chunk_size() noexcept {
+        return std::max<std::size_t>(1, ChunkBytes / sizeof(T));
     }
 
-    void clear() {
-        if (root) {
-            clear_recursive(root);
-            deallocate_node(root);
+    [[nodiscard]] T* allocate(const Allocator& allocator) {
+        if (free_list) {
+            free_node* n = free_list;
+            free_list = n->next;
+            std::destroy_at(n);
+            return reinterpret_cast<T*>(n);
+        }
+        if (!chunk_list || carved == chunk_size()) {
+            auto alloc = chunk_allocator(allocator);
+            chunk* c = std::allocator_traits<chunk_allocator>::allocate(alloc, 1);
+            std::construct_at(c);
+            c->next = chunk_list;
+            chunk_list = c;
+            carved = 0;
+            ++chunk_count;
+        }
+        return chunk_list->objects.data() + carved++;
+    }
 
-            root = nullptr;
-            head_leaf = tail_leaf = nullptr;
+    void deallocate(T* p) noexcept { free_list = std::construct_at(reinterpret_cast<free_node*>(p), free_list); }
 
-            stats = stats_type{};
+    /**
+     * Return all the chunks to the allocator. Objects still living in the pool are not destroyed.
+     */
+    void release(const Allocator& allocator) noexcept {
+        auto alloc = chunk_allocator(allocator);
+        while (chunk_list) {
+            chunk* c = chunk_list;
+            chunk_list = c->next;
+            std::destroy_at(c);
+            std::allocator_traits<chunk_allocator>::deallocate(alloc, c, 1);
         }
+        free_list = nullptr;
+        chunk_count = 0;
+    }
+
+    void swap(node_pool& other) noexcept {
+        std::swap(chunk_list, other.chunk_list);
+        std::swap(free_list, other.free_list);
+        std::swap(carved, other.carved);
+        std::swap(chunk_count, other.chunk_count);
+    }
+
+    [[nodiscard]] std::size_t chunks() const noexcept { return chunk_count; }
+    [[nodiscard]] std::size_t capacity() const noexcept { return chunk_count * chunk_size(); }
+
+private:
+    struct chunk {
+        chunk* next{};
+        uninitialized_array<T, chunk_size()> objects;
+    };
+    struct free_node {
+        free_node* next;
+    };
+    using chunk_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<chunk>;
+
+    static_assert(sizeof(T) >= sizeof(free_node) && alignof(T) >= alignof(free_node),
+                  "pooled objects must be able to hold a free list link");
+
+    chunk* chunk_list{};
+    free_node* free_list{};
+    std::size_t carved{};
+    std::size_t chunk_count{};
+};
+
+/**
+ * Pool carving objects of type T out of chunks of at most `ChunkBytes` bytes like node_pool, where each object is also
+ * designated by a 32 bits handle: its index in the pool plus one, 0 being the null handle.
+ *
+ * Chunks hold a power of two count of objects and are indexed by a table, so that resolving a handle costs a shift, a
+ * mask and two loads. Handles are not invalidated by later allocations, and stay valid when the pool is swapped.
+ */
+template <typename T, std::size_t ChunkBytes, typename Allocator>
+class node_arena {
+public:
+    using handle_type = std::uint32_t;
+    static constexpr handle_type null_handle = 0;
+
+    struct allocation {
+        T* object;
+        handle_type handle;
+    };
+
+    class resolver;
+
+    node_arena() noexcept = default;
+    node_arena(const node_arena&) = delete;
+    node_arena& operator=(const node_arena&) = delete;
+    ~node_arena() { BPLUSTREE_ASSERT(chunk_table.empty()); }
+
+    /**
+     * Number of objects held by each chunk.
+     */
+    [[nodiscard]] static constexpr std::size_t chunk_size() noexcept {
+        return std::bit_floor(std::max<std::size_t>(1, ChunkBytes / sizeof(T)));
+    }
+
+    [[nodiscard]] allocation allocate(const Allocator& allocator) {
+        if (free_list) {
+            free_node* n = free_list;
+            free_list = n->next;
+            const allocation a{reinterpret_cast<T*>(n), n->handle};
+            std::destroy_at(n);
+            return a;
+        }
+        if (chunk_table.empty() || carved == chunk_size()) {
+            if ((chunk_table.size() + 1) * chunk_size() > std::numeric_limits<handle_type>::max()) {
+                throw std::bad_alloc();
+            }
+            // Grow the table first so that the new chunk cannot be lost
+            if (chunk_table.size() == chunk_table.capacity()) {
+                chunk_table.reserve(std::max<std::size_t>(8, 2 * chunk_table.size()));
+            }
+            auto alloc = chunk_allocator(allocator);
+            chunk* c = std::allocator_traits<chunk_allocator>::allocate(alloc, 1);
+            std::construct_at(c);
+            chunk_table.push_back(c);
+            carved = 0;
+        }
+        const auto index = (chunk_table.size() - 1) * chunk_size() + carved;
+        return {chunk_table.back()->objects.data() + carved++, static_cast<handle_type>(index + 1)};
+    }
+
+    void deallocate(T* p, handle_type handle) noexcept {
+        free_list = std::construct_at(reinterpret_cast<free_node*>(p), free_list, handle);
+    }
+
+    [[nodiscard]] T* get(handle_type handle) const noexcept { return get_resolver().get(handle); }
+
+    /**
+     * Resolver of the handles of this arena, which stays valid when the arena is swapped, until it allocates a chunk.
+     */
+    [[nodiscard]] resolver get_resolver() const noexcept { return resolver(chunk_table.data()); }
+
+    /**
+     * Return all the chunks to the allocator. Objects still living in the pool are not destroyed.
+     */
+    void release(const Allocator& allocator) noexcept {
+        auto alloc = chunk_allocator(allocator);
+        for (chunk* c : chunk_table) {
+            std::destroy_at(c);
+            std::allocator_traits<chunk_allocator>::deallocate(alloc, c, 1);
+        }
+        chunk_table.clear();
+        free_list = nullptr;
+    }
+
+    void swap(node_arena& other) noexcept {
+        std::swap(chunk_table, other.chunk_table);
+        std::swap(free_list, other.free_list);
+        std::swap(carved, other.carved);
+    }
+
+    [[nodiscard]] std::size_t chunks() const noexcept { return chunk_table.size(); }
+    [[nodiscard]] std::size_t capacity() const noexcept { return chunk_table.size() * chunk_size(); }
+
+private:
+    struct chunk {
+        uninitialized_array<T, chunk_size()> objects;
+    };
+    struct free_node {
+        free_node* next;
+        handle_type handle;
+    };
+    using chunk_allocator = typename std::allocator_traits<Allocator>::template rebind_alloc<chunk>;
+
+    static_assert(sizeof(T) >= sizeof(free_node) && alignof(T) >= alignof(free_node),
+                  "pooled objects must be able to hold a free list link");
+
+    std::vector<chunk*> chunk_table;
+    free_node* free_list{};
+    std::size_t carved{};
+};
+
+/**
+ * Resolves handles through the chunk table of a node_arena, without access to the arena itself.
+ */
+template <typename T, std::size_t ChunkBytes, typename Allocator>
+class node_arena<T, ChunkBytes, Allocator>::resolver {
+public:
+    resolver() noexcept = default;
+
+    [[nodiscard]] T* get(handle_type handle) const noexcept {
+        BPLUSTREE_ASSERT(handle != null_handle);
+        const std::size_t index = handle - 1;
+        return table[index / chunk_size()]->objects.data() + index % chunk_size();
+    }
+
+private:
+    friend node_arena;
+
+    explicit resolver(chunk* const* t) noexcept : table(t) {}
+
+    chunk* const* table{};
+};
+
+/**
+ * Resolver of the handles of the node pool `Pool` if it is a node_arena, empty otherwise.
+ */
+template <typename Pool>
+struct resolver_of {
+    using type = empty;
+};
+template <typename T, std::size_t ChunkBytes, typename Allocator>
+struct resolver_of<node_arena<T, ChunkBytes, Allocator>> {
+    using type = typename node_arena<T, ChunkBytes, Allocator>::resolver;
+};
+
+/**
+ * Length of the longest common prefix of `a` and `b`.
+ */
+[[nodiscard]] inline std::size_t common_prefix_length(std::string_view a, std::string_view b) noexcept {
+    const std::size_t length = std::min(a.size(), b.size());
+    const auto a_end = a.begin() + static_cast<std::ptrdiff_t>(length);
+    return static_cast<std::size_t>(std::mismatch(a.begin(), a_end, b.begin()).first - a.begin());
+}
+
+/**
+ * Shortest separator `s` such that `greatest <= s <= least`, i.e. the shortest prefix of `least` ordered after
+ * `greatest`, or `least` itself if there is none.
+ * @pre `greatest <= least`
+ */
+[[nodiscard]] inline std::string_view shortest_separator(std::string_view greatest, std::string_view least) noexcept {
+    return least.substr(0, std::min(least.size(), common_prefix_length(greatest, least) + 1));
+}
+
+/**
+ * Up to `Slots` string separators stored inline in `Bytes` bytes, ordered lexicographically by bytes.
+ *
+ * The prefix shared by all the separators is stored once, followed by what remains of each separator. A search
+ * compares the searched key with the prefix once, then only with these suffixes.
+ */
+template <std::size_t Slots, std::size_t Bytes>
+class prefix_compressed_keys {
+public:
+    static_assert(Bytes > 0 && Bytes <= std::numeric_limits<std::uint16_t>::max(),
+                  "the bytes of the separators must be addressable by 16 bits offsets");
+
+    /**
+     * Whether the `count` sorted separators starting at `first` fit in the storage.
+     */
+    template <typename Iterator>
+    [[nodiscard]] static bool fits(Iterator first, std::size_t count) noexcept {
+        if (count == 0) {
+            return true;
+        }
+        const std::size_t prefix = common_prefix_length(first[0], first[static_cast<std::ptrdiff_t>(count - 1)]);
+        std::size_t bytes = prefix;
+        for (std::size_t i = 0; i < count; ++i) {
+            bytes += std::string_view(first[static_cast<std::ptrdiff_t>(i)]).size() - prefix;
+        }
+        return count <= Slots && bytes <= Bytes;
+    }
+
+    /**
+     * Replace the separators by the `count` sorted ones starting at `first`.
+     * @pre `fits(first, count)`
+     */
+    template <typename Iterator>
+    void assign(Iterator first, std::size_t count) noexcept {
+        BPLUSTREE_ASSERT(fits(first, count));
+        prefix_length = 0;
+        std::size_t end = 0;
+        if (count > 0) {
+            const auto last = static_cast<std::ptrdiff_t>(count - 1);
+            prefix_length = static_cast<std::uint16_t>(common_prefix_length(first[0], first[last]));
+            std::memcpy(bytes.data(), std::string_view(first[0]).data(), prefix_length);
+            end = prefix_length;
+        }
+        for (std::size_t i = 0; i < count; ++i) {
+            const std::string_view suffix =
+                std::string_view(first[static_cast<std::ptrdiff_t>(i)]).substr(prefix_length);
+            offsets[i] = static_cast<std::uint16_t>(end);
+            std::memcpy(bytes.data() + end, suffix.data(), suffix.size());
+            end += suffix.size();
+        }
+        offsets[count] = static_cast<std::uint16_t>(end);
+    }
+
+    [[nodiscard]] std::string_view prefix() const noexcept { return {bytes.data(), prefix_length}; }
+
+    [[nodiscard]] std::string_view suffix(std::size_t slot) const noexcept {
+        return {bytes.data() + offsets[slot], static_cast<std::size_t>(offsets[slot + 1] - offsets[slot])};
+    }
+
+    /**
+     * The whole separator in `slot`.
+     */
+    [[nodiscard]] std::string key(std::size_t slot) const {
+        std::string key(prefix());
+        key += suffix(slot);
+        return key;
+    }
+
+    /**
+     * Three-way comparison of the separator in `slot` with `key`.
+     */
+    [[nodiscard]] int compare(std::size_t slot, std::string_view key) const noexcept {
+        if (const int order = compare_prefix(key)) {
+            return order;
+        }
+        return suffix(slot).compare(key.substr(prefix_length));
+    }
+
+    /**
+     * First slot among the `count` first ones whose separator is not ordered before `key`, or is ordered after `key`
+     * if `upper` is set.
+     */
+    template <bool upper>
+    [[nodiscard]] std::size_t find_slot(std::size_t count, std::string_view key) const noexcept {
+        if (const int order = compare_prefix(key)) {
+            return order > 0 ? 0 : count;
+        }
+        const std::string_view rest = key.substr(prefix_length);
+        std::size_t lower = 0, higher = count;
+        while (lower < higher) {
+            const std::size_t middle = (lower + higher) / 2;
+            const int order = suffix(middle).compare(rest);
+            if (upper ? order > 0 : order >= 0) {
+                higher = middle;
+            } else {
+                lower = middle + 1;
+            }
+        }
+        return lower;
+    }
+
+    void destroy(std::size_t, std::size_t) noexcept {}
+
+private:
+    /**
+     * Three-way comparison of the prefix with the beginning of `key`, which is 0 if `key` starts with the prefix.
+     * Otherwise, all the separators compare to `key` the same way as the prefix.
+     */
+    [[nodiscard]] int compare_prefix(std::string_view key) const noexcept {
+        return prefix().compare(key.substr(0, prefix_length));
+    }
+
+    std::uint16_t prefix_length{};
+    std::array<std::uint16_t, Slots + 1> offsets{};
+    std::array<char, Bytes> bytes;
+};
+
+/**
+ * Enumeration denoting the constness of a btree iterator.
+ * Acts like a boolean.
+ */
+enum class is_const_t : bool { no = false, yes = true };
+
+}  // namespace detail
+
+template <typename Key, typename Value, typename KeyExtractor, typename Compare, typename Traits, typename Allocator>
+class concurrent_btree;
+
+template <typename Key, typename Value, typename KeyExtractor, typename Compare, typename Traits, typename Allocator>
+class persistent_btree;
+
+template <typename Key, typename Value, typename KeyExtractor, typename Compare, typename Traits, typename Allocator>
+class buffered_btree;
+
+template <typename Key,
+          typename Value,
+          typename KeyExtractor,
+          typename Compare = std::less<Key>,
+          typename Traits = btree_default_traits<Key, Value>,
+          typename Allocator = std::allocator<Value>>
+class btree {
+BPLUSTREE_PRIVATE:
+    template <detail::is_const_t is_const>
+    class iterator_base;
+
+    // The concurrent, persistent and buffered variants reuse the node layouts and search algorithms. Since the searches
+    // access the comparison object of the tree they are given, each variant befriends btree in turn
+    template <typename, typename, typename, typename, typename, typename>
+    friend class concurrent_btree;
+    template <typename, typename, typename, typename, typename, typename>
+    friend class persistent_btree;
+    template <typename, typename, typename, typename, typename, typename>
+    friend class buffered_btree;
+
+public:
+    using btree_type = btree<Key, Value, KeyExtractor, Compare, Traits, Allocator>;
+    using key_type = Key;
+    using value_type = Value;
+    using key_extractor_type = KeyExtractor;
+    using key_compare_type = Compare;
+    using value_compare_type = int;  // TODO
+    using traits_type = Traits;
+    using allocator_type = Allocator;
+    using size_type = size_t;
+    using aggregate_value_type = typename detail::aggregate_value<typename Traits::aggregate>::type;
+
+    using iterator = iterator_base<detail::is_const_t::no>;
+    using const_iterator = iterator_base<detail::is_const_t::yes>;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+BPLUSTREE_PRIVATE:
+    /**
+     * Aliases on the appropriate iterator type depending on the constness of the tree type `Self`
+     */
+    template <typename Self>
+    using select_iterator_type =
+        std::conditional_t<std::is_const_v<std::remove_reference_t<Self>>, const_iterator, iterator>;
+    template <typename Self>
+    using select_reverse_iterator_type =
+        std::conditional_t<std::is_const_v<std::remove_reference_t<Self>>, const_reverse_iterator, reverse_iterator>;
+
+public:
+    struct stats_type;
+    struct counters_type;
+    class cursor;
+
+    explicit btree(const allocator_type& alloc = allocator_type{}) : allocator(alloc) {}
+
+    explicit btree(const key_compare_type& comp, const allocator_type& alloc = allocator_type{})
+        : key_compare(comp), allocator(alloc) {}
+
+    template <class InputIterator>
+    btree(InputIterator first, InputIterator last, const allocator_type& alloc = allocator_type{}) : allocator(alloc) {
+        bulk_load(first, last);
+    }
+
+    template <class InputIterator>
+    btree(InputIterator first,
+          InputIterator last,
+          const key_compare_type& comp,
+          const allocator_type& alloc = allocator_type{})
+        : key_compare(comp), allocator(alloc) {
+        bulk_load(first, last);
+    }
+
+    /**
+     * Take the nodes of `other`, which is left empty.
+     */
+    btree(btree&& other) noexcept : key_compare(other.key_compare), allocator(other.allocator) { swap(other); }
+
+    btree& operator=(btree&& other) noexcept {
+        if (this != &other) {
+            clear();
+            swap(other);
+        }
+        return *this;
+    }
+
+    // Nodes are owned by a single tree
+    btree(const btree&) = delete;
+    btree& operator=(const btree&) = delete;
+
+    ~btree() { clear(); }
+
+    [[nodiscard]] iterator begin() noexcept { return iterator(head_leaf, 0, links()); }
+    [[nodiscard]] const_iterator begin() const noexcept { return const_iterator(head_leaf, 0, links()); }
+    [[nodiscard]] const_iterator cbegin() const noexcept { return const_iterator(head_leaf, 0, links()); }
+    [[nodiscard]] reverse_iterator rbegin() noexcept { return reverse_iterator(end()); }
+    [[nodiscard]] const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator(end()); }
+    [[nodiscard]] const_reverse_iterator crbegin() const noexcept { return const_reverse_iterator(end()); }
+
+    [[nodiscard]] iterator end() noexcept {
+        return iterator(tail_leaf, tail_leaf ? tail_leaf->slot_count : 0, links());
+    }
+    [[nodiscard]] const_iterator end() const noexcept {
+        return const_iterator(tail_leaf, tail_leaf ? tail_leaf->slot_count : 0, links());
+    }
+    [[nodiscard]] const_iterator cend() const noexcept {
+        return const_iterator(tail_leaf, tail_leaf ? tail_leaf->slot_count : 0, links());
+    }
+    [[nodiscard]] reverse_iterator rend() noexcept { return reverse_iterator(begin()); }
+    [[nodiscard]] const_reverse_iterator rend() const noexcept { return const_reverse_iterator(begin()); }
+    [[nodiscard]] const_reverse_iterator crend() const noexcept { return const_reverse_iterator(begin()); }
+
+    allocator_type get_allocator() const noexcept { return allocator; }
+
+    [[nodiscard]] key_compare_type key_comp() const { return key_compare; }
+
+    void swap(btree& from) {
+        std::swap(root, from.root);
+        std::swap(head_leaf, from.head_leaf);
+        std::swap(tail_leaf, from.tail_leaf);
+        if constexpr (with_node_pool) {
+            leaf_pool.swap(from.leaf_pool);
+            inner_pool.swap(from.inner_pool);
+        }
+        std::swap(stats, from.stats);
+        std::swap(counters, from.counters);
+        std::swap(key_compare, from.key_compare);
+        std::swap(allocator, from.allocator);
+    }
+
+    /**
+     * Remove all the values from the tree.
+     *
+     * When nodes are allocated from the node pool and hold trivially destructible keys and values, there is nothing
+     * to destroy in them: the chunks are released at once without walking the tree.
+     */
+    void clear() {
+        if (root) {
+            if constexpr (!with_node_pool || !std::is_trivially_destructible_v<key_type> ||
+                          !std::is_trivially_destructible_v<value_type>) {
+                clear_recursive(root);
+                deallocate_node(root);
+            } else {
+                add_to_counter(*this, &counters_type::deallocations, stats.nodes());
+            }
+
+            root = nullptr;
+            head_leaf = tail_leaf = nullptr;
+
+            stats = stats_type{};
+        }
+        if constexpr (with_node_pool) {
+            leaf_pool.release(allocator);
+            inner_pool.release(allocator);
+        }
+        verify_if_debug();
+    }
+
+    /**
+     * Replace the content of the tree by the values in [first, last), building the leaves and the inner levels
+     * bottom-up in a single linear pass instead of descending from the root for each value.
+     *
+     * Already sorted forward ranges are loaded directly. Any other range is first copied and stable-sorted, so that
+     * values with equivalent keys keep their relative order.
+     *
+     * Each node is filled up to `fill_factor` of its capacity. The factor is clamped to [0.5, 1] so that the resulting
+     * tree never holds underflowing nodes (except for the root).
+     * @throw std::length_error if a key is longer than `inner_key_bytes` with prefix compressed inner nodes, in which
+     * case the tree is left unchanged
+     */
+    template <class InputIterator>
+    void bulk_load(InputIterator first, InputIterator last, float fill_factor = 1.0f) {
+        const auto value_less = [this](const value_type& a, const value_type& b) {
+            return key_compare(key_extractor_type{}(a), key_extractor_type{}(b));
+        };
+        const auto check_key_lengths = [](auto begin, auto end) {
+            for (; begin != end; ++begin) {
+                check_key_length(key_extractor_type{}(*begin));
+            }
+        };
+        using category = typename std::iterator_traits<InputIterator>::iterator_category;
+        if constexpr (std::is_base_of_v<std::forward_iterator_tag, category>) {
+            if (std::is_sorted(first, last, value_less)) {
+                check_key_lengths(first, last);
+                bulk_load_sorted(first, static_cast<size_type>(std::distance(first, last)), fill_factor);
+                return;
+            }
+        }
+        std::vector<value_type> values(first, last);
+        check_key_lengths(values.begin(), values.end());
+        std::stable_sort(values.begin(), values.end(), value_less);
+        bulk_load_sorted(std::make_move_iterator(values.begin()), values.size(), fill_factor);
+    }
+
+    /**
+     * Insert `value` after the values with an equivalent key, and return an iterator to it.
+     *
+     * Values whose key is not ordered before the greatest key of the tree go straight to the tail leaf, without
+     * descending from the root. When this leaf is full, it keeps about 90% of its values instead of half of them, and
+     * so do its full ancestors, so that appending nearly sorted keys leaves the tree nearly full. Only the nodes on the
+     * right edge of the tree may underflow this way.
+     * @throw std::length_error if the key is longer than `inner_key_bytes` with prefix compressed inner nodes
+     * @note Invalidates all the iterators.
+     */
+    iterator insert(const value_type& value) { return insert_impl(value); }
+    iterator insert(value_type&& value) { return insert_impl(std::move(value)); }
+
+    /**
+     * Insert `value` as close as possible before `hint`, and return an iterator to it.
+     *
+     * The leaf of `hint` is used directly if `value` can go right before `hint` in it, in which case the inner nodes are
+     * only visited to split them or to update the sizes and aggregates of their subtrees. Otherwise `value` is
+     * inserted after the values with an equivalent key as with insert(const value_type&).
+     * @throw std::length_error if the key is longer than `inner_key_bytes` with prefix compressed inner nodes
+     * @note Invalidates all the iterators.
+     */
+    iterator insert(const_iterator hint, const value_type& value) { return insert_impl(value, hint); }
+    iterator insert(const_iterator hint, value_type&& value) { return insert_impl(std::move(value), hint); }
+
+    /**
+     * Remove the values in [first, last), and return an iterator to the value that followed the last removed one.
+     *
+     * The subtrees lying entirely between both ends of the range are freed at once and only the two leaves holding the
+     * ends are trimmed, then the nodes on the paths to both ends are rebalanced. The value that followed the range is
+     * tracked through the rebalancing rather than searched again. So the cost is O(log n) plus the number of nodes
+     * freed, however many values they hold, plus the leaves of the values with a key equivalent to the one of an end
+     * that lie before it, which locating this end walks.
+     * @note Invalidates all the iterators.
+     */
+    iterator erase(const_iterator first, const_iterator last) {
+        if (first == last) {
+            return iterator(const_cast<leaf_node_type*>(last.current_leaf), last.current_slot, links());
+        }
+        return erase_between(find_path(first), find_path(last)).following;
+    }
+
+    /**
+     * Remove the value pointed to by `pos`, and return an iterator to the value that followed it.
+     * @note Invalidates all the iterators.
+     */
+    iterator erase(const_iterator pos) {
+        const path_type first = find_path(pos);
+        path_type last = first;
+        ++last.back();
+        return erase_between(first, last).following;
+    }
+
+    /**
+     * Remove the values whose key is equivalent to `key`, and return how many were removed.
+     * @note Invalidates all the iterators.
+     */
+    size_type erase(const key_type& key) {
+        if (!root) {
+            return 0;
+        }
+        return erase_between(find_path(detail::greater_than_or_equal_to, key), find_path(detail::greater_than, key))
+            .count;
+    }
+
+    /**
+     * Remove the values whose key is in [lower, upper), and return how many were removed.
+     * @see erase(const_iterator, const_iterator)
+     */
+    size_type erase_range(const key_type& lower, const key_type& upper) {
+        if (!root || !key_compare(lower, upper)) {
+            return 0;
+        }
+        return erase_between(find_path(detail::greater_than_or_equal_to, lower),
+                             find_path(detail::greater_than_or_equal_to, upper))
+            .count;
+    }
+
+    /**
+     * Move the values whose key is not ordered before `key` to a new tree, which is returned.
+     *
+     * The nodes are cut along the path to lower_bound(key): the ones on its right move to the new tree as they are, and
+     * only the nodes on the path are split, then rebalanced, in O(log n). However the size and node counts of both
+     * trees (see size() and get_stats()) are not cached per subtree: they are found by counting the values and nodes
+     * of the smaller of both trees, then subtracting them from the totals. So split() is not O(log n) but
+     * O(log n + m / B), for a smaller tree of m values in leaves of B values.
+     *
+     * With `Traits::node_pool_chunk_bytes`, nodes cannot leave the chunks of their tree: the values from lower_bound(key)
+     * onwards are moved to newly allocated nodes instead, then erased, in O(n).
+     * @note Invalidates all the iterators.
+     */
+    [[nodiscard]] btree split(const key_type& key) {
+        btree upper(key_compare, allocator);
+        if (!root) {
+            return upper;
+        }
+        const path_type path = find_path(detail::greater_than_or_equal_to, key);
+        const leaf_node_type* leaf = leaf_at(path);
+        if (leaf == head_leaf && path.back() == 0) {
+            upper.take_content(*this);
+            return upper;
+        }
+        if (leaf == tail_leaf && path.back() == leaf->slot_count) {
+            return upper;
+        }
+        if constexpr (with_node_pool) {
+            const iterator first = lower_bound(key);
+            upper.bulk_load_sorted(std::make_move_iterator(first), static_cast<size_type>(std::distance(first, end())),
+                                   1.0f);
+            erase(first, end());
+        } else {
+            split_at(path, upper);
+        }
+        return upper;
+    }
+
+    /**
+     * Move all the values of `other`, whose keys must all be ordered either after or before the keys of this tree, into
+     * this tree. Equivalent keys may appear at the end of one tree and at the beginning of the other one, the values of
+     * this tree being kept first.
+     *
+     * The root of the shorter tree is grafted on the spine of the taller one at its level, so that the nodes of both
+     * trees are kept and only the nodes along this spine are split or rebalanced, in O(log n).
+     *
+     * Trees whose key ranges overlap are merged instead (see merge()), as well as trees using `Traits::
+     * node_pool_chunk_bytes`, or whose allocators are not equal, since their nodes cannot be moved to this tree.
+     * @note Invalidates all the iterators of both trees.
+     */
+    void join(btree& other) {
+        if (this == &other || !other.root) {
+            return;
+        }
+        if (!root) {
+            take_content(other);
+            return;
+        }
+        const auto& greatest = [](const btree& tree) -> const key_type& {
+            return tree.tail_leaf->key(tree.tail_leaf->slot_count - 1);
+        };
+        const bool append = !key_compare(other.head_leaf->key(0), greatest(*this));
+        const bool prepend = !append && key_compare(greatest(other), head_leaf->key(0));
+        if (with_node_pool || !(allocator == other.allocator) || (!append && !prepend)) {
+            merge(other);
+            return;
+        }
+        btree& lower = append ? *this : other;
+        btree& upper = append ? other : *this;
+        lower.repair_right_edge();
+        key_type separator = greatest(lower);
+        if constexpr (inner_node_type::compressed_keys) {
+            separator = detail::shortest_separator(separator, upper.head_leaf->key(0));
+        }
+        node_type* lower_root = lower.root;
+        node_type* upper_root = upper.root;
+        leaf_node_type* const head = lower.head_leaf;
+        leaf_node_type* const tail = upper.tail_leaf;
+        link_leaves(lower.tail_leaf, upper.head_leaf);
+        head_leaf = head;
+        tail_leaf = tail;
+        stats.size += other.stats.size;
+        stats.leaves += other.stats.leaves;
+        stats.inner_nodes += other.stats.inner_nodes;
+        other.root = other.head_leaf = other.tail_leaf = nullptr;
+        other.stats = stats_type{};
+
+        // The shorter tree goes at the end of the right spine of the taller one if it holds the greatest keys, or at the
+        // beginning of its left spine otherwise
+        const bool graft_at_end = lower_root->level >= upper_root->level;
+        root = graft_at_end ? lower_root : upper_root;
+        graft(graft_at_end ? upper_root : lower_root, std::move(separator), graft_at_end);
+        verify_if_debug();
+    }
+
+    /**
+     * Move all the values of `other` into this tree, in linear time: both sequences of leaves are streamed in order to
+     * build the nodes of the result bottom-up (see bulk_load()). Among equivalent keys, the values of this tree are kept
+     * first.
+     * @note Invalidates all the iterators of both trees.
+     */
+    void merge(btree& other) {
+        if (this == &other || !other.root) {
+            return;
+        }
+        if (!root) {
+            take_content(other);
+            return;
+        }
+        btree source(key_compare, allocator);
+        source.take_content(*this);
+        const size_type count = source.size() + other.size();
+        bulk_load_sorted(merge_cursor(source.begin(), source.end(), other.begin(), other.end(), key_compare), count,
+                         1.0f);
+        other.clear();
     }
 
     [[nodiscard]] size_type size() const noexcept { return stats.size; }
 
-    [[nodiscard]] size_type max_size() const noexcept { return std::numeric_limits<size_type>::max(); }
+    [[nodiscard]] size_type max_size() const noexcept { return std::numeric_limits<size_type>::max(); }
+
+    [[nodiscard]] bool empty() const noexcept { return size() == 0; }
+
+    [[nodiscard]] const stats_type& get_stats() const noexcept { return stats; }
+
+    /**
+     * Snapshot of the operation counters, completed with the current height and node fill histograms of the tree.
+     * Only available when `Traits::with_stats` is set.
+     *
+     * @note Lookups update the counters, so a tree maintaining them must not be looked up by several threads at once.
+     */
+    [[nodiscard]] counters_type get_counters() const {
+        static_assert(with_stats, "counters are only maintained when Traits::with_stats is set");
+        counters_type snapshot = counters;
+        if (root) {
+            snapshot.height = root->level + 1;
+            collect_fill(root, snapshot);
+        }
+        return snapshot;
+    }
+
+    /**
+     * Set all the operation counters back to zero. Only available when `Traits::with_stats` is set.
+     */
+    void reset_counters() noexcept {
+        static_assert(with_stats, "counters are only maintained when Traits::with_stats is set");
+        counters = counters_type{};
+    }
+
+    /**
+     * Check the structural invariants of the tree, and return a description of the first broken one, or nullptr if
+     * there is none. Walks the whole tree.
+     *
+     * Checked invariants are:
+     *   - all the leaves are at level 0 and each inner node is one level above its childs,
+     *   - no node overflows, and only the root and the nodes on the right edge may underflow (any node but an empty
+     *     leaf with prefix compressed inner nodes),
+     *   - keys are sorted within each node, and the keys of a subtree are bounded by the separators around it,
+     *   - the sibling links chain all the leaves in order, from the head leaf to the tail leaf,
+     *   - the separate keys of the leaves, if any, match their values,
+     *   - the subtree sizes of the inner nodes, if any, match the number of values below each child,
+     *   - the aggregates cached in the inner nodes, if any and comparable, match the values below each child,
+     *   - the stats match the number of values, leaves and inner nodes of the tree.
+     */
+    [[nodiscard]] const char* verify() const {
+        if (!root) {
+            if (head_leaf || tail_leaf || stats.size != 0 || stats.nodes() != 0) {
+                return "empty tree with leaves or values";
+            }
+            return nullptr;
+        }
+        verify_state state;
+        if (const char* problem = verify_node(root, nullptr, nullptr, root->level, state)) {
+            return problem;
+        }
+        if (state.previous_leaf != tail_leaf || tail_leaf->next_leaf) {
+            return "last leaf is not the tail leaf";
+        }
+        if (state.size != stats.size || state.leaves != stats.leaves || state.inner_nodes != stats.inner_nodes) {
+            return "stats do not match the content of the tree";
+        }
+        return nullptr;
+    }
+
+    /**
+     * Iterator to the value at position `n` in the tree, or end() if `n >= size()`. Only available when
+     * `Traits::order_statistics` is set.
+     */
+    [[nodiscard]] iterator nth(size_type n) { return nth_impl(*this, n); }
+    [[nodiscard]] const_iterator nth(size_type n) const { return nth_impl(*this, n); }
+
+    /**
+     * Number of values whose key is ordered before `key`, which is the position of lower_bound(key). Only available
+     * when `Traits::order_statistics` is set.
+     */
+    [[nodiscard]] size_type rank(const key_type& key) const {
+        return find_position(detail::greater_than_or_equal_to, key).rank;
+    }
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    [[nodiscard]] size_type rank(const K& key) const {
+        return find_position(detail::greater_than_or_equal_to, key).rank;
+    }
+
+    /**
+     * Position of the value pointed to by `it` in the tree, or size() for end(). Only available when
+     * `Traits::order_statistics` is set.
+     *
+     * @note The distance between two iterators is the difference between their positions.
+     */
+    [[nodiscard]] size_type index_of(const_iterator it) const {
+        if (it == end()) {
+            return size();
+        }
+        position found = find_position(detail::greater_than_or_equal_to, it.key());
+        // Values with equivalent keys may span several leaves before the one of `it`
+        while (found.leaf != it.current_leaf) {
+            found.rank += found.leaf->slot_count - found.slot;
+            found.leaf = next_sibling(*found.leaf);
+            found.slot = 0;
+        }
+        return found.rank + it.current_slot - found.slot;
+    }
+
+    /**
+     * Number of values whose key is equivalent to `key`. Only available when `Traits::order_statistics` is set.
+     */
+    [[nodiscard]] size_type count(const key_type& key) const {
+        return find_position(detail::greater_than, key).rank - rank(key);
+    }
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    [[nodiscard]] size_type count(const K& key) const {
+        return find_position(detail::greater_than, key).rank - rank(key);
+    }
+
+    /**
+     * Number of values whose key is in [lower, upper). Only available when `Traits::order_statistics` is set.
+     */
+    [[nodiscard]] size_type count(const key_type& lower, const key_type& upper) const {
+        return count_impl(lower, upper);
+    }
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    [[nodiscard]] size_type count(const K& lower, const K& upper) const {
+        return count_impl(lower, upper);
+    }
+
+    /**
+     * Combine in order the values whose key is in [lower, upper) with the monoid `Traits::aggregate`. Only the nodes on
+     * the paths to both bounds are searched, the subtrees in between contributing the aggregates cached in their
+     * parent. Only available when `Traits::aggregate` is set.
+     */
+    [[nodiscard]] aggregate_value_type aggregate(const key_type& lower, const key_type& upper) const {
+        return aggregate_impl(lower, upper);
+    }
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    [[nodiscard]] aggregate_value_type aggregate(const K& lower, const K& upper) const {
+        return aggregate_impl(lower, upper);
+    }
+
+    /**
+     * The lookups below, as well as rank(), count() and aggregate(), also accept any type of probe that the keys can be
+     * compared with when the comparator declares `is_transparent`, like `std::less<>`. The probe is then passed as is
+     * to the comparator, e.g. a `std::string_view` to look up a tree of `std::string` without building a string.
+     */
+    [[nodiscard]] iterator lower_bound(const key_type& key) { return lower_bound_impl(*this, key); }
+    [[nodiscard]] const_iterator lower_bound(const key_type& key) const { return lower_bound_impl(*this, key); }
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    [[nodiscard]] iterator lower_bound(const K& key) {
+        return lower_bound_impl(*this, key);
+    }
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    [[nodiscard]] const_iterator lower_bound(const K& key) const {
+        return lower_bound_impl(*this, key);
+    }
+
+    [[nodiscard]] iterator upper_bound(const key_type& key) { return upper_bound_impl(*this, key); }
+    [[nodiscard]] const_iterator upper_bound(const key_type& key) const { return upper_bound_impl(*this, key); }
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    [[nodiscard]] iterator upper_bound(const K& key) {
+        return upper_bound_impl(*this, key);
+    }
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    [[nodiscard]] const_iterator upper_bound(const K& key) const {
+        return upper_bound_impl(*this, key);
+    }
+
+    /**
+     * Finger search: lower_bound(key) starting from the position `hint`, for keys close to the result of a previous
+     * lookup. When the bound is in the leaf of `hint` or in a sibling of this leaf, only these leaves are searched, so
+     * that the cost of close lookups does not depend on the height of the tree. Farther bounds are found by descending
+     * from the root, which costs two leaves more than without hint: use a cursor to seek keys anywhere from its path.
+     * The result is the same as without hint.
+     */
+    [[nodiscard]] iterator lower_bound(const_iterator hint, const key_type& key) {
+        return find_leaf_slot_from(*this, detail::greater_than_or_equal_to, hint, key);
+    }
+    [[nodiscard]] const_iterator lower_bound(const_iterator hint, const key_type& key) const {
+        return find_leaf_slot_from(*this, detail::greater_than_or_equal_to, hint, key);
+    }
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    [[nodiscard]] iterator lower_bound(const_iterator hint, const K& key) {
+        return find_leaf_slot_from(*this, detail::greater_than_or_equal_to, hint, key);
+    }
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    [[nodiscard]] const_iterator lower_bound(const_iterator hint, const K& key) const {
+        return find_leaf_slot_from(*this, detail::greater_than_or_equal_to, hint, key);
+    }
+
+    /**
+     * Finger search of upper_bound(key) starting from the position `hint`.
+     * @see lower_bound(const_iterator, const key_type&)
+     */
+    [[nodiscard]] iterator upper_bound(const_iterator hint, const key_type& key) {
+        return find_leaf_slot_from(*this, detail::greater_than, hint, key);
+    }
+    [[nodiscard]] const_iterator upper_bound(const_iterator hint, const key_type& key) const {
+        return find_leaf_slot_from(*this, detail::greater_than, hint, key);
+    }
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    [[nodiscard]] iterator upper_bound(const_iterator hint, const K& key) {
+        return find_leaf_slot_from(*this, detail::greater_than, hint, key);
+    }
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    [[nodiscard]] const_iterator upper_bound(const_iterator hint, const K& key) const {
+        return find_leaf_slot_from(*this, detail::greater_than, hint, key);
+    }
+
+    /**
+     * Cursor seeking the lower bounds of increasing keys, e.g. to merge-join the tree with another sorted sequence,
+     * positioned on the first value. It is invalidated by any modification of the tree.
+     */
+    [[nodiscard]] cursor seek_cursor() const noexcept { return cursor(*this); }
+
+    /**
+     * Batched lower_bound: store in `result[i]` the lower bound of `keys[i]`, for each key of `keys`.
+     *
+     * The descents of consecutive keys are interleaved level by level, so that the next node of each descent is
+     * prefetched while the other ones are searched. When `keys` is sorted, consecutive keys also share the searches of
+     * the nodes leading to the same subtree.
+     * @pre `result.size() >= keys.size()`
+     */
+    void lower_bound(std::span<const key_type> keys, std::span<iterator> result) {
+        find_leaf_slots(*this, detail::greater_than_or_equal_to, keys, result);
+    }
+    void lower_bound(std::span<const key_type> keys, std::span<const_iterator> result) const {
+        find_leaf_slots(*this, detail::greater_than_or_equal_to, keys, result);
+    }
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    void lower_bound(std::span<const K> keys, std::span<iterator> result) {
+        find_leaf_slots(*this, detail::greater_than_or_equal_to, keys, result);
+    }
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    void lower_bound(std::span<const K> keys, std::span<const_iterator> result) const {
+        find_leaf_slots(*this, detail::greater_than_or_equal_to, keys, result);
+    }
+
+    /**
+     * Batched upper_bound: store in `result[i]` the upper bound of `keys[i]`, for each key of `keys`.
+     * @see lower_bound(std::span<const key_type>, std::span<iterator>)
+     * @pre `result.size() >= keys.size()`
+     */
+    void upper_bound(std::span<const key_type> keys, std::span<iterator> result) {
+        find_leaf_slots(*this, detail::greater_than, keys, result);
+    }
+    void upper_bound(std::span<const key_type> keys, std::span<const_iterator> result) const {
+        find_leaf_slots(*this, detail::greater_than, keys, result);
+    }
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    void upper_bound(std::span<const K> keys, std::span<iterator> result) {
+        find_leaf_slots(*this, detail::greater_than, keys, result);
+    }
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    void upper_bound(std::span<const K> keys, std::span<const_iterator> result) const {
+        find_leaf_slots(*this, detail::greater_than, keys, result);
+    }
+
+    /**
+     * Call `fn` with each run of contiguous values in [first, last), in order, as a std::span of values. Each run holds
+     * the live slots of one leaf, so that `fn` can process them in a tight loop instead of stepping an iterator across
+     * leaf boundaries. The next leaf is prefetched while `fn` processes the current one.
+     * @pre `last` is reachable from `first`
+     */
+    template <typename Function>
+    void for_each_leaf_span(iterator first, iterator last, Function&& fn) {
+        for_each_leaf_span_impl(first, last, fn);
+    }
+    template <typename Function>
+    void for_each_leaf_span(const_iterator first, const_iterator last, Function&& fn) const {
+        for_each_leaf_span_impl(first, last, fn);
+    }
+
+    /**
+     * Call `fn` with each run of contiguous values of the tree, in order.
+     * @see for_each_leaf_span(iterator, iterator, Function&&)
+     */
+    template <typename Function>
+    void for_each_leaf_span(Function&& fn) {
+        for_each_leaf_span_impl(begin(), end(), fn);
+    }
+    template <typename Function>
+    void for_each_leaf_span(Function&& fn) const {
+        for_each_leaf_span_impl(begin(), end(), fn);
+    }
+
+    /**
+     * Split the values whose key is in [lower, upper) into at most `parts` consecutive subranges holding about the
+     * same number of leaves, and return their boundaries: lower_bound(lower), the start of each following subrange,
+     * then lower_bound(upper). Subranges are cut at the boundaries of subtrees found by descending from the root, so
+     * that the leaves are not walked. Intended to scan a range with several threads.
+     */
+    [[nodiscard]] std::vector<iterator> split_range(const key_type& lower, const key_type& upper, size_type parts) {
+        return split_range_impl(*this, &lower, &upper, parts);
+    }
+    [[nodiscard]] std::vector<const_iterator> split_range(const key_type& lower,
+                                                          const key_type& upper,
+                                                          size_type parts) const {
+        return split_range_impl(*this, &lower, &upper, parts);
+    }
+
+    /**
+     * Split all the values of the tree into at most `parts` consecutive subranges.
+     * @see split_range(const key_type&, const key_type&, size_type)
+     */
+    [[nodiscard]] std::vector<iterator> split_range(size_type parts) {
+        return split_range_impl(*this, nullptr, nullptr, parts);
+    }
+    [[nodiscard]] std::vector<const_iterator> split_range(size_type parts) const {
+        return split_range_impl(*this, nullptr, nullptr, parts);
+    }
+
+BPLUSTREE_PRIVATE:
+    using level_type = size_type;
+    using slot_type = size_type;
+
+    static constexpr slot_type leaf_slots_max = traits_type::leaf_slots;
+    static constexpr slot_type inner_slots_max = traits_type::inner_slots;
+    static constexpr slot_type leaf_slots_min = leaf_slots_max / 2;
+    static constexpr slot_type inner_slots_min = inner_slots_max / 2;
+    static constexpr slot_type linear_search_threshold = traits_type::linear_search_threshold;
+    // Largest node searched linearly when its keys are compared one at a time
+    static constexpr slot_type scalar_linear_search_threshold = std::min<slot_type>(linear_search_threshold, 8);
+    static constexpr std::size_t node_pool_chunk_bytes = traits_type::node_pool_chunk_bytes;
+    static constexpr bool with_node_pool = node_pool_chunk_bytes > 0;
+    static constexpr bool with_compact_handles = traits_type::compact_handles;
+    static_assert(!with_compact_handles || with_node_pool,
+                  "compact handles designate nodes of the node pool, which requires Traits::node_pool_chunk_bytes");
+    static constexpr bool with_stats = traits_type::with_stats;
+    static constexpr bool with_order_statistics = traits_type::order_statistics;
+    using aggregate_type = typename traits_type::aggregate;
+    static constexpr bool with_aggregate = !std::is_void_v<aggregate_type>;
+    // Number of descents interleaved by batched lookups
+    static constexpr size_type batch_group_size = 16;
+
+    struct node_type;
+    struct inner_node_type;
+    struct leaf_node_type;
+
+    // Link from an inner node to one of its childs
+    using node_link_type = std::conditional_t<with_compact_handles, std::uint32_t, node_type*>;
+    // Link from a leaf to one of its siblings
+    using leaf_link_type = std::conditional_t<with_compact_handles, std::uint32_t, leaf_node_type*>;
+
+    class leaf_links;
+
+    /**
+     * Allocate a node of type `Node` from `allocator`, and construct it from `args`. `Node` is either a node type of
+     * the tree or, for the variants of the tree, a type extending one.
+     */
+    template <typename Node, typename... Args>
+    static Node* allocate_from_allocator(const allocator_type& allocator, Args&&... args) {
+        using node_allocator = typename std::allocator_traits<allocator_type>::template rebind_alloc<Node>;
+        auto alloc = node_allocator(allocator);
+        auto* n = std::allocator_traits<node_allocator>::allocate(alloc, 1);
+        std::allocator_traits<node_allocator>::construct(alloc, n, std::forward<Args>(args)...);
+        return n;
+    }
+
+    template <typename Node>
+    static void deallocate_from_allocator(const allocator_type& allocator, Node* n) noexcept {
+        using node_allocator = typename std::allocator_traits<allocator_type>::template rebind_alloc<Node>;
+        auto alloc = node_allocator(allocator);
+        std::allocator_traits<node_allocator>::destroy(alloc, n);
+        std::allocator_traits<node_allocator>::deallocate(alloc, n, 1);
+    }
+
+    template <typename Node, typename Pool, typename... Args>
+    Node* allocate_from_pool(Pool& pool, Args&&... args) {
+        Node* n;
+        if constexpr (with_compact_handles) {
+            const auto [object, handle] = pool.allocate(allocator);
+            n = std::construct_at(object, std::forward<Args>(args)...);
+            n->handle = handle;
+        } else {
+            n = std::construct_at(pool.allocate(allocator), std::forward<Args>(args)...);
+        }
+        stats.pool_chunks = leaf_pool.chunks() + inner_pool.chunks();
+        stats.pool_capacity = leaf_pool.capacity() + inner_pool.capacity();
+        return n;
+    }
+
+    template <typename Node, typename Pool>
+    static void deallocate_from_pool(Pool& pool, Node* n) {
+        if constexpr (with_compact_handles) {
+            const auto handle = n->handle;
+            std::destroy_at(n);
+            pool.deallocate(n, handle);
+        } else {
+            std::destroy_at(n);
+            pool.deallocate(n);
+        }
+    }
+
+    /**
+     * Child of `inner` in `slot`.
+     */
+    [[nodiscard]] node_type* child(const inner_node_type& inner, slot_type slot) const noexcept {
+        if constexpr (with_compact_handles) {
+            const auto handle = inner.childs[slot];
+            return inner.level == 1 ? static_cast<node_type*>(leaf_pool.get(handle)) : inner_pool.get(handle);
+        } else {
+            return inner.childs[slot];
+        }
+    }
+
+    static void set_child(inner_node_type& inner, slot_type slot, node_type* node) noexcept {
+        if constexpr (with_compact_handles) {
+            inner.childs[slot] = node->handle;
+        } else {
+            inner.childs[slot] = node;
+        }
+    }
+
+    [[nodiscard]] leaf_links links() const noexcept { return leaf_links(*this); }
+
+    /**
+     * Leaves before and after `leaf`, or null at the ends of the chain.
+     */
+    [[nodiscard]] leaf_node_type* previous_sibling(const leaf_node_type& leaf) const noexcept {
+        return links().previous(leaf);
+    }
+    [[nodiscard]] leaf_node_type* next_sibling(const leaf_node_type& leaf) const noexcept { return links().next(leaf); }
+
+    /**
+     * Add `n` to the counter `member` when statistics are enabled. Trees of other types sharing the node searches
+     * (i.e. concurrent_btree) have no counters.
+     */
+    template <typename Self>
+    static void add_to_counter(Self&& self, size_type counters_type::*member, size_type n = 1) noexcept {
+        if constexpr (with_stats && std::is_same_v<std::remove_cvref_t<Self>, btree>) {
+            self.counters.*member += n;
+        }
+    }
+
+    [[nodiscard]] leaf_node_type* allocate_leaf() {
+        leaf_node_type* leaf;
+        if constexpr (with_node_pool) {
+            leaf = allocate_from_pool<leaf_node_type>(leaf_pool);
+        } else {
+            leaf = allocate_from_allocator<leaf_node_type>(allocator);
+        }
+        ++stats.leaves;
+        add_to_counter(*this, &counters_type::allocations);
+        return leaf;
+    }
+
+    [[nodiscard]] inner_node_type* allocate_inner(level_type level) {
+        inner_node_type* inner;
+        if constexpr (with_node_pool) {
+            inner = allocate_from_pool<inner_node_type>(inner_pool, level);
+        } else {
+            inner = allocate_from_allocator<inner_node_type>(allocator, level);
+        }
+        ++stats.inner_nodes;
+        add_to_counter(*this, &counters_type::allocations);
+        return inner;
+    }
+
+    void deallocate_node(node_type* n) {
+        add_to_counter(*this, &counters_type::deallocations);
+        if (n->is_leafnode()) {
+            if constexpr (with_node_pool) {
+                deallocate_from_pool(leaf_pool, static_cast<leaf_node_type*>(n));
+            } else {
+                deallocate_from_allocator(allocator, static_cast<leaf_node_type*>(n));
+            }
+            --stats.leaves;
+        } else {
+            if constexpr (with_node_pool) {
+                deallocate_from_pool(inner_pool, static_cast<inner_node_type*>(n));
+            } else {
+                deallocate_from_allocator(allocator, static_cast<inner_node_type*>(n));
+            }
+            --stats.inner_nodes;
+        }
+    }
+
+    void clear_recursive(node_type* n) {
+        BPLUSTREE_ASSERT(n != nullptr);
+        if (n->is_leafnode()) {
+            // data objects are deleted by leaf_node's destructor
+        } else {
+            auto* inner = static_cast<inner_node_type*>(n);
+            for (slot_type slot = 0; slot < inner->slot_count + 1; ++slot) {
+                clear_recursive(child(*inner, slot));
+                deallocate_node(child(*inner, slot));
+            }
+        }
+    }
+
+    /**
+     * Compute how many nodes are needed to hold `count` entries (values or childs) when filling each of them up to
+     * `fill` entries, without exceeding `max` entries nor going below `min` entries per node.
+     */
+    [[nodiscard]] static size_type bulk_load_node_count(size_type count, size_type fill, size_type min, size_type max) {
+        const size_type at_least = (count + max - 1) / max;
+        const size_type at_most = std::max<size_type>(1, count / min);
+        return std::max(at_least, std::min((count + fill - 1) / fill, at_most));
+    }
+
+    /**
+     * Entries count to put in each node when filling `max` slots up to `fill_factor`.
+     */
+    [[nodiscard]] static size_type bulk_load_fill(float fill_factor, slot_type min, slot_type max) {
+        const float factor = std::clamp(fill_factor, 0.5f, 1.0f);
+        const auto fill = static_cast<size_type>(static_cast<float>(max) * factor + 0.5f);
+        return std::clamp<size_type>(fill, std::max<slot_type>(min, 1), max);
+    }
+
+    /**
+     * Reject `key` if it is longer than a separator can be in a prefix compressed inner node, which could then not hold
+     * it even alone.
+     */
+    static void check_key_length(const key_type& key) {
+        if constexpr (inner_node_type::compressed_keys) {
+            if (std::string_view(key).size() > static_cast<std::size_t>(traits_type::inner_key_bytes)) {
+                throw std::length_error("btree key longer than inner_key_bytes");
+            }
+        }
+    }
+
+    /**
+     * Build the tree bottom-up from `count` values sorted by key starting at `first`.
+     *
+     * Leaves are filled from left to right and chained together, then each inner level is built on top of the previous
+     * one, using the greatest key of each child subtree as separator, until a single root remains. Entries are evenly
+     * distributed among the nodes of a level so that only the root may underflow.
+     *
+     * Prefix compressed inner nodes use the shortest separator between the greatest key of a child and the least key of
+     * the next one instead, and hold fewer childs when their separators do not fit in the node.
+     */
+    template <class ForwardIterator>
+    void bulk_load_sorted(ForwardIterator first, size_type count, float fill_factor) {
+        clear();
+        if (count == 0) {
+            return;
+        }
+
+        // Nodes of the level being built, along with the least and greatest keys, the number of values and the
+        // aggregate of their subtree
+        struct subtree {
+            node_type* node;
+            const key_type* least;
+            const key_type* greatest;
+            size_type size;
+            aggregate_value_type aggregate;
+        };
+        std::vector<subtree> level_nodes;
+
+        const size_type leaf_fill = bulk_load_fill(fill_factor, leaf_slots_min, leaf_slots_max);
+        const size_type leaf_count = bulk_load_node_count(count, leaf_fill, leaf_slots_min, leaf_slots_max);
+        level_nodes.reserve(leaf_count);
+        leaf_node_type* previous = nullptr;
+        for (size_type i = 0; i < leaf_count; ++i) {
+            auto* leaf = allocate_leaf();
+            const size_type slots = count / leaf_count + (i < count % leaf_count ? 1 : 0);
+            for (slot_type slot = 0; slot < slots; ++slot, ++first) {
+                leaf->construct(slot, *first);
+            }
+            leaf->slot_count = slots;
+            leaf->previous_leaf = leaf_links::link_to(previous);
+            if (previous) {
+                previous->next_leaf = leaf_links::link_to(leaf);
+            } else {
+                head_leaf = leaf;
+            }
+            previous = leaf;
+            level_nodes.push_back({leaf, &leaf->key(0), &leaf->key(slots - 1), slots, aggregate_leaf(*leaf)});
+        }
+        tail_leaf = previous;
+        stats.size = count;
+        // Last node built, which ends up being the root once a level holds a single node
+        node_type* last_node = previous;
+
+        // An inner node holding n keys has n + 1 childs
+        const size_type inner_fill = bulk_load_fill(fill_factor, inner_slots_min, inner_slots_max) + 1;
+        for (level_type level = 1; level_nodes.size() > 1; ++level) {
+            const size_type child_count = level_nodes.size();
+            const size_type inner_count =
+                bulk_load_node_count(child_count, inner_fill, inner_slots_min + 1, inner_slots_max + 1);
+            std::vector<subtree> upper_nodes;
+            upper_nodes.reserve(inner_count);
+            // Separator between the child i and the next one, for prefix compressed nodes
+            std::vector<std::string_view> separators;
+            if constexpr (inner_node_type::compressed_keys) {
+                separators.reserve(child_count - 1);
+                for (size_type i = 0; i + 1 < child_count; ++i) {
+                    separators.push_back(
+                        detail::shortest_separator(*level_nodes[i].greatest, *level_nodes[i + 1].least));
+                }
+            }
+            for (size_type i = 0, child = 0; child < child_count; ++i) {
+                auto* inner = allocate_inner(level);
+                last_node = inner;
+                size_type childs = child_count / inner_count + (i < child_count % inner_count ? 1 : 0);
+                if constexpr (inner_node_type::compressed_keys) {
+                    // Share the remaining childs evenly, then give up childs until the separators fit
+                    const size_type remaining = child_count - child;
+                    const size_type nodes = (remaining + inner_fill - 1) / inner_fill;
+                    childs = (remaining + nodes - 1) / nodes;
+                    while (childs > 1 && !inner->keys.fits(separators.begin() + static_cast<std::ptrdiff_t>(child),
+                                                           childs - 1)) {
+                        --childs;
+                    }
+                    inner->keys.assign(separators.begin() + static_cast<std::ptrdiff_t>(child), childs - 1);
+                }
+                size_type values = 0;
+                aggregate_value_type combined = aggregate_identity();
+                for (slot_type slot = 0; slot < childs; ++slot) {
+                    set_child(*inner, slot, level_nodes[child + slot].node);
+                    values += level_nodes[child + slot].size;
+                    if constexpr (with_order_statistics) {
+                        inner->child_sizes[slot] = level_nodes[child + slot].size;
+                    }
+                    if constexpr (with_aggregate) {
+                        inner->child_aggregates[slot] = level_nodes[child + slot].aggregate;
+                        combined = aggregate_type::combine(combined, level_nodes[child + slot].aggregate);
+                    }
+                    if constexpr (!inner_node_type::compressed_keys) {
+                        if (slot + 1 < childs) {
+                            inner->keys.construct(slot, *level_nodes[child + slot].greatest);
+                        }
+                    }
+                }
+                inner->slot_count = childs - 1;
+                upper_nodes.push_back(
+                    {inner, level_nodes[child].least, level_nodes[child + childs - 1].greatest, values, combined});
+                child += childs;
+            }
+            level_nodes = std::move(upper_nodes);
+        }
+        root = last_node;
+        verify_if_debug();
+    }
+
+    /**
+     * Slots followed from the root down to a leaf, then slot in this leaf, locating a position between two values.
+     */
+    using path_type = std::vector<slot_type>;
+
+    /**
+     * A value in a leaf, followed through the moves of the values while the tree is rebalanced.
+     */
+    struct leaf_position {
+        leaf_node_type* leaf;
+        slot_type slot;
+    };
+
+    /**
+     * Path to the first leaf slot satisfying the comparison `comp` with `key`, which may be past the last value of its
+     * leaf.
+     */
+    template <typename Comparator>
+    [[nodiscard]] path_type find_path(const Comparator& comp, const key_type& key) const {
+        add_to_counter(*this, &counters_type::lookups);
+        path_type path;
+        path.reserve(root->level + 1);
+        const node_type* node = root;
+        while (!node->is_leafnode()) {
+            const auto* inner = static_cast<const inner_node_type*>(node);
+            path.push_back(find_slot_in_node(*this, *inner, comp, key));
+            node = child(*inner, path.back());
+        }
+        path.push_back(find_slot_in_node(*this, static_cast<const leaf_node_type&>(*node), comp, key));
+        return path;
+    }
+
+    /**
+     * Path to the value pointed to by `it`, or past the last value for end().
+     */
+    [[nodiscard]] path_type find_path(const_iterator it) const {
+        path_type path;
+        if (it == cend()) {
+            const node_type* node = root;
+            while (!node->is_leafnode()) {
+                path.push_back(node->slot_count);
+                node = child(*static_cast<const inner_node_type*>(node), node->slot_count);
+            }
+            path.push_back(node->slot_count);
+            return path;
+        }
+        path = find_path(detail::greater_than_or_equal_to, it.key());
+        // Values with equivalent keys may span several leaves before the one of `it`
+        while (leaf_at(path) != it.current_leaf) {
+            next_leaf_path(path);
+        }
+        path.back() = it.current_slot;
+        return path;
+    }
+
+    [[nodiscard]] leaf_node_type* leaf_at(const path_type& path) const {
+        node_type* node = root;
+        for (size_type depth = 0; depth + 1 < path.size(); ++depth) {
+            node = child(*static_cast<inner_node_type*>(node), path[depth]);
+        }
+        return static_cast<leaf_node_type*>(node);
+    }
+
+    /**
+     * Move `path` to the first slot of the next leaf.
+     */
+    void next_leaf_path(path_type& path) const {
+        std::vector<const inner_node_type*> nodes{static_cast<const inner_node_type*>(root)};
+        for (size_type depth = 0; depth + 2 < path.size(); ++depth) {
+            nodes.push_back(static_cast<const inner_node_type*>(child(*nodes.back(), path[depth])));
+        }
+        for (size_type depth = nodes.size(); depth-- > 0;) {
+            if (path[depth] < nodes[depth]->slot_count) {
+                ++path[depth];
+                std::fill(path.begin() + static_cast<std::ptrdiff_t>(depth) + 1, path.end(), 0);
+                return;
+            }
+        }
+    }
+
+    /**
+     * Chain the leaves `left` and `right`, either of them being null at the ends of the chain.
+     */
+    void link_leaves(leaf_node_type* left, leaf_node_type* right) noexcept {
+        if (left) {
+            left->next_leaf = leaf_links::link_to(right);
+        } else {
+            head_leaf = right;
+        }
+        if (right) {
+            right->previous_leaf = leaf_links::link_to(left);
+        } else {
+            tail_leaf = left;
+        }
+    }
+
+    /**
+     * Free the subtree rooted at `node`, and return the number of values it held.
+     */
+    size_type free_subtree(node_type* node) {
+        size_type values = node->slot_count;
+        if (!node->is_leafnode()) {
+            auto* inner = static_cast<inner_node_type*>(node);
+            values = 0;
+            for (slot_type slot = 0; slot <= inner->slot_count; ++slot) {
+                values += free_subtree(child(*inner, slot));
+            }
+        }
+        deallocate_node(node);
+        return values;
+    }
+
+    /**
+     * Number of values removed by erase_between(), and iterator to the value that followed them.
+     */
+    struct erased_range {
+        size_type count;
+        iterator following;
+    };
+
+    /**
+     * Remove the values between the positions `first` and `last`, and return how many were removed along with the
+     * position that followed them.
+     *
+     * The leaves in between and the boundary leaves left empty are unlinked first, then the subtrees in between are
+     * freed and the boundary leaves trimmed while descending both paths (see erase_node()). The root is finally
+     * replaced by its only child as long as it has a single one. The value that followed the range is tracked through
+     * the rebalancing, so it is never searched again.
+     */
+    erased_range erase_between(const path_type& first, const path_type& last) {
+        leaf_node_type* first_leaf = leaf_at(first);
+        leaf_node_type* last_leaf = leaf_at(last);
+        const slot_type first_slot = first.back();
+        const slot_type last_slot = std::min(last.back(), last_leaf->slot_count);
+        // The value that follows the range, if any
+        leaf_position following{last_leaf, last_slot};
+        if (last_slot == last_leaf->slot_count) {
+            following = {next_sibling(*last_leaf), 0};
+        }
+        if (first_leaf == last_leaf && first_slot >= last_slot) {
+            return {0, following.leaf ? iterator(following.leaf, following.slot, links()) : end()};
+        }
+        if (first_leaf == head_leaf && first_slot == 0 && last_leaf == tail_leaf && last_slot == tail_leaf->slot_count) {
+            const size_type erased = size();
+            clear();
+            return {erased, end()};
+        }
+
+        const bool first_emptied = first_slot == 0 && (first_leaf != last_leaf || last_slot == last_leaf->slot_count);
+        const bool last_emptied = first_leaf != last_leaf && last_slot == last_leaf->slot_count;
+        leaf_node_type* previous = first_emptied ? previous_sibling(*first_leaf) : first_leaf;
+        if (first_leaf != last_leaf && !last_emptied) {
+            link_leaves(previous, last_leaf);
+            previous = last_leaf;
+        }
+        link_leaves(previous, next_sibling(*last_leaf));
+
+        bool emptied = false;
+        const size_type erased =
+            erase_node(root, first.data(), last.data(), emptied, following.leaf ? &following : nullptr);
+        BPLUSTREE_ASSERT(!emptied);
+        collapse_root();
+        stats.size -= erased;
+        verify_if_debug();
+        return {erased, following.leaf ? iterator(following.leaf, following.slot, links()) : end()};
+    }
+
+    /**
+     * Remove from the subtree of `node` the values between the positions `first` and `last`, given as the slots to
+     * follow from `node`, a null position standing for the beginning or the end of the subtree. Return the number of
+     * values removed, and set `emptied` if none is left, in which case the caller frees the subtree.
+     *
+     * The childs between both positions are freed without being searched, and the ones holding the positions are
+     * processed recursively. Only these last ones may underflow afterwards, they are rebalanced with their siblings
+     * before returning (see repair_childs()), moving `tracked` along with the value it points to if not null.
+     */
+    size_type erase_node(node_type* node, const slot_type* first, const slot_type* last, bool& emptied,
+                         leaf_position* tracked) {
+        if (node->is_leafnode()) {
+            auto* leaf = static_cast<leaf_node_type*>(node);
+            const slot_type begin_slot = first ? std::min(*first, leaf->slot_count) : 0;
+            const slot_type end_slot = last ? std::min(*last, leaf->slot_count) : leaf->slot_count;
+            const slot_type erased = begin_slot < end_slot ? end_slot - begin_slot : 0;
+            if (erased > 0) {
+                leaf->destroy(begin_slot, end_slot);
+                leaf->relocate(end_slot, leaf->slot_count, *leaf, begin_slot);
+                leaf->slot_count -= erased;
+                if (tracked && tracked->leaf == leaf && tracked->slot >= end_slot) {
+                    tracked->slot -= erased;
+                }
+            }
+            emptied = leaf->slot_count == 0;
+            return erased;
+        }
+
+        auto* inner = static_cast<inner_node_type*>(node);
+        const slot_type first_child = first ? *first : 0;
+        const slot_type last_child = last ? *last : inner->slot_count;
+        const slot_type* child_first = first ? first + 1 : nullptr;
+        const slot_type* child_last = last ? last + 1 : nullptr;
+        // Whether the childs holding both positions are left empty
+        std::array<bool, 2> childs_emptied{};
+        size_type erased;
+        if (first_child == last_child) {
+            erased = erase_node(child(*inner, first_child), child_first, child_last, childs_emptied[0], tracked);
+        } else {
+            erased = erase_node(child(*inner, first_child), child_first, nullptr, childs_emptied[0], tracked);
+            erased += erase_node(child(*inner, last_child), nullptr, child_last, childs_emptied[1], tracked);
+            for (slot_type slot = first_child + 1; slot < last_child; ++slot) {
+                erased += free_subtree(child(*inner, slot));
+            }
+            erase_childs(*inner, first_child + 1, last_child - first_child - 1, first_child + 1);
+        }
+
+        const slot_type boundaries = first_child == last_child ? 1 : 2;
+        if (inner->slot_count + 1 == boundaries && childs_emptied[0] && (boundaries == 1 || childs_emptied[1])) {
+            emptied = true;
+            return erased;
+        }
+        // From the right, so that removing a child does not move the other one
+        for (slot_type i = boundaries; i-- > 0;) {
+            const slot_type slot = first_child + i;
+            if (childs_emptied[i]) {
+                free_subtree(child(*inner, slot));
+                erase_childs(*inner, slot, 1, slot < inner->slot_count ? slot : slot - 1);
+            } else {
+                refresh_child(*inner, slot);
+            }
+        }
+        emptied = false;
+        repair_childs(*inner, tracked);
+        return erased;
+    }
+
+    /**
+     * A child of an inner node, along with the subtree size and aggregate cached for it if any.
+     */
+    struct child_entry {
+        node_type* node;
+        [[no_unique_address]] std::conditional_t<with_order_statistics, size_type, detail::empty> size;
+        [[no_unique_address]] std::conditional_t<with_aggregate, aggregate_value_type, detail::empty> aggregate;
+    };
 
-    [[nodiscard]] bool empty() const noexcept { return size() == 0; }
+    [[nodiscard]] child_entry take_child(inner_node_type& inner, slot_type slot) {
+        child_entry entry{child(inner, slot), {}, {}};
+        if constexpr (with_order_statistics) {
+            entry.size = inner.child_sizes[slot];
+        }
+        if constexpr (with_aggregate) {
+            entry.aggregate = std::move(inner.child_aggregates[slot]);
+        }
+        return entry;
+    }
 
-    [[nodiscard]] const stats_type& get_stats() const noexcept { return stats; }
+    static void put_child(inner_node_type& inner, slot_type slot, child_entry&& entry) {
+        set_child(inner, slot, entry.node);
+        if constexpr (with_order_statistics) {
+            inner.child_sizes[slot] = entry.size;
+        }
+        if constexpr (with_aggregate) {
+            inner.child_aggregates[slot] = std::move(entry.aggregate);
+        }
+    }
 
-    [[nodiscard]] iterator lower_bound(const key_type& key) { return lower_bound_impl(*this, key); }
-    [[nodiscard]] const_iterator lower_bound(const key_type& key) const { return lower_bound_impl(*this, key); }
+    /**
+     * Entry for `node`, with the subtree size and aggregate computed from its content.
+     */
+    [[nodiscard]] static child_entry make_child_entry(node_type* node) {
+        child_entry entry{node, {}, {}};
+        if (node->is_leafnode()) {
+            if constexpr (with_order_statistics) {
+                entry.size = node->slot_count;
+            }
+            if constexpr (with_aggregate) {
+                entry.aggregate = aggregate_leaf(static_cast<const leaf_node_type&>(*node));
+            }
+            return entry;
+        }
+        const auto& inner = static_cast<const inner_node_type&>(*node);
+        const auto childs = static_cast<std::ptrdiff_t>(inner.slot_count + 1);
+        if constexpr (with_order_statistics) {
+            entry.size = std::accumulate(inner.child_sizes.begin(), inner.child_sizes.begin() + childs, size_type{0});
+        }
+        if constexpr (with_aggregate) {
+            entry.aggregate = std::accumulate(inner.child_aggregates.begin(), inner.child_aggregates.begin() + childs,
+                                              aggregate_identity(),
+                                              [](const auto& a, const auto& b) { return aggregate_type::combine(a, b); });
+        }
+        return entry;
+    }
 
-    [[nodiscard]] iterator upper_bound(const key_type& key) { return upper_bound_impl(*this, key); }
-    [[nodiscard]] const_iterator upper_bound(const key_type& key) const { return upper_bound_impl(*this, key); }
+    /**
+     * Recompute the subtree size and aggregate cached for the child in `slot` of `inner`, if any, from the content of
+     * the child.
+     */
+    void refresh_child(inner_node_type& inner, slot_type slot) {
+        if constexpr (with_order_statistics || with_aggregate) {
+            put_child(inner, slot, make_child_entry(child(inner, slot)));
+        }
+    }
 
-private:
-    using level_type = size_type;
-    using slot_type = size_type;
+    /**
+     * Copy of the separators of `inner`, as whole keys.
+     */
+    [[nodiscard]] static std::vector<key_type> separators_of(const inner_node_type& inner) {
+        std::vector<key_type> separators;
+        separators.reserve(inner.slot_count);
+        for (slot_type slot = 0; slot < inner.slot_count; ++slot) {
+            separators.push_back(inner.key(slot));
+        }
+        return separators;
+    }
 
-    static constexpr slot_type leaf_slots_max = traits_type::leaf_slots;
-    static constexpr slot_type inner_slots_max = traits_type::inner_slots;
-    static constexpr slot_type leaf_slots_min = leaf_slots_max / 2;
-    static constexpr slot_type inner_slots_min = inner_slots_max / 2;
+    /**
+     * Replace the separators of `inner` by the `count` ones starting at `first`, which becomes its slot count.
+     */
+    template <typename Iterator>
+    static void assign_separators(inner_node_type& inner, Iterator first, slot_type count) {
+        if constexpr (inner_node_type::compressed_keys) {
+            inner.keys.assign(first, count);
+        } else {
+            inner.keys.destroy(0, inner.slot_count);
+            for (slot_type slot = 0; slot < count; ++slot, ++first) {
+                inner.keys.construct(slot, std::move(*first));
+            }
+        }
+        inner.slot_count = count;
+    }
 
-    struct node_type;
-    struct inner_node_type;
-    struct leaf_node_type;
+    /**
+     * Remove `count` childs of `inner` starting at `first_child`, along with `count` separators starting at
+     * `first_key`.
+     */
+    void erase_childs(inner_node_type& inner, slot_type first_child, slot_type count, slot_type first_key) {
+        if (count == 0) {
+            return;
+        }
+        for (slot_type slot = first_child; slot + count <= inner.slot_count; ++slot) {
+            put_child(inner, slot, take_child(inner, slot + count));
+        }
+        if constexpr (inner_node_type::compressed_keys) {
+            std::vector<key_type> separators = separators_of(inner);
+            const auto erased = separators.begin() + static_cast<std::ptrdiff_t>(first_key);
+            separators.erase(erased, erased + static_cast<std::ptrdiff_t>(count));
+            inner.keys.assign(separators.begin(), separators.size());
+        } else {
+            inner.keys.destroy(first_key, first_key + count);
+            detail::relocate(inner.keys.data() + first_key + count, inner.keys.data() + inner.slot_count,
+                             inner.keys.data() + first_key);
+        }
+        inner.slot_count -= count;
+    }
 
-    template <typename Node, typename... Args>
-    static Node* allocate_from_allocator(const allocator_type& allocator, Args&&... args) {
-        auto alloc = typename Node::alloc_type(allocator);
-        auto* n = std::allocator_traits<decltype(alloc)>::allocate(alloc, 1);
-        std::allocator_traits<decltype(alloc)>::construct(alloc, n, std::forward<Args>(args)...);
-        return n;
+    /**
+     * Whether `node` holds too few entries to be anything but the root. Prefix compressed inner nodes may hold any
+     * number of separators, but a single child could not be rebalanced with siblings.
+     */
+    [[nodiscard]] static bool underflows(const node_type& node) noexcept {
+        if (node.is_leafnode()) {
+            return node.slot_count < leaf_slots_min;
+        }
+        return inner_node_type::compressed_keys ? node.slot_count == 0 : node.slot_count < inner_slots_min;
     }
 
-    template <typename Node>
-    static void deallocate_from_allocator(const allocator_type& allocator, Node* n) {
-        auto alloc = typename Node::alloc_type(allocator);
-        std::allocator_traits<decltype(alloc)>::destroy(alloc, n);
-        std::allocator_traits<decltype(alloc)>::deallocate(alloc, n, 1);
+    /**
+     * Rebalance the underflowing childs of `inner` with their siblings, until none is left or `inner` has a single
+     * child, which its own parent then rebalances. With prefix compressed inner nodes, a child is left underflowing
+     * when no separator fits in `inner` to rebalance it with either sibling. If not null, `tracked` is moved along
+     * with the value it points to.
+     */
+    void repair_childs(inner_node_type& inner, leaf_position* tracked = nullptr) {
+        slot_type slot = 0;
+        while (inner.slot_count > 0 && slot <= inner.slot_count) {
+            if (!underflows(*child(inner, slot))) {
+                ++slot;
+                continue;
+            }
+            // A merged node may still underflow when both were underflowing: check it again
+            if (slot < inner.slot_count && rebalance_childs(inner, slot, tracked)) {
+                continue;
+            }
+            if (slot > 0 && rebalance_childs(inner, slot - 1, tracked)) {
+                --slot;
+                continue;
+            }
+            ++slot;
+        }
     }
 
-    [[nodiscard]] leaf_node_type* allocate_leaf() {
-        auto* leaf = allocate_from_allocator<leaf_node_type>(allocator);
-        ++stats.leaves;
-        return leaf;
+    /**
+     * Rebalance the childs in `slot` and `slot + 1` of `parent`: merge them if their entries fit in a single node, or
+     * else share their entries evenly. Return false if neither was possible because of the length of the separators
+     * of prefix compressed inner nodes.
+     */
+    bool rebalance_childs(inner_node_type& parent, slot_type slot, leaf_position* tracked = nullptr) {
+        if (child(parent, slot)->is_leafnode()) {
+            return rebalance_leaves(parent, slot, tracked);
+        }
+        return rebalance_inner_nodes(parent, slot, tracked);
     }
 
-    [[nodiscard]] inner_node_type* allocate_inner(slot_type level) {
-        auto* inner = allocate_from_allocator<inner_node_type>(allocator, level);
-        ++stats.inner_nodes;
-        return inner;
+    bool rebalance_leaves(inner_node_type& parent, slot_type slot, leaf_position* tracked) {
+        auto& left = static_cast<leaf_node_type&>(*child(parent, slot));
+        auto& right = static_cast<leaf_node_type&>(*child(parent, slot + 1));
+        const slot_type total = left.slot_count + right.slot_count;
+        // Index of the tracked value among the values of both leaves, if it is in either
+        std::optional<slot_type> tracked_index;
+        if (tracked && tracked->leaf == &left) {
+            tracked_index = tracked->slot;
+        } else if (tracked && tracked->leaf == &right) {
+            tracked_index = left.slot_count + tracked->slot;
+        }
+        if (total <= leaf_slots_max) {
+            if (tracked_index) {
+                *tracked = {&left, *tracked_index};
+            }
+            right.relocate(0, right.slot_count, left, left.slot_count);
+            left.slot_count = total;
+            right.slot_count = 0;
+            link_leaves(&left, next_sibling(right));
+            erase_childs(parent, slot + 1, 1, slot);
+            deallocate_node(&right);
+            refresh_child(parent, slot);
+            add_to_counter(*this, &counters_type::merges);
+            return true;
+        }
+
+        // Number of values to leave in the left leaf
+        slot_type split = total / 2;
+        if constexpr (inner_node_type::compressed_keys) {
+            // Take the most balanced split leaving both leaves at least half full whose separator fits in the parent
+            std::vector<key_type> separators = separators_of(parent);
+            const auto key_at = [&](slot_type i) -> const key_type& {
+                return i < left.slot_count ? left.key(i) : right.key(i - left.slot_count);
+            };
+            const auto fits = [&](slot_type candidate) {
+                separators[slot] = detail::shortest_separator(key_at(candidate - 1), key_at(candidate));
+                return parent.keys.fits(separators.begin(), separators.size());
+            };
+            for (slot_type distance = 0;; ++distance) {
+                const bool below = split >= leaf_slots_min + distance;
+                const bool above = split + distance + leaf_slots_min <= total;
+                if (!below && !above) {
+                    return false;
+                }
+                if (below && fits(split - distance)) {
+                    split -= distance;
+                    break;
+                }
+                if (above && fits(split + distance)) {
+                    split += distance;
+                    break;
+                }
+            }
+            parent.keys.assign(separators.begin(), separators.size());
+        }
+        if (split > left.slot_count) {
+            const slot_type moved = split - left.slot_count;
+            right.relocate(0, moved, left, left.slot_count);
+            right.relocate(moved, right.slot_count, right, 0);
+        } else {
+            const slot_type moved = left.slot_count - split;
+            right.relocate(0, right.slot_count, right, moved);
+            left.relocate(split, left.slot_count, right, 0);
+        }
+        right.slot_count = total - split;
+        left.slot_count = split;
+        if (tracked_index) {
+            *tracked = *tracked_index < split ? leaf_position{&left, *tracked_index}
+                                              : leaf_position{&right, *tracked_index - split};
+        }
+        if constexpr (!inner_node_type::compressed_keys) {
+            parent.keys[slot] = left.key(split - 1);
+        }
+        refresh_child(parent, slot);
+        refresh_child(parent, slot + 1);
+        add_to_counter(*this, &counters_type::borrows);
+        return true;
     }
 
-    void deallocate_node(node_type* n) {
-        if (n->is_leafnode()) {
-            deallocate_from_allocator(allocator, static_cast<leaf_node_type*>(n));
-            --stats.leaves;
+    bool rebalance_inner_nodes(inner_node_type& parent, slot_type slot, leaf_position* tracked) {
+        auto& left = static_cast<inner_node_type&>(*child(parent, slot));
+        auto& right = static_cast<inner_node_type&>(*child(parent, slot + 1));
+        const slot_type total = left.slot_count + right.slot_count + 2;
+        // Separators between all the childs of both nodes, the one of the parent going between them
+        std::vector<key_type> separators = separators_of(left);
+        separators.push_back(parent.key(slot));
+        for (slot_type i = 0; i < right.slot_count; ++i) {
+            separators.push_back(right.key(i));
+        }
+        const auto fits = [&](slot_type first, slot_type count) {
+            if constexpr (inner_node_type::compressed_keys) {
+                return left.keys.fits(separators.begin() + static_cast<std::ptrdiff_t>(first), count);
+            } else {
+                return true;
+            }
+        };
+
+        if (total <= inner_slots_max + 1 && fits(0, total - 1)) {
+            for (slot_type i = 0; i <= right.slot_count; ++i) {
+                put_child(left, left.slot_count + 1 + i, take_child(right, i));
+            }
+            assign_separators(left, separators.begin(), total - 1);
+            erase_childs(parent, slot + 1, 1, slot);
+            deallocate_node(&right);
+            repair_childs(left, tracked);
+            refresh_child(parent, slot);
+            add_to_counter(*this, &counters_type::merges);
+            return true;
+        }
+
+        // Number of childs to leave in the left node
+        slot_type split = total / 2;
+        std::vector<key_type> parent_separators;
+        if constexpr (inner_node_type::compressed_keys) {
+            // Take the most balanced split leaving a separator in both nodes whose separators all fit
+            parent_separators = separators_of(parent);
+            const auto fits_split = [&](slot_type candidate) {
+                parent_separators[slot] = separators[candidate - 1];
+                return fits(0, candidate - 1) && fits(candidate, total - 1 - candidate) &&
+                       parent.keys.fits(parent_separators.begin(), parent_separators.size());
+            };
+            for (slot_type distance = 0;; ++distance) {
+                const bool below = split >= 2 + distance && split - distance + 2 <= total;
+                const bool above = split + distance >= 2 && split + distance + 2 <= total;
+                if (!below && !above) {
+                    return false;
+                }
+                if (below && fits_split(split - distance)) {
+                    split -= distance;
+                    break;
+                }
+                if (above && fits_split(split + distance)) {
+                    split += distance;
+                    break;
+                }
+            }
+        }
+        std::vector<child_entry> childs;
+        childs.reserve(total);
+        for (slot_type i = 0; i <= left.slot_count; ++i) {
+            childs.push_back(take_child(left, i));
+        }
+        for (slot_type i = 0; i <= right.slot_count; ++i) {
+            childs.push_back(take_child(right, i));
+        }
+        for (slot_type i = 0; i < total; ++i) {
+            put_child(i < split ? left : right, i < split ? i : i - split, std::move(childs[i]));
+        }
+        assign_separators(left, separators.begin(), split - 1);
+        assign_separators(right, separators.begin() + static_cast<std::ptrdiff_t>(split), total - 1 - split);
+        if constexpr (inner_node_type::compressed_keys) {
+            parent.keys.assign(parent_separators.begin(), parent_separators.size());
         } else {
-            deallocate_from_allocator(allocator, static_cast<inner_node_type*>(n));
-            --stats.inner_nodes;
+            parent.keys[slot] = std::move(separators[split - 1]);
+        }
+        repair_childs(left, tracked);
+        repair_childs(right, tracked);
+        refresh_child(parent, slot);
+        refresh_child(parent, slot + 1);
+        add_to_counter(*this, &counters_type::borrows);
+        return true;
+    }
+
+    template <typename V>
+    iterator insert_impl(V&& value, std::optional<const_iterator> hint = std::nullopt) {
+        check_key_length(key_extractor_type{}(value));
+        if (!root) {
+            leaf_node_type* leaf = allocate_leaf();
+            leaf->construct(0, std::forward<V>(value));
+            leaf->slot_count = 1;
+            root = head_leaf = tail_leaf = leaf;
+            stats.size = 1;
+            verify_if_debug();
+            return begin();
+        }
+        const key_type& key = key_extractor_type{}(value);
+        if (!key_compare(key, tail_leaf->key(tail_leaf->slot_count - 1))) {
+            return insert_in_leaf(tail_leaf, tail_leaf->slot_count, {}, std::forward<V>(value));
+        }
+        if (hint && hint->current_leaf) {
+            auto* leaf = const_cast<leaf_node_type*>(hint->current_leaf);
+            const slot_type slot = hint->current_slot;
+            // Values before the first one of a leaf may belong to the previous leaf, depending on the separator
+            // between both, so the key must be equivalent to this first value unless the leaf is the head leaf
+            const bool after_previous = slot > 0 ? !key_compare(key, leaf->key(slot - 1))
+                                                 : leaf == head_leaf || !key_compare(key, leaf->key(0));
+            if (after_previous && slot < leaf->slot_count && !key_compare(leaf->key(slot), key)) {
+                return insert_in_leaf(leaf, slot, {}, std::forward<V>(value));
+            }
+        }
+        path_type path = find_path(detail::greater_than, key);
+        leaf_node_type* leaf = leaf_at(path);
+        const slot_type slot = path.back();
+        return insert_in_leaf(leaf, slot, std::move(path), std::forward<V>(value));
+    }
+
+    /**
+     * Insert `value` in `leaf` before the value in `slot`. `path` leads to this position, or is empty to find it only
+     * if the inner nodes above `leaf` have to be updated.
+     *
+     * A full leaf is split, along with its full ancestors. Appending at the end of the tail leaf keeps about 90% of
+     * the entries in the left halves of the splits instead of half of them.
+     */
+    template <typename V>
+    iterator insert_in_leaf(leaf_node_type* leaf, slot_type slot, path_type path, V&& value) {
+        ++stats.size;
+        if (leaf->slot_count < leaf_slots_max) {
+            leaf->relocate(slot, leaf->slot_count, *leaf, slot + 1);
+            leaf->construct(slot, std::forward<V>(value));
+            ++leaf->slot_count;
+            if constexpr (with_order_statistics || with_aggregate) {
+                if (path.empty()) {
+                    path = find_path(const_iterator(leaf, slot, links()));
+                }
+                refresh_path(path);
+            }
+            verify_if_debug();
+            return iterator(leaf, slot, links());
+        }
+
+        if (path.empty()) {
+            path = find_path(const_iterator(leaf, slot, links()));
+        }
+        const bool append = leaf == tail_leaf && slot == leaf->slot_count;
+        const slot_type total = leaf->slot_count + 1;
+        // Number of values to leave in the left leaf
+        const slot_type split = append ? total - std::max<slot_type>(total / 10, 1) : total / 2;
+        leaf_node_type* right = allocate_leaf();
+        iterator inserted;
+        if (slot < split) {
+            leaf->relocate(split - 1, leaf->slot_count, *right, 0);
+            leaf->relocate(slot, split - 1, *leaf, slot + 1);
+            leaf->construct(slot, std::forward<V>(value));
+            inserted = iterator(leaf, slot, links());
+        } else {
+            leaf->relocate(slot, leaf->slot_count, *right, slot - split + 1);
+            leaf->relocate(split, slot, *right, 0);
+            right->construct(slot - split, std::forward<V>(value));
+            inserted = iterator(right, slot - split, links());
+        }
+        right->slot_count = total - split;
+        leaf->slot_count = split;
+        link_leaves(right, next_sibling(*leaf));
+        link_leaves(leaf, right);
+        add_to_counter(*this, &counters_type::splits);
+
+        key_type separator = leaf->key(split - 1);
+        if constexpr (inner_node_type::compressed_keys) {
+            separator = detail::shortest_separator(separator, right->key(0));
+        }
+        std::vector<inner_node_type*> nodes;
+        node_type* node = root;
+        for (size_type depth = 0; depth + 1 < path.size(); ++depth) {
+            nodes.push_back(static_cast<inner_node_type*>(node));
+            node = child(*nodes.back(), path[depth]);
+        }
+        child_entry entry = make_child_entry(right);
+        for (size_type depth = nodes.size(); depth-- > 0;) {
+            inner_node_type& inner = *nodes[depth];
+            refresh_child(inner, path[depth]);
+            auto parent_split =
+                insert_child(inner, path[depth] + 1, path[depth], std::move(separator), std::move(entry), append);
+            if (!parent_split) {
+                path.resize(depth + 1);
+                refresh_path(path);
+                verify_if_debug();
+                return inserted;
+            }
+            separator = std::move(parent_split->separator);
+            entry = make_child_entry(parent_split->node);
+        }
+        auto* new_root = allocate_inner(root->level + 1);
+        set_child(*new_root, 0, root);
+        refresh_child(*new_root, 0);
+        root = new_root;
+        [[maybe_unused]] const auto root_split = insert_child(*new_root, 1, 0, std::move(separator), std::move(entry));
+        BPLUSTREE_ASSERT(!root_split);
+        verify_if_debug();
+        return inserted;
+    }
+
+    /**
+     * Recompute the subtree sizes and aggregates cached along `path`, from the bottom up. The last slot of `path` is
+     * ignored.
+     */
+    void refresh_path(const path_type& path) {
+        if constexpr (with_order_statistics || with_aggregate) {
+            std::vector<inner_node_type*> nodes;
+            node_type* node = root;
+            for (size_type depth = 0; depth + 1 < path.size(); ++depth) {
+                nodes.push_back(static_cast<inner_node_type*>(node));
+                node = child(*nodes.back(), path[depth]);
+            }
+            for (size_type depth = nodes.size(); depth-- > 0;) {
+                refresh_child(*nodes[depth], path[depth]);
+            }
+        }
+    }
+
+    /**
+     * Rebalance the nodes on the right edge of the tree, which may underflow after insertions at the end (see
+     * insert()), before they become inner nodes of a larger tree.
+     */
+    void repair_right_edge() {
+        std::vector<inner_node_type*> spine;
+        for (node_type* node = root; !node->is_leafnode(); node = child(*spine.back(), node->slot_count)) {
+            spine.push_back(static_cast<inner_node_type*>(node));
+        }
+        for (size_type depth = spine.size(); depth-- > 0;) {
+            repair_childs(*spine[depth]);
+        }
+        collapse_root();
+    }
+
+    /**
+     * Replace the root by its only child as long as it has a single one.
+     */
+    void collapse_root() {
+        while (!root->is_leafnode() && root->slot_count == 0) {
+            node_type* single_child = child(*static_cast<inner_node_type*>(root), 0);
+            deallocate_node(root);
+            root = single_child;
+        }
+    }
+
+    [[nodiscard]] leaf_node_type* edge_leaf(node_type* node, bool rightmost) const noexcept {
+        while (!node->is_leafnode()) {
+            node = child(*static_cast<inner_node_type*>(node), rightmost ? node->slot_count : 0);
+        }
+        return static_cast<leaf_node_type*>(node);
+    }
+
+    /**
+     * Take the nodes of `other`, this tree being empty. Unlike swap(), the counters stay with their tree.
+     */
+    void take_content(btree& other) {
+        swap(other);
+        if constexpr (with_stats) {
+            std::swap(counters, other.counters);
+        }
+    }
+
+    /**
+     * Add the values, leaves and inner nodes of the subtree rooted at `node` to `counted`.
+     */
+    void count_nodes(const node_type* node, stats_type& counted) const {
+        if (node->is_leafnode()) {
+            ++counted.leaves;
+            counted.size += node->slot_count;
+            return;
+        }
+        ++counted.inner_nodes;
+        const auto* inner = static_cast<const inner_node_type*>(node);
+        for (slot_type slot = 0; slot <= inner->slot_count; ++slot) {
+            count_nodes(child(*inner, slot), counted);
+        }
+    }
+
+    /**
+     * Move the values from the position `path` onwards to the empty tree `upper`, see split(). Cutting the path is
+     * O(log n), counting the smaller part for the stats of both trees O(m / B).
+     * @pre `path` is neither at the beginning nor at the end of the tree
+     */
+    void split_at(const path_type& path, btree& upper) {
+        const stats_type before = stats;
+        upper.tail_leaf = tail_leaf;
+        bool emptied = false;
+        upper.root = cut_node(root, path.data(), upper, emptied);
+        BPLUSTREE_ASSERT(!emptied && upper.root);
+        collapse_root();
+        upper.collapse_root();
+        tail_leaf = edge_leaf(root, true);
+        upper.head_leaf = edge_leaf(upper.root, false);
+        upper.tail_leaf = edge_leaf(upper.root, true);
+        tail_leaf->next_leaf = {};
+        upper.head_leaf->previous_leaf = {};
+
+        // Nodes allocated and freed by both trees are added up, wrapping around if need be, so that counting the nodes
+        // of the smaller tree gives the stats of both
+        const size_type leaves = stats.leaves + upper.stats.leaves;
+        const size_type inner_nodes = stats.inner_nodes + upper.stats.inner_nodes;
+        const bool lower_smaller = root->level < upper.root->level ||
+                                   (root->level == upper.root->level && root->slot_count <= upper.root->slot_count);
+        btree& smaller = lower_smaller ? *this : upper;
+        btree& larger = lower_smaller ? upper : *this;
+        smaller.stats = stats_type{};
+        count_nodes(smaller.root, smaller.stats);
+        larger.stats.size = before.size - smaller.stats.size;
+        larger.stats.leaves = leaves - smaller.stats.leaves;
+        larger.stats.inner_nodes = inner_nodes - smaller.stats.inner_nodes;
+        verify_if_debug();
+        upper.verify_if_debug();
+    }
+
+    /**
+     * Cut the subtree of `node` at the position `path`, given as the slots to follow from `node`: the entries after the
+     * position move to a new node of the same level for `upper`, which is returned, or nullptr if there are none. Set
+     * `left_emptied` if no entry is left before the position, in which case `node` itself is returned.
+     *
+     * Only the nodes on the path are split, the childs on both sides of the path being shared out as they are. The
+     * childs next to the cut are then rebalanced in both parts (see repair_childs()), as far as the separators of
+     * prefix compressed inner nodes fit.
+     */
+    node_type* cut_node(node_type* node, const slot_type* path, btree& upper, bool& left_emptied) {
+        left_emptied = false;
+        if (node->is_leafnode()) {
+            auto* leaf = static_cast<leaf_node_type*>(node);
+            const slot_type slot = std::min(*path, leaf->slot_count);
+            if (slot == 0) {
+                left_emptied = true;
+                return leaf;
+            }
+            if (slot == leaf->slot_count) {
+                return nullptr;
+            }
+            leaf_node_type* right = allocate_leaf();
+            leaf->relocate(slot, leaf->slot_count, *right, 0);
+            right->slot_count = leaf->slot_count - slot;
+            leaf->slot_count = slot;
+            if (leaf->next_leaf) {
+                next_sibling(*leaf)->previous_leaf = leaf_links::link_to(right);
+            }
+            right->next_leaf = leaf->next_leaf;
+            right->previous_leaf = leaf_links::link_to(leaf);
+            leaf->next_leaf = leaf_links::link_to(right);
+            return right;
+        }
+
+        auto* inner = static_cast<inner_node_type*>(node);
+        const slot_type slot = *path;
+        bool child_emptied = false;
+        node_type* right_child = cut_node(child(*inner, slot), path + 1, upper, child_emptied);
+        if (!right_child && slot == inner->slot_count) {
+            return nullptr;
+        }
+        if (slot == 0 && child_emptied) {
+            left_emptied = true;
+            return inner;
+        }
+        // The right part holds the right part of the child on the path if any, then the childs after it, and the left
+        // part the childs before it, then the left part of this child if any
+        auto* right = allocate_inner(inner->level);
+        slot_type right_childs = 0;
+        if (right_child) {
+            put_child(*right, right_childs++, make_child_entry(right_child));
+        }
+        for (slot_type child = slot + 1; child <= inner->slot_count; ++child) {
+            put_child(*right, right_childs++, take_child(*inner, child));
+        }
+        std::vector<key_type> separators = separators_of(*inner);
+        assign_separators(*right, separators.end() - static_cast<std::ptrdiff_t>(right_childs - 1), right_childs - 1);
+        assign_separators(*inner, separators.begin(), child_emptied ? slot - 1 : slot);
+        if (!child_emptied) {
+            refresh_child(*inner, slot);
+        }
+        repair_childs(*inner);
+        upper.repair_childs(*right);
+        return right;
+    }
+
+    /**
+     * Second half of a full inner node split in two, and the separator to insert before it in the parent.
+     */
+    struct inner_split {
+        inner_node_type* node;
+        key_type separator;
+    };
+
+    /**
+     * Insert `entry` in the childs of `inner` at `child_slot`, and `separator` in its separators at `key_slot`, which
+     * is either `child_slot` or the slot before. When `inner` is full, its entries are shared out with a new node of
+     * the same level, which is returned for the parent to insert it after `inner`. `append` leaves most of them in
+     * `inner`, for a node on the right edge of the tree.
+     */
+    std::optional<inner_split> insert_child(inner_node_type& inner,
+                                            slot_type child_slot,
+                                            slot_type key_slot,
+                                            key_type separator,
+                                            child_entry&& entry,
+                                            bool append = false) {
+        if constexpr (!inner_node_type::compressed_keys) {
+            if (inner.slot_count < inner_slots_max) {
+                for (slot_type slot = inner.slot_count + 1; slot > child_slot; --slot) {
+                    put_child(inner, slot, take_child(inner, slot - 1));
+                }
+                put_child(inner, child_slot, std::move(entry));
+                detail::relocate(inner.keys.data() + key_slot, inner.keys.data() + inner.slot_count,
+                                 inner.keys.data() + key_slot + 1);
+                inner.keys.construct(key_slot, std::move(separator));
+                ++inner.slot_count;
+                return std::nullopt;
+            }
+        }
+        std::vector<key_type> separators = separators_of(inner);
+        separators.insert(separators.begin() + static_cast<std::ptrdiff_t>(key_slot), std::move(separator));
+        std::vector<child_entry> childs;
+        childs.reserve(inner.slot_count + 2);
+        for (slot_type slot = 0; slot <= inner.slot_count; ++slot) {
+            childs.push_back(take_child(inner, slot));
+        }
+        childs.insert(childs.begin() + static_cast<std::ptrdiff_t>(child_slot), std::move(entry));
+        const auto total = static_cast<slot_type>(childs.size());
+        const auto fits = [&](slot_type first, slot_type count) {
+            if constexpr (inner_node_type::compressed_keys) {
+                return inner.keys.fits(separators.begin() + static_cast<std::ptrdiff_t>(first), count);
+            } else {
+                return true;
+            }
+        };
+        if (total <= inner_slots_max + 1 && fits(0, total - 1)) {
+            for (slot_type slot = 0; slot < total; ++slot) {
+                put_child(inner, slot, std::move(childs[slot]));
+            }
+            assign_separators(inner, separators.begin(), total - 1);
+            return std::nullopt;
+        }
+
+        // Number of childs to leave in `inner`, taking the split closest to the even one, or to 90% of the childs when
+        // appending, whose separators fit in both nodes
+        slot_type split = append ? total - std::max<slot_type>(total / 10, 1) : total / 2;
+        if constexpr (inner_node_type::compressed_keys) {
+            for (slot_type distance = 0;; ++distance) {
+                const bool below = split > distance;
+                const bool above = split + distance < total;
+                BPLUSTREE_ASSERT(below || above);
+                if (below && fits(0, split - distance - 1) && fits(split - distance, total - 1 - split + distance)) {
+                    split -= distance;
+                    break;
+                }
+                if (above && fits(0, split + distance - 1) && fits(split + distance, total - 1 - split - distance)) {
+                    split += distance;
+                    break;
+                }
+            }
+        }
+        auto* right = allocate_inner(inner.level);
+        for (slot_type slot = 0; slot < total; ++slot) {
+            put_child(slot < split ? inner : *right, slot < split ? slot : slot - split, std::move(childs[slot]));
+        }
+        assign_separators(inner, separators.begin(), split - 1);
+        assign_separators(*right, separators.begin() + static_cast<std::ptrdiff_t>(split), total - 1 - split);
+        add_to_counter(*this, &counters_type::splits);
+        return inner_split{right, std::move(separators[split - 1])};
+    }
+
+    /**
+     * Graft the subtree `node`, not taller than the tree, at the end of the right spine of the tree, or at the
+     * beginning of its left spine, with `separator` between it and its new sibling.
+     *
+     * The spine nodes that get full are split bottom-up, the root included. The grafted node, which may underflow
+     * since it was a root, is then rebalanced along with the nodes of the spine.
+     */
+    void graft(node_type* node, key_type separator, bool at_end) {
+        const auto edge = [at_end](const inner_node_type& inner) { return at_end ? inner.slot_count : 0; };
+        const auto add_root = [this] {
+            auto* new_root = allocate_inner(root->level + 1);
+            set_child(*new_root, 0, root);
+            refresh_child(*new_root, 0);
+            root = new_root;
+            return new_root;
+        };
+        // Nodes of the spine from the parent of the grafted node up to the root
+        const auto spine_above = [&] {
+            std::vector<inner_node_type*> spine{static_cast<inner_node_type*>(root)};
+            while (spine.back()->level > node->level + 1) {
+                spine.push_back(static_cast<inner_node_type*>(child(*spine.back(), edge(*spine.back()))));
+            }
+            std::reverse(spine.begin(), spine.end());
+            return spine;
+        };
+        if (root->level == node->level) {
+            add_root();
+        }
+        std::vector<inner_node_type*> spine = spine_above();
+
+        child_entry entry = make_child_entry(node);
+        slot_type child_slot = at_end ? spine.front()->slot_count + 1 : 0;
+        slot_type key_slot = at_end ? spine.front()->slot_count : 0;
+        for (size_type depth = 0;; ++depth) {
+            auto split = insert_child(*spine[depth], child_slot, key_slot, std::move(separator), std::move(entry));
+            if (!split) {
+                break;
+            }
+            if (depth + 1 == spine.size()) {
+                spine.push_back(add_root());
+            }
+            // The second half goes right after the node split, which stays at the edge of its parent unless it holds
+            // the grafted node
+            inner_node_type& parent = *spine[depth + 1];
+            const slot_type slot = edge(parent);
+            refresh_child(parent, slot);
+            child_slot = slot + 1;
+            key_slot = slot;
+            separator = std::move(split->separator);
+            entry = make_child_entry(split->node);
+        }
+
+        for (inner_node_type* inner : spine_above()) {
+            refresh_child(*inner, edge(*inner));
+            repair_childs(*inner);
+        }
+        collapse_root();
+    }
+
+    /**
+     * Cursor moving out in order the values of two sorted ranges, the first range coming first among equivalent keys.
+     * Input of bulk_load_sorted() for merge().
+     */
+    class merge_cursor {
+    public:
+        merge_cursor(iterator first1, iterator last1, iterator first2, iterator last2, const key_compare_type& comp)
+            : first(first1), first_end(last1), second(first2), second_end(last2), compare(&comp) {
+            choose();
+        }
+
+        [[nodiscard]] value_type&& operator*() const { return std::move(from_first ? *first : *second); }
+
+        merge_cursor& operator++() {
+            if (from_first) {
+                ++first;
+            } else {
+                ++second;
+            }
+            choose();
+            return *this;
+        }
+
+    private:
+        // Chosen before the value is moved out, since its key may be moved along
+        void choose() {
+            from_first = second == second_end || (first != first_end && !(*compare)(second.key(), first.key()));
+        }
+
+        iterator first, first_end, second, second_end;
+        const key_compare_type* compare;
+        bool from_first{};
+    };
+
+    /**
+     * Add the fill ratio of `node` and of all the nodes of its subtree to the histograms of `snapshot`.
+     */
+    void collect_fill(const node_type* node, counters_type& snapshot) const {
+        const auto bucket = [](slot_type slots, slot_type max) {
+            return std::min(counters_type::fill_buckets - 1, slots * counters_type::fill_buckets / max);
+        };
+        if (node->is_leafnode()) {
+            ++snapshot.leaf_fill[bucket(node->slot_count, leaf_slots_max)];
+        } else {
+            ++snapshot.inner_fill[bucket(node->slot_count, inner_slots_max)];
+            const auto* inner = static_cast<const inner_node_type*>(node);
+            for (slot_type slot = 0; slot <= inner->slot_count; ++slot) {
+                collect_fill(child(*inner, slot), snapshot);
+            }
+        }
+    }
+
+    /**
+     * What has been seen so far by verify(), walking the tree in order.
+     */
+    struct verify_state {
+        const leaf_node_type* previous_leaf{};
+        size_type size{};
+        size_type leaves{};
+        size_type inner_nodes{};
+        // Aggregate of the last subtree checked
+        aggregate_value_type aggregate{};
+    };
+
+    /**
+     * Check the invariants of the subtree rooted at `node`, expected at `level`, whose keys are bounded by the
+     * separators `lower` and `upper` (nullptr when unbounded). See verify().
+     */
+    const char* verify_node(const node_type* node,
+                            const key_type* lower,
+                            const key_type* upper,
+                            level_type level,
+                            verify_state& state) const {
+        if (!node || node->level != level) {
+            return "missing node or node at the wrong level";
+        }
+        const slot_type max = node->is_leafnode() ? leaf_slots_max : inner_slots_max;
+        // With prefix compressed inner nodes, the length of the separators bounds the fill of inner nodes and may
+        // prevent rebalancing a leaf with its siblings, see repair_childs()
+        const slot_type min =
+            inner_node_type::compressed_keys ? 0 : (node->is_leafnode() ? leaf_slots_min : inner_slots_min);
+        // Nodes on the right edge, which have no upper bound, may underflow after insertions at the end
+        if (node->slot_count > max || (node != root && upper && node->slot_count < min) ||
+            (node->is_leafnode() && node->slot_count == 0)) {
+            return "node overflow or underflow";
+        }
+        const auto check_keys = [&](const auto& n) -> const char* {
+            for (slot_type slot = 1; slot < n.slot_count; ++slot) {
+                if (key_compare(n.key(slot), n.key(slot - 1))) {
+                    return "unsorted keys within a node";
+                }
+            }
+            if (n.slot_count > 0 && ((lower && key_compare(n.key(0), *lower)) ||
+                                     (upper && key_compare(*upper, n.key(n.slot_count - 1))))) {
+                return "key out of the bounds given by the separators of its subtree";
+            }
+            return nullptr;
+        };
+        if (node->is_leafnode()) {
+            const auto* leaf = static_cast<const leaf_node_type*>(node);
+            if (const char* problem = check_keys(*leaf)) {
+                return problem;
+            }
+            if constexpr (leaf_node_type::separate_keys) {
+                for (slot_type slot = 0; slot < leaf->slot_count; ++slot) {
+                    if (detail::not_equal_to(key_compare, leaf->key(slot), key_extractor_type{}(leaf->data[slot]))) {
+                        return "separate key does not match its value";
+                    }
+                }
+            }
+            if (previous_sibling(*leaf) != state.previous_leaf ||
+                (state.previous_leaf ? next_sibling(*state.previous_leaf) != leaf : head_leaf != leaf)) {
+                return "broken sibling links between leaves";
+            }
+            state.previous_leaf = leaf;
+            state.size += leaf->slot_count;
+            ++state.leaves;
+            state.aggregate = aggregate_leaf(*leaf);
+            return nullptr;
+        }
+        const auto* inner = static_cast<const inner_node_type*>(node);
+        if (const char* problem = check_keys(*inner)) {
+            return problem;
+        }
+        ++state.inner_nodes;
+        // Prefix compressed separators are rebuilt as whole keys
+        std::vector<key_type> separators;
+        if constexpr (inner_node_type::compressed_keys) {
+            for (slot_type slot = 0; slot < inner->slot_count; ++slot) {
+                separators.push_back(inner->key(slot));
+            }
+        }
+        const auto separator = [&](slot_type slot) -> const key_type* {
+            if constexpr (inner_node_type::compressed_keys) {
+                return &separators[slot];
+            } else {
+                return &inner->key(slot);
+            }
+        };
+        aggregate_value_type combined = aggregate_identity();
+        for (slot_type slot = 0; slot <= inner->slot_count; ++slot) {
+            const key_type* child_lower = slot > 0 ? separator(slot - 1) : lower;
+            const key_type* child_upper = slot < inner->slot_count ? separator(slot) : upper;
+            const size_type size_before = state.size;
+            if (const char* problem = verify_node(child(*inner, slot), child_lower, child_upper, level - 1, state)) {
+                return problem;
+            }
+            if constexpr (with_order_statistics) {
+                if (inner->child_sizes[slot] != state.size - size_before) {
+                    return "subtree size does not match the values below a child";
+                }
+            }
+            if constexpr (with_aggregate && std::equality_comparable<aggregate_value_type>) {
+                if (inner->child_aggregates[slot] != state.aggregate) {
+                    return "cached aggregate does not match the values below a child";
+                }
+            }
+            if constexpr (with_aggregate) {
+                combined = aggregate_type::combine(combined, state.aggregate);
+            }
         }
+        state.aggregate = combined;
+        return nullptr;
     }
 
-    void clear_recursive(node_type* n) {
-        BPLUSTREE_ASSERT(n != nullptr);
-        if (n->is_leafnode()) {
-            // data objects are deleted by leaf_node's destructor
-        } else {
-            auto* inner = static_cast<inner_node_type*>(n);
-            for (slot_type slot = 0; slot < inner->slot_count + 1; ++slot) {
-                clear_recursive(inner->childs[slot]);
-                deallocate_node(inner->childs[slot]);
+    /**
+     * Abort with a description of the first broken invariant of the tree if `Traits::debug` is set.
+     */
+    void verify_if_debug() const {
+        if constexpr (traits_type::debug) {
+            if (const char* problem = verify()) {
+                std::fprintf(stderr, "bplustree: corrupted tree: %s\n", problem);
+                std::abort();
             }
         }
     }
 
+    /**
+     * Whether a linear search of `K` probes compared with `Comparator` in a `Node` counts the keys ordered before the
+     * probe with the SIMD kernels, rather than comparing keys one at a time. See find_slot_in_node_linear().
+     */
+    template <typename Node, typename Comparator, typename K>
+    static constexpr bool is_simd_search_v =
+        Node::contiguous_keys && std::is_same_v<K, key_type> &&
+        detail::is_simd_searchable_v<key_type, key_compare_type> &&
+        (detail::is_lower_bound_v<Comparator> || detail::is_upper_bound_v<Comparator>);
+
+    /**
+     * Largest `Node` searched linearly for `K` probes compared with `Comparator`.
+     */
+    template <typename Node, typename Comparator, typename K>
+    static constexpr slot_type linear_search_threshold_v =
+        is_simd_search_v<Node, Comparator, K> ? linear_search_threshold : scalar_linear_search_threshold;
+
     /**
      * Find the slot corresponding to `key` for the given `node`. All comparisons on keys are performed using the
      * comparison object `comp`.
      *
-     * @todo Perform a linear search for small number of key slots. Threshold between linear and binary search should be
-     * configurable by the user.
+     * Nodes holding at most `Traits::linear_search_threshold` keys are searched linearly, or at most 8 keys when they
+     * are compared one at a time, other ones use a binary search. Prefix compressed inner nodes always use a binary
+     * search over the suffixes of their separators.
+     *
+     * `key` is either a key_type or, with a transparent comparator, any type the keys can be compared with.
      */
-    template <typename Node, typename Comparator, typename Self>
+    template <typename Node, typename Comparator, typename Self, typename K>
     [[nodiscard]] static slot_type find_slot_in_node(Self&& self,
                                                      const Node& node,
                                                      const Comparator& comp,
-                                                     const key_type& key) noexcept {
-        slot_type lower = 0, upper = node.slot_count;
-        while (lower < upper) {
-            const slot_type middle = (lower + upper) / 2;
-            if (comp(self.key_compare, node.key(middle), key)) {
-                upper = middle;
+                                                     const K& key) noexcept {
+        add_to_counter(self, &counters_type::nodes_visited);
+        if constexpr (Node::compressed_keys) {
+            add_to_counter(self, &counters_type::key_comparisons, std::bit_width(node.slot_count) + 1);
+            return node.keys.template find_slot<detail::is_upper_bound_v<Comparator>>(node.slot_count, key);
+        } else {
+            if (node.slot_count <= linear_search_threshold_v<Node, Comparator, K>) {
+                return find_slot_in_node_linear(self, node, comp, key);
+            }
+            slot_type lower = 0, upper = node.slot_count;
+            while (lower < upper) {
+                add_to_counter(self, &counters_type::key_comparisons);
+                const slot_type middle = (lower + upper) / 2;
+                if (comp(self.key_compare, node.key(middle), key)) {
+                    upper = middle;
+                } else {
+                    lower = middle + 1;
+                }
+            }
+            return lower;
+        }
+    }
+
+    /**
+     * Find the slot corresponding to `key` for the given `node` by scanning its keys from the first one.
+     *
+     * When the node stores its keys contiguously and they are eligible to SIMD comparisons (see `Traits::simd`), the
+     * slot is obtained by counting the keys ordered before `key` instead. Since the keys are sorted, both give the
+     * same slot for the lower bound (greater_than_or_equal_to) and upper bound (greater_than) comparisons. Probes of
+     * another type than key_type are always compared one key at a time.
+     */
+    template <typename Node, typename Comparator, typename Self, typename K>
+    [[nodiscard]] static slot_type find_slot_in_node_linear(Self&& self,
+                                                            const Node& node,
+                                                            const Comparator& comp,
+                                                            const K& key) noexcept {
+        if constexpr (is_simd_search_v<Node, Comparator, K>) {
+            add_to_counter(self, &counters_type::key_comparisons, node.slot_count);
+            if constexpr (detail::is_lower_bound_v<Comparator>) {
+                return detail::count_less<traits_type::simd, false>(node.key_data(), node.slot_count, key);
             } else {
-                lower = middle + 1;
+                return node.slot_count -
+                       detail::count_less<traits_type::simd, true>(node.key_data(), node.slot_count, key);
             }
+        } else {
+            slot_type slot = 0;
+            while (slot < node.slot_count && !comp(self.key_compare, node.key(slot), key)) {
+                ++slot;
+            }
+            add_to_counter(self, &counters_type::key_comparisons, std::min(slot + 1, node.slot_count));
+            return slot;
         }
-        return lower;
     }
 
     /**
      * Traverse the tree from root to leaves and find the first leaf node slot satisfying the comparison `comp` with
      * `key`.
      */
-    template <typename Comparator, typename Self>
-    [[nodiscard]] static auto find_leaf_slot(Self&& self, const Comparator& comp, const key_type& key) {
+    template <typename Comparator, typename Self, typename K>
+    [[nodiscard]] static auto find_leaf_slot(Self&& self, const Comparator& comp, const K& key) {
+        add_to_counter(self, &counters_type::lookups);
         node_type* node = self.root;
         if (!node) {
             return self.end();
@@ -351,27 +3357,388 @@ private:
         while (!node->is_leafnode()) {
             const auto* inner = static_cast<const inner_node_type*>(node);
             slot_type slot = find_slot_in_node(self, *inner, comp, key);
-            node = inner->childs[slot];
+            node = self.child(*inner, slot);
         }
         auto* leaf = static_cast<leaf_node_type*>(node);
         slot_type slot = find_slot_in_node(self, *leaf, comp, key);
-        return select_iterator_type<Self>(leaf, slot);
+        self.skip_exhausted_leaf(leaf, slot);
+        return select_iterator_type<Self>(leaf, slot, self.links());
+    }
+
+    /**
+     * Find the first leaf node slot satisfying the comparison `comp` with `key` in the leaf of `hint` or in one of its
+     * siblings when the bound is there, which the first and last keys of these leaves tell, or with find_leaf_slot()
+     * otherwise.
+     *
+     * A single sibling is stepped to: no node tells how far the bound is beyond it, so each further leaf walked for
+     * nothing would add a node to the descent from the root. A far bound thus costs a descent plus the two leaves
+     * checked.
+     */
+    template <typename Comparator, typename Self, typename K>
+    [[nodiscard]] static auto find_leaf_slot_from(Self&& self,
+                                                  const Comparator& comp,
+                                                  const_iterator hint,
+                                                  const K& key) {
+        auto* leaf = const_cast<leaf_node_type*>(hint.current_leaf);
+        if (!leaf || leaf->slot_count == 0) {
+            return find_leaf_slot(self, comp, key);
+        }
+        // Whether the bound is after the last value of `l`, or may be before its first value
+        const auto after = [&](const leaf_node_type& l) {
+            return !comp(self.key_compare, l.key(l.slot_count - 1), key);
+        };
+        const auto before = [&](const leaf_node_type& l) { return comp(self.key_compare, l.key(0), key); };
+        const auto search = [&](leaf_node_type* l) {
+            add_to_counter(self, &counters_type::lookups);
+            slot_type slot = find_slot_in_node(self, *l, comp, key);
+            self.skip_exhausted_leaf(l, slot);
+            return select_iterator_type<Self>(l, slot, self.links());
+        };
+        if (leaf->next_leaf && after(*leaf)) {
+            // The bound is in the next leaf, unless it is after its last value too
+            add_to_counter(self, &counters_type::nodes_visited);
+            leaf = self.next_sibling(*leaf);
+            if (leaf->next_leaf && after(*leaf)) {
+                add_to_counter(self, &counters_type::nodes_visited);
+                return find_leaf_slot(self, comp, key);
+            }
+            return search(leaf);
+        }
+        if (leaf->previous_leaf && before(*leaf)) {
+            // The bound is in the previous leaf, at the first value of this one if none satisfies `comp` there, unless
+            // the first value of the previous leaf satisfies it too
+            add_to_counter(self, &counters_type::nodes_visited);
+            leaf_node_type* previous = self.previous_sibling(*leaf);
+            if (after(*previous)) {
+                add_to_counter(self, &counters_type::nodes_visited);
+                add_to_counter(self, &counters_type::lookups);
+                return select_iterator_type<Self>(leaf, 0, self.links());
+            }
+            if (previous->previous_leaf && before(*previous)) {
+                add_to_counter(self, &counters_type::nodes_visited);
+                return find_leaf_slot(self, comp, key);
+            }
+            return search(previous);
+        }
+        return search(leaf);
+    }
+
+    /**
+     * Move a slot found past the last value of a leaf to the first slot of the next leaf, if any. This happens when a
+     * key falls between the greatest key of a leaf and the separator after it, which is not always the greatest key of
+     * the leaf (see btree_inner_layout::prefix_compressed).
+     */
+    void skip_exhausted_leaf(leaf_node_type*& leaf, slot_type& slot) const noexcept {
+        if (slot == leaf->slot_count && leaf->next_leaf) {
+            leaf = next_sibling(*leaf);
+            slot = 0;
+        }
+    }
+
+    /**
+     * Whether the separator in `slot` of `inner` satisfies the comparison `comp` with `key`.
+     */
+    template <typename Comparator, typename Self, typename K>
+    [[nodiscard]] static bool separator_satisfies(Self&& self,
+                                                  const inner_node_type& inner,
+                                                  const Comparator& comp,
+                                                  slot_type slot,
+                                                  const K& key) {
+        if constexpr (inner_node_type::compressed_keys) {
+            const int order = inner.keys.compare(slot, key);
+            return detail::is_upper_bound_v<Comparator> ? order > 0 : order >= 0;
+        } else {
+            return comp(self.key_compare, inner.key(slot), key);
+        }
+    }
+
+    /**
+     * Batched version of find_leaf_slot, storing in `result[i]` the leaf node slot found for `keys[i]`.
+     *
+     * Keys are looked up by groups of `batch_group_size`, descending the tree one level at a time for the whole group.
+     * All leaves being at the same depth, every descent of a group reaches a given level at the same step. The node
+     * each descent moves to is prefetched, and is only searched once the other descents of the group have been
+     * advanced, which gives its cache misses time to resolve.
+     *
+     * When the keys are sorted, a key is not ordered before the previous one. So in a node crossed by both descents,
+     * it still goes to the child followed by the previous key when this child is not the last one and its separator
+     * satisfies `comp` with the key, in which case the search of the node is skipped.
+     */
+    template <typename Comparator, typename Self, typename K>
+    static void find_leaf_slots(Self&& self,
+                                const Comparator& comp,
+                                std::span<const K> keys,
+                                std::span<select_iterator_type<Self>> result) {
+        BPLUSTREE_ASSERT(result.size() >= keys.size());
+        add_to_counter(self, &counters_type::lookups, keys.size());
+        if (!self.root) {
+            std::fill_n(result.begin(), keys.size(), self.end());
+            return;
+        }
+        // A transparent comparator may only order probes against keys, the probes are then taken as unsorted
+        bool sorted = false;
+        if constexpr (std::is_invocable_r_v<bool, const key_compare_type&, const K&, const K&>) {
+            sorted = std::is_sorted(keys.begin(), keys.end(), self.key_compare);
+        }
+        std::array<node_type*, batch_group_size> nodes;
+        for (size_type first = 0; first < keys.size(); first += batch_group_size) {
+            const size_type count = std::min(batch_group_size, keys.size() - first);
+            std::fill_n(nodes.begin(), count, self.root);
+            for (level_type level = self.root->level; level > 0; --level) {
+                const inner_node_type* previous = nullptr;
+                slot_type previous_slot = 0;
+                for (size_type i = 0; i < count; ++i) {
+                    const auto* inner = static_cast<const inner_node_type*>(nodes[i]);
+                    const K& key = keys[first + i];
+                    if (sorted && inner == previous && previous_slot < inner->slot_count &&
+                        separator_satisfies(self, *inner, comp, previous_slot, key)) {
+                        nodes[i] = nodes[i - 1];
+                        continue;
+                    }
+                    previous = inner;
+                    previous_slot = find_slot_in_node(self, *inner, comp, key);
+                    nodes[i] = self.child(*inner, previous_slot);
+                    if (level > 1) {
+                        detail::prefetch(nodes[i], sizeof(inner_node_type));
+                    } else {
+                        detail::prefetch(nodes[i], sizeof(leaf_node_type));
+                    }
+                }
+            }
+            for (size_type i = 0; i < count; ++i) {
+                auto* leaf = static_cast<leaf_node_type*>(nodes[i]);
+                slot_type slot = find_slot_in_node(self, *leaf, comp, keys[first + i]);
+                self.skip_exhausted_leaf(leaf, slot);
+                result[first + i] = select_iterator_type<Self>(leaf, slot, self.links());
+            }
+        }
+    }
+
+    [[nodiscard]] static aggregate_value_type aggregate_identity() {
+        if constexpr (with_aggregate) {
+            return aggregate_type::identity();
+        } else {
+            return {};
+        }
+    }
+
+    /**
+     * Aggregate of the values in slots [first, last) of `leaf`.
+     */
+    [[nodiscard]] static aggregate_value_type aggregate_leaf(const leaf_node_type& leaf,
+                                                             slot_type first = 0,
+                                                             slot_type last = leaf_slots_max) {
+        aggregate_value_type result = aggregate_identity();
+        if constexpr (with_aggregate) {
+            for (slot_type slot = first; slot < std::min(last, leaf.slot_count); ++slot) {
+                result = aggregate_type::combine(result, aggregate_type::lift(leaf.data[slot]));
+            }
+        }
+        return result;
+    }
+
+    /**
+     * Aggregate of the values of the subtree rooted at `node` whose key is neither ordered before `*lower` nor after or
+     * equivalent to `*upper`, a null bound leaving the subtree unbounded on its side. See aggregate().
+     */
+    template <typename K>
+    [[nodiscard]] aggregate_value_type aggregate_node(const node_type* node, const K* lower, const K* upper) const {
+        const auto find = [this](const auto& n, const K* bound, slot_type unbounded) {
+            return bound ? find_slot_in_node(*this, n, detail::greater_than_or_equal_to, *bound) : unbounded;
+        };
+        if (node->is_leafnode()) {
+            const auto& leaf = static_cast<const leaf_node_type&>(*node);
+            return aggregate_leaf(leaf, find(leaf, lower, 0), find(leaf, upper, leaf.slot_count));
+        }
+        const auto& inner = static_cast<const inner_node_type&>(*node);
+        const slot_type first = find(inner, lower, 0);
+        const slot_type last = find(inner, upper, inner.slot_count);
+        aggregate_value_type result = aggregate_type::identity();
+        for (slot_type slot = first; slot <= last; ++slot) {
+            // Only the childs holding a bound are partially in the range
+            const K* child_lower = slot == first ? lower : nullptr;
+            const K* child_upper = slot == last ? upper : nullptr;
+            result = aggregate_type::combine(result,
+                                             child_lower || child_upper
+                                                 ? aggregate_node(child(inner, slot), child_lower, child_upper)
+                                                 : inner.child_aggregates[slot]);
+        }
+        return result;
+    }
+
+    /**
+     * Leaf node slot found by a lookup, along with its position in the tree.
+     */
+    struct position {
+        const leaf_node_type* leaf;
+        slot_type slot;
+        size_type rank;
+    };
+
+    /**
+     * Traverse the tree from root to leaves like find_leaf_slot, summing the sizes of the subtrees on the left of the
+     * path to compute the position of the leaf node slot found.
+     */
+    template <typename Comparator, typename K>
+    [[nodiscard]] position find_position(const Comparator& comp, const K& key) const {
+        static_assert(with_order_statistics, "positions are only maintained when Traits::order_statistics is set");
+        add_to_counter(*this, &counters_type::lookups);
+        if (!root) {
+            return {nullptr, 0, 0};
+        }
+        size_type before = 0;
+        const node_type* node = root;
+        while (!node->is_leafnode()) {
+            const auto* inner = static_cast<const inner_node_type*>(node);
+            const slot_type slot = find_slot_in_node(*this, *inner, comp, key);
+            before = std::accumulate(inner->child_sizes.begin(), inner->child_sizes.begin() + slot, before);
+            node = child(*inner, slot);
+        }
+        const auto* leaf = static_cast<const leaf_node_type*>(node);
+        const slot_type slot = find_slot_in_node(*this, *leaf, comp, key);
+        return {leaf, slot, before + slot};
     }
 
     template <typename Self>
-    [[nodiscard]] static auto lower_bound_impl(Self&& self, const key_type& key) {
-        return find_leaf_slot(self, detail::greater_than_or_equal_to, key);
+    [[nodiscard]] static auto nth_impl(Self&& self, size_type n) {
+        static_assert(with_order_statistics, "positions are only maintained when Traits::order_statistics is set");
+        if (n >= self.size()) {
+            return self.end();
+        }
+        node_type* node = self.root;
+        while (!node->is_leafnode()) {
+            const auto* inner = static_cast<const inner_node_type*>(node);
+            slot_type slot = 0;
+            while (n >= inner->child_sizes[slot]) {
+                n -= inner->child_sizes[slot++];
+            }
+            node = self.child(*inner, slot);
+        }
+        return select_iterator_type<Self>(static_cast<leaf_node_type*>(node), n, self.links());
+    }
+
+    template <typename Iterator, typename Function>
+    static void for_each_leaf_span_impl(Iterator first, Iterator last, Function& fn) {
+        auto* leaf = first.current_leaf;
+        slot_type slot = first.current_slot;
+        if (first == last) {
+            return;
+        }
+        while (true) {
+            auto* next = first.links.next(*leaf);
+            if (next) {
+                detail::prefetch(next, sizeof(leaf_node_type));
+            }
+            const slot_type end = leaf == last.current_leaf ? last.current_slot : leaf->slot_count;
+            if (slot < end) {
+                fn(std::span(leaf->data.data() + slot, end - slot));
+            }
+            if (leaf == last.current_leaf || !next) {
+                return;
+            }
+            leaf = next;
+            slot = 0;
+        }
     }
 
+    /**
+     * See split_range(). A null bound leaves the range unbounded on its side.
+     *
+     * The nodes crossed by the range are expanded level by level from the root until there are at least `parts` of
+     * them or the leaves are reached. They are then evenly grouped, each subrange starting at the leftmost leaf of the
+     * first node of its group.
+     */
     template <typename Self>
-    [[nodiscard]] static auto upper_bound_impl(Self&& self, const key_type& key) {
+    [[nodiscard]] static auto split_range_impl(Self&& self,
+                                               const key_type* lower,
+                                               const key_type* upper,
+                                               size_type parts) {
+        using iterator_type = select_iterator_type<Self>;
+        const iterator_type first = lower ? lower_bound_impl(self, *lower) : self.begin();
+        std::vector<iterator_type> boundaries{first};
+        if (lower && upper && !self.key_compare(*lower, *upper)) {
+            boundaries.push_back(first);
+            return boundaries;
+        }
+        const iterator_type last = upper ? lower_bound_impl(self, *upper) : self.end();
+        if (first == last) {
+            boundaries.push_back(last);
+            return boundaries;
+        }
+        std::vector<node_type*> nodes{self.root};
+        while (nodes.size() < parts && !nodes.front()->is_leafnode()) {
+            std::vector<node_type*> childs;
+            for (size_type i = 0; i < nodes.size(); ++i) {
+                const auto* inner = static_cast<const inner_node_type*>(nodes[i]);
+                // Only the first and last nodes are partially crossed by the range
+                slot_type begin_slot = 0;
+                slot_type end_slot = inner->slot_count;
+                if (i == 0 && lower) {
+                    begin_slot = find_slot_in_node(self, *inner, detail::greater_than_or_equal_to, *lower);
+                }
+                if (i + 1 == nodes.size() && upper) {
+                    end_slot = find_slot_in_node(self, *inner, detail::greater_than_or_equal_to, *upper);
+                }
+                for (slot_type slot = begin_slot; slot <= end_slot; ++slot) {
+                    childs.push_back(self.child(*inner, slot));
+                }
+            }
+            nodes = std::move(childs);
+        }
+        const size_type groups = std::min(parts, nodes.size());
+        for (size_type group = 1; group < groups; ++group) {
+            node_type* node = nodes[group * nodes.size() / groups];
+            while (!node->is_leafnode()) {
+                node = self.child(*static_cast<inner_node_type*>(node), 0);
+            }
+            boundaries.push_back(iterator_type(static_cast<leaf_node_type*>(node), 0, self.links()));
+        }
+        boundaries.push_back(last);
+        return boundaries;
+    }
+
+    // The bounds are never compared with each other, which a transparent comparator is not required to support: an
+    // empty range is detected by the lookups instead
+    template <typename K>
+    [[nodiscard]] size_type count_impl(const K& lower, const K& upper) const {
+        const size_type first = find_position(detail::greater_than_or_equal_to, lower).rank;
+        const size_type last = find_position(detail::greater_than_or_equal_to, upper).rank;
+        return last > first ? last - first : 0;
+    }
+
+    template <typename K>
+    [[nodiscard]] aggregate_value_type aggregate_impl(const K& lower, const K& upper) const {
+        static_assert(with_aggregate, "aggregates are only maintained when Traits::aggregate is set");
+        add_to_counter(*this, &counters_type::lookups);
+        if (!root) {
+            return aggregate_type::identity();
+        }
+        return aggregate_node(root, &lower, &upper);
+    }
+
+    template <typename Self, typename K>
+    [[nodiscard]] static auto lower_bound_impl(Self&& self, const K& key) {
+        return find_leaf_slot(self, detail::greater_than_or_equal_to, key);
+    }
+
+    template <typename Self, typename K>
+    [[nodiscard]] static auto upper_bound_impl(Self&& self, const K& key) {
         return find_leaf_slot(self, detail::greater_than, key);
     }
 
+    template <typename Node>
+    using node_pool_type = std::conditional_t<
+        with_compact_handles,
+        detail::node_arena<Node, node_pool_chunk_bytes, allocator_type>,
+        std::conditional_t<with_node_pool, detail::node_pool<Node, node_pool_chunk_bytes, allocator_type>, detail::empty>>;
+
     node_type* root{};
     leaf_node_type* head_leaf{};
     leaf_node_type* tail_leaf{};
+    [[no_unique_address]] node_pool_type<leaf_node_type> leaf_pool;
+    [[no_unique_address]] node_pool_type<inner_node_type> inner_pool;
     stats_type stats;
+    [[no_unique_address]] mutable std::conditional_t<with_stats, counters_type, detail::empty> counters;
     // key_extractor_type key_extractor; // Cannot be stored for now since it is used inside node types
     key_compare_type key_compare;
     allocator_type allocator;
@@ -382,13 +3749,93 @@ struct btree<Key, Value, KeyExtractor, Compare, Traits, Allocator>::stats_type {
     size_type size{};
     size_type leaves{};
     size_type inner_nodes{};
+    // Chunks allocated by the node pool, and number of nodes they can hold
+    size_type pool_chunks{};
+    size_type pool_capacity{};
 
     [[nodiscard]] size_type nodes() const noexcept { return inner_nodes + leaves; }
 
+    template <typename T = float>
+    [[nodiscard]] T average_fill_pool() const noexcept {
+        return static_cast<T>(nodes()) / static_cast<T>(pool_capacity);
+    }
+
     template <typename T = float>
     [[nodiscard]] T average_fill_leaves() const noexcept {
-        return static_cast<T>(size) / (leaves * leaf_slots_max);
+        return static_cast<T>(size) / static_cast<T>(leaves * leaf_slots_max);
+    }
+};
+
+template <typename Key, typename Value, typename KeyExtractor, typename Compare, typename Traits, typename Allocator>
+struct btree<Key, Value, KeyExtractor, Compare, Traits, Allocator>::counters_type {
+    static constexpr size_type fill_buckets = 10;
+
+    // Lookups, along with the nodes they searched and the key comparisons they performed
+    size_type lookups{};
+    size_type nodes_visited{};
+    size_type key_comparisons{};
+    // Structural modifications
+    size_type splits{};
+    size_type merges{};
+    size_type borrows{};
+    size_type allocations{};
+    size_type deallocations{};
+    // Only set in snapshots: height of the tree, and number of nodes per fill ratio, the bucket i counting the nodes
+    // holding from i / fill_buckets up to (i + 1) / fill_buckets of their maximum slot count
+    size_type height{};
+    std::array<size_type, fill_buckets> leaf_fill{};
+    std::array<size_type, fill_buckets> inner_fill{};
+
+    template <typename T = float>
+    [[nodiscard]] T nodes_per_lookup() const noexcept {
+        return static_cast<T>(nodes_visited) / static_cast<T>(lookups);
+    }
+
+    template <typename T = float>
+    [[nodiscard]] T comparisons_per_lookup() const noexcept {
+        return static_cast<T>(key_comparisons) / static_cast<T>(lookups);
+    }
+};
+
+/**
+ * Resolves the links between sibling leaves. Iterators hold one, so that they can walk leaves linked by handles without
+ * access to the tree. It stays valid until the next insertion, and is empty when leaves are linked by pointers.
+ */
+template <typename Key, typename Value, typename KeyExtractor, typename Compare, typename Traits, typename Allocator>
+class btree<Key, Value, KeyExtractor, Compare, Traits, Allocator>::leaf_links {
+public:
+    leaf_links() noexcept = default;
+
+    explicit leaf_links([[maybe_unused]] const btree& tree) noexcept {
+        if constexpr (with_compact_handles) {
+            resolver = tree.leaf_pool.get_resolver();
+        }
+    }
+
+    [[nodiscard]] leaf_node_type* previous(const leaf_node_type& leaf) const noexcept { return get(leaf.previous_leaf); }
+    [[nodiscard]] leaf_node_type* next(const leaf_node_type& leaf) const noexcept { return get(leaf.next_leaf); }
+
+    /**
+     * Link to `leaf`, which may be null.
+     */
+    [[nodiscard]] static leaf_link_type link_to(leaf_node_type* leaf) noexcept {
+        if constexpr (with_compact_handles) {
+            return leaf ? leaf->handle : 0;
+        } else {
+            return leaf;
+        }
+    }
+
+private:
+    [[nodiscard]] leaf_node_type* get(leaf_link_type link) const noexcept {
+        if constexpr (with_compact_handles) {
+            return link ? resolver.get(link) : nullptr;
+        } else {
+            return link;
+        }
     }
+
+    [[no_unique_address]] typename detail::resolver_of<node_pool_type<leaf_node_type>>::type resolver;
 };
 
 template <typename Key, typename Value, typename KeyExtractor, typename Compare, typename Traits, typename Allocator>
@@ -397,6 +3844,8 @@ class btree<Key, Value, KeyExtractor, Compare, Traits, Allocator>::iterator_base
 public:
     // const iterators are allowed to access non-const iterators internals
     friend class iterator_base<detail::is_const_t::yes>;
+    // The tree locates the value pointed to by an iterator to compute its position
+    friend class btree;
 
     using key_type = Key;
     using value_type = Value;
@@ -409,13 +3858,13 @@ public:
 
     iterator_base() noexcept = default;
 
-    iterator_base(leaf_node_type_* l, slot_type s) noexcept : current_leaf{l}, current_slot{s} {}
+    iterator_base(leaf_node_type_* l, slot_type s, leaf_links k) noexcept : current_leaf{l}, current_slot{s}, links{k} {}
 
     iterator_base(const iterator_base&) = default;
 
     // Convert an non-const iterator into a const iterator
     iterator_base(const iterator_base<detail::is_const_t::no>& other) requires(is_const == detail::is_const_t::yes)
-        : iterator_base(other.current_leaf, other.current_slot) {}
+        : iterator_base(other.current_leaf, other.current_slot, other.links) {}
 
     [[nodiscard]] reference operator*() const noexcept { return current_leaf->data[current_slot]; }
     [[nodiscard]] pointer operator->() const noexcept { return &current_leaf->data[current_slot]; }
@@ -457,9 +3906,9 @@ private:
         if (current_slot + 1u < current_leaf->slot_count) {
             // There is still data in current node, switching to next slot
             ++current_slot;
-        } else if (current_leaf->next_leaf != nullptr) {
+        } else if (current_leaf->next_leaf) {
             // No data on current node, switching to the next one
-            current_leaf = current_leaf->next_leaf;
+            current_leaf = links.next(*current_leaf);
             current_slot = 0;
         } else {
             // No data and no node left, setting current slot to end()
@@ -472,9 +3921,9 @@ private:
         if (current_slot > 0) {
             // There is still data in current node, switching to previous slot
             --current_slot;
-        } else if (current_leaf->previous_leaf != nullptr) {
+        } else if (current_leaf->previous_leaf) {
             // No data on current node, switching to the previous one
-            current_leaf = current_leaf->previous_leaf;
+            current_leaf = links.previous(*current_leaf);
             current_slot = current_leaf->slot_count - 1;
         } else {
             // No node left, setting current slot to begin()
@@ -484,10 +3933,145 @@ private:
 
     leaf_node_type_* current_leaf{};
     slot_type current_slot{};
+    // Resolves the sibling links of the leaves, empty when they are pointers
+    [[no_unique_address]] leaf_links links;
+};
+
+template <typename Key, typename Value, typename KeyExtractor, typename Compare, typename Traits, typename Allocator>
+class btree<Key, Value, KeyExtractor, Compare, Traits, Allocator>::cursor {
+public:
+    explicit cursor(const btree& t) : tree(&t), position(t.begin()) {
+        if (t.root) {
+            descend(t.root);
+        }
+    }
+
+    /**
+     * Move to the first value whose key is not ordered before `key`, and return whether its key is equivalent to
+     * `key`. The leaf of the current value is searched first. Otherwise the cursor goes back up its path to the
+     * deepest inner node whose subtree `key` belongs to, and descends from there: the farther `key` is, the higher the
+     * cursor goes back up. Seeking a key ordered before the previous one is allowed.
+     */
+    bool seek(const key_type& key) { return seek_impl(key); }
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    bool seek(const K& key) {
+        return seek_impl(key);
+    }
+
+    /**
+     * Move to the next value.
+     * @pre `!at_end()`
+     */
+    void next() {
+        const leaf_node_type* leaf = position.current_leaf;
+        if (position.current_slot + 1u < leaf->slot_count || !leaf->next_leaf) {
+            ++position.current_slot;
+        } else {
+            next_leaf();
+        }
+    }
+
+    [[nodiscard]] bool at_end() const noexcept {
+        return !position.current_leaf || position.current_slot == position.current_leaf->slot_count;
+    }
+
+    [[nodiscard]] const value_type& value() const noexcept { return *position; }
+    [[nodiscard]] const key_type& key() const noexcept { return position.key(); }
+
+    /**
+     * Iterator to the current value, or end() once all the values are passed.
+     */
+    [[nodiscard]] const_iterator current() const noexcept { return position; }
+
+private:
+    template <typename K>
+    bool seek_impl(const K& key) {
+        const leaf_node_type* leaf = position.current_leaf;
+        if (!leaf) {
+            return false;
+        }
+        add_to_counter(*tree, &counters_type::lookups);
+        constexpr auto comp = detail::greater_than_or_equal_to;
+        const auto last_satisfies = [&](const leaf_node_type& l) {
+            return comp(tree->key_compare, l.key(l.slot_count - 1), key);
+        };
+        // The bound is in the current leaf unless it is in a previous one, i.e. the first key of the leaf satisfies the
+        // comparison as well as the last key of the previous leaf
+        const bool in_leaf = last_satisfies(*leaf) && (!comp(tree->key_compare, leaf->key(0), key) ||
+                                                       !leaf->previous_leaf ||
+                                                       !last_satisfies(*tree->previous_sibling(*leaf)));
+        if (in_leaf) {
+            position.current_slot = find_slot_in_node(*tree, *leaf, comp, key);
+        } else {
+            // Go back up to the first node whose separators surround `key`: the separators of a node being within the
+            // bounds of its subtree, a descent from the root goes through it
+            for (size_type depth = path.size(); depth-- > 0;) {
+                const inner_node_type* inner = path[depth].first;
+                const slot_type slot = find_slot_in_node(*tree, *inner, comp, key);
+                if (depth == 0 || (slot > 0 && slot < inner->slot_count)) {
+                    path.resize(depth);
+                    path.emplace_back(inner, slot);
+                    descend(tree->child(*inner, slot), key);
+                    break;
+                }
+            }
+            leaf = position.current_leaf;
+            position.current_slot = find_slot_in_node(*tree, *leaf, comp, key);
+            if (position.current_slot == leaf->slot_count && leaf->next_leaf) {
+                next_leaf();
+            }
+        }
+        return !at_end() && !tree->key_compare(key, position.key());
+    }
+
+    /**
+     * Descend from `node` to the first value of its subtree.
+     */
+    void descend(const node_type* node) {
+        while (!node->is_leafnode()) {
+            const auto* inner = static_cast<const inner_node_type*>(node);
+            path.emplace_back(inner, 0);
+            node = tree->child(*inner, 0);
+        }
+        position = const_iterator(static_cast<const leaf_node_type*>(node), 0, tree->links());
+    }
+
+    /**
+     * Descend from `node` to the leaf `key` is routed to.
+     */
+    template <typename K>
+    void descend(const node_type* node, const K& key) {
+        while (!node->is_leafnode()) {
+            const auto* inner = static_cast<const inner_node_type*>(node);
+            const slot_type slot = find_slot_in_node(*tree, *inner, detail::greater_than_or_equal_to, key);
+            path.emplace_back(inner, slot);
+            node = tree->child(*inner, slot);
+        }
+        position = const_iterator(static_cast<const leaf_node_type*>(node), 0, tree->links());
+    }
+
+    /**
+     * Move to the first value of the next leaf, going back up the path while the childs of its nodes are exhausted.
+     */
+    void next_leaf() {
+        while (path.back().second == path.back().first->slot_count) {
+            path.pop_back();
+        }
+        auto& [inner, slot] = path.back();
+        ++slot;
+        descend(tree->child(*inner, slot));
+    }
+
+    const btree* tree;
+    // Inner nodes from the root to the leaf of the current value, along with the slot of the child taken in each
+    std::vector<std::pair<const inner_node_type*, slot_type>> path;
+    const_iterator position;
 };
 
 template <typename Key, typename Value, typename KeyExtractor, typename Compare, typename Traits, typename Allocator>
-struct btree<Key, Value, KeyExtractor, Compare, Traits, Allocator>::node_type {
+struct btree<Key, Value, KeyExtractor, Compare, Traits, Allocator>::node_type
+    : detail::node_handle<with_compact_handles> {
     slot_type level{};
     slot_type slot_count{};
     [[nodiscard]] bool is_leafnode() const noexcept { return level == 0; }
@@ -498,22 +4082,159 @@ struct btree<Key, Value, KeyExtractor, Compare, Traits, Allocator>::node_type {
 
 template <typename Key, typename Value, typename KeyExtractor, typename Compare, typename Traits, typename Allocator>
 struct btree<Key, Value, KeyExtractor, Compare, Traits, Allocator>::inner_node_type : public node_type {
-    using alloc_type = typename std::allocator_traits<allocator_type>::template rebind_alloc<inner_node_type>;
+    static constexpr bool compressed_keys = traits_type::inner_layout == btree_inner_layout::prefix_compressed;
+    static_assert(!compressed_keys || (std::is_same_v<key_type, std::string> &&
+                                       (std::is_same_v<key_compare_type, std::less<std::string>> ||
+                                        std::is_same_v<key_compare_type, std::less<>>)),
+                  "prefix compressed inner nodes require std::string keys ordered by std::less");
+
+    using keys_type = std::conditional_t<compressed_keys,
+                                         detail::prefix_compressed_keys<inner_slots_max, traits_type::inner_key_bytes>,
+                                         detail::uninitialized_array<key_type, inner_slots_max>>;
+
+    keys_type keys;
+    std::array<node_link_type, inner_slots_max + 1> childs;
+    // Number of values in the subtree of each child, with Traits::order_statistics only
+    [[no_unique_address]] std::
+        conditional_t<with_order_statistics, std::array<size_type, inner_slots_max + 1>, detail::empty> child_sizes;
+    // Aggregate of the values in the subtree of each child, with Traits::aggregate only
+    [[no_unique_address]] std::
+        conditional_t<with_aggregate, std::array<aggregate_value_type, inner_slots_max + 1>, detail::empty>
+            child_aggregates;
+
+    static constexpr bool contiguous_keys = !compressed_keys;
+
+    explicit inner_node_type(level_type l) noexcept { this->level = l; }
+    inner_node_type(const inner_node_type&) = delete;
+    inner_node_type& operator=(const inner_node_type&) = delete;
+    ~inner_node_type() { keys.destroy(0, this->slot_count); }
 
-    std::array<key_type, inner_slots_max> keys;
-    std::array<node_type*, inner_slots_max + 1> childs;
+    // Prefix compressed separators are returned by value
+    [[nodiscard]] decltype(auto) key(slot_type slot) const {
+        if constexpr (compressed_keys) {
+            return keys.key(slot);
+        } else {
+            return keys[slot];
+        }
+    }
+    [[nodiscard]] const key_type* key_data() const noexcept requires contiguous_keys { return keys.data(); }
+
+    /**
+     * Insert `child` after the child in `slot`, `separator` going between both. The node must not be full.
+     * @note For the variants of the tree, whose childs are linked by pointers.
+     */
+    void insert_after(slot_type slot, key_type separator, node_type* child) requires(!with_compact_handles) {
+        BPLUSTREE_ASSERT(this->slot_count < inner_slots_max);
+        detail::relocate(keys.data() + slot, keys.data() + this->slot_count, keys.data() + slot + 1);
+        keys.construct(slot, std::move(separator));
+        std::copy_backward(childs.begin() + slot + 1, childs.begin() + this->slot_count + 1,
+                           childs.begin() + this->slot_count + 2);
+        childs[slot + 1] = child;
+        ++this->slot_count;
+    }
 
-    [[nodiscard]] const key_type& key(slot_type slot) const noexcept { return keys[slot]; }
+    /**
+     * Move the separators after the middle one, along with the childs they bound, to the empty node `right`. Returns
+     * the middle separator, which goes between both nodes in their parent.
+     * @note For the variants of the tree, whose childs are linked by pointers.
+     */
+    [[nodiscard]] key_type split_half(inner_node_type& right) requires(!with_compact_handles) {
+        const slot_type count = this->slot_count;
+        const slot_type middle = count / 2;
+        key_type separator = std::move(keys[middle]);
+        keys.destroy(middle, middle + 1);
+        detail::relocate(keys.data() + middle + 1, keys.data() + count, right.keys.data());
+        std::copy(childs.begin() + middle + 1, childs.begin() + count + 1, right.childs.begin());
+        right.slot_count = count - middle - 1;
+        this->slot_count = middle;
+        return separator;
+    }
 };
 
 template <typename Key, typename Value, typename KeyExtractor, typename Compare, typename Traits, typename Allocator>
 struct btree<Key, Value, KeyExtractor, Compare, Traits, Allocator>::leaf_node_type : public node_type {
-    using alloc_type = typename std::allocator_traits<allocator_type>::template rebind_alloc<leaf_node_type>;
+    // Handles of the siblings with Traits::compact_handles, resolved through leaf_links
+    leaf_link_type previous_leaf{};
+    leaf_link_type next_leaf{};
+
+    static constexpr bool separate_keys = traits_type::leaf_layout == btree_leaf_layout::separate_keys;
+
+    using keys_type =
+        std::conditional_t<separate_keys, detail::uninitialized_array<key_type, leaf_slots_max>, detail::empty>;
+
+    detail::uninitialized_array<value_type, leaf_slots_max> data;
+    [[no_unique_address]] keys_type keys;
+
+    leaf_node_type() noexcept = default;
+    leaf_node_type(const leaf_node_type&) = delete;
+    leaf_node_type& operator=(const leaf_node_type&) = delete;
+    ~leaf_node_type() { destroy(0, this->slot_count); }
+
+    // Leaves always hold whole keys
+    static constexpr bool compressed_keys = false;
+
+    // Values are the keys themselves in set-like trees
+    static constexpr bool contiguous_keys =
+        separate_keys ||
+        (std::is_same_v<key_extractor_type, btree_key_extractor_self> && std::is_same_v<key_type, value_type>);
+
+    [[nodiscard]] const key_type& key(slot_type slot) const {
+        if constexpr (separate_keys) {
+            return keys[slot];
+        } else {
+            return key_extractor_type{}(data[slot]);
+        }
+    }
+
+    [[nodiscard]] const key_type* key_data() const noexcept requires contiguous_keys {
+        if constexpr (separate_keys) {
+            return keys.data();
+        } else {
+            return data.data();
+        }
+    }
 
-    leaf_node_type* previous_leaf{};
-    leaf_node_type* next_leaf{};
+    /**
+     * Construct a value in the empty `slot` from `args`, keeping the separate key array in sync if any.
+     */
+    template <typename... Args>
+    void construct(slot_type slot, Args&&... args) {
+        const value_type& value = data.construct(slot, std::forward<Args>(args)...);
+        if constexpr (separate_keys) {
+            keys.construct(slot, key_extractor_type{}(value));
+        }
+    }
+
+    /**
+     * Destroy the values in slots [first, last), which become empty.
+     */
+    void destroy(slot_type first, slot_type last) noexcept {
+        data.destroy(first, last);
+        if constexpr (separate_keys) {
+            keys.destroy(first, last);
+        }
+    }
 
-    std::array<value_type, leaf_slots_max> data;
+    /**
+     * Relocate the values in slots [first, last) to the empty slots starting at `d_first` of leaf `dest`, which may be
+     * this leaf.
+     */
+    void relocate(slot_type first, slot_type last, leaf_node_type& dest, slot_type d_first) {
+        detail::relocate(data.data() + first, data.data() + last, dest.data.data() + d_first);
+        if constexpr (separate_keys) {
+            detail::relocate(keys.data() + first, keys.data() + last, dest.keys.data() + d_first);
+        }
+    }
 
-    [[nodiscard]] const key_type& key(slot_type slot) const { return key_extractor_type{}(data[slot]); }
+    /**
+     * Move the upper half of the values to the empty leaf `right`. Returns the separator between both leaves, the
+     * greatest key left in this leaf. The sibling links are left to the caller.
+     */
+    [[nodiscard]] key_type split_half(leaf_node_type& right) {
+        const slot_type middle = this->slot_count / 2;
+        relocate(middle, this->slot_count, right, 0);
+        right.slot_count = this->slot_count - middle;
+        this->slot_count = middle;
+        return key(middle - 1);
+    }
 };
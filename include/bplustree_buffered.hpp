@@ -0,0 +1,793 @@
+#pragma once
+
+#include <bplustree.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Write-optimized variant of `btree` (a B-epsilon tree), whose inner nodes buffer the modifications bound for their
+ * subtrees.
+ *
+ * Insertions, upserts and erasures do not descend the tree: each one is a message added to the buffer of the root, at
+ * most one message being kept per key and node. When a buffer fills, the messages bound for the child receiving the
+ * most of them are moved in one batch to the buffer of this child, or applied to it when it is a leaf. A leaf is thus
+ * loaded once per batch of modifications instead of once per modification. Lookups and iterations merge the values of
+ * each leaf with the messages bound for it along its path, so that they see every modification made so far.
+ *
+ * Nodes reuse the layouts of `btree`, inner nodes being followed by their buffer of `buffer_slots` messages. Unlike in
+ * `btree`, keys are unique: insert() keeps the value of a key already present, while upsert() replaces it. Leaves
+ * emptied by erasures are freed, but underflowing nodes are not merged. Iterators are invalidated by any modification.
+ */
+template <typename Key,
+          typename Value,
+          typename KeyExtractor,
+          typename Compare = std::less<Key>,
+          typename Traits = btree_default_traits<Key, Value>,
+          typename Allocator = std::allocator<Value>>
+class buffered_btree {
+    using base_type = btree<Key, Value, KeyExtractor, Compare, Traits, Allocator>;
+    using node_type = typename base_type::node_type;
+    using leaf_node_type = typename base_type::leaf_node_type;
+    using slot_type = typename base_type::slot_type;
+    using level_type = typename base_type::level_type;
+
+    struct message;
+    struct inner_node_type;
+
+public:
+    using key_type = Key;
+    using value_type = Value;
+    using key_extractor_type = KeyExtractor;
+    using key_compare_type = Compare;
+    using traits_type = Traits;
+    using allocator_type = Allocator;
+    using size_type = std::size_t;
+
+    static_assert(!traits_type::order_statistics && std::is_void_v<typename traits_type::aggregate>,
+                  "subtree sizes and aggregates are not maintained by buffered updates");
+    static_assert(traits_type::inner_layout != btree_inner_layout::prefix_compressed,
+                  "prefix compressed inner nodes are not supported by buffered updates");
+    static_assert(!traits_type::compact_handles, "nodes are allocated one by one, childs are linked by pointers");
+
+    /**
+     * Forward iterator over the values of the tree, once merged with the pending messages. It holds the path from the
+     * root to its leaf, and the merged values of this leaf.
+     */
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Value;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        const_iterator() noexcept = default;
+
+        [[nodiscard]] reference operator*() const noexcept { return *values[current_slot]; }
+        [[nodiscard]] pointer operator->() const noexcept { return values[current_slot]; }
+
+        [[nodiscard]] const key_type& key() const noexcept { return key_extractor_type{}(*values[current_slot]); }
+
+        const_iterator& operator++() {
+            if (++current_slot == values.size()) {
+                next_leaf();
+            }
+            return *this;
+        }
+
+        [[nodiscard]] const_iterator operator++(int) {
+            const_iterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+
+        [[nodiscard]] bool operator==(const const_iterator& x) const noexcept {
+            return x.current_leaf == current_leaf && x.current_slot == current_slot;
+        }
+        [[nodiscard]] bool operator!=(const const_iterator& x) const noexcept { return !(*this == x); }
+
+    private:
+        friend buffered_btree;
+
+        explicit const_iterator(const buffered_btree& t) noexcept : tree(&t) {}
+
+        /**
+         * Move to the first leaf of the subtree rooted at `node` holding values once merged, or to the end if none does.
+         */
+        void descend(const node_type* node) {
+            descend_leftmost(node);
+            merge();
+            if (values.empty()) {
+                next_leaf();
+            }
+        }
+
+        void descend_leftmost(const node_type* node) {
+            while (!node->is_leafnode()) {
+                const auto* inner = static_cast<const inner_node_type*>(node);
+                path.emplace_back(inner, 0);
+                node = inner->childs[0];
+            }
+            current_leaf = static_cast<const leaf_node_type*>(node);
+            current_slot = 0;
+        }
+
+        /**
+         * Move to the first value of the next leaf holding values once merged, or to the end if there is none.
+         */
+        void next_leaf() {
+            do {
+                while (!path.empty() && path.back().second == path.back().first->slot_count) {
+                    path.pop_back();
+                }
+                if (path.empty()) {
+                    current_leaf = nullptr;
+                    current_slot = 0;
+                    values.clear();
+                    return;
+                }
+                ++path.back().second;
+                descend_leftmost(path.back().first->childs[path.back().second]);
+                merge();
+            } while (values.empty());
+        }
+
+        /**
+         * Merge the values of the current leaf with the messages bound for it in the nodes of the path. The deepest
+         * messages are the oldest ones, so they are applied first.
+         */
+        void merge() {
+            values.clear();
+            const auto& comp = tree->key_compare;
+            // The keys of the leaf are in (lower, upper], the nearest separators on both sides of the path
+            const key_type* lower = nullptr;
+            const key_type* upper = nullptr;
+            for (auto it = path.rbegin(); it != path.rend() && !(lower && upper); ++it) {
+                const auto& [inner, slot] = *it;
+                if (!lower && slot > 0) {
+                    lower = &inner->key(slot - 1);
+                }
+                if (!upper && slot < inner->slot_count) {
+                    upper = &inner->key(slot);
+                }
+            }
+            const auto before = [&](const key_type& k, const message& m) { return comp(k, m.key); };
+            pending.clear();
+            for (auto it = path.rbegin(); it != path.rend(); ++it) {
+                const message* first = it->first->messages.data();
+                const message* last = first + it->first->message_count;
+                if (lower) {
+                    first = std::upper_bound(first, last, *lower, before);
+                }
+                if (upper) {
+                    last = std::upper_bound(first, last, *upper, before);
+                }
+                if (first != last) {
+                    pending.emplace_back(first, last);
+                }
+            }
+
+            slot_type slot = 0;
+            while (true) {
+                const key_type* key = slot < current_leaf->slot_count ? &current_leaf->key(slot) : nullptr;
+                for (const auto& [first, last] : pending) {
+                    if (first != last && (!key || comp(first->key, *key))) {
+                        key = &first->key;
+                    }
+                }
+                if (!key) {
+                    break;
+                }
+                const value_type* value = nullptr;
+                if (slot < current_leaf->slot_count && !comp(*key, current_leaf->key(slot))) {
+                    value = &current_leaf->data[slot++];
+                }
+                for (auto& [first, last] : pending) {
+                    if (first != last && !comp(*key, first->key)) {
+                        value = (first++)->apply(value);
+                    }
+                }
+                if (value) {
+                    values.push_back(value);
+                }
+            }
+        }
+
+        const buffered_btree* tree{};
+        std::vector<std::pair<const inner_node_type*, slot_type>> path;
+        const leaf_node_type* current_leaf{};
+        // Values of the current leaf once merged, and messages bound for it in each node of the path
+        std::vector<const value_type*> values;
+        std::vector<std::pair<const message*, const message*>> pending;
+        slot_type current_slot{};
+    };
+
+    explicit buffered_btree(const allocator_type& alloc = allocator_type{}) : allocator(alloc) {}
+
+    explicit buffered_btree(const key_compare_type& comp, const allocator_type& alloc = allocator_type{})
+        : key_compare(comp), allocator(alloc) {}
+
+    /**
+     * Build a tree holding the values in [first, last), whose messages are all applied. Of the values with equivalent
+     * keys, the last one is kept, as if they were upserted in order.
+     */
+    template <typename InputIterator>
+    buffered_btree(InputIterator first,
+                   InputIterator last,
+                   const key_compare_type& comp = key_compare_type{},
+                   const allocator_type& alloc = allocator_type{})
+        : key_compare(comp), allocator(alloc) {
+        std::vector<value_type> values(first, last);
+        const auto by_key = [this](const value_type& a, const value_type& b) {
+            return key_compare(key_extractor_type{}(a), key_extractor_type{}(b));
+        };
+        if (!std::is_sorted(values.begin(), values.end(), by_key)) {
+            std::stable_sort(values.begin(), values.end(), by_key);
+        }
+        std::vector<value_type> unique;
+        unique.reserve(values.size());
+        for (size_type i = 0; i < values.size(); ++i) {
+            if (i + 1 == values.size() || by_key(values[i], values[i + 1])) {
+                unique.push_back(std::move(values[i]));
+            }
+        }
+        build(unique);
+    }
+
+    buffered_btree(const buffered_btree&) = delete;
+    buffered_btree& operator=(const buffered_btree&) = delete;
+
+    ~buffered_btree() { clear(); }
+
+    /**
+     * Insert `value` unless a value with an equivalent key is present.
+     */
+    void insert(const value_type& value) {
+        write(message{message_kind::insert, key_extractor_type{}(value), value});
+    }
+
+    /**
+     * Insert `value`, replacing the value with an equivalent key if there is one.
+     */
+    void upsert(const value_type& value) {
+        write(message{message_kind::upsert, key_extractor_type{}(value), value});
+    }
+
+    /**
+     * Remove the value whose key is equivalent to `key`, if any.
+     */
+    void erase(const key_type& key) { write(message{message_kind::erase, key, std::nullopt}); }
+
+    /**
+     * Apply all the pending messages, rebuilding the tree with full leaves.
+     */
+    void flush() {
+        if (pending_count == 0) {
+            return;
+        }
+        std::vector<value_type> values(begin(), end());
+        clear();
+        build(values);
+    }
+
+    void clear() noexcept {
+        if (root) {
+            deallocate_subtree(std::exchange(root, nullptr));
+        }
+        pending_count = 0;
+    }
+
+    [[nodiscard]] const_iterator begin() const {
+        const_iterator it(*this);
+        if (root) {
+            it.descend(root);
+        }
+        return it;
+    }
+    [[nodiscard]] const_iterator end() const noexcept { return const_iterator(); }
+
+    [[nodiscard]] const_iterator lower_bound(const key_type& key) const {
+        return find_value(detail::greater_than_or_equal_to, key);
+    }
+    [[nodiscard]] const_iterator upper_bound(const key_type& key) const {
+        return find_value(detail::greater_than, key);
+    }
+    [[nodiscard]] const_iterator find(const key_type& key) const { return find_impl(key); }
+
+    /**
+     * Whether a value has a key equivalent to `key`. Unlike find(), stops at the first message for this key along the
+     * path, without merging the leaf.
+     */
+    [[nodiscard]] bool contains(const key_type& key) const { return contains_impl(key); }
+
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    [[nodiscard]] const_iterator lower_bound(const K& key) const {
+        return find_value(detail::greater_than_or_equal_to, key);
+    }
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    [[nodiscard]] const_iterator upper_bound(const K& key) const {
+        return find_value(detail::greater_than, key);
+    }
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    [[nodiscard]] const_iterator find(const K& key) const {
+        return find_impl(key);
+    }
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    [[nodiscard]] bool contains(const K& key) const {
+        return contains_impl(key);
+    }
+
+    [[nodiscard]] bool empty() const { return begin() == end(); }
+
+    /**
+     * Number of messages waiting in the buffers of the inner nodes.
+     */
+    [[nodiscard]] size_type pending_messages() const noexcept { return pending_count; }
+
+    [[nodiscard]] key_compare_type key_comp() const { return key_compare; }
+
+private:
+    friend base_type;
+
+    static constexpr slot_type leaf_slots_max = base_type::leaf_slots_max;
+    static constexpr slot_type inner_slots_max = base_type::inner_slots_max;
+
+    enum class message_kind : std::uint8_t { insert, upsert, erase };
+
+    /**
+     * Modification of the value of `key`, newer than the ones in the nodes below.
+     */
+    struct message {
+        message_kind kind;
+        key_type key;
+        // Absent for erasures
+        std::optional<value_type> value;
+
+        /**
+         * Value of the key once this message is applied, given its value `older` before, or nullptr if it is absent.
+         */
+        [[nodiscard]] const value_type* apply(const value_type* older) const noexcept {
+            switch (kind) {
+                case message_kind::insert:
+                    return older ? older : &*value;
+                case message_kind::upsert:
+                    return &*value;
+                default:
+                    return nullptr;
+            }
+        }
+
+        /**
+         * Merge `newer`, a message for the same key, into this one.
+         */
+        void combine(message&& newer) {
+            if (newer.kind == message_kind::insert) {
+                // Insertions do not replace a value, unless this one erases it
+                if (kind == message_kind::erase) {
+                    kind = message_kind::upsert;
+                    value.emplace(std::move(*newer.value));
+                }
+                return;
+            }
+            kind = newer.kind;
+            value.reset();
+            if (newer.value) {
+                value.emplace(std::move(*newer.value));
+            }
+        }
+    };
+
+public:
+    /**
+     * Messages held by each inner node, as many as `Traits::message_buffer_bytes` can hold but at least 16.
+     */
+    static constexpr size_type buffer_slots =
+        std::max<size_type>(16, static_cast<size_type>(traits_type::message_buffer_bytes) / sizeof(message));
+
+private:
+    struct inner_node_type : base_type::inner_node_type {
+        explicit inner_node_type(level_type l) noexcept : base_type::inner_node_type(l) {}
+        inner_node_type(const inner_node_type&) = delete;
+        inner_node_type& operator=(const inner_node_type&) = delete;
+        ~inner_node_type() { messages.destroy(0, message_count); }
+
+        // Sorted by key, at most one per key
+        detail::uninitialized_array<message, buffer_slots> messages;
+        slot_type message_count{};
+    };
+
+    [[nodiscard]] leaf_node_type* allocate_leaf() {
+        return base_type::template allocate_from_allocator<leaf_node_type>(allocator);
+    }
+
+    [[nodiscard]] inner_node_type* allocate_inner(level_type level) {
+        return base_type::template allocate_from_allocator<inner_node_type>(allocator, level);
+    }
+
+    void deallocate_subtree(node_type* n) noexcept {
+        if (n->is_leafnode()) {
+            base_type::deallocate_from_allocator(allocator, static_cast<leaf_node_type*>(n));
+            return;
+        }
+        auto* inner = static_cast<inner_node_type*>(n);
+        for (slot_type slot = 0; slot <= inner->slot_count; ++slot) {
+            deallocate_subtree(inner->childs[slot]);
+        }
+        base_type::deallocate_from_allocator(allocator, inner);
+    }
+
+    /**
+     * Build the tree from `values`, sorted by unique keys, filling the nodes evenly.
+     */
+    void build(std::vector<value_type>& values) {
+        if (values.empty()) {
+            return;
+        }
+        // Nodes of the level being built, along with the greatest key of their subtree
+        std::vector<std::pair<node_type*, const key_type*>> level;
+        // Last node built, which ends up being the root once a level holds a single node
+        node_type* last_node = nullptr;
+        const size_type leaves = (values.size() + leaf_slots_max - 1) / leaf_slots_max;
+        size_type value = 0;
+        for (size_type i = 0; i < leaves; ++i) {
+            const size_type count = values.size() / leaves + (i < values.size() % leaves ? 1 : 0);
+            auto* leaf = allocate_leaf();
+            for (slot_type slot = 0; slot < count; ++slot) {
+                leaf->construct(slot, std::move(values[value++]));
+            }
+            leaf->slot_count = count;
+            level.emplace_back(leaf, &leaf->key(count - 1));
+            last_node = leaf;
+        }
+        while (level.size() > 1) {
+            const size_type nodes = (level.size() + inner_slots_max) / (inner_slots_max + 1);
+            std::vector<std::pair<node_type*, const key_type*>> parents;
+            size_type child = 0;
+            for (size_type i = 0; i < nodes; ++i) {
+                const size_type count = level.size() / nodes + (i < level.size() % nodes ? 1 : 0);
+                auto* inner = allocate_inner(level.front().first->level + 1);
+                for (slot_type slot = 0; slot < count; ++slot) {
+                    inner->childs[slot] = level[child + slot].first;
+                    if (slot + 1 < count) {
+                        inner->keys.construct(slot, *level[child + slot].second);
+                    }
+                }
+                inner->slot_count = count - 1;
+                parents.emplace_back(inner, level[child + count - 1].second);
+                last_node = inner;
+                child += count;
+            }
+            level = std::move(parents);
+        }
+        root = last_node;
+    }
+
+    template <typename K>
+    [[nodiscard]] const_iterator find_impl(const K& key) const {
+        const_iterator it = find_value(detail::greater_than_or_equal_to, key);
+        return it != end() && detail::equal_to(key_compare, it.key(), key) ? it : end();
+    }
+
+    template <typename K>
+    [[nodiscard]] bool contains_impl(const K& key) const {
+        if (!root) {
+            return false;
+        }
+        const node_type* node = root;
+        while (!node->is_leafnode()) {
+            const auto* inner = static_cast<const inner_node_type*>(node);
+            const message* first = inner->messages.data();
+            const message* last = first + inner->message_count;
+            const message* m = std::lower_bound(first, last, key, [this](const message& x, const K& k) {
+                return key_compare(x.key, k);
+            });
+            if (m != last && !key_compare(key, m->key)) {
+                return m->kind != message_kind::erase;
+            }
+            node = inner->childs[base_type::find_slot_in_node(*this, *inner, detail::greater_than_or_equal_to, key)];
+        }
+        const auto& leaf = static_cast<const leaf_node_type&>(*node);
+        const slot_type slot = base_type::find_slot_in_node(*this, leaf, detail::greater_than_or_equal_to, key);
+        return slot < leaf.slot_count && !key_compare(key, leaf.key(slot));
+    }
+
+    /**
+     * Iterator to the first value satisfying the comparison `comp` with `key`, once merged with the pending messages.
+     * Values are routed to the child whose separator is the first one not ordered before their key.
+     */
+    template <typename Comparator, typename K>
+    [[nodiscard]] const_iterator find_value(const Comparator& comp, const K& key) const {
+        if (!root) {
+            return end();
+        }
+        const_iterator it(*this);
+        const node_type* node = root;
+        it.path.reserve(root->level);
+        while (!node->is_leafnode()) {
+            const auto* inner = static_cast<const inner_node_type*>(node);
+            const slot_type slot = base_type::find_slot_in_node(*this, *inner, detail::greater_than_or_equal_to, key);
+            it.path.emplace_back(inner, slot);
+            node = inner->childs[slot];
+        }
+        it.current_leaf = static_cast<const leaf_node_type*>(node);
+        it.merge();
+        const auto position = std::partition_point(it.values.begin(), it.values.end(), [&](const value_type* v) {
+            return !comp(key_compare, key_extractor_type{}(*v), key);
+        });
+        if (position == it.values.end()) {
+            it.next_leaf();
+        } else {
+            it.current_slot = static_cast<slot_type>(position - it.values.begin());
+        }
+        return it;
+    }
+
+    /**
+     * Add `m` to the buffer of the root, flushing it first if it is full. A root leaf is modified in place, unless it
+     * is full and `m` would insert a value into it.
+     */
+    void write(message&& m) {
+        if (!root) {
+            root = allocate_leaf();
+        }
+        if (root->is_leafnode()) {
+            auto* leaf = static_cast<leaf_node_type*>(root);
+            const slot_type slot = base_type::find_slot_in_node(*this, *leaf, detail::greater_than_or_equal_to, m.key);
+            const bool found = slot < leaf->slot_count && !key_compare(m.key, leaf->key(slot));
+            if (found || m.kind == message_kind::erase || leaf->slot_count < leaf_slots_max) {
+                apply_to_root_leaf(*leaf, slot, found, std::move(m));
+                return;
+            }
+            auto* new_root = allocate_inner(level_type{1});
+            new_root->childs[0] = root;
+            root = new_root;
+        }
+        auto* inner = static_cast<inner_node_type*>(root);
+        while (inner->message_count == buffer_slots) {
+            if (inner->slot_count == inner_slots_max) {
+                auto* new_root = allocate_inner(inner->level + 1);
+                new_root->childs[0] = inner;
+                root = new_root;
+                split_child(*new_root, 0);
+                inner = new_root;
+            } else {
+                flush_batch(*inner);
+            }
+        }
+        add_message(*inner, std::move(m));
+    }
+
+    void apply_to_root_leaf(leaf_node_type& leaf, slot_type slot, bool found, message&& m) {
+        if (found) {
+            if (m.kind == message_kind::insert) {
+                return;
+            }
+            leaf.destroy(slot, slot + 1);
+            if (m.kind == message_kind::upsert) {
+                leaf.construct(slot, std::move(*m.value));
+            } else {
+                leaf.relocate(slot + 1, leaf.slot_count, leaf, slot);
+                --leaf.slot_count;
+            }
+        } else if (m.kind != message_kind::erase) {
+            leaf.relocate(slot, leaf.slot_count, leaf, slot + 1);
+            leaf.construct(slot, std::move(*m.value));
+            ++leaf.slot_count;
+        }
+    }
+
+    void add_message(inner_node_type& inner, message&& m) {
+        message* first = inner.messages.data();
+        message* last = first + inner.message_count;
+        message* position = std::lower_bound(first, last, m.key, [this](const message& x, const key_type& k) {
+            return key_compare(x.key, k);
+        });
+        if (position != last && !key_compare(m.key, position->key)) {
+            position->combine(std::move(m));
+            return;
+        }
+        BPLUSTREE_ASSERT(inner.message_count < buffer_slots);
+        detail::relocate(position, last, position + 1);
+        std::construct_at(position, std::move(m));
+        ++inner.message_count;
+        ++pending_count;
+    }
+
+    void erase_messages(inner_node_type& inner, slot_type first, slot_type last) noexcept {
+        message* messages = inner.messages.data();
+        inner.messages.destroy(first, last);
+        detail::relocate(messages + last, messages + inner.message_count, messages + first);
+        inner.message_count -= last - first;
+    }
+
+    /**
+     * Move the messages of `parent` bound for the child receiving the most of them down to this child. At least one
+     * message leaves the buffer, unless the child is split instead.
+     * @pre `parent` holds messages, and has room for one more child.
+     */
+    void flush_batch(inner_node_type& parent) {
+        const message* messages = parent.messages.data();
+        const auto before = [this](const key_type& k, const message& m) { return key_compare(k, m.key); };
+        slot_type best = 0, best_first = 0, best_last = 0;
+        slot_type first = 0;
+        for (slot_type slot = 0; slot <= parent.slot_count && first < parent.message_count; ++slot) {
+            const slot_type last =
+                slot < parent.slot_count
+                    ? static_cast<slot_type>(std::upper_bound(messages + first, messages + parent.message_count,
+                                                              parent.key(slot), before) -
+                                             messages)
+                    : parent.message_count;
+            if (last - first > best_last - best_first) {
+                best = slot;
+                best_first = first;
+                best_last = last;
+            }
+            first = last;
+        }
+
+        node_type* child = parent.childs[best];
+        if (child->is_leafnode()) {
+            apply_to_leaf(parent, best, best_first, best_last);
+            return;
+        }
+        auto* inner = static_cast<inner_node_type*>(child);
+        if (inner->slot_count < inner_slots_max) {
+            while (inner->message_count == buffer_slots && inner->slot_count < inner_slots_max) {
+                flush_batch(*inner);
+            }
+        }
+        if (inner->message_count == buffer_slots) {
+            split_child(parent, best);
+            return;
+        }
+        move_messages(parent, best_first, best_last, *inner);
+    }
+
+    /**
+     * Merge the messages of `parent` in [first, last) into the buffer of its child `child`, as many as it can hold.
+     */
+    void move_messages(inner_node_type& parent, slot_type first, slot_type last, inner_node_type& child) {
+        message* incoming = parent.messages.data();
+        message* own = child.messages.data();
+        const slot_type count = child.message_count;
+        merged_messages.clear();
+        slot_type i = 0, taken = first;
+        while (i < count || taken < last) {
+            if (taken < last && (i == count || key_compare(incoming[taken].key, own[i].key))) {
+                if (merged_messages.size() + (count - i) >= buffer_slots) {
+                    break;
+                }
+                merged_messages.push_back(std::move(incoming[taken++]));
+            } else if (taken < last && !key_compare(own[i].key, incoming[taken].key)) {
+                own[i].combine(std::move(incoming[taken++]));
+                --pending_count;
+                merged_messages.push_back(std::move(own[i++]));
+            } else {
+                merged_messages.push_back(std::move(own[i++]));
+            }
+        }
+        for (; i < count; ++i) {
+            merged_messages.push_back(std::move(own[i]));
+        }
+        child.messages.destroy(0, count);
+        for (slot_type slot = 0; slot < merged_messages.size(); ++slot) {
+            child.messages.construct(slot, std::move(merged_messages[slot]));
+        }
+        child.message_count = merged_messages.size();
+        erase_messages(parent, first, taken);
+    }
+
+    /**
+     * Apply the messages of `parent` in [first, last) to its leaf child in `slot`, then spread the values over as many
+     * leaves as needed. Only the messages whose values fit in the leaves `parent` has room for are applied.
+     */
+    void apply_to_leaf(inner_node_type& parent, slot_type slot, slot_type first, slot_type last) {
+        auto* leaf = static_cast<leaf_node_type*>(parent.childs[slot]);
+        const slot_type leaves_max = inner_slots_max - parent.slot_count + 1;
+        last = std::min(last, first + leaves_max * leaf_slots_max - leaf->slot_count);
+
+        message* messages = parent.messages.data();
+        merged_values.clear();
+        slot_type i = 0, m = first;
+        while (i < leaf->slot_count || m < last) {
+            if (m < last && (i == leaf->slot_count || key_compare(messages[m].key, leaf->key(i)))) {
+                if (messages[m].kind != message_kind::erase) {
+                    merged_values.push_back(std::move(*messages[m].value));
+                }
+                ++m;
+            } else if (m < last && !key_compare(leaf->key(i), messages[m].key)) {
+                if (messages[m].kind == message_kind::insert) {
+                    merged_values.push_back(std::move(leaf->data[i]));
+                } else if (messages[m].kind == message_kind::upsert) {
+                    merged_values.push_back(std::move(*messages[m].value));
+                }
+                ++i;
+                ++m;
+            } else {
+                merged_values.push_back(std::move(leaf->data[i++]));
+            }
+        }
+        leaf->destroy(0, leaf->slot_count);
+        leaf->slot_count = 0;
+        pending_count -= last - first;
+        erase_messages(parent, first, last);
+
+        const size_type total = merged_values.size();
+        if (total == 0) {
+            if (parent.slot_count > 0) {
+                remove_child(parent, slot);
+            }
+            return;
+        }
+        const size_type leaves = (total + leaf_slots_max - 1) / leaf_slots_max;
+        size_type value = 0;
+        for (size_type l = 0; l < leaves; ++l) {
+            if (l > 0) {
+                auto* right = allocate_leaf();
+                parent.insert_after(static_cast<slot_type>(slot + l - 1), leaf->key(leaf->slot_count - 1), right);
+                leaf = right;
+            }
+            const size_type count = total / leaves + (l < total % leaves ? 1 : 0);
+            for (slot_type s = 0; s < count; ++s) {
+                leaf->construct(s, std::move(merged_values[value++]));
+            }
+            leaf->slot_count = count;
+        }
+    }
+
+    /**
+     * Free the empty leaf in `slot` of `parent` along with the separator on one of its sides, the keys it was bound
+     * for being then bound for a sibling.
+     */
+    void remove_child(inner_node_type& parent, slot_type slot) {
+        base_type::deallocate_from_allocator(allocator, static_cast<leaf_node_type*>(parent.childs[slot]));
+        const slot_type key_slot = slot > 0 ? slot - 1 : 0;
+        parent.keys.destroy(key_slot, key_slot + 1);
+        detail::relocate(parent.keys.data() + key_slot + 1, parent.keys.data() + parent.slot_count,
+                         parent.keys.data() + key_slot);
+        std::copy(parent.childs.begin() + slot + 1, parent.childs.begin() + parent.slot_count + 1,
+                  parent.childs.begin() + slot);
+        --parent.slot_count;
+    }
+
+    /**
+     * Split the inner child in `slot` of `parent`, moving its upper half to a new node along with the messages bound
+     * for it. The middle key moves up as the separator between both.
+     */
+    void split_child(inner_node_type& parent, slot_type slot) {
+        auto* inner = static_cast<inner_node_type*>(parent.childs[slot]);
+        auto* right = allocate_inner(inner->level);
+        key_type separator = inner->split_half(*right);
+
+        message* messages = inner->messages.data();
+        const auto split = static_cast<slot_type>(
+            std::upper_bound(messages, messages + inner->message_count, separator,
+                             [this](const key_type& k, const message& m) { return key_compare(k, m.key); }) -
+            messages);
+        detail::relocate(messages + split, messages + inner->message_count, right->messages.data());
+        right->message_count = inner->message_count - split;
+        inner->message_count = split;
+        parent.insert_after(slot, std::move(separator), right);
+    }
+
+    [[no_unique_address]] key_compare_type key_compare;
+    allocator_type allocator;
+    node_type* root{};
+    size_type pending_count{};
+    // Scratch buffers of the flushes, kept to reuse their storage
+    std::vector<message> merged_messages;
+    std::vector<value_type> merged_values;
+};
@@ -0,0 +1,629 @@
+#pragma once
+
+#include <bplustree.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace detail {
+
+/**
+ * Version lock used for optimistic lock coupling.
+ *
+ * The version is odd while a writer holds the lock. Readers never write to the lock: they record the version before
+ * reading the protected node and check that it did not change afterwards, restarting their operation otherwise.
+ * Writers first read the node like readers, then upgrade to an exclusive lock only if the version did not change in
+ * between.
+ */
+class optimistic_lock {
+public:
+    using version_type = std::uint64_t;
+
+    /**
+     * Record the current version in `version`. Returns false if a writer currently holds the lock.
+     */
+    [[nodiscard]] bool read_lock(version_type& version) const noexcept {
+        version = word.load(std::memory_order_acquire);
+        return (version & 1) == 0;
+    }
+
+    /**
+     * Returns true if no writer acquired the lock since `version` was recorded, meaning that everything read from the
+     * node in between is consistent.
+     */
+    [[nodiscard]] bool validate(version_type version) const noexcept {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return word.load(std::memory_order_relaxed) == version;
+    }
+
+    /**
+     * Acquire the lock exclusively if the version is still `version`. Returns false otherwise.
+     */
+    [[nodiscard]] bool upgrade(version_type version) noexcept {
+        if (!word.compare_exchange_strong(version, version + 1, std::memory_order_acquire)) {
+            return false;
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        return true;
+    }
+
+    void unlock() noexcept { word.fetch_add(1, std::memory_order_release); }
+
+private:
+    std::atomic<version_type> word{0};
+};
+
+/**
+ * Epoch-based reclamation of objects that concurrent operations may still be accessing.
+ *
+ * Each operation pins the current global epoch for its duration. Unlinked objects are retired along with the epoch at
+ * which they were unlinked, and are only reclaimed once no operation pinned at or before that epoch is still running.
+ */
+class epoch_manager {
+public:
+    /**
+     * Keeps the epoch pinned by an operation until its destruction.
+     */
+    class guard {
+    public:
+        explicit guard(std::atomic<std::uint64_t>& s) noexcept : slot(&s) {}
+        guard(const guard&) = delete;
+        guard& operator=(const guard&) = delete;
+        ~guard() { slot->store(0, std::memory_order_release); }
+
+    private:
+        std::atomic<std::uint64_t>* slot;
+    };
+
+    epoch_manager() = default;
+    epoch_manager(const epoch_manager&) = delete;
+    epoch_manager& operator=(const epoch_manager&) = delete;
+    ~epoch_manager() { reclaim_all(); }
+
+    /**
+     * Announce the current epoch in a free slot, starting from a slot chosen by thread to limit contention.
+     */
+    [[nodiscard]] guard pin() noexcept {
+        std::size_t index = std::hash<std::thread::id>{}(std::this_thread::get_id()) % slots.size();
+        for (;;) {
+            std::uint64_t idle = 0;
+            if (slots[index].epoch.compare_exchange_weak(idle, global_epoch.load())) {
+                return guard(slots[index].epoch);
+            }
+            index = (index + 1) % slots.size();
+        }
+    }
+
+    /**
+     * Register `reclaim` to be called once no operation can access the objects it frees. These objects must already
+     * be unreachable for operations starting from now on.
+     */
+    void retire(std::function<void()> reclaim) {
+        const std::uint64_t epoch = global_epoch.fetch_add(1);
+        std::lock_guard<std::mutex> lock(retired_mutex);
+        retired.emplace_back(epoch, std::move(reclaim));
+    }
+
+    /**
+     * Reclaim the retired objects that no running operation can access anymore.
+     */
+    void collect() {
+        std::uint64_t oldest = std::numeric_limits<std::uint64_t>::max();
+        for (const auto& slot : slots) {
+            const std::uint64_t epoch = slot.epoch.load();
+            if (epoch != 0) {
+                oldest = std::min(oldest, epoch);
+            }
+        }
+        std::vector<std::function<void()>> reclaimable;
+        {
+            std::lock_guard<std::mutex> lock(retired_mutex);
+            auto safe = std::partition(retired.begin(), retired.end(),
+                                       [oldest](const auto& object) { return object.first >= oldest; });
+            for (auto it = safe; it != retired.end(); ++it) {
+                reclaimable.push_back(std::move(it->second));
+            }
+            retired.erase(safe, retired.end());
+        }
+        for (auto& reclaim : reclaimable) {
+            reclaim();
+        }
+    }
+
+    /**
+     * Reclaim all the retired objects. Must only be called while no operation is running.
+     */
+    void reclaim_all() {
+        for (auto& object : retired) {
+            object.second();
+        }
+        retired.clear();
+    }
+
+private:
+    struct alignas(64) slot_type {
+        std::atomic<std::uint64_t> epoch{0};
+    };
+
+    std::array<slot_type, 128> slots{};
+    std::atomic<std::uint64_t> global_epoch{1};
+    std::mutex retired_mutex;
+    std::vector<std::pair<std::uint64_t, std::function<void()>>> retired;
+};
+
+}  // namespace detail
+
+/**
+ * Variant of `btree` that any number of threads can read and write simultaneously.
+ *
+ * Nodes reuse the layouts of `btree`, with a version lock added to each of them, and are accessed using optimistic
+ * lock coupling: lookups and scans never acquire locks, they read nodes optimistically and validate their versions
+ * afterwards, restarting if a writer modified a node in the meantime. Writers lock only the leaf they modify, or the
+ * nodes they split. Full nodes are split eagerly while descending, so that a split never has to propagate upwards.
+ *
+ * Nodes detached by clear() are reclaimed through epoch-based reclamation, once no running operation can still access
+ * them. No other operation frees nodes: erasing values does not merge underflowing leaves.
+ *
+ * Unlike `btree`, keys are unique. Since nodes may be read while they are being modified, keys and values must be
+ * trivially copyable, and values are returned by copy. Leaves are only linked forward, so scans are ascending.
+ * The allocator must be usable from several threads at once.
+ */
+template <typename Key,
+          typename Value,
+          typename KeyExtractor,
+          typename Compare = std::less<Key>,
+          typename Traits = btree_default_traits<Key, Value>,
+          typename Allocator = std::allocator<Value>>
+class concurrent_btree {
+    using base_type = btree<Key, Value, KeyExtractor, Compare, Traits, Allocator>;
+
+    friend base_type;
+
+public:
+    using key_type = Key;
+    using value_type = Value;
+    using key_extractor_type = KeyExtractor;
+    using key_compare_type = Compare;
+    using traits_type = Traits;
+    using allocator_type = Allocator;
+    using size_type = size_t;
+
+    static_assert(std::is_trivially_copyable_v<key_type> && std::is_trivially_copyable_v<value_type>,
+                  "keys and values are read optimistically, they must be trivially copyable");
+    static_assert(!traits_type::order_statistics && std::is_void_v<typename traits_type::aggregate>,
+                  "subtree sizes and aggregates are not maintained by concurrent updates");
+    static_assert(!traits_type::compact_handles, "nodes are allocated one by one, childs are linked by pointers");
+
+    explicit concurrent_btree(const allocator_type& alloc = allocator_type{}) : allocator(alloc) {
+        state.store(allocate_state());
+    }
+
+    explicit concurrent_btree(const key_compare_type& comp, const allocator_type& alloc = allocator_type{})
+        : key_compare(comp), allocator(alloc) {
+        state.store(allocate_state());
+    }
+
+    concurrent_btree(const concurrent_btree&) = delete;
+    concurrent_btree& operator=(const concurrent_btree&) = delete;
+
+    ~concurrent_btree() {
+        epochs.reclaim_all();
+        deallocate_state(state.load());
+    }
+
+    /**
+     * Insert `value` if no value with an equivalent key is present. Returns true if it was inserted.
+     */
+    bool insert(const value_type& value) {
+        const auto guard = epochs.pin();
+        const key_type& key = key_extractor_type{}(value);
+        for (;;) {
+            tree_state* current = state.load(std::memory_order_acquire);
+            node_type* node = current->root.load(std::memory_order_acquire);
+            version_type version = 0;
+            if (!lock_of(node).read_lock(version) || node != current->root.load(std::memory_order_acquire)) {
+                continue;
+            }
+            inner_node_type* parent = nullptr;
+            version_type parent_version = 0;
+            slot_type parent_slot = 0;
+            bool valid = true;
+            while (valid && !node->is_leafnode()) {
+                auto* inner = static_cast<inner_node_type*>(node);
+                if (inner->slot_count == inner_slots_max) {
+                    split(*current, parent, parent_version, parent_slot, inner, version);
+                    valid = false;
+                    break;
+                }
+                const slot_type slot =
+                    base_type::find_slot_in_node(*this, *inner, detail::greater_than_or_equal_to, key);
+                node_type* child = inner->childs[slot];
+                version_type child_version = 0;
+                valid = child && inner->lock.validate(version) && lock_of(child).read_lock(child_version) &&
+                        inner->lock.validate(version);
+                parent = inner;
+                parent_version = version;
+                parent_slot = slot;
+                node = child;
+                version = child_version;
+            }
+            if (!valid) {
+                continue;
+            }
+
+            auto* leaf = static_cast<leaf_node_type*>(node);
+            if (leaf->slot_count == leaf_slots_max) {
+                split(*current, parent, parent_version, parent_slot, leaf, version);
+                continue;
+            }
+            // The range of keys covered by a leaf only changes when it is split, which changes its version
+            if (!leaf->lock.upgrade(version)) {
+                continue;
+            }
+            const slot_type slot = base_type::find_slot_in_node(*this, *leaf, detail::greater_than_or_equal_to, key);
+            const bool inserted = slot == leaf->slot_count || !detail::equal_to(key_compare, leaf->key(slot), key);
+            if (inserted) {
+                leaf->relocate(slot, leaf->slot_count, *leaf, slot + 1);
+                leaf->construct(slot, value);
+                ++leaf->slot_count;
+                current->count.fetch_add(1, std::memory_order_relaxed);
+            }
+            leaf->lock.unlock();
+            return inserted;
+        }
+    }
+
+    /**
+     * Erase the value whose key is equivalent to `key`, if any. Returns true if a value was erased.
+     */
+    bool erase(const key_type& key) {
+        const auto guard = epochs.pin();
+        for (;;) {
+            tree_state* current = state.load(std::memory_order_acquire);
+            auto [found_leaf, version] = find_leaf(*current, detail::greater_than_or_equal_to, key);
+            auto* leaf = const_cast<leaf_node_type*>(found_leaf);
+            if (!leaf->lock.upgrade(version)) {
+                continue;
+            }
+            const slot_type slot = base_type::find_slot_in_node(*this, *leaf, detail::greater_than_or_equal_to, key);
+            const bool erased = slot < leaf->slot_count && detail::equal_to(key_compare, leaf->key(slot), key);
+            if (erased) {
+                leaf->destroy(slot, slot + 1);
+                leaf->relocate(slot + 1, leaf->slot_count, *leaf, slot);
+                --leaf->slot_count;
+                current->count.fetch_sub(1, std::memory_order_relaxed);
+            }
+            leaf->lock.unlock();
+            return erased;
+        }
+    }
+
+    /**
+     * Returns a copy of the value whose key is equivalent to `key`, if any.
+     */
+    [[nodiscard]] std::optional<value_type> find(const key_type& key) const { return find_impl(key); }
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    [[nodiscard]] std::optional<value_type> find(const K& key) const {
+        return find_impl(key);
+    }
+
+    /**
+     * Returns a copy of the first value whose key is not ordered before `key`, if any.
+     */
+    [[nodiscard]] std::optional<value_type> lower_bound(const key_type& key) const {
+        return first_satisfying(detail::greater_than_or_equal_to, key);
+    }
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    [[nodiscard]] std::optional<value_type> lower_bound(const K& key) const {
+        return first_satisfying(detail::greater_than_or_equal_to, key);
+    }
+
+    /**
+     * Returns a copy of the first value whose key is ordered after `key`, if any.
+     */
+    [[nodiscard]] std::optional<value_type> upper_bound(const key_type& key) const {
+        return first_satisfying(detail::greater_than, key);
+    }
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    [[nodiscard]] std::optional<value_type> upper_bound(const K& key) const {
+        return first_satisfying(detail::greater_than, key);
+    }
+
+    /**
+     * Call `fn` with each value whose key is not ordered before `first`, in ascending order, until `fn` returns false.
+     *
+     * Values are passed to `fn` from a validated copy of each leaf, so `fn` may run for as long as needed without
+     * blocking writers. Values inserted or erased concurrently may or may not be visited, but each key is visited at
+     * most once and in order.
+     */
+    template <typename Function>
+    void for_each(const key_type& first, Function&& fn) const {
+        scan(detail::greater_than_or_equal_to, first, std::forward<Function>(fn));
+    }
+    template <typename K, typename Function>
+        requires detail::is_transparent_v<key_compare_type>
+    void for_each(const K& first, Function&& fn) const {
+        scan(detail::greater_than_or_equal_to, first, std::forward<Function>(fn));
+    }
+
+    /**
+     * Remove all the values from the tree. Nodes are reclaimed once no running operation can access them anymore.
+     *
+     * The root and the count are replaced together, so that writers still updating a leaf of the previous tree only
+     * change the count of that tree.
+     */
+    void clear() {
+        tree_state* previous = state.exchange(allocate_state());
+        epochs.retire([this, previous] { deallocate_state(previous); });
+        epochs.collect();
+    }
+
+    [[nodiscard]] size_type size() const noexcept {
+        const auto guard = epochs.pin();
+        return state.load(std::memory_order_acquire)->count.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] bool empty() const noexcept { return size() == 0; }
+
+private:
+    using node_type = typename base_type::node_type;
+    using slot_type = typename base_type::slot_type;
+    using level_type = typename base_type::level_type;
+    using version_type = detail::optimistic_lock::version_type;
+
+    static constexpr slot_type leaf_slots_max = base_type::leaf_slots_max;
+    static constexpr slot_type inner_slots_max = base_type::inner_slots_max;
+
+    struct leaf_node_type : base_type::leaf_node_type {
+        detail::optimistic_lock lock;
+    };
+
+    struct inner_node_type : base_type::inner_node_type {
+        // Childs are cleared so that a reader never follows an uninitialized pointer before validating the node
+        explicit inner_node_type(level_type l) noexcept : base_type::inner_node_type(l) { this->childs.fill(nullptr); }
+
+        detail::optimistic_lock lock;
+    };
+
+    /**
+     * Root of the tree along with the number of values it holds. Writers update the count of the state they descended
+     * from, and clear() replaces the whole state.
+     */
+    struct tree_state {
+        std::atomic<node_type*> root{};
+        std::atomic<size_type> count{};
+    };
+
+    [[nodiscard]] static detail::optimistic_lock& lock_of(const node_type* n) noexcept {
+        if (n->is_leafnode()) {
+            return const_cast<leaf_node_type*>(static_cast<const leaf_node_type*>(n))->lock;
+        }
+        return const_cast<inner_node_type*>(static_cast<const inner_node_type*>(n))->lock;
+    }
+
+    [[nodiscard]] leaf_node_type* allocate_leaf() {
+        return base_type::template allocate_from_allocator<leaf_node_type>(allocator);
+    }
+
+    [[nodiscard]] inner_node_type* allocate_inner(level_type level) {
+        return base_type::template allocate_from_allocator<inner_node_type>(allocator, level);
+    }
+
+    [[nodiscard]] tree_state* allocate_state() {
+        auto* s = new tree_state;
+        s->root.store(allocate_leaf());
+        return s;
+    }
+
+    void deallocate_state(tree_state* s) {
+        deallocate_subtree(s->root.load());
+        delete s;
+    }
+
+    void deallocate_subtree(node_type* n) {
+        if (n->is_leafnode()) {
+            base_type::deallocate_from_allocator(allocator, static_cast<leaf_node_type*>(n));
+        } else {
+            auto* inner = static_cast<inner_node_type*>(n);
+            for (slot_type slot = 0; slot < inner->slot_count + 1; ++slot) {
+                deallocate_subtree(inner->childs[slot]);
+            }
+            base_type::deallocate_from_allocator(allocator, inner);
+        }
+    }
+
+    template <typename K>
+    [[nodiscard]] std::optional<value_type> find_impl(const K& key) const {
+        auto value = first_satisfying(detail::greater_than_or_equal_to, key);
+        if (value && !detail::equal_to(key_compare, key_extractor_type{}(*value), key)) {
+            value.reset();
+        }
+        return value;
+    }
+
+    /**
+     * Returns a copy of the first value satisfying `comp` with `key`, if any.
+     */
+    template <typename Comparator, typename K>
+    [[nodiscard]] std::optional<value_type> first_satisfying(const Comparator& comp, const K& key) const {
+        std::optional<value_type> value;
+        scan(comp, key, [&value](const value_type& v) {
+            value = v;
+            return false;
+        });
+        return value;
+    }
+
+    /**
+     * Descend optimistically from the root of `current` to the leaf holding the first slot satisfying `comp` with
+     * `key`. Returns the leaf along with the version at which it was read.
+     */
+    template <typename Comparator, typename K>
+    [[nodiscard]] std::pair<const leaf_node_type*, version_type> find_leaf(const tree_state& current,
+                                                                            const Comparator& comp,
+                                                                            const K& key) const noexcept {
+        for (;;) {
+            const node_type* node = current.root.load(std::memory_order_acquire);
+            version_type version = 0;
+            if (!lock_of(node).read_lock(version) || node != current.root.load(std::memory_order_acquire)) {
+                continue;
+            }
+            bool valid = true;
+            while (valid && !node->is_leafnode()) {
+                const auto* inner = static_cast<const inner_node_type*>(node);
+                const node_type* child = inner->childs[base_type::find_slot_in_node(*this, *inner, comp, key)];
+                version_type child_version = 0;
+                valid = child && inner->lock.validate(version) && lock_of(child).read_lock(child_version) &&
+                        inner->lock.validate(version);
+                node = child;
+                version = child_version;
+            }
+            if (valid) {
+                return {static_cast<const leaf_node_type*>(node), version};
+            }
+        }
+    }
+
+    /**
+     * Call `fn` with each value from the first one satisfying `comp` with `key`, in ascending order, until `fn` returns
+     * false.
+     *
+     * Each leaf is copied optimistically then validated before its values are passed to `fn`. Whenever the validation
+     * fails, the scan resumes with a new descent after the last visited key.
+     */
+    template <typename Comparator, typename K, typename Function>
+    void scan(const Comparator& comp, const K& key, Function&& fn) const {
+        const auto guard = epochs.pin();
+        detail::uninitialized_array<value_type, leaf_slots_max> buffer;
+        std::optional<key_type> last;
+
+        const leaf_node_type* leaf = nullptr;
+        version_type version = 0;
+        slot_type slot = 0;
+        const auto descend = [&] {
+            const tree_state& current = *state.load(std::memory_order_acquire);
+            if (last) {
+                std::tie(leaf, version) = find_leaf(current, detail::greater_than, *last);
+                slot = base_type::find_slot_in_node(*this, *leaf, detail::greater_than, *last);
+            } else {
+                std::tie(leaf, version) = find_leaf(current, comp, key);
+                slot = base_type::find_slot_in_node(*this, *leaf, comp, key);
+            }
+        };
+
+        descend();
+        for (;;) {
+            const slot_type slot_count = std::min(leaf->slot_count, leaf_slots_max);
+            const slot_type copied = slot < slot_count ? slot_count - slot : 0;
+            std::memcpy(static_cast<void*>(buffer.data()), leaf->data.data() + slot, copied * sizeof(value_type));
+            const auto* next = static_cast<const leaf_node_type*>(leaf->next_leaf);
+            if (!leaf->lock.validate(version)) {
+                descend();
+                continue;
+            }
+            for (slot_type i = 0; i < copied; ++i) {
+                const key_type& current = key_extractor_type{}(buffer[i]);
+                if (last) {
+                    const key_type& previous = *last;
+                    if (!detail::less_than(key_compare, previous, current)) {
+                        continue;
+                    }
+                }
+                last = current;
+                if (!fn(static_cast<const value_type&>(buffer[i]))) {
+                    return;
+                }
+            }
+            if (!next) {
+                return;
+            }
+            leaf = next;
+            slot = 0;
+            if (!leaf->lock.read_lock(version)) {
+                descend();
+            }
+        }
+    }
+
+    /**
+     * Split the full `node` of `current`, reached through slot `parent_slot` of `parent` or being the root if `parent`
+     * is null.
+     *
+     * Both nodes are locked only if they did not change since they were read at the given versions, otherwise nothing
+     * is done. The caller restarts its operation in any case.
+     */
+    void split(tree_state& current,
+               inner_node_type* parent,
+               version_type parent_version,
+               slot_type parent_slot,
+               node_type* node,
+               version_type version) {
+        if (parent && !parent->lock.upgrade(parent_version)) {
+            return;
+        }
+        if (!lock_of(node).upgrade(version)) {
+            if (parent) {
+                parent->lock.unlock();
+            }
+            return;
+        }
+        if (!parent && node != current.root.load(std::memory_order_acquire)) {
+            lock_of(node).unlock();
+            return;
+        }
+
+        auto [separator, right] = node->is_leafnode() ? split_leaf(static_cast<leaf_node_type*>(node))
+                                                      : split_inner(static_cast<inner_node_type*>(node));
+        if (parent) {
+            // The parent cannot be full, since full inner nodes are split before descending into them
+            parent->insert_after(parent_slot, separator, right);
+            lock_of(node).unlock();
+            parent->lock.unlock();
+        } else {
+            auto* new_root = allocate_inner(node->level + 1);
+            new_root->keys.construct(0, separator);
+            new_root->childs[0] = node;
+            new_root->childs[1] = right;
+            new_root->slot_count = 1;
+            current.root.store(new_root, std::memory_order_release);
+            lock_of(node).unlock();
+        }
+    }
+
+    /**
+     * Move the upper half of the locked `leaf` to a new leaf. Returns the separator between both along with the new
+     * leaf.
+     */
+    std::pair<key_type, node_type*> split_leaf(leaf_node_type* leaf) {
+        auto* right = allocate_leaf();
+        key_type separator = leaf->split_half(*right);
+        right->next_leaf = leaf->next_leaf;
+        leaf->next_leaf = right;
+        return {std::move(separator), right};
+    }
+
+    /**
+     * Move the upper half of the locked `inner` node to a new node. The middle key moves up as the separator between
+     * both, and is returned along with the new node.
+     */
+    std::pair<key_type, node_type*> split_inner(inner_node_type* inner) {
+        auto* right = allocate_inner(inner->level);
+        return {inner->split_half(*right), right};
+    }
+
+    key_compare_type key_compare;
+    allocator_type allocator;
+    std::atomic<tree_state*> state{};
+    mutable detail::epoch_manager epochs;
+};
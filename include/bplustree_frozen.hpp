@@ -0,0 +1,270 @@
+#pragma once
+
+#include <bplustree.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Immutable index built from the values of a `btree`, for lookups in data that never changes once built.
+ *
+ * The values are stored in one dense sorted array, viewed as blocks of `block_keys` values. Above it, the inner levels
+ * form a static B+ tree (an S+ tree) whose nodes are blocks of `block_keys` separators, each aligned on a cache line
+ * and stored level by level from the root in a single allocation. The childs of the block `k` of a level are the
+ * blocks `k * (block_keys + 1)` to `k * (block_keys + 1) + block_keys` of the level below, so no pointer is stored
+ * and a descent touches exactly one block per level. The separator `j` of a block is the first key of the subtree of
+ * its child `j + 1`.
+ *
+ * Compared with the btree it is built from, there is no room kept for insertions, no child or sibling pointers, and the
+ * inner levels hold about one key per block of values. Blocks of keys eligible to SIMD comparisons (see
+ * `Traits::simd`) are searched by counting the keys ordered before the probe, other ones by a binary search.
+ */
+template <typename Key,
+          typename Value,
+          typename KeyExtractor,
+          typename Compare = std::less<Key>,
+          typename Traits = btree_default_traits<Key, Value>,
+          typename Allocator = std::allocator<Value>>
+class frozen_btree {
+public:
+    using key_type = Key;
+    using value_type = Value;
+    using key_extractor_type = KeyExtractor;
+    using key_compare_type = Compare;
+    using traits_type = Traits;
+    using allocator_type = Allocator;
+    using size_type = std::size_t;
+
+    using const_iterator = typename std::vector<value_type, allocator_type>::const_iterator;
+    using iterator = const_iterator;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+    using reverse_iterator = const_reverse_iterator;
+
+    static_assert(std::is_default_constructible_v<key_type>, "inner blocks are arrays of keys, built in place");
+
+    /**
+     * Keys per block: a cache line of keys when they are searched with SIMD comparisons, more otherwise to reduce the
+     * number of levels, since such blocks are binary searched anyway.
+     */
+    static constexpr size_type block_keys = detail::is_simd_searchable_v<key_type, key_compare_type>
+                                                ? std::max<size_type>(detail::cache_line_size / sizeof(key_type), 2)
+                                                : 16;
+
+    explicit frozen_btree(const allocator_type& alloc = allocator_type{})
+        : values(alloc), blocks(block_allocator(alloc)) {}
+
+    explicit frozen_btree(const key_compare_type& comp, const allocator_type& alloc = allocator_type{})
+        : key_compare(comp), values(alloc), blocks(block_allocator(alloc)) {}
+
+    /**
+     * Copy the values of `tree`.
+     */
+    template <typename TreeAllocator>
+    explicit frozen_btree(const btree<Key, Value, KeyExtractor, Compare, Traits, TreeAllocator>& tree,
+                          const allocator_type& alloc = allocator_type{})
+        : key_compare(tree.key_comp()), values(tree.begin(), tree.end(), alloc), blocks(block_allocator(alloc)) {
+        build();
+    }
+
+    /**
+     * Move the values out of `tree`, which is left empty.
+     */
+    template <typename TreeAllocator>
+    explicit frozen_btree(btree<Key, Value, KeyExtractor, Compare, Traits, TreeAllocator>&& tree,
+                          const allocator_type& alloc = allocator_type{})
+        : key_compare(tree.key_comp()),
+          values(std::make_move_iterator(tree.begin()), std::make_move_iterator(tree.end()), alloc),
+          blocks(block_allocator(alloc)) {
+        tree.clear();
+        build();
+    }
+
+    /**
+     * Copy the values in [first, last), sorting them by key when they are not sorted yet. Values with equivalent keys
+     * keep their order.
+     */
+    template <typename InputIterator>
+    frozen_btree(InputIterator first,
+                 InputIterator last,
+                 const key_compare_type& comp = key_compare_type{},
+                 const allocator_type& alloc = allocator_type{})
+        : key_compare(comp), values(first, last, alloc), blocks(block_allocator(alloc)) {
+        const auto by_key = [this](const value_type& a, const value_type& b) {
+            return key_compare(key_extractor_type{}(a), key_extractor_type{}(b));
+        };
+        if (!std::is_sorted(values.begin(), values.end(), by_key)) {
+            std::stable_sort(values.begin(), values.end(), by_key);
+        }
+        build();
+    }
+
+    [[nodiscard]] const_iterator begin() const noexcept { return values.begin(); }
+    [[nodiscard]] const_iterator cbegin() const noexcept { return begin(); }
+    [[nodiscard]] const_iterator end() const noexcept { return values.end(); }
+    [[nodiscard]] const_iterator cend() const noexcept { return end(); }
+
+    [[nodiscard]] const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator(end()); }
+    [[nodiscard]] const_reverse_iterator crbegin() const noexcept { return rbegin(); }
+    [[nodiscard]] const_reverse_iterator rend() const noexcept { return const_reverse_iterator(begin()); }
+    [[nodiscard]] const_reverse_iterator crend() const noexcept { return rend(); }
+
+    [[nodiscard]] size_type size() const noexcept { return values.size(); }
+    [[nodiscard]] bool empty() const noexcept { return values.empty(); }
+
+    [[nodiscard]] key_compare_type key_comp() const { return key_compare; }
+
+    [[nodiscard]] const_iterator lower_bound(const key_type& key) const { return find_value<false>(key); }
+    [[nodiscard]] const_iterator upper_bound(const key_type& key) const { return find_value<true>(key); }
+
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    [[nodiscard]] const_iterator lower_bound(const K& key) const {
+        return find_value<false>(key);
+    }
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    [[nodiscard]] const_iterator upper_bound(const K& key) const {
+        return find_value<true>(key);
+    }
+
+    /**
+     * Number of bytes allocated for the values and the inner levels.
+     */
+    [[nodiscard]] size_type memory_usage() const noexcept {
+        return values.capacity() * sizeof(value_type) + blocks.capacity() * sizeof(block);
+    }
+
+BPLUSTREE_PRIVATE:
+    struct alignas(detail::cache_line_size) block {
+        key_type keys[block_keys];
+    };
+
+    using block_allocator = typename std::allocator_traits<allocator_type>::template rebind_alloc<block>;
+
+    /**
+     * Level of inner blocks, the first one being the root.
+     */
+    struct level {
+        // Index of the first block of the level in `blocks`
+        size_type offset;
+        // Number of separators of the level, which are all stored before the unused slots of the level
+        size_type size;
+    };
+
+    // Values are searched in place when they are their own keys, so that the SIMD kernels can read them
+    static constexpr bool values_are_keys =
+        std::is_same_v<key_type, value_type> && std::is_same_v<key_extractor_type, btree_key_extractor_self>;
+
+    /**
+     * Build the inner levels above the values, from the lowest one up to the root.
+     */
+    void build() {
+        size_type leaf_blocks = (values.size() + block_keys - 1) / block_keys;
+        std::vector<size_type> blocks_per_level;
+        while (leaf_blocks > 1) {
+            leaf_blocks = (leaf_blocks + block_keys) / (block_keys + 1);
+            blocks_per_level.push_back(leaf_blocks);
+        }
+        levels.clear();
+        size_type offset = 0;
+        for (auto it = blocks_per_level.rbegin(); it != blocks_per_level.rend(); ++it) {
+            levels.push_back({offset, 0});
+            offset += *it;
+        }
+        blocks.assign(offset, block{});
+        // The separator `j` of a block at height `height` above the values is the first key of the leaf block reached
+        // from its child `j + 1` by always going to the first child
+        for (size_type height = 1; height <= levels.size(); ++height) {
+            level& l = levels[levels.size() - height];
+            size_type subtree_blocks = 1;
+            for (size_type i = 1; i < height; ++i) {
+                subtree_blocks *= block_keys + 1;
+            }
+            const size_type slots = blocks_per_level[height - 1] * block_keys;
+            for (; l.size < slots; ++l.size) {
+                const size_type child = l.size / block_keys * (block_keys + 1) + l.size % block_keys + 1;
+                const size_type first_value = child * subtree_blocks * block_keys;
+                if (first_value >= values.size()) {
+                    break;
+                }
+                blocks[l.offset + l.size / block_keys].keys[l.size % block_keys] =
+                    key_extractor_type{}(values[first_value]);
+            }
+        }
+    }
+
+    /**
+     * Find the lower bound of `key` (upper bound if `upper` is set) among the `count` sorted slots at `slots`, whose
+     * keys are obtained by applying `get_key`.
+     */
+    template <bool upper, typename T, typename K, typename GetKey>
+    [[nodiscard]] size_type find_slot(const T* slots, size_type count, const K& key, GetKey get_key) const {
+        if constexpr (std::is_same_v<T, key_type> && std::is_same_v<K, key_type> &&
+                      detail::is_simd_searchable_v<key_type, key_compare_type>) {
+            if constexpr (upper) {
+                return count - detail::count_less<traits_type::simd, true>(slots, count, key);
+            } else {
+                return detail::count_less<traits_type::simd, false>(slots, count, key);
+            }
+        } else if constexpr (upper) {
+            return static_cast<size_type>(
+                std::upper_bound(slots, slots + count, key,
+                                 [&](const K& k, const T& slot) { return key_compare(k, get_key(slot)); }) -
+                slots);
+        } else {
+            return static_cast<size_type>(
+                std::lower_bound(slots, slots + count, key,
+                                 [&](const T& slot, const K& k) { return key_compare(get_key(slot), k); }) -
+                slots);
+        }
+    }
+
+    /**
+     * Descend the inner levels to the block of values holding the lower bound of `key` (upper bound if `upper` is
+     * set), then search it.
+     */
+    template <bool upper, typename K>
+    [[nodiscard]] const_iterator find_value(const K& key) const {
+        const auto identity = [](const key_type& k) -> const key_type& { return k; };
+        size_type index = 0;
+        for (const level& l : levels) {
+            const size_type first = index * block_keys;
+            const size_type count = l.size > first ? std::min(block_keys, l.size - first) : 0;
+            index = index * (block_keys + 1) + find_slot<upper>(blocks[l.offset + index].keys, count, key, identity);
+        }
+        const size_type first = index * block_keys;
+        if (first >= values.size()) {
+            return values.end();
+        }
+        const size_type count = std::min(block_keys, values.size() - first);
+        size_type slot;
+        if constexpr (values_are_keys) {
+            slot = find_slot<upper>(values.data() + first, count, key, identity);
+        } else {
+            slot = find_slot<upper>(values.data() + first, count, key,
+                                    [](const value_type& v) -> decltype(auto) { return key_extractor_type{}(v); });
+        }
+        return values.begin() + static_cast<std::ptrdiff_t>(first + slot);
+    }
+
+    [[no_unique_address]] key_compare_type key_compare;
+    std::vector<value_type, allocator_type> values;
+    std::vector<block, block_allocator> blocks;
+    std::vector<level> levels;
+};
+
+/**
+ * Turn `tree` into an immutable frozen_btree, moving its values out of it.
+ */
+template <typename Key, typename Value, typename KeyExtractor, typename Compare, typename Traits, typename Allocator>
+[[nodiscard]] frozen_btree<Key, Value, KeyExtractor, Compare, Traits, Allocator> freeze(
+    btree<Key, Value, KeyExtractor, Compare, Traits, Allocator>&& tree) {
+    const Allocator alloc = tree.get_allocator();
+    return frozen_btree<Key, Value, KeyExtractor, Compare, Traits, Allocator>(std::move(tree), alloc);
+}
@@ -0,0 +1,595 @@
+#pragma once
+
+#include <bplustree.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define BPLUSTREE_HAS_MMAP
+#endif
+
+namespace detail {
+
+/**
+ * Header stored in the first page of a mapped tree file.
+ *
+ * All offsets are in bytes from the beginning of the file, 0 standing for no node. Fields are stored in the native
+ * byte order, so a file written on a machine of a different endianness is rejected since its magic number does not
+ * match.
+ */
+struct mapped_btree_header {
+    static constexpr std::uint64_t expected_magic = 0x3145455254504230;  // "0BPTREE1" read as little endian
+    static constexpr std::uint32_t expected_version = 1;
+
+    std::uint64_t magic;
+    std::uint32_t version;
+    std::uint32_t page_size;
+    // Layout parameters of the tree that wrote the file, which must match the ones of the view
+    std::uint32_t key_size;
+    std::uint32_t value_size;
+    std::uint32_t leaf_slots;
+    std::uint32_t inner_slots;
+    std::uint32_t leaf_node_size;
+    std::uint32_t inner_node_size;
+    // Number of values, and of levels of nodes (0 for an empty tree)
+    std::uint64_t size;
+    std::uint64_t levels;
+    std::uint64_t root;
+    std::uint64_t head_leaf;
+    std::uint64_t tail_leaf;
+    std::uint64_t file_size;
+    // Checksum of the nodes, i.e. of everything after the first page
+    std::uint64_t checksum;
+};
+
+/**
+ * Inner node of a mapped tree file. Childs are stored as offsets instead of pointers.
+ */
+template <typename Key, std::size_t Slots>
+struct alignas(cache_line_size) mapped_inner_node {
+    std::uint32_t level;
+    std::uint32_t slot_count;
+    std::uint64_t childs[Slots + 1];
+    Key keys[Slots];
+};
+
+/**
+ * Leaf node of a mapped tree file. Sibling leaves are stored as offsets instead of pointers.
+ */
+template <typename Value, std::size_t Slots>
+struct alignas(cache_line_size) mapped_leaf_node {
+    std::uint32_t level;
+    std::uint32_t slot_count;
+    std::uint64_t previous_leaf;
+    std::uint64_t next_leaf;
+    Value values[Slots];
+};
+
+/**
+ * FNV-1a hash of the `size` bytes at `data` processed by words of 8 bytes, continuing from `hash`.
+ * @pre `size` is a multiple of 8
+ */
+[[nodiscard]] inline std::uint64_t mapped_checksum(const std::byte* data,
+                                                   std::size_t size,
+                                                   std::uint64_t hash = 14695981039346656037ull) noexcept {
+    for (std::size_t offset = 0; offset < size; offset += sizeof(std::uint64_t)) {
+        std::uint64_t word;
+        std::memcpy(&word, data + offset, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+    return hash;
+}
+
+/**
+ * Find the slot of the lower bound of `key` (upper bound if `Upper` is set) among the `count` sorted slots at `slots`,
+ * whose keys are obtained by applying `get_key` and ordered by `comp`.
+ *
+ * Up to `linear_threshold` keys of type `Key` eligible to SIMD comparisons are counted with count_less() when `key` is
+ * a `Key` too, other ones use a binary search.
+ */
+template <bool Upper, btree_simd Simd, typename Key, typename T, typename K, typename Compare, typename GetKey>
+[[nodiscard]] std::size_t find_sorted_slot(const T* slots,
+                                           std::size_t count,
+                                           const K& key,
+                                           const Compare& comp,
+                                           GetKey get_key,
+                                           std::size_t linear_threshold) {
+    if constexpr (std::is_same_v<T, Key> && std::is_same_v<K, Key> && is_simd_searchable_v<Key, Compare>) {
+        if (count <= linear_threshold) {
+            if constexpr (Upper) {
+                return count - count_less<Simd, true>(slots, count, key);
+            } else {
+                return count_less<Simd, false>(slots, count, key);
+            }
+        }
+    }
+    if constexpr (Upper) {
+        const T* found = std::upper_bound(slots, slots + count, key,
+                                          [&](const K& k, const T& slot) { return comp(k, get_key(slot)); });
+        return static_cast<std::size_t>(found - slots);
+    } else {
+        const T* found = std::lower_bound(slots, slots + count, key,
+                                          [&](const T& slot, const K& k) { return comp(get_key(slot), k); });
+        return static_cast<std::size_t>(found - slots);
+    }
+}
+
+}  // namespace detail
+
+/**
+ * Read-only view of a tree stored in a file, serving lookups and iterations directly from a memory mapping of the
+ * file.
+ *
+ * The file is produced by `write()` from a `btree` with the same template parameters. Its first page holds a header
+ * describing the layout of the nodes, followed by the nodes themselves where child and sibling pointers are replaced by
+ * offsets. Nothing is deserialized: opening a view only maps the file and checks its header, and nodes are paged in
+ * lazily by the system, their pages being shared by all the processes mapping the same file.
+ *
+ * Since nodes are read in place, keys and values must be trivially copyable and must not hold pointers. The file does
+ * not record the comparison object of the tree, so a view must be given one ordering keys the same way.
+ */
+template <typename Key,
+          typename Value,
+          typename KeyExtractor,
+          typename Compare = std::less<Key>,
+          typename Traits = btree_default_traits<Key, Value>>
+class mapped_btree {
+public:
+    using key_type = Key;
+    using value_type = Value;
+    using key_extractor_type = KeyExtractor;
+    using key_compare_type = Compare;
+    using traits_type = Traits;
+    using size_type = size_t;
+
+    class const_iterator;
+    using iterator = const_iterator;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+    using reverse_iterator = const_reverse_iterator;
+
+    static_assert(std::is_trivially_copyable_v<key_type> && std::is_trivially_copyable_v<value_type>,
+                  "nodes are stored as is in the file, keys and values must be trivially copyable");
+
+    /**
+     * Size in bytes of the header page. Nodes start right after it, so that they are as aligned as the mapping.
+     */
+    static constexpr std::size_t page_size = 4096;
+
+    /**
+     * Write `tree` to the file at `path`, replacing it.
+     *
+     * Nodes are rebuilt from the values of the tree rather than copied, so that they are all completely filled: the
+     * file is read-only, so no room has to be kept for insertions.
+     * @throw std::system_error if the file cannot be written
+     */
+    template <typename Allocator>
+    static void write(const btree<Key, Value, KeyExtractor, Compare, Traits, Allocator>& tree, const std::string& path);
+
+#ifdef BPLUSTREE_HAS_MMAP
+    /**
+     * Map the file at `path`, written by `write()` from a tree ordered by `comp`. The checksum of the nodes is only
+     * verified if `verify_checksum` is set, since it requires to read the whole file. Otherwise lookups still check
+     * that each node they read lies in the file with a valid slot count, but iterations trust the sibling offsets.
+     * @throw std::system_error if the file cannot be mapped
+     * @throw std::runtime_error if the file was not written by a tree of the same type, or is corrupted
+     */
+    explicit mapped_btree(const std::string& path,
+                          bool verify_checksum = false,
+                          const key_compare_type& comp = key_compare_type{})
+        : key_compare(comp) {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "cannot open " + path);
+        }
+        struct stat status {};
+        if (::fstat(fd, &status) != 0) {
+            const int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), "cannot stat " + path);
+        }
+        mapping_size = static_cast<std::size_t>(status.st_size);
+        if (mapping_size < page_size) {
+            ::close(fd);
+            throw std::runtime_error(path + " is not a mapped btree file");
+        }
+        void* address = ::mmap(nullptr, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+        const int error = errno;
+        ::close(fd);
+        if (address == MAP_FAILED) {
+            throw std::system_error(error, std::generic_category(), "cannot map " + path);
+        }
+        mapping = static_cast<const std::byte*>(address);
+        if (const char* problem = check_header(verify_checksum)) {
+            ::munmap(address, mapping_size);
+            throw std::runtime_error(path + ": " + problem);
+        }
+    }
+
+    /**
+     * Take the mapping of `other`, which is left empty.
+     */
+    mapped_btree(mapped_btree&& other) noexcept
+        : key_compare(other.key_compare),
+          mapping(std::exchange(other.mapping, nullptr)),
+          mapping_size(std::exchange(other.mapping_size, 0)) {}
+
+    mapped_btree& operator=(mapped_btree&& other) noexcept {
+        std::swap(key_compare, other.key_compare);
+        std::swap(mapping, other.mapping);
+        std::swap(mapping_size, other.mapping_size);
+        return *this;
+    }
+
+    ~mapped_btree() {
+        if (mapping) {
+            ::munmap(const_cast<std::byte*>(mapping), mapping_size);
+        }
+    }
+#endif
+
+    [[nodiscard]] const_iterator begin() const noexcept { return const_iterator(this, header().head_leaf, 0); }
+    [[nodiscard]] const_iterator cbegin() const noexcept { return begin(); }
+    [[nodiscard]] const_iterator end() const noexcept {
+        const std::uint64_t tail = header().tail_leaf;
+        return const_iterator(this, tail, tail ? leaf_at(tail).slot_count : 0);
+    }
+    [[nodiscard]] const_iterator cend() const noexcept { return end(); }
+
+    [[nodiscard]] const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator(end()); }
+    [[nodiscard]] const_reverse_iterator crbegin() const noexcept { return rbegin(); }
+    [[nodiscard]] const_reverse_iterator rend() const noexcept { return const_reverse_iterator(begin()); }
+    [[nodiscard]] const_reverse_iterator crend() const noexcept { return rend(); }
+
+    [[nodiscard]] size_type size() const noexcept { return static_cast<size_type>(header().size); }
+
+    [[nodiscard]] bool empty() const noexcept { return size() == 0; }
+
+    [[nodiscard]] key_compare_type key_comp() const { return key_compare; }
+
+    [[nodiscard]] const_iterator lower_bound(const key_type& key) const { return find_leaf_slot<false>(key); }
+
+    [[nodiscard]] const_iterator upper_bound(const key_type& key) const { return find_leaf_slot<true>(key); }
+
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    [[nodiscard]] const_iterator lower_bound(const K& key) const {
+        return find_leaf_slot<false>(key);
+    }
+
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    [[nodiscard]] const_iterator upper_bound(const K& key) const {
+        return find_leaf_slot<true>(key);
+    }
+
+BPLUSTREE_PRIVATE:
+    using slot_type = size_type;
+    using header_type = detail::mapped_btree_header;
+    using inner_node_type = detail::mapped_inner_node<key_type, traits_type::inner_slots>;
+    using leaf_node_type = detail::mapped_leaf_node<value_type, traits_type::leaf_slots>;
+
+    static_assert(alignof(inner_node_type) <= page_size && alignof(leaf_node_type) <= page_size,
+                  "nodes must be aligned within a page");
+
+    static constexpr slot_type linear_search_threshold = traits_type::linear_search_threshold;
+
+    /**
+     * Header of the mapped file, or a header without any node for a moved-from view.
+     */
+    [[nodiscard]] const header_type& header() const noexcept {
+        static constexpr header_type empty_header{};
+        return mapping ? *reinterpret_cast<const header_type*>(mapping) : empty_header;
+    }
+
+    /**
+     * Number of nodes of each level of a file holding `count` values, from the leaves up to the root. Nodes are all
+     * completely filled, see write().
+     */
+    [[nodiscard]] static std::vector<std::uint64_t> level_counts_of(std::uint64_t count) {
+        constexpr std::uint64_t leaf_slots = traits_type::leaf_slots;
+        constexpr std::uint64_t inner_childs = traits_type::inner_slots + 1;
+        std::vector<std::uint64_t> level_counts;
+        if (count > 0) {
+            level_counts.push_back((count + leaf_slots - 1) / leaf_slots);
+            while (level_counts.back() > 1) {
+                level_counts.push_back((level_counts.back() + inner_childs - 1) / inner_childs);
+            }
+        }
+        return level_counts;
+    }
+
+    [[nodiscard]] const inner_node_type& inner_at(std::uint64_t offset) const noexcept {
+        return *reinterpret_cast<const inner_node_type*>(mapping + offset);
+    }
+
+    [[nodiscard]] const leaf_node_type& leaf_at(std::uint64_t offset) const noexcept {
+        return *reinterpret_cast<const leaf_node_type*>(mapping + offset);
+    }
+
+    /**
+     * Whether a node of type `Node` at `offset` lies within the nodes of the file, with at most `max_slots` slots.
+     */
+    template <typename Node>
+    [[nodiscard]] bool valid_node(std::uint64_t offset, std::uint32_t max_slots) const noexcept {
+        return offset >= page_size && offset <= mapping_size && mapping_size - offset >= sizeof(Node) &&
+               offset % alignof(Node) == 0 &&
+               reinterpret_cast<const Node*>(mapping + offset)->slot_count <= max_slots;
+    }
+
+    /**
+     * Node of type `Node` at `offset`, reached by a lookup.
+     * @throw std::runtime_error if it does not lie within the nodes of the file or has too many slots
+     */
+    template <typename Node>
+    [[nodiscard]] const Node& checked_node(std::uint64_t offset, std::uint32_t max_slots) const {
+        if (!valid_node<Node>(offset, max_slots)) {
+            throw std::runtime_error("corrupted mapped btree node");
+        }
+        return *reinterpret_cast<const Node*>(mapping + offset);
+    }
+
+    /**
+     * Returns a description of the first inconsistency found in the header, or nullptr if there is none.
+     */
+    [[nodiscard]] const char* check_header(bool verify_checksum) const noexcept {
+        const header_type& h = header();
+        if (h.magic != header_type::expected_magic) {
+            return "not a mapped btree file, or written on a machine of a different endianness";
+        }
+        if (h.version != header_type::expected_version) {
+            return "unsupported file format version";
+        }
+        if (h.page_size != page_size || h.key_size != sizeof(key_type) || h.value_size != sizeof(value_type) ||
+            h.leaf_slots != traits_type::leaf_slots || h.inner_slots != traits_type::inner_slots ||
+            h.leaf_node_size != sizeof(leaf_node_type) || h.inner_node_size != sizeof(inner_node_type)) {
+            return "written by a tree of a different type";
+        }
+        if (h.file_size != mapping_size || (h.size == 0) != (h.root == 0) || h.root >= mapping_size ||
+            h.head_leaf >= mapping_size || h.tail_leaf >= mapping_size) {
+            return "truncated or corrupted file";
+        }
+        // The number of values gives the one of nodes at each level, hence the levels and the size of the file
+        const std::vector<std::uint64_t> level_counts = level_counts_of(h.size);
+        std::uint64_t nodes_size = 0;
+        for (std::size_t level = 0; level < level_counts.size(); ++level) {
+            nodes_size += level_counts[level] * (level == 0 ? sizeof(leaf_node_type) : sizeof(inner_node_type));
+        }
+        if (h.levels != level_counts.size() || h.file_size != page_size + nodes_size) {
+            return "inconsistent number of values, levels and nodes";
+        }
+        // The leaves come first, the root last, see write()
+        if (h.size > 0) {
+            const std::uint64_t root_size = h.levels == 1 ? sizeof(leaf_node_type) : sizeof(inner_node_type);
+            if (h.head_leaf != page_size || h.root != h.file_size - root_size ||
+                h.tail_leaf != page_size + (level_counts.front() - 1) * sizeof(leaf_node_type) ||
+                !valid_node<leaf_node_type>(h.head_leaf, traits_type::leaf_slots) ||
+                !valid_node<leaf_node_type>(h.tail_leaf, traits_type::leaf_slots)) {
+                return "inconsistent node offsets";
+            }
+        }
+        if (verify_checksum &&
+            detail::mapped_checksum(mapping + page_size, mapping_size - page_size) != h.checksum) {
+            return "checksum mismatch";
+        }
+        return nullptr;
+    }
+
+    /**
+     * Find the slot of the lower bound of `key` (upper bound if `upper` is set) among the `count` sorted slots at
+     * `slots`, whose keys are obtained by applying `get_key`, ordered by the comparison object of the view. See
+     * detail::find_sorted_slot().
+     */
+    template <bool upper, typename T, typename K, typename GetKey>
+    [[nodiscard]] slot_type find_slot(const T* slots, slot_type count, const K& key, GetKey get_key) const {
+        return detail::find_sorted_slot<upper, traits_type::simd, key_type>(slots, count, key, key_compare, get_key,
+                                                                            linear_search_threshold);
+    }
+
+    template <bool upper, typename K>
+    [[nodiscard]] const_iterator find_leaf_slot(const K& key) const {
+        const header_type& h = header();
+        if (h.root == 0) {
+            return end();
+        }
+        std::uint64_t offset = h.root;
+        for (std::uint64_t level = h.levels - 1; level > 0; --level) {
+            const auto& inner = checked_node<inner_node_type>(offset, traits_type::inner_slots);
+            offset = inner.childs[find_slot<upper>(inner.keys, inner.slot_count, key,
+                                                   [](const key_type& k) -> const key_type& { return k; })];
+        }
+        const auto& leaf = checked_node<leaf_node_type>(offset, traits_type::leaf_slots);
+        const slot_type slot = find_slot<upper>(leaf.values, leaf.slot_count, key, [](const value_type& v) {
+            return key_extractor_type{}(v);
+        });
+        // Separators are the greatest key of each subtree, so only the tail leaf can be exhausted
+        return const_iterator(this, offset, slot);
+    }
+
+    [[no_unique_address]] key_compare_type key_compare;
+    const std::byte* mapping{};
+    std::size_t mapping_size{};
+};
+
+template <typename Key, typename Value, typename KeyExtractor, typename Compare, typename Traits>
+template <typename Allocator>
+void mapped_btree<Key, Value, KeyExtractor, Compare, Traits>::write(
+    const btree<Key, Value, KeyExtractor, Compare, Traits, Allocator>& tree,
+    const std::string& path) {
+    // Count the nodes of each level, from the leaves up to the root, and the offset of the first node of each level
+    const std::uint64_t count = tree.size();
+    const std::vector<std::uint64_t> level_counts = level_counts_of(count);
+    std::vector<std::uint64_t> level_offsets;
+    std::uint64_t offset = page_size;
+    for (std::size_t level = 0; level < level_counts.size(); ++level) {
+        level_offsets.push_back(offset);
+        offset += level_counts[level] * (level == 0 ? sizeof(leaf_node_type) : sizeof(inner_node_type));
+    }
+
+    header_type h{};
+    h.magic = header_type::expected_magic;
+    h.version = header_type::expected_version;
+    h.page_size = page_size;
+    h.key_size = sizeof(key_type);
+    h.value_size = sizeof(value_type);
+    h.leaf_slots = traits_type::leaf_slots;
+    h.inner_slots = traits_type::inner_slots;
+    h.leaf_node_size = sizeof(leaf_node_type);
+    h.inner_node_size = sizeof(inner_node_type);
+    h.size = count;
+    h.levels = level_counts.size();
+    h.file_size = offset;
+    h.checksum = detail::mapped_checksum(nullptr, 0);
+    if (count > 0) {
+        h.root = level_offsets.back();
+        h.head_leaf = level_offsets.front();
+        h.tail_leaf = level_offsets.front() + (level_counts.front() - 1) * sizeof(leaf_node_type);
+    }
+
+    std::ofstream file;
+    file.exceptions(std::ios::failbit | std::ios::badbit);
+    try {
+        file.open(path, std::ios::binary | std::ios::trunc);
+        const std::vector<char> first_page(page_size);
+        file.write(first_page.data(), static_cast<std::streamsize>(first_page.size()));
+
+        // Greatest key of each node of the level being written, used as separators by the level above
+        std::vector<key_type> greatest_keys;
+        greatest_keys.reserve(level_counts.empty() ? 0 : level_counts.front());
+
+        // Write a node built into `buffer`, then clear the buffer so that padding bytes are always zero
+        std::vector<std::byte> buffer(std::max(sizeof(leaf_node_type), sizeof(inner_node_type)));
+        const auto flush = [&](std::size_t size) {
+            h.checksum = detail::mapped_checksum(buffer.data(), size, h.checksum);
+            file.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(size));
+            std::fill(buffer.begin(), buffer.end(), std::byte{});
+        };
+
+        // Leaves, evenly filled so that the last one is not almost empty
+        auto value = tree.begin();
+        for (std::uint64_t i = 0; i < (level_counts.empty() ? 0 : level_counts.front()); ++i) {
+            auto* leaf = reinterpret_cast<leaf_node_type*>(buffer.data());
+            const std::uint64_t leaves = level_counts.front();
+            const auto slots = static_cast<std::uint32_t>(count / leaves + (i < count % leaves ? 1 : 0));
+            leaf->slot_count = slots;
+            leaf->previous_leaf = i > 0 ? level_offsets.front() + (i - 1) * sizeof(leaf_node_type) : 0;
+            leaf->next_leaf = i + 1 < leaves ? level_offsets.front() + (i + 1) * sizeof(leaf_node_type) : 0;
+            for (std::uint32_t slot = 0; slot < slots; ++slot, ++value) {
+                std::memcpy(static_cast<void*>(&leaf->values[slot]), &*value, sizeof(value_type));
+            }
+            greatest_keys.push_back(key_extractor_type{}(leaf->values[slots - 1]));
+            flush(sizeof(leaf_node_type));
+        }
+
+        // Inner levels, each node using the greatest keys of its childs but the last one as separators
+        for (std::size_t level = 1; level < level_counts.size(); ++level) {
+            const std::uint64_t child_count = level_counts[level - 1];
+            const std::uint64_t inner_count = level_counts[level];
+            std::vector<key_type> upper_keys;
+            upper_keys.reserve(inner_count);
+            std::uint64_t child = 0;
+            for (std::uint64_t i = 0; i < inner_count; ++i) {
+                auto* inner = reinterpret_cast<inner_node_type*>(buffer.data());
+                const auto childs =
+                    static_cast<std::uint32_t>(child_count / inner_count + (i < child_count % inner_count ? 1 : 0));
+                inner->level = static_cast<std::uint32_t>(level);
+                inner->slot_count = childs - 1;
+                const std::size_t child_size = level == 1 ? sizeof(leaf_node_type) : sizeof(inner_node_type);
+                for (std::uint32_t slot = 0; slot < childs; ++slot, ++child) {
+                    inner->childs[slot] = level_offsets[level - 1] + child * child_size;
+                    if (slot + 1 < childs) {
+                        std::memcpy(static_cast<void*>(&inner->keys[slot]), &greatest_keys[child], sizeof(key_type));
+                    }
+                }
+                upper_keys.push_back(greatest_keys[child - 1]);
+                flush(sizeof(inner_node_type));
+            }
+            greatest_keys = std::move(upper_keys);
+        }
+
+        file.seekp(0);
+        file.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        file.close();
+    } catch (const std::ios::failure& failure) {
+        throw std::system_error(failure.code(), "cannot write " + path);
+    }
+}
+
+template <typename Key, typename Value, typename KeyExtractor, typename Compare, typename Traits>
+class mapped_btree<Key, Value, KeyExtractor, Compare, Traits>::const_iterator {
+public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = typename mapped_btree::value_type;
+    using difference_type = std::ptrdiff_t;
+    using reference = const value_type&;
+    using pointer = const value_type*;
+
+    const_iterator() = default;
+
+    reference operator*() const noexcept { return leaf().values[current_slot]; }
+
+    pointer operator->() const noexcept { return &leaf().values[current_slot]; }
+
+    const_iterator& operator++() noexcept {
+        if (++current_slot == leaf().slot_count && leaf().next_leaf != 0) {
+            current_leaf = leaf().next_leaf;
+            current_slot = 0;
+        }
+        return *this;
+    }
+
+    const_iterator operator++(int) noexcept {
+        const_iterator copy = *this;
+        ++*this;
+        return copy;
+    }
+
+    const_iterator& operator--() noexcept {
+        if (current_slot == 0 && leaf().previous_leaf != 0) {
+            current_leaf = leaf().previous_leaf;
+            current_slot = leaf().slot_count;
+        }
+        --current_slot;
+        return *this;
+    }
+
+    const_iterator operator--(int) noexcept {
+        const_iterator copy = *this;
+        --*this;
+        return copy;
+    }
+
+    friend bool operator==(const const_iterator& a, const const_iterator& b) noexcept {
+        return a.current_leaf == b.current_leaf && a.current_slot == b.current_slot;
+    }
+
+    friend bool operator!=(const const_iterator& a, const const_iterator& b) noexcept { return !(a == b); }
+
+private:
+    friend mapped_btree;
+
+    const_iterator(const mapped_btree* owner, std::uint64_t leaf_offset, slot_type slot) noexcept
+        : tree(owner), current_leaf(leaf_offset), current_slot(slot) {}
+
+    [[nodiscard]] const leaf_node_type& leaf() const noexcept { return tree->leaf_at(current_leaf); }
+
+    const mapped_btree* tree{};
+    std::uint64_t current_leaf{};
+    slot_type current_slot{};
+};
@@ -0,0 +1,978 @@
+#pragma once
+
+#include <bplustree.hpp>
+#include <bplustree_mapped.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if __has_include(<unistd.h>)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define BPLUSTREE_HAS_PAGED_FILES
+#endif
+
+/**
+ * Traits of a paged_btree whose nodes each fill a page of `PageBytes` bytes, e.g. 4 KiB or 16 KiB.
+ */
+template <typename Key, typename Value, std::size_t PageBytes = 4096>
+struct btree_page_traits : btree_default_traits<Key, Value> {
+    static_assert(PageBytes % detail::cache_line_size == 0, "nodes are aligned on cache lines within their page");
+
+    static const int page_bytes = static_cast<int>(PageBytes);
+    // Leaves start with their level, slot count and sibling offsets
+    static const int leaf_slots = static_cast<int>((PageBytes - 24) / sizeof(Value));
+    // Inner nodes start with their level and slot count, and have one more child than keys
+    static const int inner_slots = static_cast<int>((PageBytes - 16) / (sizeof(Key) + sizeof(std::uint64_t)));
+    /**
+     * Pages following a leaf in the file read along with it when an iteration moves to it and misses the buffer pool.
+     * Leaves created by appends follow each other in the file, so that scans read them in large batches. Set to 0 to
+     * read one page at a time.
+     */
+    static const int read_ahead_pages = 16;
+};
+
+#ifdef BPLUSTREE_HAS_PAGED_FILES
+
+namespace detail {
+
+/**
+ * Header stored in the first page of a paged tree file. Offsets are in bytes from the beginning of the file, 0 standing
+ * for no page.
+ */
+struct paged_btree_header {
+    static constexpr std::uint64_t expected_magic = 0x3145474150504230;  // "0BPPAGE1" read as little endian
+    static constexpr std::uint32_t expected_version = 1;
+
+    std::uint64_t magic;
+    std::uint32_t version;
+    std::uint32_t page_size;
+    // Layout parameters of the tree that wrote the file, which must match the ones of the tree reading it
+    std::uint32_t key_size;
+    std::uint32_t value_size;
+    std::uint32_t leaf_slots;
+    std::uint32_t inner_slots;
+    // Number of values, and of levels of nodes (0 for an empty tree)
+    std::uint64_t size;
+    std::uint64_t levels;
+    std::uint64_t root;
+    std::uint64_t head_leaf;
+    std::uint64_t tail_leaf;
+    // Number of pages of the file including the header page, and first page of the list of freed pages
+    std::uint64_t page_count;
+    std::uint64_t free_page;
+};
+
+/**
+ * File of fixed-size pages, read and written with positioned I/O.
+ */
+class page_file {
+public:
+    /**
+     * Open the file at `path` for reading and writing, creating it if it does not exist.
+     * @throw std::system_error if the file cannot be opened
+     */
+    explicit page_file(const std::string& path) : fd(::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644)) {
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "cannot open " + path);
+        }
+    }
+
+    page_file(const page_file&) = delete;
+    page_file& operator=(const page_file&) = delete;
+
+    ~page_file() { ::close(fd); }
+
+    [[nodiscard]] std::uint64_t size() const {
+        struct stat status {};
+        if (::fstat(fd, &status) != 0) {
+            throw std::system_error(errno, std::generic_category(), "cannot stat page file");
+        }
+        return static_cast<std::uint64_t>(status.st_size);
+    }
+
+    /**
+     * Read `size` bytes at `offset` into `data`. Bytes past the end of the file, which belong to pages allocated but
+     * not written yet, read as zeros.
+     */
+    void read(std::uint64_t offset, std::byte* data, std::size_t size) const {
+        while (size > 0) {
+            const ::ssize_t n = ::pread(fd, data, size, static_cast<::off_t>(offset));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                throw std::system_error(errno, std::generic_category(), "cannot read page file");
+            }
+            if (n == 0) {
+                std::memset(data, 0, size);
+                return;
+            }
+            data += n;
+            offset += static_cast<std::uint64_t>(n);
+            size -= static_cast<std::size_t>(n);
+        }
+    }
+
+    void write(std::uint64_t offset, const std::byte* data, std::size_t size) {
+        while (size > 0) {
+            const ::ssize_t n = ::pwrite(fd, data, size, static_cast<::off_t>(offset));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0) {
+                throw std::system_error(errno, std::generic_category(), "cannot write page file");
+            }
+            data += n;
+            offset += static_cast<std::uint64_t>(n);
+            size -= static_cast<std::size_t>(n);
+        }
+    }
+
+    void sync() {
+        if (::fsync(fd) != 0) {
+            throw std::system_error(errno, std::generic_category(), "cannot sync page file");
+        }
+    }
+
+private:
+    int fd;
+};
+
+/**
+ * Bounded cache of the pages of a page_file, holding at most `capacity` of them in memory.
+ *
+ * Pages are pinned while they are used, so that they stay in memory. When a page is missing, it replaces an unpinned
+ * one chosen by the CLOCK algorithm: frames are swept in a circle, a frame referenced since the previous sweep being
+ * given another chance. Modified pages are written back when they are evicted or flushed.
+ */
+class buffer_pool {
+public:
+    using frame_id = std::size_t;
+
+    /**
+     * Counters of the page accesses. Pages read ahead are not counted as misses, but the pins that then find them are
+     * counted as hits.
+     */
+    struct counters_type {
+        std::size_t hits{};
+        std::size_t misses{};
+        std::size_t evictions{};
+        // Modified pages written to the file, when evicted or flushed
+        std::size_t writebacks{};
+        std::size_t read_ahead_pages{};
+    };
+
+    buffer_pool(page_file& f, std::size_t page_bytes, std::size_t capacity)
+        : file(&f),
+          page_size(page_bytes),
+          frames(capacity),
+          lines(capacity * page_bytes / cache_line_size),
+          scratch(page_bytes) {
+        page_table.reserve(capacity);
+    }
+
+    buffer_pool(const buffer_pool&) = delete;
+    buffer_pool& operator=(const buffer_pool&) = delete;
+
+    /**
+     * Pin the page at `page`, reading it if it is missing along with up to `read_ahead` pages following it in the
+     * file, which are left unpinned.
+     * @throw std::runtime_error if all the pages in memory are pinned
+     */
+    frame_id pin(std::uint64_t page, std::size_t read_ahead = 0) {
+        if (const auto it = page_table.find(page); it != page_table.end()) {
+            ++counters.hits;
+            frame& f = frames[it->second];
+            ++f.pins;
+            f.referenced = true;
+            return it->second;
+        }
+        ++counters.misses;
+        // Read the page and the uncached pages following it in a single call
+        read_ahead = std::min(read_ahead, frames.size() / 4);
+        std::size_t count = 1;
+        while (count <= read_ahead && !page_table.contains(page + count * page_size)) {
+            ++count;
+        }
+        scratch.resize(count * page_size);
+        file->read(page, scratch.data(), scratch.size());
+        const frame_id pinned = install(page, scratch.data());
+        frames[pinned].pins = 1;
+        frames[pinned].referenced = true;
+        for (std::size_t i = 1; i < count; ++i) {
+            if (!has_victim()) {
+                break;
+            }
+            install(page + i * page_size, scratch.data() + i * page_size);
+            ++counters.read_ahead_pages;
+        }
+        return pinned;
+    }
+
+    /**
+     * Pin the page at `page` filled with zeros, without reading it.
+     */
+    frame_id pin_zeroed(std::uint64_t page) {
+        frame_id id;
+        if (const auto it = page_table.find(page); it != page_table.end()) {
+            id = it->second;
+            std::memset(data(id), 0, page_size);
+        } else {
+            std::memset(scratch.data(), 0, page_size);
+            id = install(page, scratch.data());
+        }
+        frame& f = frames[id];
+        ++f.pins;
+        f.referenced = true;
+        f.dirty = true;
+        return id;
+    }
+
+    void pin_again(frame_id id) noexcept { ++frames[id].pins; }
+
+    void unpin(frame_id id) noexcept {
+        BPLUSTREE_ASSERT(frames[id].pins > 0);
+        --frames[id].pins;
+    }
+
+    void mark_dirty(frame_id id) noexcept { frames[id].dirty = true; }
+
+    [[nodiscard]] std::byte* data(frame_id id) noexcept {
+        return lines[id * page_size / cache_line_size].bytes;
+    }
+    [[nodiscard]] std::uint64_t page(frame_id id) const noexcept { return frames[id].page; }
+
+    /**
+     * Write back all the modified pages, which stay in memory.
+     */
+    void flush() {
+        for (frame_id id = 0; id < frames.size(); ++id) {
+            write_back(id);
+        }
+    }
+
+    [[nodiscard]] const counters_type& get_counters() const noexcept { return counters; }
+    void reset_counters() noexcept { counters = counters_type{}; }
+
+private:
+    struct frame {
+        // Offset of the page held, 0 for none
+        std::uint64_t page{};
+        std::uint32_t pins{};
+        bool dirty{};
+        bool referenced{};
+    };
+
+    // Pages are made of whole cache lines, so that nodes are aligned in memory
+    struct alignas(cache_line_size) cache_line {
+        std::byte bytes[cache_line_size];
+    };
+
+    void write_back(frame_id id) {
+        frame& f = frames[id];
+        if (f.page != 0 && f.dirty) {
+            file->write(f.page, data(id), page_size);
+            f.dirty = false;
+            ++counters.writebacks;
+        }
+    }
+
+    [[nodiscard]] bool has_victim() const noexcept {
+        return std::any_of(frames.begin(), frames.end(), [](const frame& f) { return f.pins == 0; });
+    }
+
+    /**
+     * Free an unpinned frame, writing back its page if it was modified.
+     */
+    frame_id evict() {
+        // Two sweeps clear the reference bits of all the unpinned frames
+        for (std::size_t swept = 0; swept < 2 * frames.size(); ++swept) {
+            const frame_id id = std::exchange(hand, (hand + 1) % frames.size());
+            frame& f = frames[id];
+            if (f.pins > 0) {
+                continue;
+            }
+            if (f.referenced) {
+                f.referenced = false;
+                continue;
+            }
+            if (f.page != 0) {
+                write_back(id);
+                page_table.erase(f.page);
+                f.page = 0;
+                ++counters.evictions;
+            }
+            return id;
+        }
+        throw std::runtime_error("buffer pool exhausted: all its pages are pinned");
+    }
+
+    /**
+     * Copy the page at `page` read into `bytes` to a free frame, unpinned and not referenced yet.
+     */
+    frame_id install(std::uint64_t page, const std::byte* bytes) {
+        const frame_id id = evict();
+        std::memcpy(data(id), bytes, page_size);
+        frames[id] = frame{page, 0, false, false};
+        page_table.emplace(page, id);
+        return id;
+    }
+
+    page_file* file;
+    std::size_t page_size;
+    std::vector<frame> frames;
+    std::vector<cache_line> lines;
+    std::unordered_map<std::uint64_t, frame_id> page_table;
+    frame_id hand{};
+    std::vector<std::byte> scratch;
+    counters_type counters;
+};
+
+/**
+ * Pin of a page of a buffer_pool, released when destroyed. Copies pin the page again.
+ */
+class pinned_page {
+public:
+    pinned_page() noexcept = default;
+    /**
+     * No page of `p`, which end iterators hold so that their pool is never null.
+     */
+    explicit pinned_page(buffer_pool& p) noexcept : pool(&p) {}
+    pinned_page(buffer_pool& p, buffer_pool::frame_id f) noexcept : pool(&p), frame(f) {}
+
+    pinned_page(const pinned_page& other) noexcept : pool(other.pool), frame(other.frame) {
+        if (*this) {
+            pool->pin_again(frame);
+        }
+    }
+    pinned_page(pinned_page&& other) noexcept : pool(other.pool), frame(std::exchange(other.frame, no_frame)) {}
+
+    pinned_page& operator=(pinned_page other) noexcept {
+        std::swap(pool, other.pool);
+        std::swap(frame, other.frame);
+        return *this;
+    }
+
+    ~pinned_page() {
+        if (*this) {
+            pool->unpin(frame);
+        }
+    }
+
+    [[nodiscard]] explicit operator bool() const noexcept { return frame != no_frame; }
+
+    /**
+     * Offset of the page in the file, 0 for no page.
+     */
+    [[nodiscard]] std::uint64_t page() const noexcept { return *this ? pool->page(frame) : 0; }
+
+    template <typename Node>
+    [[nodiscard]] Node& as() const noexcept {
+        return *reinterpret_cast<Node*>(pool->data(frame));
+    }
+
+    void mark_dirty() const noexcept { pool->mark_dirty(frame); }
+
+private:
+    static constexpr buffer_pool::frame_id no_frame = std::numeric_limits<buffer_pool::frame_id>::max();
+
+    buffer_pool* pool{};
+    buffer_pool::frame_id frame = no_frame;
+};
+
+}  // namespace detail
+
+/**
+ * Tree whose nodes are pages of a file, for indexes larger than the memory. Only the pages held by a bounded buffer
+ * pool are in memory at any time.
+ *
+ * Nodes use the layouts of the mapped tree files (see `mapped_btree`), their childs and siblings being designated by
+ * the offsets of their pages, and fill a page of `Traits::page_bytes` bytes (see `btree_page_traits`). The first page
+ * of the file holds a header pointing to the root and to the ends of the chain of leaves. Pages are pinned in the
+ * buffer pool while they are used: iterators keep the page of their leaf pinned. Modifications are written to the file
+ * when their pages are evicted, or by flush(), which also writes the header. Leaves emptied by erasures are freed and
+ * their pages reused, but underflowing nodes are not merged.
+ *
+ * Since nodes are read in place, keys and values must be trivially copyable and must not hold pointers.
+ */
+template <typename Key,
+          typename Value,
+          typename KeyExtractor,
+          typename Compare = std::less<Key>,
+          typename Traits = btree_page_traits<Key, Value>>
+class paged_btree {
+public:
+    using key_type = Key;
+    using value_type = Value;
+    using key_extractor_type = KeyExtractor;
+    using key_compare_type = Compare;
+    using traits_type = Traits;
+    using size_type = std::size_t;
+    using counters_type = detail::buffer_pool::counters_type;
+
+    class const_iterator;
+    using iterator = const_iterator;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+    using reverse_iterator = const_reverse_iterator;
+
+    static_assert(std::is_trivially_copyable_v<key_type> && std::is_trivially_copyable_v<value_type>,
+                  "nodes are stored as is in the file, keys and values must be trivially copyable");
+
+    static constexpr std::size_t page_size = static_cast<std::size_t>(traits_type::page_bytes);
+
+    /**
+     * Open the tree stored in the file at `path`, or create an empty one if the file does not exist, with a buffer
+     * pool of `pool_pages` pages.
+     * @pre `pool_pages >= 8`, pages being pinned along the path of a modification
+     * @throw std::system_error if the file cannot be opened or read
+     * @throw std::runtime_error if the file was not written by a paged tree of the same type
+     */
+    explicit paged_btree(const std::string& path,
+                         size_type pool_pages = 1024,
+                         const key_compare_type& comp = key_compare_type{})
+        : key_compare(comp), file(path), pool(file, page_size, pool_pages) {
+        BPLUSTREE_ASSERT(pool_pages >= 8);
+        if (file.size() == 0) {
+            header.magic = header_type::expected_magic;
+            header.version = header_type::expected_version;
+            header.page_size = static_cast<std::uint32_t>(page_size);
+            header.key_size = static_cast<std::uint32_t>(sizeof(key_type));
+            header.value_size = static_cast<std::uint32_t>(sizeof(value_type));
+            header.leaf_slots = static_cast<std::uint32_t>(leaf_slots_max);
+            header.inner_slots = static_cast<std::uint32_t>(inner_slots_max);
+            header.page_count = 1;
+            return;
+        }
+        file.read(0, reinterpret_cast<std::byte*>(&header), sizeof(header));
+        if (header.magic != header_type::expected_magic) {
+            throw std::runtime_error(path +
+                                     ": not a paged btree file, or written on a machine of a different endianness");
+        }
+        if (header.version != header_type::expected_version) {
+            throw std::runtime_error(path + ": unsupported file format version");
+        }
+        if (header.page_size != page_size || header.key_size != sizeof(key_type) ||
+            header.value_size != sizeof(value_type) || header.leaf_slots != leaf_slots_max ||
+            header.inner_slots != inner_slots_max) {
+            throw std::runtime_error(path + ": written by a tree of a different type");
+        }
+    }
+
+    paged_btree(const paged_btree&) = delete;
+    paged_btree& operator=(const paged_btree&) = delete;
+
+    /**
+     * Flush the tree, ignoring errors: call flush() first to be notified of them.
+     */
+    ~paged_btree() {
+        try {
+            flush();
+        } catch (...) {
+        }
+    }
+
+    [[nodiscard]] const_iterator begin() const {
+        return header.head_leaf ? const_iterator(this, pin(header.head_leaf), 0) : end();
+    }
+    [[nodiscard]] const_iterator cbegin() const { return begin(); }
+    [[nodiscard]] const_iterator end() const noexcept { return const_iterator(this, detail::pinned_page(pool), 0); }
+    [[nodiscard]] const_iterator cend() const noexcept { return end(); }
+
+    [[nodiscard]] const_reverse_iterator rbegin() const noexcept { return const_reverse_iterator(end()); }
+    [[nodiscard]] const_reverse_iterator crbegin() const noexcept { return rbegin(); }
+    [[nodiscard]] const_reverse_iterator rend() const { return const_reverse_iterator(begin()); }
+    [[nodiscard]] const_reverse_iterator crend() const { return rend(); }
+
+    [[nodiscard]] size_type size() const noexcept { return static_cast<size_type>(header.size); }
+    [[nodiscard]] bool empty() const noexcept { return header.size == 0; }
+
+    [[nodiscard]] key_compare_type key_comp() const { return key_compare; }
+
+    [[nodiscard]] const_iterator lower_bound(const key_type& key) const { return find_leaf_slot<false>(key); }
+    [[nodiscard]] const_iterator upper_bound(const key_type& key) const { return find_leaf_slot<true>(key); }
+
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    [[nodiscard]] const_iterator lower_bound(const K& key) const {
+        return find_leaf_slot<false>(key);
+    }
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    [[nodiscard]] const_iterator upper_bound(const K& key) const {
+        return find_leaf_slot<true>(key);
+    }
+
+    /**
+     * Insert `value` after the values with an equivalent key, and return an iterator to it.
+     *
+     * A full leaf is split, along with its full ancestors. Appending at the end of the tail leaf leaves it full and
+     * starts a new leaf instead, so that values inserted in order fill their pages.
+     */
+    iterator insert(const value_type& value);
+
+    /**
+     * Remove the values whose key is equivalent to `key`, and return how many were removed.
+     */
+    size_type erase(const key_type& key) {
+        size_type erased = 0;
+        while (erase_one(key)) {
+            ++erased;
+        }
+        return erased;
+    }
+
+    /**
+     * Write the modified pages and the header to the file, then wait for the file to reach the storage.
+     * @throw std::system_error if the file cannot be written
+     */
+    void flush() {
+        pool.flush();
+        file.write(0, reinterpret_cast<const std::byte*>(&header), sizeof(header));
+        file.sync();
+    }
+
+    /**
+     * Counters of the buffer pool: page hits and misses, evictions, write-backs and pages read ahead.
+     */
+    [[nodiscard]] counters_type get_counters() const noexcept { return pool.get_counters(); }
+    void reset_counters() noexcept { pool.reset_counters(); }
+
+BPLUSTREE_PRIVATE:
+    using slot_type = size_type;
+    using header_type = detail::paged_btree_header;
+    using inner_node_type = detail::mapped_inner_node<key_type, traits_type::inner_slots>;
+    using leaf_node_type = detail::mapped_leaf_node<value_type, traits_type::leaf_slots>;
+    // Inner nodes from the root to a leaf, along with the slot of the child taken in each
+    using path_type = std::vector<std::pair<std::uint64_t, slot_type>>;
+
+    static constexpr slot_type leaf_slots_max = traits_type::leaf_slots;
+    static constexpr slot_type inner_slots_max = traits_type::inner_slots;
+    static constexpr slot_type linear_search_threshold = traits_type::linear_search_threshold;
+
+    static_assert(sizeof(inner_node_type) <= page_size && sizeof(leaf_node_type) <= page_size,
+                  "nodes must fit in a page");
+
+    [[nodiscard]] detail::pinned_page pin(std::uint64_t page, size_type read_ahead = 0) const {
+        return detail::pinned_page(pool, pool.pin(page, read_ahead));
+    }
+
+    /**
+     * Pin the leaf at `page` reached by an iteration, reading the pages following it along with it if it is missing.
+     */
+    [[nodiscard]] detail::pinned_page pin_next_leaf(std::uint64_t page) const {
+        const std::uint64_t following = header.page_count - page / page_size - 1;
+        return pin(page, std::min<std::uint64_t>(traits_type::read_ahead_pages, following));
+    }
+
+    /**
+     * Pin a free page filled with zeros, reusing a freed page if there is one.
+     */
+    [[nodiscard]] detail::pinned_page allocate_page() {
+        std::uint64_t page = header.free_page;
+        if (page != 0) {
+            const detail::pinned_page freed = pin(page);
+            std::memcpy(&header.free_page, &freed.template as<std::byte>(), sizeof(header.free_page));
+        } else {
+            page = header.page_count++ * page_size;
+        }
+        return detail::pinned_page(pool, pool.pin_zeroed(page));
+    }
+
+    /**
+     * Add the page at `page` to the list of freed pages.
+     */
+    void free_page(std::uint64_t page) {
+        const detail::pinned_page freed(pool, pool.pin_zeroed(page));
+        std::memcpy(&freed.template as<std::byte>(), &header.free_page, sizeof(header.free_page));
+        header.free_page = page;
+    }
+
+    /**
+     * Find the slot of the lower bound of `key` (upper bound if `upper` is set) among the `count` sorted slots at
+     * `slots`, whose keys are obtained by applying `get_key`, ordered by the comparison object of the tree. See
+     * detail::find_sorted_slot().
+     */
+    template <bool upper, typename T, typename K, typename GetKey>
+    [[nodiscard]] slot_type find_slot(const T* slots, slot_type count, const K& key, GetKey get_key) const {
+        return detail::find_sorted_slot<upper, traits_type::simd, key_type>(slots, count, key, key_compare, get_key,
+                                                                            linear_search_threshold);
+    }
+
+    template <bool upper, typename K>
+    [[nodiscard]] slot_type find_slot_in_inner(const inner_node_type& inner, const K& key) const {
+        return find_slot<upper>(inner.keys, inner.slot_count, key, [](const key_type& k) -> const key_type& {
+            return k;
+        });
+    }
+
+    template <bool upper, typename K>
+    [[nodiscard]] slot_type find_slot_in_leaf(const leaf_node_type& leaf, const K& key) const {
+        return find_slot<upper>(leaf.values, leaf.slot_count, key, [](const value_type& v) -> decltype(auto) {
+            return key_extractor_type{}(v);
+        });
+    }
+
+    /**
+     * Descend from the root to the leaf holding the lower bound of `key` (upper bound if `upper` is set), storing the
+     * path to it in `path` if given. A separator is the greatest key of the subtree on its left, or was until values
+     * were erased.
+     */
+    template <bool upper, typename K>
+    [[nodiscard]] detail::pinned_page find_leaf(const K& key, path_type* path = nullptr) const {
+        std::uint64_t page = header.root;
+        for (std::uint64_t level = header.levels - 1; level > 0; --level) {
+            const detail::pinned_page node = pin(page);
+            const auto& inner = node.template as<inner_node_type>();
+            const slot_type slot = find_slot_in_inner<upper>(inner, key);
+            if (path) {
+                path->emplace_back(page, slot);
+            }
+            page = inner.childs[slot];
+        }
+        return pin(page);
+    }
+
+    template <bool upper, typename K>
+    [[nodiscard]] const_iterator find_leaf_slot(const K& key) const {
+        if (header.root == 0) {
+            return end();
+        }
+        detail::pinned_page leaf = find_leaf<upper>(key);
+        const auto& node = leaf.template as<leaf_node_type>();
+        const slot_type slot = find_slot_in_leaf<upper>(node, key);
+        // Past the last value of the leaf when `key` falls between it and the separator after the leaf
+        if (slot == node.slot_count) {
+            return node.next_leaf ? const_iterator(this, pin(node.next_leaf), 0) : end();
+        }
+        return const_iterator(this, std::move(leaf), slot);
+    }
+
+    /**
+     * Move `path` to the leaf following the one it leads to.
+     * @pre the leaf `path` leads to is not the tail leaf
+     */
+    void next_leaf_path(path_type& path) const {
+        while (path.back().second == pin(path.back().first).template as<inner_node_type>().slot_count) {
+            path.pop_back();
+        }
+        ++path.back().second;
+        while (path.size() + 1 < header.levels) {
+            const detail::pinned_page parent = pin(path.back().first);
+            path.emplace_back(parent.template as<inner_node_type>().childs[path.back().second], 0);
+        }
+    }
+
+    /**
+     * Insert the separator `separator` and the child `child` after it in the inner node at the end of `path`, splitting
+     * full nodes up to the root.
+     */
+    void insert_in_parent(path_type& path, key_type separator, std::uint64_t child);
+
+    /**
+     * Remove one value whose key is equivalent to `key`, if any.
+     */
+    bool erase_one(const key_type& key);
+
+    /**
+     * Free the empty leaf at `page`, at the end of `path`, removing it from its ancestors.
+     */
+    void remove_leaf(path_type& path, std::uint64_t page);
+
+    [[no_unique_address]] key_compare_type key_compare;
+    header_type header{};
+    detail::page_file file;
+    mutable detail::buffer_pool pool;
+};
+
+template <typename Key, typename Value, typename KeyExtractor, typename Compare, typename Traits>
+auto paged_btree<Key, Value, KeyExtractor, Compare, Traits>::insert(const value_type& value) -> iterator {
+    ++header.size;
+    if (header.root == 0) {
+        detail::pinned_page leaf = allocate_page();
+        auto& node = leaf.template as<leaf_node_type>();
+        std::memcpy(static_cast<void*>(&node.values[0]), &value, sizeof(value_type));
+        node.slot_count = 1;
+        header.root = header.head_leaf = header.tail_leaf = leaf.page();
+        header.levels = 1;
+        return const_iterator(this, std::move(leaf), 0);
+    }
+    const key_type& key = key_extractor_type{}(value);
+    path_type path;
+    detail::pinned_page leaf = find_leaf<true>(key, &path);
+    auto& node = leaf.template as<leaf_node_type>();
+    const slot_type slot = find_slot_in_leaf<true>(node, key);
+    leaf.mark_dirty();
+    if (node.slot_count < leaf_slots_max) {
+        std::memmove(static_cast<void*>(&node.values[slot + 1]), &node.values[slot],
+                     (node.slot_count - slot) * sizeof(value_type));
+        std::memcpy(static_cast<void*>(&node.values[slot]), &value, sizeof(value_type));
+        ++node.slot_count;
+        return const_iterator(this, std::move(leaf), slot);
+    }
+
+    // Split the leaf, the values from `left_count` on moving to a new leaf on its right
+    const bool appending = leaf.page() == header.tail_leaf && slot == node.slot_count;
+    const slot_type left_count = appending ? leaf_slots_max : (leaf_slots_max + 1) / 2;
+    std::vector<value_type> values(node.values, node.values + node.slot_count);
+    values.insert(values.begin() + static_cast<std::ptrdiff_t>(slot), value);
+    detail::pinned_page right = allocate_page();
+    auto& right_node = right.template as<leaf_node_type>();
+    std::memcpy(static_cast<void*>(node.values), values.data(), left_count * sizeof(value_type));
+    std::memcpy(static_cast<void*>(right_node.values), values.data() + left_count,
+                (values.size() - left_count) * sizeof(value_type));
+    node.slot_count = static_cast<std::uint32_t>(left_count);
+    right_node.slot_count = static_cast<std::uint32_t>(values.size() - left_count);
+
+    right_node.previous_leaf = leaf.page();
+    right_node.next_leaf = node.next_leaf;
+    if (node.next_leaf) {
+        const detail::pinned_page next = pin(node.next_leaf);
+        next.template as<leaf_node_type>().previous_leaf = right.page();
+        next.mark_dirty();
+    } else {
+        header.tail_leaf = right.page();
+    }
+    node.next_leaf = right.page();
+
+    const std::uint64_t right_page = right.page();
+    const_iterator result = slot < left_count ? const_iterator(this, std::move(leaf), slot)
+                                              : const_iterator(this, std::move(right), slot - left_count);
+    insert_in_parent(path, key_extractor_type{}(values[left_count - 1]), right_page);
+    return result;
+}
+
+template <typename Key, typename Value, typename KeyExtractor, typename Compare, typename Traits>
+void paged_btree<Key, Value, KeyExtractor, Compare, Traits>::insert_in_parent(path_type& path,
+                                                                             key_type separator,
+                                                                             std::uint64_t child) {
+    while (!path.empty()) {
+        const auto [page, slot] = path.back();
+        path.pop_back();
+        const detail::pinned_page parent = pin(page);
+        auto& inner = parent.template as<inner_node_type>();
+        parent.mark_dirty();
+        if (inner.slot_count < inner_slots_max) {
+            std::memmove(static_cast<void*>(&inner.keys[slot + 1]), &inner.keys[slot],
+                         (inner.slot_count - slot) * sizeof(key_type));
+            std::memmove(&inner.childs[slot + 2], &inner.childs[slot + 1],
+                         (inner.slot_count - slot) * sizeof(std::uint64_t));
+            std::memcpy(static_cast<void*>(&inner.keys[slot]), &separator, sizeof(key_type));
+            inner.childs[slot + 1] = child;
+            ++inner.slot_count;
+            return;
+        }
+        // Split the inner node, its middle key moving up as the separator between both halves
+        std::vector<key_type> keys(inner.keys, inner.keys + inner.slot_count);
+        std::vector<std::uint64_t> childs(inner.childs, inner.childs + inner.slot_count + 1);
+        keys.insert(keys.begin() + static_cast<std::ptrdiff_t>(slot), separator);
+        childs.insert(childs.begin() + static_cast<std::ptrdiff_t>(slot) + 1, child);
+        const slot_type middle = keys.size() / 2;
+        const detail::pinned_page right = allocate_page();
+        auto& right_inner = right.template as<inner_node_type>();
+        right_inner.level = inner.level;
+        inner.slot_count = static_cast<std::uint32_t>(middle);
+        right_inner.slot_count = static_cast<std::uint32_t>(keys.size() - middle - 1);
+        std::memcpy(static_cast<void*>(inner.keys), keys.data(), middle * sizeof(key_type));
+        std::memcpy(inner.childs, childs.data(), (middle + 1) * sizeof(std::uint64_t));
+        std::memcpy(static_cast<void*>(right_inner.keys), keys.data() + middle + 1,
+                    right_inner.slot_count * sizeof(key_type));
+        std::memcpy(right_inner.childs, childs.data() + middle + 1,
+                    (right_inner.slot_count + 1) * sizeof(std::uint64_t));
+        separator = keys[middle];
+        child = right.page();
+    }
+    // The root was split: grow a new root above both halves
+    const detail::pinned_page root = allocate_page();
+    auto& inner = root.template as<inner_node_type>();
+    inner.level = static_cast<std::uint32_t>(header.levels);
+    inner.slot_count = 1;
+    std::memcpy(static_cast<void*>(&inner.keys[0]), &separator, sizeof(key_type));
+    inner.childs[0] = header.root;
+    inner.childs[1] = child;
+    header.root = root.page();
+    ++header.levels;
+}
+
+template <typename Key, typename Value, typename KeyExtractor, typename Compare, typename Traits>
+bool paged_btree<Key, Value, KeyExtractor, Compare, Traits>::erase_one(const key_type& key) {
+    if (header.root == 0) {
+        return false;
+    }
+    path_type path;
+    detail::pinned_page leaf = find_leaf<false>(key, &path);
+    slot_type slot = find_slot_in_leaf<false>(leaf.template as<leaf_node_type>(), key);
+    if (slot == leaf.template as<leaf_node_type>().slot_count) {
+        const std::uint64_t next = leaf.template as<leaf_node_type>().next_leaf;
+        if (next == 0) {
+            return false;
+        }
+        next_leaf_path(path);
+        leaf = pin(next);
+        slot = 0;
+    }
+    auto& node = leaf.template as<leaf_node_type>();
+    if (key_compare(key, key_extractor_type{}(node.values[slot]))) {
+        return false;
+    }
+    std::memmove(static_cast<void*>(&node.values[slot]), &node.values[slot + 1],
+                 (node.slot_count - slot - 1) * sizeof(value_type));
+    --node.slot_count;
+    --header.size;
+    leaf.mark_dirty();
+    if (node.slot_count == 0) {
+        const std::uint64_t page = leaf.page();
+        leaf = {};
+        remove_leaf(path, page);
+    }
+    return true;
+}
+
+template <typename Key, typename Value, typename KeyExtractor, typename Compare, typename Traits>
+void paged_btree<Key, Value, KeyExtractor, Compare, Traits>::remove_leaf(path_type& path, std::uint64_t page) {
+    std::uint64_t previous, next;
+    {
+        const detail::pinned_page leaf = pin(page);
+        previous = leaf.template as<leaf_node_type>().previous_leaf;
+        next = leaf.template as<leaf_node_type>().next_leaf;
+    }
+    if (previous) {
+        const detail::pinned_page left = pin(previous);
+        left.template as<leaf_node_type>().next_leaf = next;
+        left.mark_dirty();
+    } else {
+        header.head_leaf = next;
+    }
+    if (next) {
+        const detail::pinned_page right = pin(next);
+        right.template as<leaf_node_type>().previous_leaf = previous;
+        right.mark_dirty();
+    } else {
+        header.tail_leaf = previous;
+    }
+    free_page(page);
+
+    // Remove the leaf from its parent, along with the ancestors left without child
+    while (true) {
+        if (path.empty()) {
+            header.root = 0;
+            header.levels = 0;
+            return;
+        }
+        const auto [parent_page, slot] = path.back();
+        path.pop_back();
+        const detail::pinned_page parent = pin(parent_page);
+        auto& inner = parent.template as<inner_node_type>();
+        if (inner.slot_count == 0) {
+            free_page(parent_page);
+            continue;
+        }
+        // The keys of the removed child are now routed to one of its siblings
+        const slot_type key_slot = slot > 0 ? slot - 1 : 0;
+        std::memmove(static_cast<void*>(&inner.keys[key_slot]), &inner.keys[key_slot + 1],
+                     (inner.slot_count - key_slot - 1) * sizeof(key_type));
+        std::memmove(&inner.childs[slot], &inner.childs[slot + 1], (inner.slot_count - slot) * sizeof(std::uint64_t));
+        --inner.slot_count;
+        parent.mark_dirty();
+        break;
+    }
+    // Replace the root by its only child as long as it has a single one
+    while (header.levels > 1) {
+        const std::uint64_t root_page = header.root;
+        {
+            const detail::pinned_page root = pin(root_page);
+            const auto& inner = root.template as<inner_node_type>();
+            if (inner.slot_count > 0) {
+                return;
+            }
+            header.root = inner.childs[0];
+        }
+        free_page(root_page);
+        --header.levels;
+    }
+}
+
+template <typename Key, typename Value, typename KeyExtractor, typename Compare, typename Traits>
+class paged_btree<Key, Value, KeyExtractor, Compare, Traits>::const_iterator {
+public:
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = typename paged_btree::value_type;
+    using difference_type = std::ptrdiff_t;
+    using reference = const value_type&;
+    using pointer = const value_type*;
+
+    const_iterator() = default;
+
+    reference operator*() const noexcept { return leaf().values[current_slot]; }
+    pointer operator->() const noexcept { return &leaf().values[current_slot]; }
+
+    const_iterator& operator++() {
+        if (++current_slot == leaf().slot_count) {
+            const std::uint64_t next = leaf().next_leaf;
+            current_page = next ? tree->pin_next_leaf(next) : detail::pinned_page(tree->pool);
+            current_slot = 0;
+        }
+        return *this;
+    }
+
+    const_iterator operator++(int) {
+        const_iterator copy = *this;
+        ++*this;
+        return copy;
+    }
+
+    const_iterator& operator--() {
+        if (!current_page) {
+            current_page = tree->pin(tree->header.tail_leaf);
+            current_slot = leaf().slot_count;
+        } else if (current_slot == 0) {
+            current_page = tree->pin(leaf().previous_leaf);
+            current_slot = leaf().slot_count;
+        }
+        --current_slot;
+        return *this;
+    }
+
+    const_iterator operator--(int) {
+        const_iterator copy = *this;
+        --*this;
+        return copy;
+    }
+
+    friend bool operator==(const const_iterator& a, const const_iterator& b) noexcept {
+        return a.current_page.page() == b.current_page.page() && a.current_slot == b.current_slot;
+    }
+
+    friend bool operator!=(const const_iterator& a, const const_iterator& b) noexcept { return !(a == b); }
+
+private:
+    friend paged_btree;
+
+    const_iterator(const paged_btree* owner, detail::pinned_page page, slot_type slot) noexcept
+        : tree(owner), current_page(std::move(page)), current_slot(slot) {}
+
+    [[nodiscard]] const leaf_node_type& leaf() const noexcept {
+        return current_page.template as<const leaf_node_type>();
+    }
+
+    const paged_btree* tree{};
+    // Page of the current leaf, kept pinned; none for end()
+    detail::pinned_page current_page;
+    slot_type current_slot{};
+};
+
+#endif
@@ -0,0 +1,350 @@
+#pragma once
+
+#include <bplustree.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Executors run the subranges of the parallel algorithms below. An executor provides:
+ *   - `std::size_t concurrency() const`: the number of tasks it runs at once,
+ *   - `void bulk(std::size_t count, Task&& task)`: call `task(i)` for each i in [0, count), possibly from several
+ *     threads at once, and return once all the calls returned, rethrowing the first exception thrown by one of them.
+ */
+
+/**
+ * Fixed-size pool of threads running bulk jobs with work stealing.
+ *
+ * The tasks of a job are dealt in contiguous blocks to one queue per thread, the calling thread included. Each thread
+ * takes the tasks from the front of its own queue, then steals from the back of the other queues once it is empty, so
+ * that threads finishing early take over the work of the slower ones.
+ *
+ * Jobs are run one at a time: a task must not submit a job to the pool running it.
+ */
+class btree_thread_pool {
+public:
+    /**
+     * Start `threads - 1` worker threads, the thread submitting a job being the last one.
+     */
+    explicit btree_thread_pool(std::size_t threads = std::thread::hardware_concurrency())
+        : queues(std::max<std::size_t>(threads, 1)) {
+        workers.reserve(queues.size() - 1);
+        for (std::size_t index = 0; index + 1 < queues.size(); ++index) {
+            workers.emplace_back([this, index] { work(index); });
+        }
+    }
+
+    btree_thread_pool(const btree_thread_pool&) = delete;
+    btree_thread_pool& operator=(const btree_thread_pool&) = delete;
+
+    ~btree_thread_pool() {
+        {
+            std::lock_guard lock(state_mutex);
+            stopping = true;
+        }
+        job_started.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    [[nodiscard]] std::size_t concurrency() const noexcept { return queues.size(); }
+
+    template <typename Task>
+    void bulk(std::size_t count, Task&& task) {
+        if (count == 0) {
+            return;
+        }
+        std::lock_guard job_lock(job_mutex);
+        const std::function<void(std::size_t)> function = std::ref(task);
+        job = &function;
+        remaining.store(count, std::memory_order_relaxed);
+        for (std::size_t index = 0; index < queues.size(); ++index) {
+            std::lock_guard lock(queues[index].mutex);
+            for (std::size_t i = index * count / queues.size(); i < (index + 1) * count / queues.size(); ++i) {
+                queues[index].tasks.push_back(i);
+            }
+        }
+        {
+            std::lock_guard lock(state_mutex);
+            ++generation;
+        }
+        job_started.notify_all();
+        run_tasks(queues.size() - 1);
+
+        std::unique_lock lock(state_mutex);
+        job_done.wait(lock, [this] { return remaining.load(std::memory_order_acquire) == 0; });
+        job = nullptr;
+        if (error) {
+            std::rethrow_exception(std::exchange(error, nullptr));
+        }
+    }
+
+private:
+    struct queue {
+        std::mutex mutex;
+        std::deque<std::size_t> tasks;
+    };
+
+    void work(std::size_t index) {
+        std::uint64_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock lock(state_mutex);
+                job_started.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) {
+                    return;
+                }
+                seen = generation;
+            }
+            run_tasks(index);
+        }
+    }
+
+    /**
+     * Take the next task, from the front of the queue `index` or else from the back of another queue.
+     */
+    [[nodiscard]] std::optional<std::size_t> take_task(std::size_t index) {
+        for (std::size_t offset = 0; offset < queues.size(); ++offset) {
+            auto& victim = queues[(index + offset) % queues.size()];
+            std::lock_guard lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                std::size_t task;
+                if (offset == 0) {
+                    task = victim.tasks.front();
+                    victim.tasks.pop_front();
+                } else {
+                    task = victim.tasks.back();
+                    victim.tasks.pop_back();
+                }
+                return task;
+            }
+        }
+        return std::nullopt;
+    }
+
+    void run_tasks(std::size_t index) {
+        while (const auto task = take_task(index)) {
+            try {
+                (*job)(*task);
+            } catch (...) {
+                std::lock_guard lock(state_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+            if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard lock(state_mutex);
+                job_done.notify_all();
+            }
+        }
+    }
+
+    std::vector<queue> queues;
+    std::vector<std::thread> workers;
+    // Serializes the jobs
+    std::mutex job_mutex;
+    // Set before the tasks of a job are queued, so a thread that took one of them sees the job
+    const std::function<void(std::size_t)>* job{};
+    std::atomic<std::size_t> remaining{};
+    std::mutex state_mutex;
+    std::condition_variable job_started;
+    std::condition_variable job_done;
+    std::uint64_t generation{};
+    bool stopping{};
+    std::exception_ptr error;
+};
+
+/**
+ * Executor running the tasks of a job through a standard execution policy, such as `std::execution::par`.
+ * @note <execution> is not included here, since some standard libraries require linking with a threading library as
+ * soon as it is included: include it to use this executor.
+ */
+template <typename Policy>
+class btree_policy_executor {
+public:
+    explicit btree_policy_executor(Policy p, std::size_t tasks = std::thread::hardware_concurrency())
+        : policy(std::move(p)), concurrent_tasks(std::max<std::size_t>(tasks, 1)) {}
+
+    [[nodiscard]] std::size_t concurrency() const noexcept { return concurrent_tasks; }
+
+    /**
+     * Run the tasks through the policy. An exception escaping an element access function of a parallel algorithm calls
+     * std::terminate(), so the first one thrown is caught and rethrown once all the tasks returned.
+     */
+    template <typename Task>
+    void bulk(std::size_t count, Task&& task) {
+        std::vector<std::size_t> indices(count);
+        std::iota(indices.begin(), indices.end(), std::size_t{0});
+        std::mutex error_mutex;
+        std::exception_ptr error;
+        std::for_each(policy, indices.begin(), indices.end(), [&](std::size_t i) {
+            try {
+                task(i);
+            } catch (...) {
+                std::lock_guard lock(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        });
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    Policy policy;
+    std::size_t concurrent_tasks;
+};
+
+namespace detail {
+
+/**
+ * Subranges scanned per task that an executor runs at once, so that the tasks finishing early can take over the work
+ * of the slower ones.
+ */
+inline constexpr std::size_t parallel_parts_per_task = 4;
+
+/**
+ * Call `fn` with the runs of contiguous values of each subrange between consecutive `boundaries` (see
+ * `btree::split_range()`), one task per subrange. `part` is the index of the subrange.
+ */
+template <typename Executor, typename Tree, typename Iterator, typename Function>
+void parallel_for_each_span(Executor& executor, Tree& tree, const std::vector<Iterator>& boundaries, Function&& fn) {
+    executor.bulk(boundaries.size() - 1, [&](std::size_t part) {
+        tree.for_each_leaf_span(boundaries[part], boundaries[part + 1], [&](auto span) { fn(part, span); });
+    });
+}
+
+/**
+ * Reduce the results of `transform` for each value of the subranges between consecutive `boundaries`, starting from
+ * `init`, one task per subrange.
+ */
+template <typename Executor, typename Tree, typename Iterator, typename T, typename Reduce, typename Transform>
+[[nodiscard]] T parallel_reduce_spans(Executor& executor,
+                                      Tree& tree,
+                                      const std::vector<Iterator>& boundaries,
+                                      T init,
+                                      Reduce& reduce,
+                                      Transform& transform) {
+    // Partial results are reduced in the order of the subranges, whichever task completes first
+    std::vector<std::optional<T>> partials(boundaries.size() - 1);
+    parallel_for_each_span(executor, tree, boundaries, [&](std::size_t part, auto span) {
+        auto& partial = partials[part];
+        auto it = span.begin();
+        T result = partial ? std::move(*partial) : T(transform(*it++));
+        for (; it != span.end(); ++it) {
+            result = reduce(std::move(result), transform(*it));
+        }
+        partial = std::move(result);
+    });
+    for (auto& partial : partials) {
+        if (partial) {
+            init = reduce(std::move(init), std::move(*partial));
+        }
+    }
+    return init;
+}
+
+}  // namespace detail
+
+/**
+ * Call `fn` with each value of `tree` whose key is in [lower, upper), using the tasks of `executor`. Calls are made
+ * from several threads at once, in no particular order.
+ *
+ * The range is split into subranges at the boundaries of subtrees (see `btree::split_range()`), several per task the
+ * executor runs at once, so that the tasks finishing early can take over the work of the slower ones.
+ */
+template <typename Executor, typename Tree, typename Function>
+void parallel_for_each(Executor& executor,
+                       Tree& tree,
+                       const typename Tree::key_type& lower,
+                       const typename Tree::key_type& upper,
+                       Function fn) {
+    const auto boundaries = tree.split_range(lower, upper, executor.concurrency() * detail::parallel_parts_per_task);
+    detail::parallel_for_each_span(executor, tree, boundaries, [&](std::size_t, auto span) {
+        for (auto& value : span) {
+            fn(value);
+        }
+    });
+}
+
+/**
+ * Call `fn` with each value of `tree`, using the tasks of `executor`.
+ * @see parallel_for_each(Executor&, Tree&, const key_type&, const key_type&, Function)
+ */
+template <typename Executor, typename Tree, typename Function>
+void parallel_for_each(Executor& executor, Tree& tree, Function fn) {
+    const auto boundaries = tree.split_range(executor.concurrency() * detail::parallel_parts_per_task);
+    detail::parallel_for_each_span(executor, tree, boundaries, [&](std::size_t, auto span) {
+        for (auto& value : span) {
+            fn(value);
+        }
+    });
+}
+
+/**
+ * Reduce with `reduce` the results of `transform` for each value of `tree` whose key is in [lower, upper), starting
+ * from `init`, using the tasks of `executor`.
+ *
+ * Each subrange is reduced in order, then the results of the subranges are reduced in order. So the result is the
+ * same as a sequential reduction whenever `reduce` is associative, even if it is not commutative, and does not depend
+ * on the order in which the tasks complete.
+ */
+template <typename Executor, typename Tree, typename T, typename Reduce, typename Transform>
+[[nodiscard]] T parallel_transform_reduce(Executor& executor,
+                                          Tree& tree,
+                                          const typename Tree::key_type& lower,
+                                          const typename Tree::key_type& upper,
+                                          T init,
+                                          Reduce reduce,
+                                          Transform transform) {
+    const auto boundaries = tree.split_range(lower, upper, executor.concurrency() * detail::parallel_parts_per_task);
+    return detail::parallel_reduce_spans(executor, tree, boundaries, std::move(init), reduce, transform);
+}
+
+/**
+ * Reduce the results of `transform` for each value of `tree`, using the tasks of `executor`.
+ * @see parallel_transform_reduce(Executor&, Tree&, const key_type&, const key_type&, T, Reduce, Transform)
+ */
+template <typename Executor, typename Tree, typename T, typename Reduce, typename Transform>
+[[nodiscard]] T parallel_transform_reduce(Executor& executor, Tree& tree, T init, Reduce reduce, Transform transform) {
+    const auto boundaries = tree.split_range(executor.concurrency() * detail::parallel_parts_per_task);
+    return detail::parallel_reduce_spans(executor, tree, boundaries, std::move(init), reduce, transform);
+}
+
+/**
+ * Number of values of `tree` whose key is in [lower, upper) satisfying `pred`, counted using the tasks of `executor`.
+ */
+template <typename Executor, typename Tree, typename Predicate>
+[[nodiscard]] std::size_t parallel_count_if(Executor& executor,
+                                            Tree& tree,
+                                            const typename Tree::key_type& lower,
+                                            const typename Tree::key_type& upper,
+                                            Predicate pred) {
+    return parallel_transform_reduce(executor, tree, lower, upper, std::size_t{0}, std::plus<>{},
+                                     [&](const auto& value) -> std::size_t { return pred(value) ? 1 : 0; });
+}
+
+/**
+ * Number of values of `tree` satisfying `pred`, counted using the tasks of `executor`.
+ */
+template <typename Executor, typename Tree, typename Predicate>
+[[nodiscard]] std::size_t parallel_count_if(Executor& executor, Tree& tree, Predicate pred) {
+    return parallel_transform_reduce(executor, tree, std::size_t{0}, std::plus<>{},
+                                     [&](const auto& value) -> std::size_t { return pred(value) ? 1 : 0; });
+}
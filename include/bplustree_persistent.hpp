@@ -0,0 +1,505 @@
+#pragma once
+
+#include <bplustree.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/**
+ * Variant of `btree` whose successive versions share their nodes, so that snapshot() returns an immutable snapshot of
+ * the tree in O(1).
+ *
+ * Nodes reuse the layouts of `btree`, with a reference count added to each of them: the number of parents and versions
+ * holding the node. A writer copies a node held more than once before modifying it, after the nodes above it, so that a
+ * modification copies at most the path from the root to the leaf it modifies, and never changes a node reachable from
+ * a snapshot. Snapshots can therefore be read by any number of threads without locks while the tree keeps being
+ * modified, and released from any thread.
+ *
+ * Since leaves are shared by several versions, they are not linked to their siblings: iterators keep the path from the
+ * root to their leaf instead. Full nodes are split eagerly while descending, and erasing values only frees the nodes it
+ * empties: underflowing nodes are not merged.
+ *
+ * As in `btree`, values with equivalent keys are kept in insertion order. The tree itself must only be used by one
+ * thread at a time.
+ */
+template <typename Key,
+          typename Value,
+          typename KeyExtractor,
+          typename Compare = std::less<Key>,
+          typename Traits = btree_default_traits<Key, Value>,
+          typename Allocator = std::allocator<Value>>
+class persistent_btree {
+    using base_type = btree<Key, Value, KeyExtractor, Compare, Traits, Allocator>;
+    using node_type = typename base_type::node_type;
+    using slot_type = typename base_type::slot_type;
+    using level_type = typename base_type::level_type;
+
+    struct leaf_node_type;
+    struct inner_node_type;
+
+public:
+    using key_type = Key;
+    using value_type = Value;
+    using key_extractor_type = KeyExtractor;
+    using key_compare_type = Compare;
+    using traits_type = Traits;
+    using allocator_type = Allocator;
+    using size_type = size_t;
+
+    static_assert(!traits_type::order_statistics && std::is_void_v<typename traits_type::aggregate>,
+                  "subtree sizes and aggregates are not maintained by persistent updates");
+    static_assert(traits_type::inner_layout != btree_inner_layout::prefix_compressed,
+                  "prefix compressed inner nodes are not supported by persistent updates");
+    static_assert(!traits_type::compact_handles, "nodes shared between versions are linked by pointers");
+
+    /**
+     * Forward iterator over the values of a version of the tree, along with the path from the root to its leaf. It is
+     * valid as long as this version is: while its snapshot is alive, or until the next modification of the tree.
+     */
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Value;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        const_iterator() noexcept = default;
+
+        [[nodiscard]] reference operator*() const noexcept { return current_leaf->data[current_slot]; }
+        [[nodiscard]] pointer operator->() const noexcept { return &current_leaf->data[current_slot]; }
+
+        [[nodiscard]] const key_type& key() const noexcept { return current_leaf->key(current_slot); }
+
+        const_iterator& operator++() {
+            next();
+            return *this;
+        }
+
+        [[nodiscard]] const_iterator operator++(int) {
+            const_iterator tmp = *this;
+            next();
+            return tmp;
+        }
+
+        [[nodiscard]] bool operator==(const const_iterator& x) const noexcept {
+            return x.current_leaf == current_leaf && x.current_slot == current_slot;
+        }
+        [[nodiscard]] bool operator!=(const const_iterator& x) const noexcept { return !(*this == x); }
+
+    private:
+        friend persistent_btree;
+
+        /**
+         * Move to the first value of the subtree rooted at `node`.
+         */
+        void descend(const node_type* node) {
+            while (!node->is_leafnode()) {
+                const auto* inner = static_cast<const inner_node_type*>(node);
+                path.emplace_back(inner, 0);
+                node = inner->childs[0];
+            }
+            current_leaf = static_cast<const leaf_node_type*>(node);
+            current_slot = 0;
+        }
+
+        /**
+         * Move to the next value, climbing up to the first ancestor having a next child when the leaf is exhausted.
+         */
+        void next() {
+            BPLUSTREE_ASSERT(current_leaf != nullptr);
+            if (++current_slot < current_leaf->slot_count) {
+                return;
+            }
+            while (!path.empty() && path.back().second == path.back().first->slot_count) {
+                path.pop_back();
+            }
+            if (path.empty()) {
+                current_leaf = nullptr;
+                current_slot = 0;
+                return;
+            }
+            ++path.back().second;
+            descend(path.back().first->childs[path.back().second]);
+        }
+
+        std::vector<std::pair<const inner_node_type*, slot_type>> path;
+        const leaf_node_type* current_leaf{};
+        slot_type current_slot{};
+    };
+
+    /**
+     * Immutable version of a tree. Copying a snapshot is O(1), and so is releasing it unless it holds the last
+     * reference to some nodes.
+     */
+    class snapshot_type {
+    public:
+        snapshot_type(const snapshot_type& other) noexcept
+            : key_compare(other.key_compare), allocator(other.allocator), root(acquire(other.root)), count(other.count) {}
+
+        snapshot_type(snapshot_type&& other) noexcept
+            : key_compare(other.key_compare),
+              allocator(other.allocator),
+              root(std::exchange(other.root, nullptr)),
+              count(std::exchange(other.count, 0)) {}
+
+        snapshot_type& operator=(snapshot_type other) noexcept {
+            std::swap(key_compare, other.key_compare);
+            std::swap(allocator, other.allocator);
+            std::swap(root, other.root);
+            std::swap(count, other.count);
+            return *this;
+        }
+
+        ~snapshot_type() { release(allocator, root); }
+
+        [[nodiscard]] const_iterator begin() const {
+            const_iterator it;
+            if (root) {
+                it.descend(root);
+            }
+            return it;
+        }
+        [[nodiscard]] const_iterator end() const noexcept { return const_iterator(); }
+
+        [[nodiscard]] const_iterator lower_bound(const key_type& key) const {
+            return find_leaf_slot(detail::greater_than_or_equal_to, key);
+        }
+        [[nodiscard]] const_iterator upper_bound(const key_type& key) const {
+            return find_leaf_slot(detail::greater_than, key);
+        }
+        [[nodiscard]] const_iterator find(const key_type& key) const { return find_impl(key); }
+
+        template <typename K>
+            requires detail::is_transparent_v<key_compare_type>
+        [[nodiscard]] const_iterator lower_bound(const K& key) const {
+            return find_leaf_slot(detail::greater_than_or_equal_to, key);
+        }
+        template <typename K>
+            requires detail::is_transparent_v<key_compare_type>
+        [[nodiscard]] const_iterator upper_bound(const K& key) const {
+            return find_leaf_slot(detail::greater_than, key);
+        }
+        template <typename K>
+            requires detail::is_transparent_v<key_compare_type>
+        [[nodiscard]] const_iterator find(const K& key) const {
+            return find_impl(key);
+        }
+
+        [[nodiscard]] size_type size() const noexcept { return count; }
+        [[nodiscard]] bool empty() const noexcept { return count == 0; }
+
+    private:
+        friend persistent_btree;
+        friend base_type;
+
+        snapshot_type(const key_compare_type& comp, const allocator_type& alloc) : key_compare(comp), allocator(alloc) {}
+
+        template <typename K>
+        [[nodiscard]] const_iterator find_impl(const K& key) const {
+            const_iterator it = find_leaf_slot(detail::greater_than_or_equal_to, key);
+            return it != end() && detail::equal_to(key_compare, it.key(), key) ? it : end();
+        }
+
+        /**
+         * Iterator to the first value satisfying the comparison `comp` with `key`.
+         */
+        template <typename Comparator, typename K>
+        [[nodiscard]] const_iterator find_leaf_slot(const Comparator& comp, const K& key) const {
+            const_iterator it;
+            if (!root) {
+                return it;
+            }
+            const node_type* node = root;
+            it.path.reserve(root->level);
+            while (!node->is_leafnode()) {
+                const auto* inner = static_cast<const inner_node_type*>(node);
+                const slot_type slot = base_type::find_slot_in_node(*this, *inner, comp, key);
+                it.path.emplace_back(inner, slot);
+                node = inner->childs[slot];
+            }
+            it.current_leaf = static_cast<const leaf_node_type*>(node);
+            it.current_slot = base_type::find_slot_in_node(*this, *it.current_leaf, comp, key);
+            // The slot may be past the last value of its leaf, the value being in the next one
+            if (it.current_slot == it.current_leaf->slot_count) {
+                --it.current_slot;
+                it.next();
+            }
+            return it;
+        }
+
+        key_compare_type key_compare;
+        allocator_type allocator;
+        node_type* root{};
+        size_type count{};
+    };
+
+    explicit persistent_btree(const allocator_type& alloc = allocator_type{}) : current(key_compare_type{}, alloc) {}
+
+    explicit persistent_btree(const key_compare_type& comp, const allocator_type& alloc = allocator_type{})
+        : current(comp, alloc) {}
+
+    template <class InputIterator>
+    persistent_btree(InputIterator first, InputIterator last, const allocator_type& alloc = allocator_type{})
+        : current(key_compare_type{}, alloc) {
+        for (; first != last; ++first) {
+            insert(*first);
+        }
+    }
+
+    persistent_btree(const persistent_btree&) = delete;
+    persistent_btree& operator=(const persistent_btree&) = delete;
+
+    /**
+     * Snapshot of the current version of the tree, in O(1). Later modifications of the tree do not affect it.
+     */
+    [[nodiscard]] snapshot_type snapshot() const noexcept { return current; }
+
+    /**
+     * Insert `value` after the values with an equivalent key, and return an iterator to it. Nodes shared with snapshots
+     * along the path to its leaf are copied first.
+     */
+    const_iterator insert(const value_type& value) {
+        const key_type& key = key_extractor_type{}(value);
+        if (!current.root) {
+            current.root = allocate_leaf();
+        } else if (writable(current.root)->slot_count == max_slots(current.root)) {
+            auto* new_root = allocate_inner(current.root->level + 1);
+            new_root->childs[0] = current.root;
+            current.root = new_root;
+            split_child(*new_root, 0);
+        }
+
+        const_iterator position;
+        node_type* node = current.root;
+        while (!node->is_leafnode()) {
+            auto* inner = static_cast<inner_node_type*>(node);
+            slot_type slot = base_type::find_slot_in_node(current, *inner, detail::greater_than, key);
+            if (writable(inner->childs[slot])->slot_count == max_slots(inner->childs[slot])) {
+                split_child(*inner, slot);
+                if (!detail::less_than(current.key_compare, key, inner->key(slot))) {
+                    ++slot;
+                }
+            }
+            position.path.emplace_back(inner, slot);
+            node = inner->childs[slot];
+        }
+        auto* leaf = static_cast<leaf_node_type*>(node);
+        const slot_type slot = base_type::find_slot_in_node(current, *leaf, detail::greater_than, key);
+        leaf->relocate(slot, leaf->slot_count, *leaf, slot + 1);
+        leaf->construct(slot, value);
+        ++leaf->slot_count;
+        ++current.count;
+        position.current_leaf = leaf;
+        position.current_slot = slot;
+        return position;
+    }
+
+    /**
+     * Remove the values whose key is equivalent to `key`, and return how many were removed.
+     */
+    size_type erase(const key_type& key) {
+        size_type erased = 0;
+        for (auto it = lower_bound(key); it != end() && detail::equal_to(current.key_compare, it.key(), key);
+             it = lower_bound(key)) {
+            erase_at(it);
+            ++erased;
+        }
+        return erased;
+    }
+
+    /**
+     * Remove all the values. Nodes shared with snapshots are kept until they are released.
+     */
+    void clear() noexcept {
+        release(current.allocator, std::exchange(current.root, nullptr));
+        current.count = 0;
+    }
+
+    [[nodiscard]] const_iterator begin() const { return current.begin(); }
+    [[nodiscard]] const_iterator end() const noexcept { return current.end(); }
+    [[nodiscard]] const_iterator lower_bound(const key_type& key) const { return current.lower_bound(key); }
+    [[nodiscard]] const_iterator upper_bound(const key_type& key) const { return current.upper_bound(key); }
+    [[nodiscard]] const_iterator find(const key_type& key) const { return current.find(key); }
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    [[nodiscard]] const_iterator lower_bound(const K& key) const {
+        return current.lower_bound(key);
+    }
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    [[nodiscard]] const_iterator upper_bound(const K& key) const {
+        return current.upper_bound(key);
+    }
+    template <typename K>
+        requires detail::is_transparent_v<key_compare_type>
+    [[nodiscard]] const_iterator find(const K& key) const {
+        return current.find(key);
+    }
+
+    [[nodiscard]] size_type size() const noexcept { return current.size(); }
+    [[nodiscard]] bool empty() const noexcept { return current.empty(); }
+
+private:
+    static constexpr slot_type leaf_slots_max = base_type::leaf_slots_max;
+    static constexpr slot_type inner_slots_max = base_type::inner_slots_max;
+
+    struct leaf_node_type : base_type::leaf_node_type {
+        std::atomic<size_type> references{1};
+    };
+
+    struct inner_node_type : base_type::inner_node_type {
+        explicit inner_node_type(level_type l) noexcept : base_type::inner_node_type(l) {}
+
+        std::atomic<size_type> references{1};
+    };
+
+    [[nodiscard]] static std::atomic<size_type>& references(const node_type* n) noexcept {
+        if (n->is_leafnode()) {
+            return const_cast<leaf_node_type*>(static_cast<const leaf_node_type*>(n))->references;
+        }
+        return const_cast<inner_node_type*>(static_cast<const inner_node_type*>(n))->references;
+    }
+
+    [[nodiscard]] static slot_type max_slots(const node_type* n) noexcept {
+        return n->is_leafnode() ? leaf_slots_max : inner_slots_max;
+    }
+
+    [[nodiscard]] leaf_node_type* allocate_leaf() {
+        return base_type::template allocate_from_allocator<leaf_node_type>(current.allocator);
+    }
+
+    [[nodiscard]] inner_node_type* allocate_inner(level_type level) {
+        return base_type::template allocate_from_allocator<inner_node_type>(current.allocator, level);
+    }
+
+    static node_type* acquire(node_type* n) noexcept {
+        if (n) {
+            references(n).fetch_add(1, std::memory_order_relaxed);
+        }
+        return n;
+    }
+
+    /**
+     * Drop a reference to `n`, freeing it along with the childs it held the last reference to if it was the last one.
+     * Reading the node happens before dropping the reference, so that no other version frees it meanwhile.
+     */
+    static void release(allocator_type& allocator, node_type* n) noexcept {
+        if (!n || references(n).fetch_sub(1, std::memory_order_acq_rel) != 1) {
+            return;
+        }
+        if (n->is_leafnode()) {
+            base_type::deallocate_from_allocator(allocator, static_cast<leaf_node_type*>(n));
+        } else {
+            auto* inner = static_cast<inner_node_type*>(n);
+            for (slot_type slot = 0; slot <= inner->slot_count; ++slot) {
+                release(allocator, inner->childs[slot]);
+            }
+            base_type::deallocate_from_allocator(allocator, inner);
+        }
+    }
+
+    /**
+     * Make the node held by `link` owned by the current version only, copying it if it is shared, and return it.
+     *
+     * The parent holding `link` must be owned by the current version only: the reference count of a node then includes
+     * all the versions that can reach it, so that a node held once is not reachable from any snapshot.
+     */
+    node_type* writable(node_type*& link) {
+        if (references(link).load(std::memory_order_acquire) == 1) {
+            return link;
+        }
+        node_type* copy;
+        if (link->is_leafnode()) {
+            const auto* leaf = static_cast<const leaf_node_type*>(link);
+            auto* leaf_copy = allocate_leaf();
+            for (slot_type slot = 0; slot < leaf->slot_count; ++slot) {
+                leaf_copy->construct(slot, leaf->data[slot]);
+            }
+            copy = leaf_copy;
+        } else {
+            const auto* inner = static_cast<const inner_node_type*>(link);
+            auto* inner_copy = allocate_inner(inner->level);
+            for (slot_type slot = 0; slot < inner->slot_count; ++slot) {
+                inner_copy->keys.construct(slot, inner->keys[slot]);
+            }
+            for (slot_type slot = 0; slot <= inner->slot_count; ++slot) {
+                inner_copy->childs[slot] = acquire(inner->childs[slot]);
+            }
+            copy = inner_copy;
+        }
+        copy->slot_count = link->slot_count;
+        release(current.allocator, std::exchange(link, copy));
+        return copy;
+    }
+
+    /**
+     * Split the full child in `slot` of `parent`, both being owned by the current version only, moving its upper half
+     * to a new node inserted after it. `parent` must not be full.
+     */
+    void split_child(inner_node_type& parent, slot_type slot) {
+        node_type* child = parent.childs[slot];
+        if (child->is_leafnode()) {
+            auto* right = allocate_leaf();
+            parent.insert_after(slot, static_cast<leaf_node_type*>(child)->split_half(*right), right);
+        } else {
+            auto* right = allocate_inner(child->level);
+            parent.insert_after(slot, static_cast<inner_node_type*>(child)->split_half(*right), right);
+        }
+    }
+
+    /**
+     * Remove the value at `position`, copying the shared nodes on its path. A leaf left empty is freed, along with the
+     * inner nodes left without childs.
+     */
+    void erase_at(const const_iterator& position) {
+        std::vector<inner_node_type*> nodes;
+        node_type** link = &current.root;
+        for (const auto& [inner, slot] : position.path) {
+            nodes.push_back(static_cast<inner_node_type*>(writable(*link)));
+            link = &nodes.back()->childs[slot];
+        }
+        auto* leaf = static_cast<leaf_node_type*>(writable(*link));
+        leaf->destroy(position.current_slot, position.current_slot + 1);
+        leaf->relocate(position.current_slot + 1, leaf->slot_count, *leaf, position.current_slot);
+        --leaf->slot_count;
+        --current.count;
+        if (leaf->slot_count > 0) {
+            return;
+        }
+
+        base_type::deallocate_from_allocator(current.allocator, leaf);
+        size_type depth = nodes.size();
+        for (; depth > 0 && nodes[depth - 1]->slot_count == 0; --depth) {
+            base_type::deallocate_from_allocator(current.allocator, nodes[depth - 1]);
+        }
+        if (depth == 0) {
+            current.root = nullptr;
+            return;
+        }
+        // Remove the emptied child along with the separator on one of its sides
+        inner_node_type& inner = *nodes[depth - 1];
+        const slot_type slot = position.path[depth - 1].second;
+        const slot_type key_slot = slot > 0 ? slot - 1 : 0;
+        inner.keys.destroy(key_slot, key_slot + 1);
+        detail::relocate(inner.keys.data() + key_slot + 1, inner.keys.data() + inner.slot_count,
+                         inner.keys.data() + key_slot);
+        std::copy(inner.childs.begin() + slot + 1, inner.childs.begin() + inner.slot_count + 1,
+                  inner.childs.begin() + slot);
+        --inner.slot_count;
+        while (!current.root->is_leafnode() && current.root->slot_count == 0) {
+            // Only the root is owned by the current version: its child can still be reachable from snapshots
+            auto* single_parent = static_cast<inner_node_type*>(current.root);
+            node_type* child = acquire(single_parent->childs[0]);
+            release(current.allocator, single_parent);
+            current.root = child;
+        }
+    }
+
+    snapshot_type current;
+};
@@ -0,0 +1,156 @@
+#include <bplustree_buffered.hpp>
+
+#include <gtest/gtest.h>
+
+#include "test-utilities.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+
+/**
+ * Small nodes and buffers, so that a few thousand values make a tree with several inner levels, whose buffers are
+ * flushed often.
+ */
+template <typename Key, typename Value>
+struct small_traits : btree_default_traits<Key, Value> {
+    static const int leaf_slots = 4;
+    static const int inner_slots = 4;
+    static const int message_buffer_bytes = 0;
+};
+
+using buffered_records = buffered_btree<std::int64_t, record, record_key>;
+using small_buffered_records =
+    buffered_btree<std::int64_t, record, record_key, std::less<std::int64_t>, small_traits<std::int64_t, record>>;
+
+/**
+ * Apply a random mix of insertions, upserts and erasures of keys in [0, key_range) to `tree` and to a map.
+ */
+template <typename Tree>
+void random_writes(Tree& tree, std::map<std::int64_t, std::int64_t>& reference, std::int64_t key_range,
+                   std::int64_t count, std::uint64_t seed, int erase_percent) {
+    std::mt19937_64 rng(seed);
+    std::uniform_int_distribution<std::int64_t> keys(0, key_range - 1);
+    std::uniform_int_distribution<int> percent(0, 99);
+    for (std::int64_t version = 0; version < count; ++version) {
+        const std::int64_t key = keys(rng);
+        const int operation = percent(rng);
+        if (operation < erase_percent) {
+            tree.erase(key);
+            reference.erase(key);
+        } else if (operation % 2 == 0) {
+            tree.insert({key, version});
+            reference.emplace(key, version);
+        } else {
+            tree.upsert({key, version});
+            reference.insert_or_assign(key, version);
+        }
+    }
+}
+
+}  // namespace
+
+TEST(buffered_btree, empty) {
+    const buffered_records tree;
+    ASSERT_TRUE(tree.empty());
+    ASSERT_EQ(tree.begin(), tree.end());
+    ASSERT_EQ(tree.lower_bound(3), tree.end());
+    ASSERT_EQ(tree.find(3), tree.end());
+    ASSERT_FALSE(tree.contains(3));
+    ASSERT_EQ(tree.pending_messages(), 0);
+}
+
+static_assert(small_buffered_records::buffer_slots == 16);
+
+TEST(buffered_btree, insert_keeps_and_upsert_replaces) {
+    buffered_records tree;
+    tree.insert({1, 0});
+    tree.insert({1, 1});
+    ASSERT_EQ(tree.find(1)->version, 0);
+    tree.upsert({1, 2});
+    ASSERT_EQ(tree.find(1)->version, 2);
+    tree.erase(1);
+    ASSERT_FALSE(tree.contains(1));
+    tree.insert({1, 3});
+    ASSERT_EQ(tree.find(1)->version, 3);
+}
+
+TEST(buffered_btree, matches_reference) {
+    // Erasures from 0% to 60% of the writes, the last ones emptying a part of the leaves
+    for (const int erase_percent : {0, 20, 60}) {
+        small_buffered_records tree;
+        std::map<std::int64_t, std::int64_t> reference;
+        random_writes(tree, reference, 2000, 20000, static_cast<std::uint64_t>(erase_percent), erase_percent);
+        ASSERT_GT(tree.pending_messages(), 0);
+        expect_equal(tree, reference, -1, 2000);
+        tree.flush();
+        ASSERT_EQ(tree.pending_messages(), 0);
+        expect_equal(tree, reference, -1, 2000);
+        // Writes into the rebuilt tree
+        random_writes(tree, reference, 2000, 5000, 42, erase_percent);
+        expect_equal(tree, reference, -1, 2000);
+    }
+}
+
+TEST(buffered_btree, default_nodes) {
+    buffered_records tree;
+    std::map<std::int64_t, std::int64_t> reference;
+    random_writes(tree, reference, 100000, 200000, 7, 10);
+    expect_equal(tree, reference, 0, 1000);
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), reference.begin(), reference.end(),
+                           [](const record& r, const auto& p) { return r.key == p.first && r.version == p.second; }));
+}
+
+TEST(buffered_btree, erase_everything) {
+    small_buffered_records tree;
+    for (std::int64_t key = 0; key < 3000; ++key) {
+        tree.insert({key, 0});
+    }
+    for (std::int64_t key = 0; key < 3000; ++key) {
+        tree.erase(key);
+    }
+    ASSERT_TRUE(tree.empty());
+    ASSERT_FALSE(tree.contains(1500));
+    tree.flush();
+    ASSERT_TRUE(tree.empty());
+    ASSERT_EQ(tree.pending_messages(), 0);
+    tree.insert({5, 1});
+    ASSERT_EQ(tree.find(5)->version, 1);
+}
+
+TEST(buffered_btree, range_constructor) {
+    // Unsorted, with duplicates of which the last one is kept
+    std::vector<record> values;
+    for (std::int64_t i = 0; i < 5000; ++i) {
+        values.push_back({(i * 7919) % 1000, i});
+    }
+    const small_buffered_records tree(values.begin(), values.end());
+    ASSERT_EQ(tree.pending_messages(), 0);
+    std::map<std::int64_t, std::int64_t> reference;
+    for (const record& r : values) {
+        reference.insert_or_assign(r.key, r.version);
+    }
+    expect_equal(tree, reference, -1, 1000);
+}
+
+TEST(buffered_btree, transparent_lookups) {
+    buffered_btree<std::string, std::string, btree_key_extractor_self, std::less<>> tree;
+    for (int i = 0; i < 1000; ++i) {
+        tree.insert(std::to_string(i));
+    }
+    ASSERT_TRUE(tree.contains(std::string_view("500")));
+    ASSERT_FALSE(tree.contains(std::string_view("5000")));
+    ASSERT_EQ(*tree.find(std::string_view("42")), "42");
+    ASSERT_EQ(*tree.lower_bound(std::string_view("9985")), "999");
+    ASSERT_EQ(tree.lower_bound(std::string_view("9990")), tree.end());
+    ASSERT_EQ(tree.upper_bound(std::string_view("999")), tree.end());
+}
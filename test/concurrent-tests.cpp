@@ -0,0 +1,199 @@
+#include <bplustree_concurrent.hpp>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+
+template <typename T>
+using concurrent_set = concurrent_btree<T, T, btree_key_extractor_self>;
+
+/**
+ * Single-threaded behavior
+ */
+
+TEST(concurrent_btree, empty) {
+    concurrent_set<int> tree;
+    ASSERT_TRUE(tree.empty());
+    ASSERT_FALSE(tree.find(3));
+    ASSERT_FALSE(tree.lower_bound(3));
+    ASSERT_FALSE(tree.upper_bound(3));
+}
+
+TEST(concurrent_btree, matches_std_set) {
+    concurrent_set<int> tree;
+    std::set<int> expected;
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> dist(0, 20000);
+    for (int i = 0; i < 20000; ++i) {
+        const int key = dist(rng);
+        ASSERT_EQ(tree.insert(key), expected.insert(key).second);
+    }
+    for (int i = 0; i < 5000; ++i) {
+        const int key = dist(rng);
+        ASSERT_EQ(tree.erase(key), expected.erase(key) == 1);
+    }
+    ASSERT_EQ(tree.size(), expected.size());
+    for (int key = -1; key < 20002; key += 3) {
+        auto lower = expected.lower_bound(key);
+        auto upper = expected.upper_bound(key);
+        ASSERT_EQ(tree.lower_bound(key).value_or(-1), lower == expected.end() ? -1 : *lower);
+        ASSERT_EQ(tree.upper_bound(key).value_or(-1), upper == expected.end() ? -1 : *upper);
+        ASSERT_EQ(tree.find(key).has_value(), expected.count(key) == 1);
+    }
+    std::vector<int> scanned;
+    tree.for_each(std::numeric_limits<int>::min(), [&scanned](int value) {
+        scanned.push_back(value);
+        return true;
+    });
+    ASSERT_TRUE(std::equal(scanned.begin(), scanned.end(), expected.begin(), expected.end()));
+}
+
+TEST(concurrent_btree, for_each_stops) {
+    concurrent_set<int> tree;
+    for (int i = 0; i < 1000; ++i) {
+        tree.insert(i);
+    }
+    int visited = 0;
+    tree.for_each(500, [&visited](int value) {
+        EXPECT_EQ(value, 500 + visited);
+        return ++visited < 10;
+    });
+    ASSERT_EQ(visited, 10);
+}
+
+TEST(concurrent_btree, transparent_lookups) {
+    concurrent_btree<std::int64_t, std::int64_t, btree_key_extractor_self, std::less<>> tree;
+    for (std::int64_t i = 0; i < 1000; ++i) {
+        tree.insert(i * 2);
+    }
+    // Probes between two keys are not truncated to one of them
+    ASSERT_EQ(tree.find(10.0).value_or(-1), 10);
+    ASSERT_FALSE(tree.find(10.5));
+    ASSERT_EQ(tree.lower_bound(10.5).value_or(-1), 12);
+    ASSERT_EQ(tree.upper_bound(9.5).value_or(-1), 10);
+    std::int64_t first = -1;
+    tree.for_each(1.5, [&first](std::int64_t value) {
+        first = value;
+        return false;
+    });
+    ASSERT_EQ(first, 2);
+}
+
+/**
+ * Multi-threaded stress tests
+ */
+
+TEST(concurrent_btree, stress_concurrent_writers_and_readers) {
+    constexpr int writers = 4;
+    constexpr int readers = 4;
+    constexpr int per_writer = 20000;
+    concurrent_set<std::int64_t> tree;
+    std::atomic<bool> done{false};
+    std::atomic<bool> ordered{true};
+
+    std::vector<std::thread> threads;
+    for (int w = 0; w < writers; ++w) {
+        threads.emplace_back([&tree, w] {
+            // Interleave the keys of all writers so that they contend on the same leaves
+            for (std::int64_t i = 0; i < per_writer; ++i) {
+                tree.insert(i * writers + w);
+                if (i % 4 == 3) {
+                    tree.erase((i - 1) * writers + w);
+                }
+            }
+        });
+    }
+    for (int r = 0; r < readers; ++r) {
+        threads.emplace_back([&tree, &done, &ordered, r] {
+            std::mt19937 rng(static_cast<unsigned>(r));
+            std::uniform_int_distribution<std::int64_t> dist(0, writers * per_writer);
+            while (!done.load()) {
+                const std::int64_t key = dist(rng);
+                if (auto found = tree.lower_bound(key); found && *found < key) {
+                    ordered = false;
+                }
+                std::int64_t previous = -1;
+                tree.for_each(key, [&](std::int64_t value) {
+                    if (value <= previous || value < key) {
+                        ordered = false;
+                    }
+                    previous = value;
+                    return value < key + 500;
+                });
+            }
+        });
+    }
+    for (int w = 0; w < writers; ++w) {
+        threads[static_cast<std::size_t>(w)].join();
+    }
+    done = true;
+    for (std::size_t t = writers; t < threads.size(); ++t) {
+        threads[t].join();
+    }
+
+    ASSERT_TRUE(ordered);
+    ASSERT_EQ(tree.size(), static_cast<std::size_t>(writers * per_writer * 3 / 4));
+    for (std::int64_t i = 0; i < per_writer; ++i) {
+        for (std::int64_t w = 0; w < writers; ++w) {
+            ASSERT_EQ(tree.find(i * writers + w).has_value(), i % 4 != 2) << i * writers + w;
+        }
+    }
+}
+
+TEST(concurrent_btree, stress_clear_with_readers_and_writers) {
+    concurrent_set<int> tree;
+    std::atomic<bool> done{false};
+    std::vector<std::thread> threads;
+    for (int r = 0; r < 4; ++r) {
+        threads.emplace_back([&tree, &done] {
+            while (!done.load()) {
+                int previous = -1;
+                tree.for_each(0, [&previous](int value) {
+                    EXPECT_GT(value, previous);
+                    previous = value;
+                    return true;
+                });
+            }
+        });
+    }
+    for (int w = 0; w < 4; ++w) {
+        threads.emplace_back([&tree, &done, w] {
+            std::mt19937 rng(static_cast<unsigned>(w));
+            std::uniform_int_distribution<int> dist(0, 63);
+            while (!done.load()) {
+                const int key = dist(rng);
+                if (key % 2 == 0) {
+                    tree.insert(key);
+                } else {
+                    tree.erase(key - 1);
+                }
+            }
+        });
+    }
+    for (int round = 0; round < 20; ++round) {
+        for (int i = 0; i < 5000; ++i) {
+            tree.insert(i);
+        }
+        tree.clear();
+    }
+    done = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // Writers still updating the previous tree while it was cleared must not affect the count of the current one
+    std::size_t present = 0;
+    tree.for_each(0, [&present](int) {
+        ++present;
+        return true;
+    });
+    ASSERT_EQ(tree.size(), present);
+    tree.clear();
+    ASSERT_TRUE(tree.empty());
+}
@@ -0,0 +1,127 @@
+#include <bplustree_frozen.hpp>
+
+#include <gtest/gtest.h>
+
+#include "test-utilities.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+template <typename T>
+using set = btree<T, T, btree_key_extractor_self>;
+template <typename T>
+using frozen_set = frozen_btree<T, T, btree_key_extractor_self>;
+
+namespace {
+
+/**
+ * Check the bounds of every key between the smallest and greatest values against the ones of `values`, in steps of
+ * `step`.
+ */
+template <typename Frozen, typename Values, typename Key>
+void expect_bounds(const Frozen& frozen, const Values& values, Key first, Key last, Key step) {
+    for (Key key = first; key <= last; key += step) {
+        const auto lower = std::lower_bound(values.begin(), values.end(), key) - values.begin();
+        const auto upper = std::upper_bound(values.begin(), values.end(), key) - values.begin();
+        ASSERT_EQ(frozen.lower_bound(key) - frozen.begin(), lower) << key;
+        ASSERT_EQ(frozen.upper_bound(key) - frozen.begin(), upper) << key;
+    }
+}
+
+}  // namespace
+
+TEST(frozen_btree, empty) {
+    const frozen_set<int> frozen(set<int>{});
+    ASSERT_TRUE(frozen.empty());
+    ASSERT_EQ(frozen.begin(), frozen.end());
+    ASSERT_EQ(frozen.lower_bound(3), frozen.end());
+    ASSERT_EQ(frozen.upper_bound(3), frozen.end());
+}
+
+TEST(frozen_btree, bounds_for_all_heights) {
+    // Sizes around the capacity of each number of levels, with each key present once then three times
+    for (const std::int64_t size : {1, 7, 8, 9, 71, 72, 73, 648, 649, 5000, 100000}) {
+        for (const std::int64_t copies : {1, 3}) {
+            std::vector<std::int64_t> values(static_cast<std::size_t>(size));
+            for (std::int64_t i = 0; i < size; ++i) {
+                values[static_cast<std::size_t>(i)] = i / copies * 2;
+            }
+            const frozen_set<std::int64_t> frozen(set<std::int64_t>(values.begin(), values.end()));
+            ASSERT_EQ(frozen.size(), values.size());
+            ASSERT_TRUE(std::equal(frozen.begin(), frozen.end(), values.begin(), values.end()));
+            ASSERT_TRUE(std::equal(frozen.rbegin(), frozen.rend(), values.rbegin(), values.rend()));
+            expect_bounds(frozen, values, std::int64_t{-1}, values.back() + 1, std::int64_t{1});
+        }
+    }
+}
+
+TEST(frozen_btree, string_keys) {
+    std::vector<std::string> values;
+    for (int i = 0; i < 20000; ++i) {
+        values.push_back("key-" + std::to_string(i / 2 * 3));
+    }
+    std::sort(values.begin(), values.end());
+    const frozen_set<std::string> frozen(values.begin(), values.end());
+    ASSERT_TRUE(std::equal(frozen.begin(), frozen.end(), values.begin(), values.end()));
+    for (int i = -1; i < 30001; ++i) {
+        const std::string key = "key-" + std::to_string(i);
+        ASSERT_EQ(frozen.lower_bound(key) - frozen.begin(), std::lower_bound(values.begin(), values.end(), key) -
+                                                                 values.begin());
+        ASSERT_EQ(frozen.upper_bound(key) - frozen.begin(), std::upper_bound(values.begin(), values.end(), key) -
+                                                                 values.begin());
+    }
+}
+
+TEST(frozen_btree, unsorted_range_keeps_order_of_equivalent_values) {
+    std::vector<record> records;
+    std::mt19937 generator(42);
+    for (int i = 0; i < 5000; ++i) {
+        records.push_back({static_cast<std::int64_t>(generator() % 500), i});
+    }
+    const frozen_btree<std::int64_t, record, record_key> frozen(records.begin(), records.end());
+    std::stable_sort(records.begin(), records.end(), [](const record& a, const record& b) { return a.key < b.key; });
+    ASSERT_TRUE(std::equal(frozen.begin(), frozen.end(), records.begin(), records.end(),
+                           [](const record& a, const record& b) { return a.key == b.key && a.version == b.version; }));
+    for (std::int64_t key = -1; key <= 500; ++key) {
+        const auto lower = frozen.lower_bound(key);
+        ASSERT_TRUE(lower == frozen.begin() || std::prev(lower)->key < key);
+        ASSERT_TRUE(lower == frozen.end() || lower->key >= key);
+    }
+}
+
+TEST(frozen_btree, freeze_moves_values) {
+    set<std::string> tree;
+    for (int i = 0; i < 1000; ++i) {
+        tree.insert(std::string(40, 'x') + std::to_string(i));
+    }
+    const std::vector<std::string> values(tree.begin(), tree.end());
+    const auto frozen = freeze(std::move(tree));
+    ASSERT_TRUE(tree.empty());
+    ASSERT_TRUE(std::equal(frozen.begin(), frozen.end(), values.begin(), values.end()));
+}
+
+TEST(frozen_btree, transparent_lookups) {
+    using transparent_set = frozen_btree<std::int64_t, std::int64_t, btree_key_extractor_self, std::less<>>;
+    std::vector<std::int64_t> values(10000);
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        values[i] = static_cast<std::int64_t>(i) * 2;
+    }
+    const transparent_set frozen(values.begin(), values.end());
+    // Probes between two keys are not truncated to one of them
+    expect_bounds(frozen, values, -0.5, 20000.5, 0.75);
+}
+
+TEST(frozen_btree, uses_less_memory_than_tree) {
+    std::vector<std::int64_t> values(100000);
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        values[i] = static_cast<std::int64_t>(i);
+    }
+    const frozen_set<std::int64_t> frozen(values.begin(), values.end());
+    // The inner levels hold about one key per block of values
+    ASSERT_LT(frozen.memory_usage(), values.size() * sizeof(std::int64_t) * 5 / 4);
+}
@@ -0,0 +1,205 @@
+#include <bplustree_mapped.hpp>
+
+#include <gtest/gtest.h>
+
+#include "test-utilities.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+template <typename T>
+using set = btree<T, T, btree_key_extractor_self>;
+template <typename T>
+using mapped_set = mapped_btree<T, T, btree_key_extractor_self>;
+
+namespace {
+
+// Comparison object whose order depends on its state
+struct directed_less {
+    bool descending;
+    bool operator()(int a, int b) const { return descending ? b < a : a < b; }
+};
+
+// Even keys from 0 to 2 * 9999, each one present three times
+set<int> make_tree() {
+    std::vector<int> values(30000);
+    for (int i = 0; i < 30000; ++i) {
+        values[static_cast<std::size_t>(i)] = i / 3 * 2;
+    }
+    return set<int>(values.begin(), values.end());
+}
+
+}  // namespace
+
+TEST(mapped_btree, empty) {
+    temporary_file file("mapped-empty");
+    mapped_set<int>::write(set<int>{}, file.path);
+    mapped_set<int> view(file.path, true);
+    ASSERT_TRUE(view.empty());
+    ASSERT_EQ(view.begin(), view.end());
+    ASSERT_EQ(view.lower_bound(3), view.end());
+    ASSERT_EQ(view.upper_bound(3), view.end());
+}
+TEST(mapped_btree, iteration) {
+    temporary_file file("mapped-iteration");
+    const auto tree = make_tree();
+    mapped_set<int>::write(tree, file.path);
+    mapped_set<int> view(file.path, true);
+    ASSERT_EQ(view.size(), tree.size());
+    ASSERT_TRUE(std::equal(view.begin(), view.end(), tree.begin(), tree.end()));
+    ASSERT_TRUE(std::equal(view.rbegin(), view.rend(), tree.rbegin(), tree.rend()));
+}
+TEST(mapped_btree, bounds) {
+    temporary_file file("mapped-bounds");
+    const auto tree = make_tree();
+    mapped_set<int>::write(tree, file.path);
+    mapped_set<int> view(file.path);
+    for (int key = -1; key <= 20000; ++key) {
+        // A bound is characterized by its value and by the value before it
+        auto lower = view.lower_bound(key);
+        auto upper = view.upper_bound(key);
+        ASSERT_EQ(lower == view.end(), tree.lower_bound(key) == tree.end());
+        ASSERT_EQ(upper == view.end(), tree.upper_bound(key) == tree.end());
+        if (lower != view.end()) {
+            ASSERT_EQ(*lower, *tree.lower_bound(key));
+        }
+        if (upper != view.end()) {
+            ASSERT_EQ(*upper, *tree.upper_bound(key));
+        }
+        ASSERT_TRUE(lower == view.begin() || *std::prev(lower) < key);
+        ASSERT_TRUE(upper == view.begin() || *std::prev(upper) <= key);
+    }
+}
+TEST(mapped_btree, transparent_bounds) {
+    using transparent_set = btree<std::int64_t, std::int64_t, btree_key_extractor_self, std::less<>>;
+    temporary_file file("mapped-transparent-bounds");
+    std::vector<std::int64_t> values(10000);
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        values[i] = static_cast<std::int64_t>(i);
+    }
+    mapped_btree<std::int64_t, std::int64_t, btree_key_extractor_self, std::less<>>::write(
+        transparent_set(values.begin(), values.end()), file.path);
+    mapped_btree<std::int64_t, std::int64_t, btree_key_extractor_self, std::less<>> view(file.path);
+    // Probes between two keys are not truncated to one of them
+    for (double probe = -0.5; probe < 10000; probe += 7.5) {
+        const auto expected = static_cast<std::int64_t>(std::ceil(probe));
+        ASSERT_EQ(*view.lower_bound(probe), expected);
+        ASSERT_EQ(*view.upper_bound(probe), probe == std::floor(probe) ? expected + 1 : expected);
+    }
+}
+TEST(mapped_btree, map_like_values) {
+    using map = btree<std::int64_t, record, record_key>;
+    using mapped_map = mapped_btree<std::int64_t, record, record_key>;
+    temporary_file file("mapped-map");
+    std::vector<record> values;
+    for (std::int64_t i = 0; i < 5000; ++i) {
+        values.push_back({i * 2, i / 2});
+    }
+    mapped_map::write(map(values.begin(), values.end()), file.path);
+    mapped_map view(file.path, true);
+    auto it = view.lower_bound(1235);
+    ASSERT_EQ(it->key, 1236);
+    ASSERT_EQ(it->version, 309);
+    ASSERT_EQ(view.upper_bound(9998), view.end());
+}
+TEST(mapped_btree, stateful_comparison) {
+    using directed_set = btree<int, int, btree_key_extractor_self, directed_less>;
+    using mapped_directed_set = mapped_btree<int, int, btree_key_extractor_self, directed_less>;
+    temporary_file file("mapped-stateful-comparison");
+    std::vector<int> values(5000);
+    for (int i = 0; i < 5000; ++i) {
+        values[static_cast<std::size_t>(i)] = (4999 - i) * 2;
+    }
+    mapped_directed_set::write(directed_set(values.begin(), values.end(), directed_less{true}), file.path);
+    mapped_directed_set view(file.path, true, directed_less{true});
+    ASSERT_TRUE(view.key_comp().descending);
+    ASSERT_TRUE(std::equal(view.begin(), view.end(), values.begin(), values.end()));
+    ASSERT_EQ(*view.lower_bound(1235), 1234);
+    ASSERT_EQ(*view.upper_bound(1236), 1234);
+    ASSERT_EQ(view.lower_bound(-1), view.end());
+}
+TEST(mapped_btree, move) {
+    temporary_file file("mapped-move");
+    mapped_set<int>::write(make_tree(), file.path);
+    mapped_set<int> view(file.path);
+    mapped_set<int> moved(std::move(view));
+    ASSERT_EQ(*moved.lower_bound(7), 8);
+    // The moved-from view is left empty
+    ASSERT_TRUE(view.empty());
+    ASSERT_EQ(view.begin(), view.end());
+    ASSERT_EQ(view.lower_bound(7), view.end());
+    view = std::move(moved);
+    ASSERT_EQ(*view.lower_bound(7), 8);
+}
+TEST(mapped_btree, missing_file) {
+    ASSERT_THROW(mapped_set<int>("/nonexistent/bplustree-file"), std::system_error);
+}
+TEST(mapped_btree, rejects_other_layout) {
+    temporary_file file("mapped-layout");
+    mapped_set<int>::write(make_tree(), file.path);
+    ASSERT_THROW(mapped_set<long long>(file.path), std::runtime_error);
+}
+TEST(mapped_btree, rejects_inconsistent_levels) {
+    temporary_file file("mapped-levels");
+    mapped_set<int>::write(make_tree(), file.path);
+    {
+        std::fstream stream(file.path, std::ios::binary | std::ios::in | std::ios::out);
+        const std::uint64_t levels = 1;
+        stream.seekp(static_cast<std::streamoff>(offsetof(detail::mapped_btree_header, levels)));
+        stream.write(reinterpret_cast<const char*>(&levels), sizeof(levels));
+    }
+    ASSERT_THROW(mapped_set<int>(file.path), std::runtime_error);
+}
+TEST(mapped_btree, detects_corruption) {
+    temporary_file file("mapped-corruption");
+    mapped_set<int>::write(make_tree(), file.path);
+    {
+        std::fstream stream(file.path, std::ios::binary | std::ios::in | std::ios::out);
+        stream.seekp(static_cast<std::streamoff>(mapped_set<int>::page_size + 100));
+        stream.put('\x7f');
+    }
+    ASSERT_NO_THROW(mapped_set<int>(file.path));
+    ASSERT_THROW(mapped_set<int>(file.path, true), std::runtime_error);
+}
+TEST(mapped_btree, rejects_inconsistent_offsets) {
+    temporary_file file("mapped-offsets");
+    mapped_set<int>::write(make_tree(), file.path);
+    {
+        std::fstream stream(file.path, std::ios::binary | std::ios::in | std::ios::out);
+        const std::uint64_t tail_leaf = std::uint64_t{1} << 40;
+        stream.seekp(static_cast<std::streamoff>(offsetof(detail::mapped_btree_header, tail_leaf)));
+        stream.write(reinterpret_cast<const char*>(&tail_leaf), sizeof(tail_leaf));
+    }
+    ASSERT_THROW(mapped_set<int>(file.path), std::runtime_error);
+}
+TEST(mapped_btree, checks_nodes_without_checksum) {
+    using inner_node = detail::mapped_inner_node<int, 1>;
+    // Overwrite a field of the root inner node, then look up the smallest key
+    const auto lookup_after_writing = [](const std::string& path, std::size_t field, std::uint64_t value,
+                                         std::size_t size) {
+        mapped_set<int>::write(make_tree(), path);
+        {
+            std::fstream stream(path, std::ios::binary | std::ios::in | std::ios::out);
+            std::uint64_t root = 0;
+            stream.seekg(static_cast<std::streamoff>(offsetof(detail::mapped_btree_header, root)));
+            stream.read(reinterpret_cast<char*>(&root), sizeof(root));
+            stream.seekp(static_cast<std::streamoff>(root + field));
+            stream.write(reinterpret_cast<const char*>(&value), static_cast<std::streamsize>(size));
+        }
+        const mapped_set<int> view(path);
+        static_cast<void>(view.lower_bound(0));
+    };
+    temporary_file file("mapped-nodes");
+    ASSERT_THROW(
+        lookup_after_writing(file.path, offsetof(inner_node, slot_count), 0xffffffff, sizeof(std::uint32_t)),
+        std::runtime_error);
+    ASSERT_THROW(lookup_after_writing(file.path, offsetof(inner_node, childs), std::uint64_t{1} << 40,
+                                      sizeof(std::uint64_t)),
+                 std::runtime_error);
+}
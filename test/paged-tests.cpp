@@ -0,0 +1,187 @@
+#include <bplustree_paged.hpp>
+
+#include <gtest/gtest.h>
+
+#include "test-utilities.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <iterator>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ * Pages of 512 bytes holding 61 values or 31 keys, so that a few thousand values make a tree with several inner levels.
+ */
+using small_page_traits = btree_page_traits<std::int64_t, std::int64_t, 512>;
+
+using paged_set = paged_btree<std::int64_t, std::int64_t, btree_key_extractor_self>;
+using small_paged_set =
+    paged_btree<std::int64_t, std::int64_t, btree_key_extractor_self, std::less<std::int64_t>, small_page_traits>;
+
+}  // namespace
+
+static_assert(sizeof(detail::mapped_leaf_node<std::int64_t, btree_page_traits<std::int64_t, std::int64_t>::leaf_slots>) ==
+              4096);
+static_assert(btree_page_traits<std::int64_t, std::int64_t, 16384>::inner_slots == 1023);
+
+TEST(paged_btree, empty) {
+    temporary_file file("paged-empty");
+    const paged_set tree(file.path);
+    ASSERT_TRUE(tree.empty());
+    ASSERT_EQ(tree.begin(), tree.end());
+    ASSERT_EQ(tree.rbegin(), tree.rend());
+    ASSERT_EQ(tree.lower_bound(3), tree.end());
+    ASSERT_EQ(tree.upper_bound(3), tree.end());
+}
+
+TEST(paged_btree, matches_reference) {
+    temporary_file file("paged-reference");
+    // A pool much smaller than the tree, whose pages are evicted and read again all along
+    small_paged_set tree(file.path, 16);
+    std::multiset<std::int64_t> reference;
+    std::mt19937_64 rng(42);
+    std::uniform_int_distribution<std::int64_t> keys(0, 2999);
+    for (int i = 0; i < 20000; ++i) {
+        const std::int64_t key = keys(rng);
+        if (i % 3 == 2) {
+            ASSERT_EQ(tree.erase(key), reference.erase(key));
+        } else {
+            ASSERT_EQ(*tree.insert(key), key);
+            reference.insert(key);
+        }
+    }
+    expect_equal(tree, reference, -1, 3000);
+    ASSERT_GT(tree.get_counters().evictions, 0);
+    ASSERT_GT(tree.get_counters().writebacks, 0);
+}
+
+TEST(paged_btree, erase_everything_reuses_pages) {
+    temporary_file file("paged-erase");
+    {
+        small_paged_set tree(file.path, 16);
+        for (std::int64_t key = 0; key < 5000; ++key) {
+            tree.insert(key);
+        }
+        for (std::int64_t key = 0; key < 5000; key += 2) {
+            ASSERT_EQ(tree.erase(key), 1);
+        }
+        for (std::int64_t key = 1; key < 5000; key += 2) {
+            ASSERT_EQ(tree.erase(key), 1);
+        }
+        ASSERT_TRUE(tree.empty());
+        ASSERT_EQ(tree.begin(), tree.end());
+        ASSERT_EQ(tree.lower_bound(0), tree.end());
+        for (std::int64_t key = 0; key < 5000; ++key) {
+            tree.insert(key);
+        }
+        ASSERT_EQ(tree.size(), 5000);
+    }
+    // Every page freed by the erasures was reused by the insertions
+    const auto size = std::filesystem::file_size(file.path);
+    {
+        small_paged_set tree(file.path, 16);
+        for (std::int64_t key = 0; key < 5000; ++key) {
+            tree.erase(key);
+        }
+        for (std::int64_t key = 0; key < 5000; ++key) {
+            tree.insert(key);
+        }
+    }
+    ASSERT_EQ(std::filesystem::file_size(file.path), size);
+}
+
+TEST(paged_btree, reopen) {
+    temporary_file file("paged-reopen");
+    std::multiset<std::int64_t> reference;
+    {
+        small_paged_set tree(file.path, 16);
+        for (std::int64_t i = 0; i < 10000; ++i) {
+            const std::int64_t key = (i * 7919) % 4000;
+            tree.insert(key);
+            reference.insert(key);
+        }
+        tree.flush();
+        for (std::int64_t key = 0; key < 4000; key += 3) {
+            tree.erase(key);
+            reference.erase(key);
+        }
+        // Flushed by the destructor
+    }
+    small_paged_set tree(file.path, 16);
+    expect_equal(tree, reference, -1, 4000);
+}
+
+TEST(paged_btree, layout_mismatch) {
+    temporary_file file("paged-mismatch");
+    {
+        small_paged_set tree(file.path);
+        tree.insert(1);
+    }
+    ASSERT_THROW(paged_set{file.path}, std::runtime_error);
+    ASSERT_THROW((paged_btree<std::int32_t, std::int32_t, btree_key_extractor_self>{file.path}), std::runtime_error);
+}
+
+TEST(paged_btree, iterators_pin_their_leaf) {
+    temporary_file file("paged-pins");
+    small_paged_set tree(file.path, 8);
+    for (std::int64_t key = 0; key < 1000; ++key) {
+        tree.insert(key);
+    }
+    // Iterators in leaves that are not in memory anymore are still valid
+    std::vector<small_paged_set::const_iterator> iterators;
+    for (std::int64_t key = 0; key < 1000; key += 250) {
+        iterators.push_back(tree.lower_bound(key));
+    }
+    for (std::int64_t key = 0; key < 1000; ++key) {
+        ASSERT_EQ(*tree.lower_bound(key), key);
+    }
+    for (std::size_t i = 0; i < iterators.size(); ++i) {
+        ASSERT_EQ(*iterators[i], static_cast<std::int64_t>(i) * 250);
+        ASSERT_EQ(*std::next(iterators[i]), static_cast<std::int64_t>(i) * 250 + 1);
+    }
+}
+
+TEST(paged_btree, scans_read_ahead) {
+    temporary_file file("paged-scan");
+    {
+        paged_set tree(file.path);
+        for (std::int64_t key = 0; key < 100000; ++key) {
+            tree.insert(key);
+        }
+    }
+    const paged_set tree(file.path, 64);
+    std::int64_t expected = 0;
+    for (const std::int64_t key : tree) {
+        ASSERT_EQ(key, expected++);
+    }
+    ASSERT_EQ(expected, 100000);
+    const auto counters = tree.get_counters();
+    // Leaves appended in order follow each other in the file, and are read in batches
+    ASSERT_GT(counters.read_ahead_pages, 0);
+    ASSERT_GT(counters.hits, counters.misses);
+    ASSERT_GT(counters.evictions, 0);
+}
+
+TEST(paged_btree, transparent_lookups) {
+    struct transparent_less {
+        using is_transparent = void;
+        bool operator()(std::int64_t a, std::int64_t b) const { return a < b; }
+        bool operator()(std::int64_t a, double b) const { return static_cast<double>(a) < b; }
+        bool operator()(double a, std::int64_t b) const { return a < static_cast<double>(b); }
+    };
+    temporary_file file("paged-transparent");
+    paged_btree<std::int64_t, std::int64_t, btree_key_extractor_self, transparent_less> tree(file.path);
+    for (std::int64_t key = 0; key < 100; key += 2) {
+        tree.insert(key);
+    }
+    ASSERT_EQ(*tree.lower_bound(3.5), 4);
+    ASSERT_EQ(*tree.upper_bound(4.0), 6);
+    ASSERT_EQ(tree.lower_bound(98.5), tree.end());
+}
@@ -0,0 +1,140 @@
+#ifdef BPLUSTREE_TEST_EXECUTION_POLICIES
+#include <execution>
+#endif
+
+#include <bplustree_parallel.hpp>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+template <typename T>
+using set = btree<T, T, btree_key_extractor_self>;
+
+namespace {
+
+set<int> make_tree(int size) {
+    std::vector<int> values(static_cast<std::size_t>(size));
+    std::iota(values.begin(), values.end(), 0);
+    return set<int>(values.begin(), values.end());
+}
+
+}  // namespace
+
+/**
+ * Thread pool
+ */
+
+TEST(thread_pool, runs_each_task_once) {
+    btree_thread_pool pool(4);
+    ASSERT_EQ(pool.concurrency(), 4u);
+    for (std::size_t count : {0u, 1u, 3u, 1000u}) {
+        std::vector<std::atomic<int>> runs(count);
+        pool.bulk(count, [&](std::size_t i) { ++runs[i]; });
+        ASSERT_TRUE(std::all_of(runs.begin(), runs.end(), [](const auto& n) { return n == 1; }));
+    }
+}
+TEST(thread_pool, single_thread) {
+    btree_thread_pool pool(1);
+    std::size_t sum = 0;
+    pool.bulk(100, [&](std::size_t i) { sum += i; });
+    ASSERT_EQ(sum, 4950u);
+}
+TEST(thread_pool, rethrows_task_exceptions) {
+    btree_thread_pool pool(4);
+    ASSERT_THROW(pool.bulk(100,
+                           [](std::size_t i) {
+                               if (i == 42) {
+                                   throw std::runtime_error("task failed");
+                               }
+                           }),
+                 std::runtime_error);
+    // The pool is still usable
+    std::atomic<std::size_t> runs{0};
+    pool.bulk(100, [&](std::size_t) { ++runs; });
+    ASSERT_EQ(runs, 100u);
+}
+
+/**
+ * Parallel algorithms
+ */
+
+TEST(parallel, for_each) {
+    btree_thread_pool pool(4);
+    auto tree = make_tree(100000);
+    std::vector<std::atomic<int>> visits(100000);
+    parallel_for_each(pool, tree, 1000, 90000, [&](int value) { ++visits[static_cast<std::size_t>(value)]; });
+    for (int value = 0; value < 100000; ++value) {
+        ASSERT_EQ(visits[static_cast<std::size_t>(value)], value >= 1000 && value < 90000 ? 1 : 0);
+    }
+    // Values of a non-const tree can be modified in place
+    parallel_for_each(pool, tree, [](int& value) { value *= 1; });
+}
+TEST(parallel, count_if) {
+    btree_thread_pool pool(4);
+    const auto tree = make_tree(100000);
+    const auto even = [](int value) { return value % 2 == 0; };
+    ASSERT_EQ(parallel_count_if(pool, tree, even), 50000u);
+    ASSERT_EQ(parallel_count_if(pool, tree, 10, 21, even), 6u);
+    ASSERT_EQ(parallel_count_if(pool, tree, 21, 10, even), 0u);
+    const set<int> empty;
+    ASSERT_EQ(parallel_count_if(pool, empty, even), 0u);
+}
+TEST(parallel, transform_reduce) {
+    btree_thread_pool pool(8);
+    const auto tree = make_tree(100000);
+    const auto sum = parallel_transform_reduce(pool, tree, std::int64_t{0}, std::plus<>{},
+                                               [](int value) { return static_cast<std::int64_t>(value); });
+    ASSERT_EQ(sum, std::int64_t{99999} * 100000 / 2);
+    const auto squares = parallel_transform_reduce(pool, tree, 0, 10, std::int64_t{1}, std::plus<>{},
+                                                   [](int value) { return std::int64_t{value} * value; });
+    ASSERT_EQ(squares, 286);
+}
+TEST(parallel, ordered_reduction) {
+    // Concatenation is associative but not commutative
+    btree_thread_pool pool(8);
+    const auto tree = make_tree(20000);
+    const auto concatenation = parallel_transform_reduce(
+        pool, tree, 100, 15000, std::string{}, [](std::string a, const std::string& b) { return a + b; },
+        [](int value) { return std::to_string(value) + ","; });
+    std::string expected;
+    for (int value = 100; value < 15000; ++value) {
+        expected += std::to_string(value) + ",";
+    }
+    ASSERT_EQ(concatenation, expected);
+}
+#ifdef BPLUSTREE_TEST_EXECUTION_POLICIES
+TEST(parallel, policy_executor) {
+    btree_policy_executor executor(std::execution::par, 4);
+    const auto tree = make_tree(50000);
+    ASSERT_EQ(parallel_count_if(executor, tree, 0, 30000, [](int value) { return value % 3 == 0; }), 10000u);
+}
+TEST(parallel, policy_executor_rethrows_task_exceptions) {
+    btree_policy_executor executor(std::execution::par, 4);
+    std::atomic<std::size_t> runs{0};
+    ASSERT_THROW(executor.bulk(100,
+                               [&](std::size_t i) {
+                                   ++runs;
+                                   if (i == 42) {
+                                       throw std::runtime_error("task failed");
+                                   }
+                               }),
+                 std::runtime_error);
+    // The other tasks still ran
+    ASSERT_EQ(runs.load(), 100u);
+    const auto tree = make_tree(1000);
+    const auto failing = [](int value) -> bool {
+        if (value == 500) {
+            throw std::runtime_error("predicate failed");
+        }
+        return true;
+    };
+    ASSERT_THROW(static_cast<void>(parallel_count_if(executor, tree, 0, 1000, failing)), std::runtime_error);
+}
+#endif
@@ -0,0 +1,239 @@
+#include <bplustree_persistent.hpp>
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+template <typename T>
+using persistent_set = persistent_btree<T, T, btree_key_extractor_self>;
+
+namespace {
+
+// Small nodes give deep trees, so that modifications copy long paths
+struct small_node_traits : btree_default_traits<int, int> {
+    static const int leaf_slots = 4;
+    static const int inner_slots = 4;
+};
+
+using small_persistent_set = persistent_btree<int, int, btree_key_extractor_self, std::less<int>, small_node_traits>;
+
+template <typename Tree, typename Values>
+void expect_content(const Tree& tree, const Values& values) {
+    ASSERT_EQ(tree.size(), values.size());
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), values.begin(), values.end()));
+}
+
+}  // namespace
+
+/**
+ * Single version
+ */
+
+TEST(persistent_btree, empty) {
+    persistent_set<int> tree;
+    ASSERT_TRUE(tree.empty());
+    ASSERT_EQ(tree.begin(), tree.end());
+    ASSERT_EQ(tree.find(3), tree.end());
+    ASSERT_EQ(tree.lower_bound(3), tree.end());
+    ASSERT_EQ(tree.erase(3), 0u);
+}
+
+TEST(persistent_btree, matches_reference) {
+    small_persistent_set tree;
+    std::vector<int> values;
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> distribution(0, 1000);
+    for (int i = 0; i < 5000; ++i) {
+        const int value = distribution(generator);
+        ASSERT_EQ(*tree.insert(value), value);
+        values.insert(std::upper_bound(values.begin(), values.end(), value), value);
+    }
+    expect_content(tree, values);
+    for (int key = -1; key < 1002; ++key) {
+        const auto lower = std::lower_bound(values.begin(), values.end(), key);
+        const auto upper = std::upper_bound(values.begin(), values.end(), key);
+        ASSERT_EQ(std::distance(tree.begin(), tree.lower_bound(key)), lower - values.begin());
+        ASSERT_EQ(std::distance(tree.begin(), tree.upper_bound(key)), upper - values.begin());
+        ASSERT_EQ(tree.find(key) != tree.end(), lower != upper);
+    }
+    for (int i = 0; i < 2000; ++i) {
+        const int key = distribution(generator);
+        const auto [first, last] = std::equal_range(values.begin(), values.end(), key);
+        ASSERT_EQ(tree.erase(key), static_cast<std::size_t>(last - first));
+        values.erase(first, last);
+    }
+    expect_content(tree, values);
+    for (const int value : std::vector<int>(values)) {
+        tree.erase(value);
+    }
+    ASSERT_TRUE(tree.empty());
+    ASSERT_EQ(tree.begin(), tree.end());
+}
+
+TEST(persistent_btree, equivalent_keys_keep_insertion_order) {
+    using map = persistent_btree<int, std::pair<int, int>, btree_key_extractor_pair>;
+    map tree;
+    for (int i = 0; i < 1000; ++i) {
+        tree.insert({i % 3, i});
+    }
+    int previous = -1;
+    for (auto it = tree.lower_bound(1); it != tree.upper_bound(1); ++it) {
+        ASSERT_GT(it->second, previous);
+        previous = it->second;
+    }
+    ASSERT_EQ(tree.erase(1), 333u);
+    ASSERT_EQ(tree.size(), 667u);
+}
+
+TEST(persistent_btree, transparent_lookups) {
+    persistent_btree<std::string, std::string, btree_key_extractor_self, std::less<>> tree;
+    for (int i = 0; i < 1000; ++i) {
+        tree.insert("key-" + std::to_string(i * 2));
+    }
+    const auto snapshot = tree.snapshot();
+    ASSERT_EQ(*snapshot.find(std::string_view("key-10")), "key-10");
+    ASSERT_EQ(snapshot.find("key-11"), snapshot.end());
+    ASSERT_EQ(*snapshot.lower_bound("key-11"), "key-110");
+    ASSERT_EQ(*tree.upper_bound(std::string_view("key-996")), "key-998");
+    ASSERT_EQ(tree.upper_bound("key-998"), tree.end());
+    ASSERT_EQ(*tree.find("key-998"), "key-998");
+}
+
+/**
+ * Snapshots
+ */
+
+TEST(persistent_btree, snapshots_are_not_modified) {
+    small_persistent_set tree;
+    std::vector<std::pair<small_persistent_set::snapshot_type, std::vector<int>>> snapshots;
+    std::vector<int> values;
+    std::mt19937 generator(7);
+    std::uniform_int_distribution<int> distribution(0, 300);
+    for (int i = 0; i < 3000; ++i) {
+        const int key = distribution(generator);
+        if (i % 3 == 0) {
+            const auto [first, last] = std::equal_range(values.begin(), values.end(), key);
+            tree.erase(key);
+            values.erase(first, last);
+        } else {
+            tree.insert(key);
+            values.insert(std::upper_bound(values.begin(), values.end(), key), key);
+        }
+        if (i % 100 == 0) {
+            snapshots.emplace_back(tree.snapshot(), values);
+        }
+        // Release some snapshots, so that their nodes are freed or get owned by the tree only again
+        if (i % 250 == 0 && snapshots.size() > 3) {
+            snapshots.erase(snapshots.begin() + static_cast<std::ptrdiff_t>(generator() % snapshots.size()));
+        }
+    }
+    expect_content(tree, values);
+    for (const auto& [snapshot, expected] : snapshots) {
+        expect_content(snapshot, expected);
+    }
+    tree.clear();
+    ASSERT_TRUE(tree.empty());
+    for (const auto& [snapshot, expected] : snapshots) {
+        expect_content(snapshot, expected);
+    }
+}
+
+TEST(persistent_btree, erasing_down_to_one_value_keeps_snapshots) {
+    small_persistent_set tree;
+    std::vector<int> values(200);
+    for (int i = 0; i < 200; ++i) {
+        values[static_cast<std::size_t>(i)] = i;
+        tree.insert(i);
+    }
+    // The root collapses several times, while the nodes below it are still shared with the snapshots
+    std::vector<std::pair<small_persistent_set::snapshot_type, std::vector<int>>> snapshots;
+    while (values.size() > 1) {
+        snapshots.emplace_back(tree.snapshot(), values);
+        const int key = values[values.size() / 2];
+        tree.erase(key);
+        values.erase(values.begin() + static_cast<std::ptrdiff_t>(values.size() / 2));
+    }
+    expect_content(tree, values);
+    for (const auto& [snapshot, expected] : snapshots) {
+        expect_content(snapshot, expected);
+    }
+}
+
+TEST(persistent_btree, snapshot_outlives_tree) {
+    std::vector<std::string> values;
+    for (int i = 0; i < 1000; ++i) {
+        values.push_back("value-" + std::to_string(i));
+    }
+    std::sort(values.begin(), values.end());
+    auto tree = std::make_unique<persistent_set<std::string>>(values.begin(), values.end());
+    auto snapshot = tree->snapshot();
+    tree->erase(values[10]);
+    tree.reset();
+    expect_content(snapshot, values);
+    auto copy = snapshot;
+    snapshot = std::move(copy);
+    ASSERT_EQ(*snapshot.find(values[10]), values[10]);
+}
+
+TEST(persistent_btree, readers_of_snapshots_while_writing) {
+    constexpr int readers = 4;
+    persistent_set<std::int64_t> tree;
+    for (std::int64_t i = 0; i < 10000; ++i) {
+        tree.insert(2 * i);
+    }
+    // Each published snapshot holds the even keys below 20000, and its own number of odd keys
+    std::mutex published_mutex;
+    auto published = std::make_shared<const persistent_set<std::int64_t>::snapshot_type>(tree.snapshot());
+    std::atomic<bool> done{false};
+    std::atomic<bool> consistent{true};
+    std::vector<std::thread> threads;
+    for (int r = 0; r < readers; ++r) {
+        threads.emplace_back([&] {
+            while (!done.load()) {
+                std::shared_ptr<const persistent_set<std::int64_t>::snapshot_type> snapshot;
+                {
+                    std::lock_guard lock(published_mutex);
+                    snapshot = published;
+                }
+                std::size_t evens = 0;
+                std::int64_t previous = -1;
+                for (const std::int64_t value : *snapshot) {
+                    evens += value % 2 == 0 && value < 20000 ? 1 : 0;
+                    if (value <= previous) {
+                        consistent = false;
+                    }
+                    previous = value;
+                }
+                if (evens != 10000) {
+                    consistent = false;
+                }
+            }
+        });
+    }
+    for (std::int64_t i = 0; i < 2000; ++i) {
+        tree.insert(2 * (i * 7919 % 10000) + 1);
+        if (i % 3 == 0) {
+            tree.erase(2 * (i * 104729 % 10000) + 1);
+        }
+        if (i % 50 == 0) {
+            auto snapshot = std::make_shared<const persistent_set<std::int64_t>::snapshot_type>(tree.snapshot());
+            std::lock_guard lock(published_mutex);
+            published = std::move(snapshot);
+        }
+    }
+    done = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    ASSERT_TRUE(consistent);
+}
@@ -2,50 +2,410 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
 #include <map>
+#include <numeric>
+#include <random>
 #include <string>
 #include <vector>
 
 template <typename T>
 using set = btree<T, T, btree_key_extractor_self>;
 
-// TEST(inner_node, lower_bound) {
-//     set<int>::inner_node_type node;
-//     set<int> tree;
-
-//     node.keys = {0, 1, 2, 3, 3, 3, 4, 5, 6};
-//     node.slot_count = 9;
-//     auto slot = set<int>::find_slot_in_node(tree, node, detail::greater_than_or_equal_to, 3);
-//     ASSERT_EQ(slot, 3);
-// }
-
-// TEST(inner_node, upper_bound) {
-//     set<int>::inner_node_type node;
-//     set<int> tree;
-
-//     node.keys = {0, 1, 2, 3, 3, 3, 4, 5, 6};
-//     node.slot_count = 9;
-//     auto slot = set<int>::find_slot_in_node(tree, node, detail::greater_than, 3);
-//     ASSERT_EQ(slot, 6);
-// }
-
-// TEST(leaf_node, lower_bound) {
-//     set<int>::leaf_node_type node;
-//     set<int> tree;
-
-//     node.data = {10, 11, 12, 13, 13, 13, 14, 15, 16};
-//     node.slot_count = 9;
-//     auto slot = set<int>::find_slot_in_node(tree, node, detail::greater_than_or_equal_to, 3);
-//     std::cout << "slot found: " << slot << "\n";
-//     ASSERT_EQ(slot, 3);
-// }
-
-// TEST(leaf_node, upper_bound) {
-//     set<int>::leaf_node_type node;
-//     set<int> tree;
-
-//     node.data = {0, 1, 2, 3, 3, 3, 4, 5, 6};
-//     node.slot_count = 9;
-//     auto slot = set<int>::find_slot_in_node(tree, node, detail::greater_than, 3);
-//     ASSERT_EQ(slot, 6);
-// }
+template <typename T>
+struct binary_search_traits : btree_default_traits<T, T> {
+    static const int linear_search_threshold = 0;
+};
+
+template <typename T>
+struct linear_search_traits : btree_default_traits<T, T> {
+    static const int linear_search_threshold = 64;
+};
+
+template <typename T>
+struct scalar_search_traits : btree_default_traits<T, T> {
+    static const btree_simd simd = btree_simd::none;
+};
+
+template <typename T>
+struct order_statistics_traits : btree_default_traits<T, T> {
+    static const bool order_statistics = true;
+};
+
+template <typename T>
+struct sum_traits : btree_default_traits<T, T> {
+    using aggregate = btree_sum_aggregate<T>;
+};
+
+template <typename T, typename Traits>
+using set_with_traits = btree<T, T, btree_key_extractor_self, std::less<T>, Traits>;
+
+template <typename K, typename V>
+using separate_keys_map =
+    btree<K, std::pair<K, V>, btree_key_extractor_pair, std::less<K>, btree_separate_keys_traits<K, std::pair<K, V>>>;
+
+/**
+ * Search in node
+ */
+
+template <typename Tree>
+void check_find_slot_in_inner_node() {
+    typename Tree::inner_node_type node{1};
+    Tree tree;
+
+    node.keys.construct(0, 0);
+    node.keys.construct(1, 1);
+    node.keys.construct(2, 2);
+    node.keys.construct(3, 3);
+    node.keys.construct(4, 3);
+    node.keys.construct(5, 3);
+    node.keys.construct(6, 4);
+    node.keys.construct(7, 5);
+    node.keys.construct(8, 6);
+    node.slot_count = 9;
+    // Probes are given as keys, since other types are only passed as is to transparent comparators
+    using key_type = typename Tree::key_type;
+    ASSERT_EQ(Tree::find_slot_in_node(tree, node, detail::greater_than_or_equal_to, key_type(3)), 3u);
+    ASSERT_EQ(Tree::find_slot_in_node(tree, node, detail::greater_than, key_type(3)), 6u);
+    ASSERT_EQ(Tree::find_slot_in_node(tree, node, detail::greater_than_or_equal_to, key_type(-1)), 0u);
+    ASSERT_EQ(Tree::find_slot_in_node(tree, node, detail::greater_than, key_type(6)), 9u);
+}
+
+template <typename Tree>
+void check_find_slot_in_leaf_node() {
+    typename Tree::leaf_node_type node;
+    Tree tree;
+
+    const std::vector<typename Tree::key_type> keys{0, 1, 2, 3, 3, 3, 4, 5, 6};
+    for (std::size_t slot = 0; slot < keys.size(); ++slot) {
+        if constexpr (std::is_same_v<typename Tree::key_type, typename Tree::value_type>) {
+            node.construct(slot, keys[slot]);
+        } else {
+            node.construct(slot, typename Tree::value_type{keys[slot], {}});
+        }
+    }
+    node.slot_count = 9;
+    // Probes are given as keys, since other types are only passed as is to transparent comparators
+    using key_type = typename Tree::key_type;
+    ASSERT_EQ(Tree::find_slot_in_node(tree, node, detail::greater_than_or_equal_to, key_type(3)), 3u);
+    ASSERT_EQ(Tree::find_slot_in_node(tree, node, detail::greater_than, key_type(3)), 6u);
+    ASSERT_EQ(Tree::find_slot_in_node(tree, node, detail::greater_than_or_equal_to, key_type(-1)), 0u);
+    ASSERT_EQ(Tree::find_slot_in_node(tree, node, detail::greater_than, key_type(6)), 9u);
+}
+
+TEST(inner_node, find_slot_binary) {
+    check_find_slot_in_inner_node<set_with_traits<int, binary_search_traits<int>>>();
+}
+
+TEST(inner_node, find_slot_linear_scalar) {
+    check_find_slot_in_inner_node<set_with_traits<int, scalar_search_traits<int>>>();
+}
+
+TEST(inner_node, find_slot_linear_simd) {
+    check_find_slot_in_inner_node<set<int>>();
+    check_find_slot_in_inner_node<set<std::int64_t>>();
+    check_find_slot_in_inner_node<set<float>>();
+    check_find_slot_in_inner_node<set<double>>();
+}
+
+TEST(inner_node, find_slot_linear_generic) {
+    check_find_slot_in_inner_node<set_with_traits<short, linear_search_traits<short>>>();
+}
+
+// Only nodes whose search runs the SIMD kernels are searched linearly when large
+using lower_bound_type = std::remove_cv_t<decltype(detail::greater_than_or_equal_to)>;
+template <typename Tree, typename Node, typename K = typename Tree::key_type>
+constexpr auto linear_search_threshold_v = Tree::template linear_search_threshold_v<Node, lower_bound_type, K>;
+static_assert(linear_search_threshold_v<set<int>, set<int>::leaf_node_type> == 64);
+static_assert(linear_search_threshold_v<set<double>, set<double>::inner_node_type> == 64);
+static_assert(linear_search_threshold_v<set<short>, set<short>::leaf_node_type> == 8);
+static_assert(linear_search_threshold_v<set<std::string>, set<std::string>::leaf_node_type> == 8);
+static_assert(linear_search_threshold_v<separate_keys_map<int, int>, separate_keys_map<int, int>::leaf_node_type> == 64);
+static_assert(linear_search_threshold_v<set<int>, set<int>::leaf_node_type, long> == 8);
+
+template <typename K, typename V>
+struct stats_traits : btree_default_traits<K, V> {
+    static const bool with_stats = true;
+};
+
+template <typename Tree>
+std::size_t comparisons_to_find_in_full_leaf() {
+    using key_type = typename Tree::key_type;
+    typename Tree::leaf_node_type node;
+    Tree tree;
+    std::vector<key_type> keys(Tree::leaf_slots_max);
+    std::iota(keys.begin(), keys.end(), key_type(0));
+    std::sort(keys.begin(), keys.end(), typename Tree::key_compare_type{});
+    for (std::size_t slot = 0; slot < keys.size(); ++slot) {
+        const key_type key = keys[slot];
+        if constexpr (std::is_same_v<typename Tree::key_type, typename Tree::value_type>) {
+            node.construct(slot, key);
+        } else {
+            node.construct(slot, typename Tree::value_type{key, {}});
+        }
+    }
+    node.slot_count = Tree::leaf_slots_max;
+    const auto slot = Tree::find_slot_in_node(tree, node, detail::greater_than_or_equal_to, keys[keys.size() - 2]);
+    EXPECT_EQ(slot, Tree::leaf_slots_max - 2);
+    return tree.get_counters().key_comparisons;
+}
+
+TEST(leaf_node, find_slot_binary_without_simd) {
+    // Leaves of map-like trees have no contiguous keys, and std::greater is not handled by the SIMD kernels
+    using map = btree<int, std::pair<int, int>, btree_key_extractor_pair, std::less<int>,
+                      stats_traits<int, std::pair<int, int>>>;
+    using descending_set = btree<int, int, btree_key_extractor_self, std::greater<int>, stats_traits<int, int>>;
+    static_assert(map::leaf_slots_max > 8 && descending_set::leaf_slots_max > 8);
+    ASSERT_LE(comparisons_to_find_in_full_leaf<map>(), static_cast<std::size_t>(std::bit_width(map::leaf_slots_max)));
+    ASSERT_LE(comparisons_to_find_in_full_leaf<descending_set>(),
+              static_cast<std::size_t>(std::bit_width(descending_set::leaf_slots_max)));
+}
+
+TEST(leaf_node, find_slot_binary) {
+    check_find_slot_in_leaf_node<set_with_traits<int, binary_search_traits<int>>>();
+}
+
+TEST(leaf_node, find_slot_linear_simd) {
+    check_find_slot_in_leaf_node<set<int>>();
+    check_find_slot_in_leaf_node<set<std::int64_t>>();
+    check_find_slot_in_leaf_node<set<float>>();
+    check_find_slot_in_leaf_node<set<double>>();
+}
+
+TEST(leaf_node, find_slot_separate_keys) {
+    check_find_slot_in_leaf_node<separate_keys_map<int, int>>();
+    check_find_slot_in_leaf_node<separate_keys_map<short, int>>();
+    check_find_slot_in_leaf_node<separate_keys_map<double, float>>();
+}
+
+/**
+ * Slot storage
+ */
+
+TEST(relocate, overlapping_ranges) {
+    detail::uninitialized_array<std::string, 8> slots;
+    for (std::size_t i = 0; i < 5; ++i) {
+        slots.construct(i, std::string(32, static_cast<char>('a' + i)));
+    }
+    // Shift right to open a gap at slot 1
+    detail::relocate(slots.data() + 1, slots.data() + 5, slots.data() + 2);
+    slots.construct(1, "gap");
+    ASSERT_EQ(slots[0], std::string(32, 'a'));
+    ASSERT_EQ(slots[1], "gap");
+    ASSERT_EQ(slots[2], std::string(32, 'b'));
+    ASSERT_EQ(slots[5], std::string(32, 'e'));
+    // Shift left to close it again
+    slots.destroy(1, 2);
+    detail::relocate(slots.data() + 2, slots.data() + 6, slots.data() + 1);
+    for (std::size_t i = 0; i < 5; ++i) {
+        ASSERT_EQ(slots[i], std::string(32, static_cast<char>('a' + i)));
+    }
+    slots.destroy(0, 5);
+}
+
+TEST(relocate, trivially_relocatable) {
+    detail::uninitialized_array<int, 8> slots;
+    for (std::size_t i = 0; i < 5; ++i) {
+        slots.construct(i, static_cast<int>(i));
+    }
+    detail::relocate(slots.data(), slots.data() + 5, slots.data() + 3);
+    for (std::size_t i = 0; i < 5; ++i) {
+        ASSERT_EQ(slots[i + 3], static_cast<int>(i));
+    }
+}
+
+TEST(leaf_node, relocate_between_leaves) {
+    using map = separate_keys_map<int, std::string>;
+    map::leaf_node_type left;
+    map::leaf_node_type right;
+    for (int i = 0; i < 6; ++i) {
+        left.construct(static_cast<std::size_t>(i), i, std::to_string(i));
+    }
+    left.slot_count = 6;
+    left.relocate(3, 6, right, 0);
+    left.slot_count = 3;
+    right.slot_count = 3;
+    for (std::size_t slot = 0; slot < 3; ++slot) {
+        ASSERT_EQ(left.key(slot), static_cast<int>(slot));
+        ASSERT_EQ(right.key(slot), static_cast<int>(slot + 3));
+        ASSERT_EQ(right.data[slot].second, std::to_string(slot + 3));
+    }
+}
+
+/**
+ * Node pool
+ */
+
+TEST(node_pool, recycles_freed_storage) {
+    using pool_type = detail::node_pool<std::array<void*, 4>, 256, std::allocator<int>>;
+    std::allocator<int> allocator;
+    pool_type pool;
+    ASSERT_EQ(pool_type::chunk_size(), 8u);
+    std::vector<std::array<void*, 4>*> nodes;
+    for (int i = 0; i < 20; ++i) {
+        nodes.push_back(pool.allocate(allocator));
+    }
+    ASSERT_EQ(pool.chunks(), 3u);
+    ASSERT_EQ(pool.capacity(), 24u);
+    auto* freed = nodes[5];
+    pool.deallocate(freed);
+    ASSERT_EQ(pool.allocate(allocator), freed);
+    ASSERT_EQ(pool.chunks(), 3u);
+    pool.release(allocator);
+    ASSERT_EQ(pool.chunks(), 0u);
+}
+
+// With compact handles, nodes hold no pointer to other nodes, leaves included
+using compact_int_set = btree<int, int, btree_key_extractor_self, std::less<int>, btree_compact_traits<int, int>>;
+static_assert(sizeof(compact_int_set::leaf_node_type::next_leaf) == sizeof(std::uint32_t));
+static_assert(sizeof(compact_int_set::inner_node_type::childs[0]) == sizeof(std::uint32_t));
+// Iterators only hold a resolver when leaves are linked by handles
+static_assert(sizeof(set<int>::iterator) == sizeof(void*) + sizeof(std::size_t));
+
+/**
+ * SIMD kernels
+ */
+
+template <btree_simd simd, typename T>
+void check_count_less() {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> dist(-50, 50);
+    for (std::size_t count = 0; count < 70; ++count) {
+        std::vector<T> keys(count);
+        std::generate(keys.begin(), keys.end(), [&] { return static_cast<T>(dist(rng)); });
+        std::sort(keys.begin(), keys.end());
+        for (int probe = -52; probe <= 52; ++probe) {
+            const auto key = static_cast<T>(probe);
+            const auto lower = static_cast<std::size_t>(std::lower_bound(keys.begin(), keys.end(), key) - keys.begin());
+            const auto upper = static_cast<std::size_t>(std::upper_bound(keys.begin(), keys.end(), key) - keys.begin());
+            ASSERT_EQ((detail::count_less<simd, false>(keys.data(), count, key)), lower);
+            ASSERT_EQ((count - detail::count_less<simd, true>(keys.data(), count, key)), upper);
+        }
+    }
+}
+
+template <btree_simd simd>
+void check_count_less_all_types() {
+    check_count_less<simd, std::int32_t>();
+    check_count_less<simd, std::int64_t>();
+    check_count_less<simd, float>();
+    check_count_less<simd, double>();
+}
+
+TEST(count_less, scalar) {
+    check_count_less_all_types<btree_simd::none>();
+}
+
+TEST(count_less, sse2) {
+    check_count_less_all_types<btree_simd::sse2>();
+}
+
+TEST(count_less, avx2) {
+    check_count_less_all_types<btree_simd::avx2>();
+}
+
+TEST(count_less, avx512) {
+    check_count_less_all_types<btree_simd::avx512>();
+}
+
+/**
+ * Structural verifier
+ */
+
+namespace {
+
+set<int> make_verified_tree() {
+    std::vector<int> values(5000);
+    std::iota(values.begin(), values.end(), 0);
+    return set<int>(values.begin(), values.end());
+}
+
+}  // namespace
+
+TEST(verify, sound_trees) {
+    ASSERT_EQ(set<int>{}.verify(), nullptr);
+    ASSERT_EQ(make_verified_tree().verify(), nullptr);
+    std::vector<std::pair<int, int>> values;
+    for (int i = 0; i < 1000; ++i) {
+        values.emplace_back(i / 2, i);
+    }
+    separate_keys_map<int, int> map(values.begin(), values.end());
+    ASSERT_EQ(map.verify(), nullptr);
+}
+TEST(verify, unsorted_keys) {
+    auto tree = make_verified_tree();
+    std::swap(tree.head_leaf->data[0], tree.head_leaf->data[1]);
+    ASSERT_NE(tree.verify(), nullptr);
+}
+TEST(verify, key_out_of_separators) {
+    auto tree = make_verified_tree();
+    tree.head_leaf->next_leaf->data[0] = -1;
+    ASSERT_NE(tree.verify(), nullptr);
+}
+TEST(verify, broken_sibling_links) {
+    auto tree = make_verified_tree();
+    auto* second = tree.head_leaf->next_leaf;
+    second->previous_leaf = nullptr;
+    ASSERT_NE(tree.verify(), nullptr);
+    second->previous_leaf = tree.head_leaf;
+    ASSERT_EQ(tree.verify(), nullptr);
+}
+TEST(verify, stats_mismatch) {
+    auto tree = make_verified_tree();
+    ++tree.stats.size;
+    ASSERT_NE(tree.verify(), nullptr);
+}
+TEST(verify, subtree_size_mismatch) {
+    std::vector<int> values(5000);
+    std::iota(values.begin(), values.end(), 0);
+    set_with_traits<int, order_statistics_traits<int>> tree(values.begin(), values.end());
+    ASSERT_EQ(tree.verify(), nullptr);
+    auto* root = static_cast<decltype(tree)::inner_node_type*>(tree.root);
+    ++root->child_sizes[0];
+    ASSERT_NE(tree.verify(), nullptr);
+}
+TEST(verify, aggregate_mismatch) {
+    std::vector<int> values(5000);
+    std::iota(values.begin(), values.end(), 0);
+    set_with_traits<int, sum_traits<int>> tree(values.begin(), values.end());
+    ASSERT_EQ(tree.verify(), nullptr);
+    auto* root = static_cast<decltype(tree)::inner_node_type*>(tree.root);
+    ++root->child_aggregates[0];
+    ASSERT_NE(tree.verify(), nullptr);
+}
+
+/**
+ * Prefix compressed separators
+ */
+
+TEST(prefix_compressed_keys, shortest_separator) {
+    ASSERT_EQ(detail::shortest_separator("abc", "abd"), "abd");
+    ASSERT_EQ(detail::shortest_separator("abc", "abzzz"), "abz");
+    ASSERT_EQ(detail::shortest_separator("ab", "abcd"), "abc");
+    ASSERT_EQ(detail::shortest_separator("abc", "abc"), "abc");
+    ASSERT_EQ(detail::shortest_separator("", "b"), "b");
+}
+TEST(prefix_compressed_keys, find_slot) {
+    const std::vector<std::string_view> separators{"http://a/b", "http://a/c", "http://a/cd", "http://a/e"};
+    detail::prefix_compressed_keys<8, 64> keys;
+    ASSERT_TRUE(keys.fits(separators.begin(), separators.size()));
+    keys.assign(separators.begin(), separators.size());
+    ASSERT_EQ(keys.prefix(), "http://a/");
+    ASSERT_EQ(keys.key(2), "http://a/cd");
+    for (const std::string probe : {"", "http://", "http://a/", "http://a/c", "http://a/ca", "http://a/e", "z"}) {
+        const auto lower = std::lower_bound(separators.begin(), separators.end(), probe) - separators.begin();
+        const auto upper = std::upper_bound(separators.begin(), separators.end(), probe) - separators.begin();
+        ASSERT_EQ(keys.find_slot<false>(separators.size(), probe), static_cast<std::size_t>(lower)) << probe;
+        ASSERT_EQ(keys.find_slot<true>(separators.size(), probe), static_cast<std::size_t>(upper)) << probe;
+    }
+}
+TEST(prefix_compressed_keys, capacity) {
+    const std::vector<std::string_view> separators{"prefix-aaaaaaaa", "prefix-bbbbbbbb", "prefix-cccccccc"};
+    // The shared prefix is stored once: 7 + 3 * 8 bytes
+    ASSERT_TRUE((detail::prefix_compressed_keys<4, 31>::fits(separators.begin(), 3)));
+    ASSERT_FALSE((detail::prefix_compressed_keys<4, 30>::fits(separators.begin(), 3)));
+    ASSERT_FALSE((detail::prefix_compressed_keys<2, 64>::fits(separators.begin(), 3)));
+}
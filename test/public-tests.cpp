@@ -2,9 +2,1438 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <set>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
 template <typename T>
 using set = btree<T, T, btree_key_extractor_self>;
 
+/**
+ * Bulk load
+ */
+
+TEST(bulk_load, sorted_range) {
+    std::vector<int> values(10000);
+    std::iota(values.begin(), values.end(), 0);
+    set<int> tree(values.begin(), values.end());
+    ASSERT_EQ(tree.size(), values.size());
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), values.begin(), values.end()));
+    ASSERT_TRUE(std::equal(tree.rbegin(), tree.rend(), values.rbegin(), values.rend()));
+    ASSERT_EQ(*tree.begin(), 0);
+    ASSERT_EQ(*std::prev(tree.end()), 9999);
+}
+
+TEST(bulk_load, unsorted_range) {
+    std::vector<int> values(5000);
+    std::iota(values.begin(), values.end(), 0);
+    std::reverse(values.begin(), values.end());
+    set<int> tree(values.begin(), values.end());
+    std::sort(values.begin(), values.end());
+    ASSERT_EQ(tree.size(), values.size());
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), values.begin(), values.end()));
+}
+
+TEST(bulk_load, input_iterator) {
+    std::istringstream stream("5 3 9 1 7");
+    set<int> tree(std::istream_iterator<int>(stream), std::istream_iterator<int>{});
+    std::vector<int> expected{1, 3, 5, 7, 9};
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), expected.begin(), expected.end()));
+}
+
+TEST(bulk_load, empty_range) {
+    std::vector<int> values;
+    set<int> tree(values.begin(), values.end());
+    ASSERT_TRUE(tree.empty());
+    ASSERT_EQ(tree.begin(), tree.end());
+    ASSERT_EQ(tree.get_stats().nodes(), 0u);
+}
+
+TEST(bulk_load, fill_factor) {
+    std::vector<int> values(10000);
+    std::iota(values.begin(), values.end(), 0);
+    set<int> full;
+    full.bulk_load(values.begin(), values.end(), 1.0f);
+    set<int> half;
+    half.bulk_load(values.begin(), values.end(), 0.5f);
+    ASSERT_GT(full.get_stats().average_fill_leaves(), 0.99f);
+    ASSERT_LT(half.get_stats().average_fill_leaves(), 0.51f);
+    ASSERT_GT(half.get_stats().leaves, full.get_stats().leaves);
+    ASSERT_TRUE(std::equal(half.begin(), half.end(), values.begin(), values.end()));
+}
+
+TEST(bulk_load, reload_replaces_content) {
+    std::vector<int> values{1, 2, 3};
+    set<int> tree(values.begin(), values.end());
+    std::vector<int> other{4, 5};
+    tree.bulk_load(other.begin(), other.end());
+    ASSERT_EQ(tree.size(), 2u);
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), other.begin(), other.end()));
+}
+
+TEST(bulk_load, bounds_with_duplicates) {
+    std::vector<int> values;
+    for (int i = 0; i < 3000; ++i) {
+        values.insert(values.end(), 3, i * 2);
+    }
+    const set<int> tree(values.begin(), values.end());
+    for (int key = -1; key < 6001; ++key) {
+        auto expected_lower = std::lower_bound(values.begin(), values.end(), key) - values.begin();
+        auto expected_upper = std::upper_bound(values.begin(), values.end(), key) - values.begin();
+        ASSERT_EQ(std::distance(tree.begin(), tree.lower_bound(key)), expected_lower);
+        ASSERT_EQ(std::distance(tree.begin(), tree.upper_bound(key)), expected_upper);
+    }
+}
+
+/**
+ * Leaf layout
+ */
+
+template <typename K, typename V>
+using separate_keys_map =
+    btree<K, std::pair<K, V>, btree_key_extractor_pair, std::less<K>, btree_separate_keys_traits<K, std::pair<K, V>>>;
+
+static_assert(btree_default_traits<int, std::pair<int, int>>::leaf_slots == 256 / 8);
+static_assert(btree_separate_keys_traits<int, std::pair<int, int>>::leaf_slots == 256 / 12);
+
+TEST(leaf_layout, separate_keys_bounds) {
+    std::vector<std::pair<int, std::string>> values;
+    for (int i = 0; i < 2000; ++i) {
+        values.emplace_back(i * 2, std::to_string(i));
+    }
+    const separate_keys_map<int, std::string> tree(values.begin(), values.end());
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), values.begin(), values.end()));
+    for (int key = -1; key < 4001; ++key) {
+        auto lower = tree.lower_bound(key);
+        auto upper = tree.upper_bound(key);
+        if (key < 3998) {
+            ASSERT_EQ(lower->first, key + (key % 2 != 0 ? 1 : 0));
+            ASSERT_EQ(upper->first, key + (key % 2 != 0 ? 1 : 2));
+            ASSERT_EQ(lower.key(), lower->first);
+        } else {
+            ASSERT_EQ(upper, tree.end());
+        }
+    }
+}
+
+/**
+ * Slot storage
+ */
+
+namespace {
+
+// Not default-constructible, counts its live instances
+struct counted {
+    static inline int alive = 0;
+    explicit counted(int v) : value(v) { ++alive; }
+    counted(const counted& other) : value(other.value) { ++alive; }
+    counted& operator=(const counted&) = default;
+    ~counted() { --alive; }
+    int value;
+};
+
+}  // namespace
+
+TEST(slot_storage, only_live_slots_are_constructed) {
+    using map = btree<int, std::pair<int, counted>, btree_key_extractor_pair>;
+    std::vector<std::pair<int, counted>> values;
+    values.reserve(1000);
+    for (int i = 0; i < 1000; ++i) {
+        values.emplace_back(i, counted(i));
+    }
+    const int before = counted::alive;
+    {
+        map tree(values.begin(), values.end());
+        ASSERT_EQ(counted::alive - before, 1000);
+        ASSERT_EQ(tree.lower_bound(500)->second.value, 500);
+    }
+    ASSERT_EQ(counted::alive, before);
+}
+
+/**
+ * Node pool
+ */
+
+namespace {
+
+template <typename T>
+struct pooled_traits : btree_default_traits<T, T> {
+    static const int node_pool_chunk_bytes = 16384;
+};
+
+// Counts the allocations performed through any of its rebound copies
+int allocations = 0;
+
+template <typename T>
+struct counting_allocator {
+    using value_type = T;
+    counting_allocator() noexcept = default;
+    template <typename U>
+    counting_allocator(const counting_allocator<U>&) noexcept {}
+    T* allocate(std::size_t n) {
+        ++allocations;
+        return std::allocator<T>{}.allocate(n);
+    }
+    void deallocate(T* p, std::size_t n) noexcept { std::allocator<T>{}.deallocate(p, n); }
+    template <typename U>
+    bool operator==(const counting_allocator<U>&) const noexcept {
+        return true;
+    }
+};
+
+template <typename T>
+using pooled_set = btree<T, T, btree_key_extractor_self, std::less<T>, pooled_traits<T>, counting_allocator<T>>;
+
+}  // namespace
+
+TEST(node_pool, chunks_come_from_allocator) {
+    std::vector<int> values(100000);
+    std::iota(values.begin(), values.end(), 0);
+    allocations = 0;
+    pooled_set<int> tree(values.begin(), values.end());
+    const auto& stats = tree.get_stats();
+    ASSERT_GT(stats.pool_chunks, 0u);
+    ASSERT_EQ(allocations, static_cast<int>(stats.pool_chunks));
+    ASSERT_LT(stats.pool_chunks * 10, stats.nodes());
+    ASSERT_GE(stats.pool_capacity, stats.nodes());
+    ASSERT_GT(stats.average_fill_pool(), 0.5f);
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), values.begin(), values.end()));
+}
+
+TEST(node_pool, clear_releases_chunks) {
+    std::vector<int> values(10000);
+    std::iota(values.begin(), values.end(), 0);
+    pooled_set<int> tree(values.begin(), values.end());
+    tree.clear();
+    ASSERT_TRUE(tree.empty());
+    ASSERT_EQ(tree.get_stats().pool_chunks, 0u);
+    tree.bulk_load(values.begin(), values.end());
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), values.begin(), values.end()));
+}
+
+TEST(node_pool, non_trivial_values) {
+    using map = btree<int, std::pair<int, std::string>, btree_key_extractor_pair, std::less<int>,
+                      pooled_traits<std::pair<int, std::string>>>;
+    std::vector<std::pair<int, std::string>> values;
+    for (int i = 0; i < 5000; ++i) {
+        values.emplace_back(i, std::string(40, 'x'));
+    }
+    map tree(values.begin(), values.end());
+    ASSERT_EQ(tree.lower_bound(1234)->first, 1234);
+    tree.clear();
+    ASSERT_TRUE(tree.empty());
+}
+
+namespace {
+
+template <typename T>
+using compact_set = btree<T, T, btree_key_extractor_self, std::less<T>, btree_compact_traits<T, T>>;
+
+}  // namespace
+
+static_assert(btree_default_traits<int, int>::inner_slots == 232 / 12);
+static_assert(btree_compact_traits<int, int>::inner_slots == 228 / 8);
+
+TEST(compact_handles, matches_reference) {
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> distribution(0, 20000);
+    compact_set<int> tree;
+    std::multiset<int> reference;
+    for (int i = 0; i < 100000; ++i) {
+        const int value = distribution(generator);
+        if (i % 3 == 2) {
+            ASSERT_EQ(tree.erase(value), reference.erase(value));
+        } else {
+            tree.insert(value);
+            reference.insert(value);
+        }
+    }
+    ASSERT_EQ(tree.verify(), nullptr);
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), reference.begin(), reference.end()));
+    for (int key = -1; key <= 20001; key += 7) {
+        ASSERT_EQ(tree.lower_bound(key) == tree.end() ? -1 : *tree.lower_bound(key),
+                  reference.lower_bound(key) == reference.end() ? -1 : *reference.lower_bound(key));
+    }
+    compact_set<int> moved(std::move(tree));
+    ASSERT_EQ(moved.verify(), nullptr);
+    ASSERT_TRUE(std::equal(moved.begin(), moved.end(), reference.begin(), reference.end()));
+}
+TEST(compact_handles, iterators_walk_leaves_by_handles) {
+    std::vector<int> values(10000);
+    std::iota(values.begin(), values.end(), 0);
+    compact_set<int> tree(values.begin(), values.end());
+    ASSERT_TRUE(std::equal(tree.rbegin(), tree.rend(), values.rbegin(), values.rend()));
+    // Iterators resolve the sibling handles through the chunks of the leaves, which move along with them
+    auto it = std::next(tree.begin(), 100);
+    compact_set<int> moved(std::move(tree));
+    ASSERT_TRUE(std::equal(it, moved.end(), values.begin() + 100, values.end()));
+    ASSERT_EQ(std::prev(it, 100), moved.begin());
+}
+TEST(compact_handles, split_and_join) {
+    std::vector<int> values(50000);
+    std::iota(values.begin(), values.end(), 0);
+    compact_set<int> tree(values.begin(), values.end());
+    auto upper = tree.split(12345);
+    ASSERT_EQ(tree.verify(), nullptr);
+    ASSERT_EQ(upper.verify(), nullptr);
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), values.begin(), values.begin() + 12345));
+    ASSERT_TRUE(std::equal(upper.begin(), upper.end(), values.begin() + 12345, values.end()));
+    tree.join(upper);
+    ASSERT_EQ(tree.verify(), nullptr);
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), values.begin(), values.end()));
+}
+TEST(compact_handles, higher_fanout) {
+    std::vector<int> values(100000);
+    std::iota(values.begin(), values.end(), 0);
+    compact_set<int> compact(values.begin(), values.end());
+    pooled_set<int> plain(values.begin(), values.end());
+    ASSERT_EQ(compact.get_stats().leaves, plain.get_stats().leaves);
+    ASSERT_LT(compact.get_stats().inner_nodes * 4, plain.get_stats().inner_nodes * 3);
+}
+
+namespace {
+
+// Even keys from 0 to 2 * 9999, each one present three times
+set<int> make_batch_tree() {
+    std::vector<int> values(30000);
+    for (int i = 0; i < 30000; ++i) {
+        values[static_cast<std::size_t>(i)] = i / 3 * 2;
+    }
+    return set<int>(values.begin(), values.end());
+}
+
+std::vector<int> make_batch_keys(bool sorted) {
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> distribution(-10, 20010);
+    std::vector<int> keys(1000);
+    std::generate(keys.begin(), keys.end(), [&] { return distribution(generator); });
+    if (sorted) {
+        std::sort(keys.begin(), keys.end());
+    }
+    return keys;
+}
+
+}  // namespace
+
+TEST(batch_lookup, empty) {
+    set<int> tree;
+    std::vector<int> keys{1, 2, 3};
+    std::vector<set<int>::iterator> result(keys.size());
+    tree.lower_bound(keys, result);
+    ASSERT_TRUE(std::all_of(result.begin(), result.end(), [&](auto it) { return it == tree.end(); }));
+}
+TEST(batch_lookup, unsorted_keys) {
+    auto tree = make_batch_tree();
+    auto keys = make_batch_keys(false);
+    std::vector<set<int>::iterator> lower(keys.size()), upper(keys.size());
+    tree.lower_bound(keys, lower);
+    tree.upper_bound(keys, upper);
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        ASSERT_EQ(lower[i], tree.lower_bound(keys[i]));
+        ASSERT_EQ(upper[i], tree.upper_bound(keys[i]));
+    }
+}
+TEST(batch_lookup, sorted_keys) {
+    auto tree = make_batch_tree();
+    auto keys = make_batch_keys(true);
+    std::vector<set<int>::iterator> lower(keys.size()), upper(keys.size());
+    tree.lower_bound(keys, lower);
+    tree.upper_bound(keys, upper);
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        ASSERT_EQ(lower[i], tree.lower_bound(keys[i]));
+        ASSERT_EQ(upper[i], tree.upper_bound(keys[i]));
+    }
+}
+TEST(batch_lookup, const_tree) {
+    const auto tree = make_batch_tree();
+    std::vector<int> keys{0, 7, 8, 20000, 3, 3};
+    std::vector<set<int>::const_iterator> result(keys.size());
+    tree.lower_bound(keys, result);
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        ASSERT_EQ(result[i], tree.lower_bound(keys[i]));
+    }
+}
+
+namespace {
+
+template <typename Traits>
+using string_set = btree<std::string, std::string, btree_key_extractor_self, std::less<std::string>, Traits>;
+
+// Long keys sharing most of their bytes, each one present twice
+std::vector<std::string> make_urls() {
+    std::vector<std::string> urls;
+    for (int i = 0; i < 20000; ++i) {
+        const int id = i / 2 * 7;
+        urls.push_back("https://example.com/static/assets/" + std::to_string(id % 13) + "/images/" +
+                       std::to_string(id));
+    }
+    std::sort(urls.begin(), urls.end());
+    return urls;
+}
+
+}  // namespace
+
+TEST(prefix_compression, bounds) {
+    const auto urls = make_urls();
+    string_set<btree_string_traits<std::string, std::string>> tree(urls.begin(), urls.end());
+    ASSERT_EQ(tree.verify(), nullptr);
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), urls.begin(), urls.end()));
+    std::vector<std::string> probes{"", "a", "https://example.com/static/assets/", "z"};
+    for (std::size_t i = 0; i < urls.size(); i += 7) {
+        probes.push_back(urls[i]);
+        probes.push_back(urls[i] + "0");
+        probes.push_back(urls[i].substr(0, urls[i].size() - 1));
+    }
+    for (const auto& probe : probes) {
+        const auto lower = std::lower_bound(urls.begin(), urls.end(), probe) - urls.begin();
+        const auto upper = std::upper_bound(urls.begin(), urls.end(), probe) - urls.begin();
+        auto it = tree.lower_bound(probe);
+        ASSERT_EQ(it == tree.end(), lower == static_cast<std::ptrdiff_t>(urls.size()));
+        if (it != tree.end()) {
+            ASSERT_EQ(*it, urls[static_cast<std::size_t>(lower)]);
+            ASSERT_TRUE(it == tree.begin() || *std::prev(it) < probe);
+        }
+        it = tree.upper_bound(probe);
+        ASSERT_EQ(it == tree.end(), upper == static_cast<std::ptrdiff_t>(urls.size()));
+        if (it != tree.end()) {
+            ASSERT_EQ(*it, urls[static_cast<std::size_t>(upper)]);
+            ASSERT_TRUE(it == tree.begin() || !(probe < *std::prev(it)));
+        }
+    }
+    std::sort(probes.begin(), probes.end());
+    std::vector<decltype(tree)::iterator> result(probes.size());
+    tree.lower_bound(probes, result);
+    for (std::size_t i = 0; i < probes.size(); ++i) {
+        ASSERT_EQ(result[i], tree.lower_bound(probes[i]));
+    }
+}
+TEST(prefix_compression, higher_fanout) {
+    const auto urls = make_urls();
+    string_set<btree_string_traits<std::string, std::string>> compressed(urls.begin(), urls.end());
+    string_set<btree_default_traits<std::string, std::string>> plain(urls.begin(), urls.end());
+    ASSERT_LT(compressed.get_stats().inner_nodes, plain.get_stats().inner_nodes);
+}
+
+TEST(prefix_compression, keys_as_long_as_inner_key_bytes) {
+    // Separators as long as the keys, so that each inner node holds a single one
+    std::vector<std::string> keys;
+    for (int i = 1000; i < 3000; ++i) {
+        keys.push_back(std::string(1020, 'x') + std::to_string(i));
+    }
+    const string_set<btree_string_traits<std::string, std::string>> loaded(keys.begin(), keys.end());
+    ASSERT_EQ(loaded.verify(), nullptr);
+    ASSERT_TRUE(std::equal(loaded.begin(), loaded.end(), keys.begin(), keys.end()));
+    string_set<btree_string_traits<std::string, std::string>> tree;
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        tree.insert(keys[(i * 7919) % keys.size()]);
+    }
+    ASSERT_EQ(tree.verify(), nullptr);
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), keys.begin(), keys.end()));
+    // Two separators never fit in a node, so that inner nodes left with a single child cannot be rebalanced, nor can
+    // their leaf, which may then underflow
+    std::vector<std::string> remaining;
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        if (i % 2 == 0) {
+            ASSERT_EQ(tree.erase(keys[i]), 1u);
+        } else {
+            remaining.push_back(keys[i]);
+        }
+    }
+    ASSERT_EQ(tree.verify(), nullptr);
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), remaining.begin(), remaining.end()));
+    for (std::size_t i = 0; i + 1 < keys.size(); i += 2) {
+        ASSERT_EQ(*tree.lower_bound(keys[i]), keys[i + 1]);
+    }
+}
+
+TEST(prefix_compression, keys_longer_than_inner_key_bytes) {
+    std::vector<std::string> keys;
+    for (int i = 0; i < 200; ++i) {
+        keys.push_back(std::string(1100, 'x') + std::to_string(i));
+    }
+    std::sort(keys.begin(), keys.end());
+    string_set<btree_string_traits<std::string, std::string>> tree;
+    tree.insert("a");
+    ASSERT_THROW(tree.bulk_load(keys.begin(), keys.end()), std::length_error);
+    ASSERT_THROW(tree.insert(keys[0]), std::length_error);
+    ASSERT_EQ(tree.size(), 1u);
+    ASSERT_EQ(*tree.begin(), "a");
+    ASSERT_EQ(tree.verify(), nullptr);
+    // Only prefix compressed inner nodes limit the length of the keys
+    const string_set<btree_default_traits<std::string, std::string>> plain(keys.begin(), keys.end());
+    ASSERT_EQ(plain.size(), keys.size());
+}
+
+namespace {
+
+struct debug_string_traits : btree_string_traits<std::string, std::string> {
+    static const bool debug = true;
+};
+
+// Keys of 20 to 1000 bytes made of one of a few long random prefixes followed by a random suffix, so that the length
+// of the separators limits the fanout of the inner nodes and the splits between leaves
+std::string make_prefixed_key(std::mt19937& generator, const std::vector<std::string>& prefixes) {
+    const auto& prefix = prefixes[std::uniform_int_distribution<std::size_t>(0, prefixes.size() - 1)(generator)];
+    std::uniform_int_distribution<std::size_t> length(std::max<std::size_t>(20, prefix.size()), 1000);
+    std::string key = prefix;
+    key.resize(length(generator));
+    for (std::size_t i = prefix.size(); i < key.size(); ++i) {
+        key[i] = static_cast<char>(std::uniform_int_distribution<int>('a', 'z')(generator));
+    }
+    return key;
+}
+
+std::vector<std::string> make_prefixes(std::mt19937& generator) {
+    std::vector<std::string> prefixes;
+    for (int i = 0; i < 6; ++i) {
+        prefixes.push_back(std::string(std::uniform_int_distribution<std::size_t>(10, 900)(generator), 'a'));
+        for (auto& c : prefixes.back()) {
+            c = static_cast<char>(std::uniform_int_distribution<int>('a', 'c')(generator));
+        }
+    }
+    return prefixes;
+}
+
+}  // namespace
+
+TEST(prefix_compression, random_erasures) {
+    std::mt19937 generator(11);
+    for (int round = 0; round < 4; ++round) {
+        const auto prefixes = make_prefixes(generator);
+        string_set<debug_string_traits> tree;
+        std::multiset<std::string> reference;
+        for (int i = 0; i < 3000; ++i) {
+            const int action = std::uniform_int_distribution<int>(0, 9)(generator);
+            const std::string key = make_prefixed_key(generator, prefixes);
+            if (action < 6) {
+                tree.insert(key);
+                reference.insert(key);
+            } else if (action < 9 && !reference.empty()) {
+                auto it = reference.begin();
+                std::advance(it, std::uniform_int_distribution<std::size_t>(0, reference.size() - 1)(generator));
+                const std::string erased = *it;
+                ASSERT_EQ(tree.erase(erased), reference.erase(erased));
+            } else {
+                const std::string other = make_prefixed_key(generator, prefixes);
+                const auto& lower = std::min(key, other);
+                const auto& upper = std::max(key, other);
+                const auto first = reference.lower_bound(lower);
+                const auto last = reference.lower_bound(upper);
+                ASSERT_EQ(tree.erase_range(lower, upper), static_cast<std::size_t>(std::distance(first, last)));
+                reference.erase(first, last);
+            }
+        }
+        ASSERT_EQ(tree.verify(), nullptr);
+        ASSERT_TRUE(std::equal(tree.begin(), tree.end(), reference.begin(), reference.end()));
+    }
+}
+
+namespace {
+
+template <typename T>
+struct stats_traits : btree_default_traits<T, T> {
+    static const bool with_stats = true;
+    static const bool debug = true;
+};
+
+template <typename T>
+using stats_set = btree<T, T, btree_key_extractor_self, std::less<T>, stats_traits<T>>;
+
+}  // namespace
+
+TEST(counters, lookups) {
+    std::vector<int> values(10000);
+    std::iota(values.begin(), values.end(), 0);
+    stats_set<int> tree(values.begin(), values.end());
+    auto counters = tree.get_counters();
+    ASSERT_EQ(counters.lookups, 0u);
+    ASSERT_EQ(counters.allocations, tree.get_stats().nodes());
+    for (int key = 0; key < 100; ++key) {
+        ASSERT_EQ(*tree.lower_bound(key), key);
+    }
+    std::vector<stats_set<int>::iterator> result(values.size());
+    tree.upper_bound(values, result);
+    counters = tree.get_counters();
+    ASSERT_EQ(counters.lookups, 100u + values.size());
+    ASSERT_GT(counters.key_comparisons, counters.lookups);
+    // Each single lookup searches one node per level
+    ASSERT_GE(counters.nodes_visited, 100u * counters.height);
+    ASSERT_GE(counters.height, 2u);
+    tree.reset_counters();
+    ASSERT_EQ(tree.get_counters().lookups, 0u);
+}
+TEST(counters, fill_histograms) {
+    std::vector<int> values(10000);
+    std::iota(values.begin(), values.end(), 0);
+    stats_set<int> tree;
+    tree.bulk_load(values.begin(), values.end(), 0.5f);
+    const auto counters = tree.get_counters();
+    const auto& leaf_fill = counters.leaf_fill;
+    ASSERT_EQ(std::accumulate(leaf_fill.begin(), leaf_fill.end(), std::size_t{0}), tree.get_stats().leaves);
+    ASSERT_EQ(leaf_fill[5], tree.get_stats().leaves);
+    const auto& inner_fill = counters.inner_fill;
+    ASSERT_EQ(std::accumulate(inner_fill.begin(), inner_fill.end(), std::size_t{0}), tree.get_stats().inner_nodes);
+}
+TEST(counters, clear_deallocates_all_nodes) {
+    std::vector<int> values(10000);
+    std::iota(values.begin(), values.end(), 0);
+    stats_set<int> tree(values.begin(), values.end());
+    const auto nodes = tree.get_stats().nodes();
+    tree.clear();
+    ASSERT_EQ(tree.get_counters().deallocations, nodes);
+    ASSERT_EQ(tree.get_counters().height, 0u);
+}
+
+/**
+ * Order statistics
+ */
+
+namespace {
+
+template <typename T>
+struct order_statistics_traits : btree_default_traits<T, T> {
+    static const bool order_statistics = true;
+    static const bool debug = true;
+};
+
+template <typename T>
+using order_statistics_set = btree<T, T, btree_key_extractor_self, std::less<T>, order_statistics_traits<T>>;
+
+}  // namespace
+
+TEST(order_statistics, empty) {
+    const order_statistics_set<int> tree;
+    ASSERT_EQ(tree.nth(0), tree.end());
+    ASSERT_EQ(tree.rank(3), 0u);
+    ASSERT_EQ(tree.count(3), 0u);
+    ASSERT_EQ(tree.index_of(tree.end()), 0u);
+}
+TEST(order_statistics, nth_and_rank) {
+    std::vector<int> values(20000);
+    std::iota(values.begin(), values.end(), 0);
+    std::transform(values.begin(), values.end(), values.begin(), [](int value) { return value * 2; });
+    order_statistics_set<int> tree;
+    tree.bulk_load(values.begin(), values.end(), 0.7f);
+    for (std::size_t n = 0; n < values.size(); n += 7) {
+        const auto it = tree.nth(n);
+        ASSERT_EQ(*it, values[n]);
+        ASSERT_EQ(tree.index_of(it), n);
+        ASSERT_EQ(tree.rank(values[n]), n);
+        ASSERT_EQ(tree.rank(values[n] + 1), n + 1);
+    }
+    ASSERT_EQ(tree.nth(values.size()), tree.end());
+    ASSERT_EQ(tree.rank(-1), 0u);
+    ASSERT_EQ(tree.rank(values.back() + 1), values.size());
+    ASSERT_EQ(tree.index_of(tree.end()), values.size());
+}
+TEST(order_statistics, count_ranges) {
+    std::vector<int> values(10000);
+    std::iota(values.begin(), values.end(), 0);
+    const order_statistics_set<int> tree(values.begin(), values.end());
+    ASSERT_EQ(tree.count(100, 200), 100u);
+    ASSERT_EQ(tree.count(-50, 50), 50u);
+    ASSERT_EQ(tree.count(9990, 20000), 10u);
+    ASSERT_EQ(tree.count(200, 100), 0u);
+    ASSERT_EQ(tree.count(42), 1u);
+    ASSERT_EQ(tree.count(-42), 0u);
+}
+TEST(order_statistics, duplicates_spanning_leaves) {
+    std::vector<int> values;
+    for (int i = 0; i < 5000; ++i) {
+        values.push_back(i / 1000);
+    }
+    const order_statistics_set<int> tree(values.begin(), values.end());
+    for (int key = 0; key < 5; ++key) {
+        ASSERT_EQ(tree.count(key), 1000u);
+        ASSERT_EQ(tree.rank(key), static_cast<std::size_t>(key) * 1000);
+    }
+    // Every iterator over equivalent keys has its own position
+    std::size_t n = 0;
+    for (auto it = tree.begin(); it != tree.end(); ++it, ++n) {
+        ASSERT_EQ(tree.index_of(it), n);
+    }
+}
+
+/**
+ * Subtree aggregates
+ */
+
+namespace {
+
+template <typename Value, typename Aggregate>
+struct aggregate_traits : btree_default_traits<Value, Value> {
+    using aggregate = Aggregate;
+    static const bool debug = true;
+};
+
+template <typename Aggregate>
+using aggregate_set = btree<int, int, btree_key_extractor_self, std::less<int>, aggregate_traits<int, Aggregate>>;
+
+struct second {
+    [[nodiscard]] double operator()(const std::pair<int, double>& value) const { return value.second; }
+};
+
+template <typename Aggregate>
+using aggregate_map = btree<int,
+                            std::pair<int, double>,
+                            btree_key_extractor_pair,
+                            std::less<int>,
+                            aggregate_traits<std::pair<int, double>, Aggregate>>;
+
+// Concatenation of the values, which is associative but not commutative
+struct sequence_aggregate {
+    using value_type = std::vector<int>;
+    static value_type identity() { return {}; }
+    static value_type lift(int value) { return {value}; }
+    static value_type combine(value_type a, const value_type& b) {
+        a.insert(a.end(), b.begin(), b.end());
+        return a;
+    }
+};
+
+}  // namespace
+
+TEST(aggregate, empty) {
+    const aggregate_set<btree_sum_aggregate<std::int64_t>> tree;
+    ASSERT_EQ(tree.aggregate(0, 100), 0);
+}
+TEST(aggregate, sum_over_ranges) {
+    std::vector<int> values(20000);
+    std::iota(values.begin(), values.end(), 0);
+    const aggregate_set<btree_sum_aggregate<std::int64_t>> tree(values.begin(), values.end());
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> bound(-100, 20100);
+    for (int i = 0; i < 1000; ++i) {
+        const int lower = bound(generator);
+        const int upper = bound(generator);
+        std::int64_t expected = 0;
+        for (int value = std::max(lower, 0); value < std::min(upper, 20000); ++value) {
+            expected += value;
+        }
+        ASSERT_EQ(tree.aggregate(lower, upper), expected);
+    }
+}
+TEST(aggregate, min_max_of_mapped_values) {
+    std::vector<std::pair<int, double>> values;
+    for (int i = 0; i < 5000; ++i) {
+        values.emplace_back(i, static_cast<double>((i * 7919) % 5000));
+    }
+    const aggregate_map<btree_max_aggregate<double, second>> max_tree(values.begin(), values.end());
+    const aggregate_map<btree_min_aggregate<double, second>> min_tree(values.begin(), values.end());
+    for (int lower = 0; lower < 5000; lower += 331) {
+        const int upper = lower + 1000;
+        double expected_min = std::numeric_limits<double>::max();
+        double expected_max = std::numeric_limits<double>::lowest();
+        for (int i = lower; i < std::min(upper, 5000); ++i) {
+            expected_min = std::min(expected_min, values[static_cast<std::size_t>(i)].second);
+            expected_max = std::max(expected_max, values[static_cast<std::size_t>(i)].second);
+        }
+        ASSERT_EQ(min_tree.aggregate(lower, upper), expected_min);
+        ASSERT_EQ(max_tree.aggregate(lower, upper), expected_max);
+    }
+}
+TEST(aggregate, combines_in_order) {
+    std::vector<int> values;
+    for (int i = 0; i < 3000; ++i) {
+        values.push_back(i / 3);
+    }
+    const aggregate_set<sequence_aggregate> tree(values.begin(), values.end());
+    ASSERT_EQ(tree.aggregate(100, 900), std::vector<int>(values.begin() + 300, values.begin() + 2700));
+    ASSERT_EQ(tree.aggregate(5, 5), std::vector<int>{});
+}
+
+/**
+ * Leaf spans
+ */
+
+TEST(leaf_span, empty) {
+    const set<int> tree;
+    std::size_t calls = 0;
+    tree.for_each_leaf_span([&](std::span<const int>) { ++calls; });
+    ASSERT_EQ(calls, 0u);
+}
+TEST(leaf_span, whole_tree) {
+    std::vector<int> values(10000);
+    std::iota(values.begin(), values.end(), 0);
+    const set<int> tree(values.begin(), values.end());
+    std::vector<int> visited;
+    std::size_t spans = 0;
+    tree.for_each_leaf_span([&](std::span<const int> span) {
+        visited.insert(visited.end(), span.begin(), span.end());
+        ++spans;
+    });
+    ASSERT_EQ(visited, values);
+    ASSERT_EQ(spans, tree.get_stats().leaves);
+}
+TEST(leaf_span, sub_ranges) {
+    std::vector<int> values(3000);
+    std::iota(values.begin(), values.end(), 0);
+    set<int> tree(values.begin(), values.end());
+    for (const auto& [lower, upper] : {std::pair{0, 3000}, {10, 20}, {100, 2900}, {1500, 1500}, {2999, 3000}}) {
+        std::vector<int> visited;
+        tree.for_each_leaf_span(tree.lower_bound(lower), tree.lower_bound(upper), [&](std::span<int> span) {
+            visited.insert(visited.end(), span.begin(), span.end());
+        });
+        ASSERT_EQ(visited, std::vector<int>(values.begin() + lower, values.begin() + upper));
+    }
+}
+
+/**
+ * Range splitting
+ */
+
+TEST(split_range, empty) {
+    const set<int> tree;
+    const auto boundaries = tree.split_range(8);
+    ASSERT_EQ(boundaries.size(), 2u);
+    ASSERT_EQ(boundaries.front(), tree.end());
+    ASSERT_EQ(boundaries.back(), tree.end());
+}
+TEST(split_range, covers_range_in_order) {
+    std::vector<int> values(100000);
+    std::iota(values.begin(), values.end(), 0);
+    const set<int> tree(values.begin(), values.end());
+    for (const auto& [lower, upper] : {std::pair{0, 100000}, {-10, 200000}, {5, 10}, {1234, 98765}, {500, 400}}) {
+        for (std::size_t parts : {1u, 2u, 7u, 64u, 100000u}) {
+            const auto boundaries = tree.split_range(lower, upper, parts);
+            ASSERT_GE(boundaries.size(), 2u);
+            ASSERT_LE(boundaries.size(), parts + 1);
+            ASSERT_EQ(boundaries.front(), tree.lower_bound(lower));
+            ASSERT_EQ(boundaries.back(), lower < upper ? tree.lower_bound(upper) : tree.lower_bound(lower));
+            std::vector<int> visited;
+            for (std::size_t part = 0; part + 1 < boundaries.size(); ++part) {
+                for (auto it = boundaries[part]; it != boundaries[part + 1]; ++it) {
+                    visited.push_back(*it);
+                }
+            }
+            const int first = std::clamp(lower, 0, 100000);
+            const int last = std::max(first, std::clamp(upper, 0, 100000));
+            ASSERT_EQ(visited, std::vector<int>(values.begin() + first, values.begin() + last));
+        }
+    }
+}
+TEST(split_range, balanced_parts) {
+    std::vector<int> values(100000);
+    std::iota(values.begin(), values.end(), 0);
+    const set<int> tree(values.begin(), values.end());
+    const auto boundaries = tree.split_range(4);
+    ASSERT_EQ(boundaries.size(), 5u);
+    for (std::size_t part = 0; part + 1 < boundaries.size(); ++part) {
+        const auto size = std::distance(boundaries[part], boundaries[part + 1]);
+        ASSERT_GT(size, 15000);
+        ASSERT_LT(size, 35000);
+    }
+}
+
+/**
+ * Range erase
+ */
+
+namespace {
+
+// Small nodes give deep trees, whose sizes and aggregates are checked after each erasure
+template <typename T>
+struct small_node_traits : btree_default_traits<T, T> {
+    static const int leaf_slots = 8;
+    static const int inner_slots = 8;
+    static const bool debug = true;
+    static const bool order_statistics = true;
+    using aggregate = btree_sum_aggregate<std::int64_t>;
+};
+
+template <typename T>
+using small_node_set = btree<T, T, btree_key_extractor_self, std::less<T>, small_node_traits<T>>;
+
+}  // namespace
+
+TEST(erase, empty) {
+    set<int> tree;
+    ASSERT_EQ(tree.erase_range(0, 10), 0u);
+    ASSERT_EQ(tree.erase(3), 0u);
+    ASSERT_EQ(tree.erase(tree.begin(), tree.end()), tree.end());
+}
+TEST(erase, ranges_match_reference) {
+    std::mt19937 generator(42);
+    for (const float fill_factor : {0.5f, 0.8f, 1.0f}) {
+        std::vector<int> values(3000);
+        std::iota(values.begin(), values.end(), 0);
+        small_node_set<int> tree;
+        tree.bulk_load(values.begin(), values.end(), fill_factor);
+        while (!values.empty()) {
+            std::uniform_int_distribution<int> bound(-10, 3010);
+            const int lower = bound(generator);
+            const int upper = std::min(lower + std::uniform_int_distribution<int>(0, 400)(generator), 3010);
+            const auto first = std::lower_bound(values.begin(), values.end(), lower);
+            const auto last = std::lower_bound(first, values.end(), upper);
+            ASSERT_EQ(tree.erase_range(lower, upper), static_cast<std::size_t>(last - first));
+            values.erase(first, last);
+            ASSERT_EQ(tree.size(), values.size());
+            ASSERT_TRUE(std::equal(tree.begin(), tree.end(), values.begin(), values.end()));
+            ASSERT_EQ(tree.count(-10, 3010), values.size());
+            ASSERT_EQ(tree.aggregate(-10, 3010), std::accumulate(values.begin(), values.end(), std::int64_t{0}));
+        }
+        ASSERT_EQ(tree.verify(), nullptr);
+        ASSERT_EQ(tree.get_stats().nodes(), 0u);
+    }
+}
+TEST(erase, iterator_ranges_with_duplicates) {
+    std::vector<int> values;
+    for (int i = 0; i < 4000; ++i) {
+        values.push_back(i / 50);
+    }
+    small_node_set<int> tree(values.begin(), values.end());
+    std::mt19937 generator(7);
+    while (!values.empty()) {
+        const auto size = static_cast<int>(values.size());
+        const int offset = std::uniform_int_distribution<int>(0, size - 1)(generator);
+        const int length = std::uniform_int_distribution<int>(0, std::min(size - offset, 300))(generator);
+        const auto it = tree.erase(tree.nth(static_cast<std::size_t>(offset)),
+                                   tree.nth(static_cast<std::size_t>(offset + length)));
+        values.erase(values.begin() + offset, values.begin() + offset + length);
+        ASSERT_EQ(tree.index_of(it), static_cast<std::size_t>(offset));
+        ASSERT_TRUE(std::equal(tree.begin(), tree.end(), values.begin(), values.end()));
+    }
+    ASSERT_TRUE(tree.empty());
+}
+TEST(erase, iterators_in_runs_of_equivalent_keys) {
+    std::vector<int> values(5000, 7);
+    values.push_back(8);
+    stats_set<int> tree(values.begin(), values.end());
+    tree.reset_counters();
+    // The value following the erased ones is tracked, not searched again among the equivalent keys
+    auto it = tree.erase(std::next(tree.begin(), 2500));
+    ASSERT_EQ(tree.get_counters().lookups, 1u);
+    ASSERT_EQ(std::distance(tree.begin(), it), 2500);
+    tree.reset_counters();
+    it = tree.erase(std::next(tree.begin(), 1000), std::next(tree.begin(), 3000));
+    ASSERT_EQ(tree.get_counters().lookups, 2u);
+    ASSERT_EQ(std::distance(tree.begin(), it), 1000);
+    it = tree.erase(std::next(tree.begin(), 1000), std::prev(tree.end()));
+    ASSERT_EQ(*it, 8);
+    ASSERT_EQ(tree.size(), 1001u);
+    ASSERT_EQ(tree.verify(), nullptr);
+}
+TEST(erase, single_values_and_keys) {
+    std::vector<int> values;
+    for (int i = 0; i < 2000; ++i) {
+        values.push_back(i / 4);
+    }
+    small_node_set<int> tree(values.begin(), values.end());
+    ASSERT_EQ(tree.erase(100), 4u);
+    ASSERT_EQ(tree.erase(100), 0u);
+    ASSERT_EQ(tree.count(100), 0u);
+    const auto it = tree.erase(tree.lower_bound(200));
+    ASSERT_EQ(*it, 200);
+    ASSERT_EQ(tree.count(200), 3u);
+    for (int key = 0; key < 500; key += 2) {
+        tree.erase(key);
+    }
+    ASSERT_EQ(tree.size(), 1000u);
+    ASSERT_EQ(tree.verify(), nullptr);
+}
+TEST(erase, frees_covered_nodes) {
+    std::vector<int> values(100000);
+    std::iota(values.begin(), values.end(), 0);
+    set<int> tree(values.begin(), values.end());
+    ASSERT_EQ(tree.erase_range(10, 99990), 99980u);
+    ASSERT_EQ(tree.verify(), nullptr);
+    ASSERT_EQ(tree.size(), 20u);
+    ASSERT_LE(tree.get_stats().nodes(), 2u);
+    ASSERT_EQ(*std::next(tree.begin(), 10), 99990);
+}
+TEST(erase, separate_keys_map) {
+    std::vector<std::pair<int, int>> values;
+    for (int i = 0; i < 5000; ++i) {
+        values.emplace_back(i, -i);
+    }
+    separate_keys_map<int, int> tree(values.begin(), values.end());
+    ASSERT_EQ(tree.erase_range(1000, 4000), 3000u);
+    ASSERT_EQ(tree.verify(), nullptr);
+    values.erase(values.begin() + 1000, values.begin() + 4000);
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), values.begin(), values.end()));
+}
+TEST(erase, prefix_compressed) {
+    auto urls = make_urls();
+    string_set<btree_string_traits<std::string, std::string>> tree(urls.begin(), urls.end());
+    std::mt19937 generator(3);
+    for (int i = 0; i < 50 && !urls.empty(); ++i) {
+        const auto lower = urls[std::uniform_int_distribution<std::size_t>(0, urls.size() - 1)(generator)];
+        const auto upper = lower + std::to_string(i % 10);
+        const auto first = std::lower_bound(urls.begin(), urls.end(), lower);
+        const auto last = std::lower_bound(first, urls.end(), upper);
+        ASSERT_EQ(tree.erase_range(lower, upper), static_cast<std::size_t>(last - first));
+        urls.erase(first, last);
+        ASSERT_EQ(tree.verify(), nullptr);
+    }
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), urls.begin(), urls.end()));
+    ASSERT_EQ(tree.erase_range("", "~"), urls.size());
+    ASSERT_TRUE(tree.empty());
+}
+
+/**
+ * Split, join and merge
+ */
+
+namespace {
+
+template <typename Tree, typename Values>
+void expect_content(const Tree& tree, const Values& values) {
+    ASSERT_EQ(tree.verify(), nullptr);
+    ASSERT_EQ(tree.size(), values.size());
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), values.begin(), values.end()));
+}
+
+}  // namespace
+
+TEST(split, empty_and_edges) {
+    small_node_set<int> empty;
+    ASSERT_TRUE(empty.split(3).empty());
+
+    std::vector<int> values(500);
+    std::iota(values.begin(), values.end(), 0);
+    small_node_set<int> tree(values.begin(), values.end());
+    auto upper = tree.split(1000);
+    ASSERT_TRUE(upper.empty());
+    expect_content(tree, values);
+    upper = tree.split(-1);
+    ASSERT_TRUE(tree.empty());
+    ASSERT_EQ(tree.verify(), nullptr);
+    expect_content(upper, values);
+}
+TEST(split, matches_reference) {
+    std::vector<int> values;
+    for (int i = 0; i < 3000; ++i) {
+        values.push_back(i / 3);
+    }
+    std::mt19937 generator(42);
+    for (const float fill_factor : {0.5f, 1.0f}) {
+        for (int i = 0; i < 50; ++i) {
+            small_node_set<int> tree;
+            tree.bulk_load(values.begin(), values.end(), fill_factor);
+            const int key = std::uniform_int_distribution<int>(0, 1000)(generator);
+            auto upper = tree.split(key);
+            const auto middle = std::lower_bound(values.begin(), values.end(), key);
+            expect_content(tree, std::vector<int>(values.begin(), middle));
+            expect_content(upper, std::vector<int>(middle, values.end()));
+            ASSERT_EQ(upper.count(0, 1000), static_cast<std::size_t>(values.end() - middle));
+            ASSERT_EQ(tree.aggregate(0, 1000), std::accumulate(values.begin(), middle, std::int64_t{0}));
+        }
+    }
+}
+TEST(join, concatenates_in_order) {
+    std::mt19937 generator(7);
+    for (int i = 0; i < 100; ++i) {
+        std::uniform_int_distribution<int> size(0, 2000);
+        std::vector<int> lower_values(static_cast<std::size_t>(size(generator)));
+        std::vector<int> upper_values(static_cast<std::size_t>(size(generator)));
+        std::iota(lower_values.begin(), lower_values.end(), 0);
+        std::iota(upper_values.begin(), upper_values.end(), static_cast<int>(lower_values.size()));
+        small_node_set<int> lower(lower_values.begin(), lower_values.end());
+        small_node_set<int> upper(upper_values.begin(), upper_values.end());
+        if (i % 2 == 0) {
+            lower.join(upper);
+            ASSERT_TRUE(upper.empty());
+            ASSERT_EQ(upper.verify(), nullptr);
+        } else {
+            upper.join(lower);
+            std::swap(lower, upper);
+        }
+        lower_values.insert(lower_values.end(), upper_values.begin(), upper_values.end());
+        expect_content(lower, lower_values);
+        ASSERT_EQ(lower.count(0, 5000), lower_values.size());
+    }
+}
+TEST(join, inverse_of_split) {
+    std::vector<int> values;
+    for (int i = 0; i < 5000; ++i) {
+        values.push_back(i / 4);
+    }
+    small_node_set<int> tree(values.begin(), values.end());
+    std::mt19937 generator(3);
+    for (int i = 0; i < 100; ++i) {
+        auto upper = tree.split(std::uniform_int_distribution<int>(0, 1250)(generator));
+        tree.join(upper);
+        expect_content(tree, values);
+    }
+}
+TEST(join, equivalent_keys_at_boundary) {
+    std::vector<int> values(100, 5);
+    small_node_set<int> lower(values.begin(), values.begin() + 40);
+    small_node_set<int> upper(values.begin() + 40, values.end());
+    lower.join(upper);
+    expect_content(lower, values);
+}
+TEST(join, overlapping_ranges_merge) {
+    std::vector<int> evens;
+    std::vector<int> odds;
+    for (int i = 0; i < 3000; ++i) {
+        (i % 2 == 0 ? evens : odds).push_back(i);
+    }
+    small_node_set<int> tree(evens.begin(), evens.end());
+    small_node_set<int> other(odds.begin(), odds.end());
+    tree.join(other);
+    ASSERT_TRUE(other.empty());
+    std::vector<int> values(3000);
+    std::iota(values.begin(), values.end(), 0);
+    expect_content(tree, values);
+}
+TEST(merge, keeps_values_of_tree_first) {
+    using map = btree<int, std::pair<int, std::string>, btree_key_extractor_pair>;
+    std::vector<std::pair<int, std::string>> left;
+    std::vector<std::pair<int, std::string>> right;
+    for (int i = 0; i < 2000; ++i) {
+        left.emplace_back(i / 2, "left");
+        right.emplace_back(i / 3, "right");
+    }
+    map tree(left.begin(), left.end());
+    map other(right.begin(), right.end());
+    tree.merge(other);
+    ASSERT_TRUE(other.empty());
+    ASSERT_EQ(tree.verify(), nullptr);
+    ASSERT_EQ(tree.size(), 4000u);
+    std::vector<std::pair<int, std::string>> expected = left;
+    expected.insert(expected.end(), right.begin(), right.end());
+    std::stable_sort(expected.begin(), expected.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), expected.begin(), expected.end()));
+}
+TEST(split, prefix_compressed) {
+    const auto urls = make_urls();
+    using string_tree = string_set<btree_string_traits<std::string, std::string>>;
+    string_tree tree(urls.begin(), urls.end());
+    std::mt19937 generator(5);
+    for (int i = 0; i < 30; ++i) {
+        const auto& key = urls[std::uniform_int_distribution<std::size_t>(0, urls.size() - 1)(generator)];
+        string_tree upper = tree.split(key);
+        const auto middle = std::lower_bound(urls.begin(), urls.end(), key);
+        expect_content(tree, std::vector<std::string>(urls.begin(), middle));
+        expect_content(upper, std::vector<std::string>(middle, urls.end()));
+        tree.join(upper);
+        expect_content(tree, urls);
+    }
+}
+namespace {
+
+// Few separators per inner node and few values per leaf, so that splits and joins often fail to rebalance nodes
+struct small_string_traits : btree_string_traits<std::string, std::string> {
+    static const int leaf_slots = 4;
+    static const int inner_slots = 8;
+    static const int inner_key_bytes = 64;
+    static const bool debug = true;
+};
+
+// Sorted keys of up to 64 bytes, made of one of many long random prefixes followed by a random suffix
+std::vector<std::string> make_short_prefixed_keys(std::mt19937& generator, std::size_t count) {
+    std::vector<std::string> prefixes(50);
+    for (auto& prefix : prefixes) {
+        prefix.resize(std::uniform_int_distribution<std::size_t>(30, 60)(generator));
+        for (auto& c : prefix) {
+            c = static_cast<char>(std::uniform_int_distribution<int>('a', 'c')(generator));
+        }
+    }
+    std::vector<std::string> keys;
+    for (std::size_t i = 0; i < count; ++i) {
+        std::string key = prefixes[std::uniform_int_distribution<std::size_t>(0, prefixes.size() - 1)(generator)];
+        const std::size_t prefix_size = key.size();
+        key.resize(std::uniform_int_distribution<std::size_t>(prefix_size, 64)(generator));
+        for (std::size_t j = prefix_size; j < key.size(); ++j) {
+            key[j] = static_cast<char>(std::uniform_int_distribution<int>('a', 'z')(generator));
+        }
+        keys.push_back(std::move(key));
+    }
+    std::sort(keys.begin(), keys.end());
+    return keys;
+}
+
+}  // namespace
+
+TEST(split, small_prefix_compressed_nodes) {
+    using string_tree = string_set<small_string_traits>;
+    std::mt19937 generator(13);
+    const auto keys = make_short_prefixed_keys(generator, 3000);
+    string_tree tree;
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        tree.insert(keys[(i * 7919) % keys.size()]);
+    }
+    for (int i = 0; i < 100; ++i) {
+        const auto& key = keys[std::uniform_int_distribution<std::size_t>(0, keys.size() - 1)(generator)];
+        string_tree upper = tree.split(key);
+        const auto middle = std::lower_bound(keys.begin(), keys.end(), key);
+        expect_content(tree, std::vector<std::string>(keys.begin(), middle));
+        expect_content(upper, std::vector<std::string>(middle, keys.end()));
+        if (i % 2 == 0) {
+            tree.join(upper);
+        } else {
+            upper.join(tree);
+            std::swap(tree, upper);
+        }
+        expect_content(tree, keys);
+    }
+}
+TEST(merge, small_prefix_compressed_nodes) {
+    using string_tree = string_set<small_string_traits>;
+    std::mt19937 generator(17);
+    const auto keys = make_short_prefixed_keys(generator, 3000);
+    std::vector<std::string> left;
+    std::vector<std::string> right;
+    for (const auto& key : keys) {
+        (std::uniform_int_distribution<int>(0, 2)(generator) == 0 ? left : right).push_back(key);
+    }
+    string_tree tree(left.begin(), left.end());
+    string_tree other(right.begin(), right.end());
+    tree.merge(other);
+    ASSERT_TRUE(other.empty());
+    expect_content(tree, keys);
+}
+TEST(split, node_pool) {
+    std::vector<int> values(20000);
+    std::iota(values.begin(), values.end(), 0);
+    pooled_set<int> tree(values.begin(), values.end());
+    auto upper = tree.split(12345);
+    expect_content(tree, std::vector<int>(values.begin(), values.begin() + 12345));
+    expect_content(upper, std::vector<int>(values.begin() + 12345, values.end()));
+    tree.join(upper);
+    expect_content(tree, values);
+}
+
+/**
+ * Insert
+ */
+TEST(insert, into_empty_tree) {
+    set<int> tree;
+    auto it = tree.insert(3);
+    ASSERT_EQ(it, tree.begin());
+    ASSERT_EQ(*it, 3);
+    ASSERT_EQ(tree.size(), 1u);
+    ASSERT_EQ(tree.verify(), nullptr);
+}
+TEST(insert, matches_reference) {
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> distribution(0, 500);
+    small_node_set<int> tree;
+    std::vector<int> values;
+    for (int i = 0; i < 5000; ++i) {
+        const int value = distribution(generator);
+        const auto it = tree.insert(value);
+        ASSERT_EQ(tree.index_of(it), static_cast<std::size_t>(std::upper_bound(values.begin(), values.end(), value) -
+                                                              values.begin()));
+        values.insert(std::upper_bound(values.begin(), values.end(), value), value);
+    }
+    ASSERT_EQ(tree.verify(), nullptr);
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), values.begin(), values.end()));
+    ASSERT_EQ(tree.aggregate(0, 501), std::accumulate(values.begin(), values.end(), std::int64_t{0}));
+}
+TEST(insert, appends_fill_leaves) {
+    set<int> tree;
+    for (int i = 0; i < 100000; ++i) {
+        tree.insert(i);
+    }
+    ASSERT_EQ(tree.verify(), nullptr);
+    ASSERT_GT(tree.get_stats().average_fill_leaves(), 0.85f);
+    ASSERT_EQ(tree.lower_bound(12345).key(), 12345);
+}
+TEST(insert, nearly_sorted_keys) {
+    std::vector<int> values(3000);
+    std::iota(values.begin(), values.end(), 0);
+    std::mt19937 generator(7);
+    for (std::size_t i = 0; i + 8 < values.size(); i += 10) {
+        std::swap(values[i], values[i + std::uniform_int_distribution<std::size_t>(1, 8)(generator)]);
+    }
+    small_node_set<int> tree;
+    for (const int value : values) {
+        tree.insert(tree.end(), value);
+    }
+    std::sort(values.begin(), values.end());
+    ASSERT_EQ(tree.verify(), nullptr);
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), values.begin(), values.end()));
+    ASSERT_EQ(tree.count(0, 3000), values.size());
+}
+TEST(insert, hint_goes_before_it) {
+    using map = btree<int, std::pair<int, int>, btree_key_extractor_pair>;
+    map tree;
+    for (int i = 0; i < 1000; ++i) {
+        tree.insert({i / 10, 0});
+    }
+    // Right before the hint when the key belongs there, after the equivalent keys otherwise
+    auto it = tree.insert(tree.lower_bound(50), {50, 1});
+    ASSERT_EQ(it, tree.lower_bound(50));
+    it = tree.insert(tree.lower_bound(20), {60, 2});
+    ASSERT_EQ(std::next(it), tree.lower_bound(61));
+    it = tree.insert(std::next(tree.lower_bound(70), 5), {70, 3});
+    ASSERT_EQ(std::distance(tree.lower_bound(70), it), 5);
+    ASSERT_EQ(tree.verify(), nullptr);
+    ASSERT_EQ(tree.size(), 1003u);
+}
+TEST(insert, prefix_compressed) {
+    auto urls = make_urls();
+    std::shuffle(urls.begin(), urls.end(), std::mt19937(3));
+    string_set<btree_string_traits<std::string, std::string>> tree;
+    for (const auto& url : urls) {
+        tree.insert(url);
+    }
+    std::sort(urls.begin(), urls.end());
+    ASSERT_EQ(tree.verify(), nullptr);
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), urls.begin(), urls.end()));
+}
+TEST(insert, join_after_appends) {
+    small_node_set<int> lower;
+    small_node_set<int> upper;
+    std::vector<int> values(3000);
+    std::iota(values.begin(), values.end(), 0);
+    for (const int value : values) {
+        (value < 2000 ? lower : upper).insert(value);
+    }
+    // The right edge of the lower tree, which appends left nearly empty, becomes inner nodes of the result
+    lower.join(upper);
+    expect_content(lower, values);
+    upper.insert(-1);
+    upper.join(lower);
+    values.insert(values.begin(), -1);
+    expect_content(upper, values);
+}
+
+/**
+ * Heterogeneous lookup
+ */
+
+namespace {
+
+// Key counting its conversions from int, compared with ints by a transparent comparator
+struct tracked_key {
+    static inline int conversions = 0;
+
+    tracked_key(int v) : value(v) { ++conversions; }
+
+    int value;
+};
+
+struct tracked_key_less {
+    using is_transparent = void;
+
+    bool operator()(const tracked_key& a, const tracked_key& b) const { return a.value < b.value; }
+    bool operator()(const tracked_key& a, int b) const { return a.value < b; }
+    bool operator()(int a, const tracked_key& b) const { return a < b.value; }
+};
+
+struct tracked_key_traits : btree_default_traits<tracked_key, tracked_key> {
+    static const bool order_statistics = true;
+};
+
+using tracked_key_set = btree<tracked_key, tracked_key, btree_key_extractor_self, tracked_key_less, tracked_key_traits>;
+
+// Transparent comparator ordering the probes only against the keys, not against each other
+struct fractional_probe_less {
+    using is_transparent = void;
+
+    bool operator()(long a, long b) const { return a < b; }
+    bool operator()(long a, double b) const { return static_cast<double>(a) < b; }
+    bool operator()(double a, long b) const { return a < static_cast<double>(b); }
+};
+
+template <typename Traits>
+using transparent_string_set = btree<std::string, std::string, btree_key_extractor_self, std::less<>, Traits>;
+
+}  // namespace
+
+TEST(transparent, no_key_conversion) {
+    tracked_key_set tree;
+    for (int i = 0; i < 1000; ++i) {
+        tree.insert(tracked_key(i * 2));
+    }
+    tracked_key::conversions = 0;
+    ASSERT_EQ(tree.lower_bound(500)->value, 500);
+    ASSERT_EQ(tree.lower_bound(501)->value, 502);
+    ASSERT_EQ(std::as_const(tree).upper_bound(500)->value, 502);
+    ASSERT_EQ(tree.upper_bound(1998), tree.end());
+    ASSERT_EQ(tree.rank(501), 251u);
+    ASSERT_EQ(tree.count(500), 1u);
+    ASSERT_EQ(tree.count(100, 200), 50u);
+    ASSERT_EQ(tracked_key::conversions, 0);
+}
+
+TEST(transparent, string_probes) {
+    const auto urls = make_urls();
+    const transparent_string_set<btree_default_traits<std::string, std::string>> plain(urls.begin(), urls.end());
+    const transparent_string_set<btree_string_traits<std::string, std::string>> compressed(urls.begin(), urls.end());
+    std::vector<std::string> probes{"", "https://example.com/static/assets/", "z"};
+    for (std::size_t i = 0; i < urls.size(); i += 13) {
+        probes.push_back(urls[i]);
+        probes.push_back(urls[i].substr(0, urls[i].size() - 1));
+    }
+    for (const auto& probe : probes) {
+        const std::string_view view = probe;
+        const auto lower = plain.lower_bound(probe);
+        const auto upper = plain.upper_bound(probe);
+        ASSERT_EQ(plain.lower_bound(view), lower);
+        ASSERT_EQ(plain.lower_bound(probe.c_str()), lower);
+        ASSERT_EQ(plain.upper_bound(view), upper);
+        ASSERT_EQ(std::distance(compressed.begin(), compressed.lower_bound(view)),
+                  std::distance(plain.begin(), lower));
+        ASSERT_EQ(std::distance(compressed.begin(), compressed.upper_bound(probe.c_str())),
+                  std::distance(plain.begin(), upper));
+    }
+}
+
+TEST(transparent, batched_string_probes) {
+    const auto urls = make_urls();
+    const transparent_string_set<btree_default_traits<std::string, std::string>> plain(urls.begin(), urls.end());
+    const transparent_string_set<btree_string_traits<std::string, std::string>> compressed(urls.begin(), urls.end());
+    std::vector<std::string_view> probes{"", "https://example.com/static/assets/", "z"};
+    for (std::size_t i = 0; i < urls.size(); i += 13) {
+        probes.push_back(urls[i]);
+        probes.push_back(std::string_view(urls[i]).substr(0, urls[i].size() - 1));
+    }
+    // Unsorted probes, then sorted ones sharing the searches of their common nodes
+    for (const bool sorted : {false, true}) {
+        if (sorted) {
+            std::sort(probes.begin(), probes.end());
+        }
+        std::vector<decltype(plain)::const_iterator> lower(probes.size());
+        std::vector<decltype(plain)::const_iterator> upper(probes.size());
+        std::vector<decltype(compressed)::const_iterator> compressed_lower(probes.size());
+        plain.lower_bound(std::span<const std::string_view>(probes), lower);
+        plain.upper_bound(std::span<const std::string_view>(probes), upper);
+        compressed.lower_bound(std::span<const std::string_view>(probes), compressed_lower);
+        for (std::size_t i = 0; i < probes.size(); ++i) {
+            ASSERT_EQ(lower[i], plain.lower_bound(probes[i])) << probes[i];
+            ASSERT_EQ(upper[i], plain.upper_bound(probes[i])) << probes[i];
+            ASSERT_EQ(std::distance(compressed.begin(), compressed_lower[i]), std::distance(plain.begin(), lower[i]));
+        }
+    }
+}
+
+TEST(transparent, batched_probes_not_comparable_together) {
+    using long_set = btree<long, long, btree_key_extractor_self, fractional_probe_less>;
+    static_assert(!std::is_invocable_v<const fractional_probe_less&, const double&, const double&>);
+    std::vector<long> values(5000);
+    std::iota(values.begin(), values.end(), 0L);
+    std::transform(values.begin(), values.end(), values.begin(), [](long v) { return v * 2; });
+    long_set tree(values.begin(), values.end());
+    std::vector<double> probes;
+    for (double probe = -1.5; probe < 10001; probe += 3.5) {
+        probes.push_back(probe);
+    }
+    std::vector<long_set::iterator> lower(probes.size());
+    std::vector<long_set::iterator> upper(probes.size());
+    tree.lower_bound(std::span<const double>(probes), lower);
+    tree.upper_bound(std::span<const double>(probes), upper);
+    for (std::size_t i = 0; i < probes.size(); ++i) {
+        ASSERT_EQ(lower[i], tree.lower_bound(probes[i])) << probes[i];
+        ASSERT_EQ(upper[i], tree.upper_bound(probes[i])) << probes[i];
+    }
+}
+
 /**
  * Lower bound
  */
@@ -36,6 +1465,196 @@ TEST(upper_bound_const, empty) {
     ASSERT_EQ(it, tree.end());
 }
 
+/**
+ * Finger search
+ */
+
+TEST(finger_search, empty) {
+    set<int> tree;
+    ASSERT_EQ(tree.lower_bound(tree.end(), 3), tree.end());
+    ASSERT_EQ(std::as_const(tree).upper_bound(tree.begin(), 3), tree.end());
+}
+
+TEST(finger_search, matches_lookups_from_root) {
+    // Each key three times, so that equivalent keys span leaves
+    std::vector<int> values;
+    for (int i = 0; i < 3000; ++i) {
+        values.push_back(i / 3 * 2);
+    }
+    small_node_set<int> tree(values.begin(), values.end());
+    std::vector<small_node_set<int>::const_iterator> hints{tree.begin(), tree.end()};
+    for (int key = 0; key < 2000; key += 97) {
+        hints.push_back(tree.lower_bound(key));
+        hints.push_back(tree.upper_bound(key));
+    }
+    for (const auto& hint : hints) {
+        for (int key = -2; key <= 2002; ++key) {
+            ASSERT_EQ(tree.lower_bound(hint, key), tree.lower_bound(key)) << key;
+            ASSERT_EQ(std::as_const(tree).upper_bound(hint, key), tree.upper_bound(key)) << key;
+        }
+    }
+}
+
+TEST(finger_search, nearby_keys_stay_in_leaves) {
+    std::vector<int> values(100000);
+    std::iota(values.begin(), values.end(), 0);
+    stats_set<int> tree(values.begin(), values.end());
+    auto hint = tree.lower_bound(50000);
+    const auto before = tree.get_counters();
+    ASSERT_GE(before.height, 3u);
+    // The next key is in the leaf of the hint, or in the next leaf when the hint is the last value of its leaf
+    for (int key = 50001; key < 50101; ++key) {
+        hint = tree.lower_bound(hint, key);
+        ASSERT_EQ(*hint, key);
+    }
+    const auto after = tree.get_counters();
+    ASSERT_EQ(after.lookups - before.lookups, 100u);
+    ASSERT_LT(after.nodes_visited - before.nodes_visited, 200u);
+    // Far keys are found by a descent from the root
+    ASSERT_EQ(*tree.lower_bound(hint, 10), 10);
+    ASSERT_EQ(*tree.upper_bound(tree.begin(), 99990), 99991);
+}
+
+TEST(finger_search, adjacent_leaves) {
+    std::vector<int> values(100000);
+    std::iota(values.begin(), values.end(), 0);
+    stats_set<int> tree(values.begin(), values.end());
+    const auto visits = [&tree](auto lookup) {
+        const auto before = tree.get_counters().nodes_visited;
+        lookup();
+        return tree.get_counters().nodes_visited - before;
+    };
+    // Last value of the leaf holding 50000
+    int last_key = 0;
+    tree.for_each_leaf_span([&](std::span<const int> span) {
+        if (span.front() <= 50000 && 50000 <= span.back()) {
+            last_key = span.back();
+        }
+    });
+    // From the last value of a leaf to the values of the next leaf, and back
+    const auto last = tree.lower_bound(last_key);
+    const auto first = std::next(last);
+    ASSERT_EQ(visits([&] { ASSERT_EQ(tree.lower_bound(last, *first), first); }), 2u);
+    ASSERT_EQ(visits([&] { ASSERT_EQ(tree.upper_bound(last, *first), std::next(first)); }), 2u);
+    ASSERT_EQ(visits([&] { ASSERT_EQ(tree.upper_bound(last, *first + 5), std::next(first, 6)); }), 2u);
+    ASSERT_EQ(visits([&] { ASSERT_EQ(tree.lower_bound(first, *last), last); }), 2u);
+    ASSERT_EQ(visits([&] { ASSERT_EQ(tree.upper_bound(first, *last), first); }), 2u);
+    ASSERT_EQ(visits([&] { ASSERT_EQ(tree.lower_bound(first, *last - 5), std::prev(last, 5)); }), 2u);
+}
+TEST(finger_search, far_hints_cost_a_descent) {
+    std::vector<int> values(100000);
+    std::iota(values.begin(), values.end(), 0);
+    stats_set<int> tree(values.begin(), values.end());
+    const auto visits = [&tree](auto lookup) {
+        const auto before = tree.get_counters().nodes_visited;
+        lookup();
+        return tree.get_counters().nodes_visited - before;
+    };
+    const auto from_root = visits([&] { ASSERT_EQ(*tree.lower_bound(51024), 51024); });
+    const auto hint = tree.lower_bound(50000);
+    // Keys a few leaves away from the hint, then at the other end of the tree, in both directions: the leaf of the
+    // hint and its sibling are checked before descending
+    for (const int key : {50100, 51024, 99000, 49900, 48976, 10}) {
+        ASSERT_LE(visits([&] { ASSERT_EQ(*tree.lower_bound(hint, key), key); }), from_root + 2) << key;
+        ASSERT_LE(visits([&] { ASSERT_EQ(*tree.upper_bound(hint, key), key + 1); }), from_root + 2) << key;
+    }
+    ASSERT_EQ(visits([&] { ASSERT_EQ(*tree.lower_bound(hint, 50001), 50001); }), 1u);
+}
+
+TEST(finger_search, transparent_probes) {
+    tracked_key_set tree;
+    for (int i = 0; i < 1000; ++i) {
+        tree.insert(tracked_key(i * 2));
+    }
+    tracked_key::conversions = 0;
+    const auto hint = tree.lower_bound(500);
+    ASSERT_EQ(tree.lower_bound(hint, 503)->value, 504);
+    ASSERT_EQ(tree.upper_bound(hint, 496)->value, 498);
+    ASSERT_TRUE(tree.seek_cursor().seek(1000));
+    ASSERT_EQ(tracked_key::conversions, 0);
+}
+
+TEST(seek_cursor, merge_join) {
+    std::vector<int> values(20000);
+    std::iota(values.begin(), values.end(), 0);
+    std::transform(values.begin(), values.end(), values.begin(), [](int v) { return v * 2; });
+    const set<int> tree(values.begin(), values.end());
+    // Join the even values of the tree with the multiples of 3, then of 301
+    for (const int step : {3, 301}) {
+        std::vector<int> stream;
+        for (int key = 0; key < 40200; key += step) {
+            stream.push_back(key);
+        }
+        std::vector<int> expected;
+        std::set_intersection(values.begin(), values.end(), stream.begin(), stream.end(), std::back_inserter(expected));
+        std::vector<int> joined;
+        auto cursor = tree.seek_cursor();
+        for (const int key : stream) {
+            if (cursor.seek(key)) {
+                joined.push_back(cursor.value());
+            }
+        }
+        ASSERT_EQ(joined, expected);
+        ASSERT_TRUE(cursor.at_end());
+        ASSERT_EQ(cursor.current(), tree.end());
+    }
+}
+
+TEST(seek_cursor, matches_lookups_from_root) {
+    // Each key three times, so that equivalent keys span leaves
+    std::vector<int> values;
+    for (int i = 0; i < 3000; ++i) {
+        values.push_back(i / 3 * 2);
+    }
+    const small_node_set<int> tree(values.begin(), values.end());
+    std::mt19937 generator(42);
+    for (const int max_step : {1, 10, 300, 3000}) {
+        auto cursor = tree.seek_cursor();
+        int key = -2;
+        while (key <= 2002) {
+            ASSERT_EQ(cursor.seek(key), std::binary_search(values.begin(), values.end(), key)) << key;
+            ASSERT_EQ(cursor.current(), tree.lower_bound(key)) << key;
+            // Mostly forward, sometimes backward
+            key += std::uniform_int_distribution<int>(-max_step / 4, max_step)(generator);
+        }
+    }
+    // Walking the whole tree from a seek in the middle
+    auto cursor = tree.seek_cursor();
+    cursor.seek(1000);
+    for (auto it = tree.lower_bound(1000); it != tree.end(); ++it) {
+        ASSERT_EQ(cursor.current(), it);
+        cursor.next();
+    }
+    ASSERT_TRUE(cursor.at_end());
+}
+
+TEST(seek_cursor, prefix_compressed) {
+    auto urls = make_urls();
+    const transparent_string_set<btree_string_traits<std::string, std::string>> tree(urls.begin(), urls.end());
+    std::sort(urls.begin(), urls.end());
+    auto cursor = tree.seek_cursor();
+    for (std::size_t i = 0; i < urls.size(); i += 7) {
+        const std::string_view probe = std::string_view(urls[i]).substr(0, urls[i].size() - 1);
+        cursor.seek(probe);
+        ASSERT_EQ(cursor.current(), tree.lower_bound(probe)) << probe;
+        ASSERT_TRUE(cursor.seek(urls[i]));
+    }
+}
+
+TEST(seek_cursor, next) {
+    const std::vector<int> values{1, 2, 3, 5, 8};
+    const set<int> tree(values.begin(), values.end());
+    auto cursor = tree.seek_cursor();
+    ASSERT_EQ(cursor.key(), 1);
+    ASSERT_FALSE(cursor.seek(4));
+    ASSERT_EQ(cursor.key(), 5);
+    cursor.next();
+    ASSERT_EQ(cursor.key(), 8);
+    cursor.next();
+    ASSERT_TRUE(cursor.at_end());
+    ASSERT_FALSE(cursor.seek(9));
+}
+
 /**
  * Iterators
  */
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <iterator>
+#include <string>
+#include <utility>
+
+// Helpers shared by the tests of the tree variants
+
+/**
+ * Path of a file in the temporary directory, removed at the beginning and at the end of the test. Names are prefixed
+ * by the variant tested, so that test programs run in parallel do not share files.
+ */
+struct temporary_file {
+    std::string path;
+
+    explicit temporary_file(const std::string& name)
+        : path((std::filesystem::temp_directory_path() / ("bplustree-" + name)).string()) {
+        std::filesystem::remove(path);
+    }
+    ~temporary_file() { std::filesystem::remove(path); }
+};
+
+/**
+ * Trivially copyable value of a map-like tree, storable in files.
+ */
+struct record {
+    std::int64_t key;
+    std::int64_t version;
+};
+
+struct record_key {
+    const std::int64_t& operator()(const record& r) const { return r.key; }
+};
+
+/**
+ * Key of a value of a tree or of a reference container: a set of integers, or a map of records versions by key.
+ */
+inline std::int64_t key_of(std::int64_t value) {
+    return value;
+}
+inline std::int64_t key_of(const record& r) {
+    return r.key;
+}
+inline std::int64_t key_of(const std::pair<const std::int64_t, std::int64_t>& p) {
+    return p.first;
+}
+
+inline bool same_value(std::int64_t a, std::int64_t b) {
+    return a == b;
+}
+inline bool same_value(const record& r, const std::pair<const std::int64_t, std::int64_t>& p) {
+    return r.key == p.first && r.version == p.second;
+}
+
+/**
+ * Check the content of `tree` against `reference`, a std::multiset or a std::map, then its bounds and if it has them its
+ * point lookups for every key in [first, last].
+ */
+template <typename Tree, typename Reference>
+void expect_equal(const Tree& tree, const Reference& reference, std::int64_t first, std::int64_t last) {
+    const auto same = [](const auto& a, const auto& b) { return same_value(a, b); };
+    ASSERT_EQ(static_cast<std::size_t>(std::distance(tree.begin(), tree.end())), reference.size());
+    ASSERT_TRUE(std::equal(tree.begin(), tree.end(), reference.begin(), reference.end(), same));
+    if constexpr (requires { tree.rbegin(); }) {
+        ASSERT_TRUE(std::equal(tree.rbegin(), tree.rend(), reference.rbegin(), reference.rend(), same));
+    }
+    for (std::int64_t key = first; key <= last; ++key) {
+        const auto lower = reference.lower_bound(key);
+        const auto upper = reference.upper_bound(key);
+        const auto tree_lower = tree.lower_bound(key);
+        const auto tree_upper = tree.upper_bound(key);
+        ASSERT_EQ(tree_lower == tree.end(), lower == reference.end()) << key;
+        if (lower != reference.end()) {
+            ASSERT_EQ(key_of(*tree_lower), key_of(*lower)) << key;
+        }
+        ASSERT_EQ(tree_upper == tree.end(), upper == reference.end()) << key;
+        if (upper != reference.end()) {
+            ASSERT_EQ(key_of(*tree_upper), key_of(*upper)) << key;
+        }
+        ASSERT_EQ(std::distance(tree_lower, tree_upper), std::distance(lower, upper)) << key;
+        if constexpr (requires { tree.contains(key); }) {
+            const bool present = lower != upper;
+            ASSERT_EQ(tree.contains(key), present) << key;
+            ASSERT_EQ(tree.find(key) != tree.end(), present) << key;
+            if (present) {
+                ASSERT_TRUE(same_value(*tree.find(key), *lower)) << key;
+            }
+        }
+    }
+}